@@ -0,0 +1,53 @@
+/*
+ * Copyright (c) 2022, Bernd Bauer <bernd.bauer@gmx.at>
+ *
+ * SPDX-License-Identifier: BSD-2-Clause
+ */
+
+#ifndef AOT_H
+#define AOT_H
+
+#include <stdint.h>
+
+#include "core/bus.h"
+#include "core/cpu6502_alu.h"
+
+/* Ahead-of-time recompiled ROM images as emitted by 6502-recomp. Every
+ * recompiled instruction is an entry point; CPU6502_run() calls the block
+ * function registered for the current PC and interprets everything else. */
+
+/* Recompiled code returns to the interpreter as soon as an interrupt or
+ * hook is pending or the run deadline is reached. Invalidated blocks, e.g.
+ * by a bank switch, clear the deadline so the old code stops right after
+ * the access. */
+#define AOT_STOP(cpu) (((cpu)->pending | (cpu)->hooks) != 0 || (cpu)->clock_count >= (cpu)->deadline)
+
+/* Little endian pointer in the zero page, the high byte wraps to 0x00 */
+static inline uint16_t aot_zpWord(struct Bus *bus, uint8_t zp)
+{
+  return bus_read_fast(bus, zp) | (bus_read_fast(bus, (uint8_t)(zp + 1)) << 8);
+}
+
+struct AotEntry
+{
+  uint16_t pc;
+  CPU6502_BlockFn fn;
+};
+
+struct AotImage
+{
+  uint16_t base;              /* ROM image the code was generated from */
+  uint32_t size;
+  uint32_t hash;              /* aot_hash() of the image */
+
+  const struct AotEntry *entries;
+  int count;
+};
+
+uint32_t aot_hash(const uint8_t *data, uint32_t len);
+
+/* Install the image if the bus content still matches its hash, entry
+ * points outside ROM are left to the interpreter */
+int aot_install(struct Bus *bus, const struct AotImage *image);
+
+#endif /* AOT_H */
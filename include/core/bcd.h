@@ -0,0 +1,27 @@
+/*
+ * Copyright (c) 2022, Bernd Bauer <bernd.bauer@gmx.at>
+ *
+ * SPDX-License-Identifier: BSD-2-Clause
+ */
+
+#ifndef BCD_H
+#define BCD_H
+
+#include <stdint.h>
+
+#include "core/cpu6502.h"
+
+/* Flags delivered by the decimal mode tables */
+#define BCD_FLAGS (CPU6502_FLAG_NEGATIVE | CPU6502_FLAG_OVERFLOW | CPU6502_FLAG_ZERO | CPU6502_FLAG_CARRY)
+
+/* Decimal mode ADC/SBC results of the NMOS 6502 indexed by
+ * [carry][A][operand]. The low byte of an entry is the new accumulator,
+ * the high byte holds N, V, Z and C in their status register positions.
+ * As on the NMOS part Z, and for SBC also N and V, follow the binary
+ * result. Filled by bcd_init(). */
+extern uint16_t bcd_adc_table[2][256][256];
+extern uint16_t bcd_sbc_table[2][256][256];
+
+void bcd_init(void);
+
+#endif /* BCD_H */
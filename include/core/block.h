@@ -0,0 +1,74 @@
+/*
+ * Copyright (c) 2022, Bernd Bauer <bernd.bauer@gmx.at>
+ *
+ * SPDX-License-Identifier: BSD-2-Clause
+ */
+
+#ifndef BLOCK_H
+#define BLOCK_H
+
+#include <stdint.h>
+
+struct Bus;
+struct Device;
+
+#define BLOCK_REGISTERS   16
+#define BLOCK_SECTOR_SIZE 512
+#define BLOCK_LATENCY     2000  /* default cycles from command to completion */
+
+/* Register offsets */
+#define BLOCK_COMMAND 0x00 /* RW: BLOCK_CMD_*, a write starts the command */
+#define BLOCK_STATUS  0x01 /* R: BLOCK_STATUS_* / W: acknowledge completion */
+#define BLOCK_CONTROL 0x02 /* RW: BLOCK_CONTROL_* */
+#define BLOCK_COUNT   0x03 /* RW: sectors to transfer */
+#define BLOCK_ADDRL   0x04 /* RW: DMA address low */
+#define BLOCK_ADDRH   0x05 /* RW: DMA address high */
+#define BLOCK_LBA0    0x06 /* RW: first sector, little endian 0x06 - 0x09 */
+#define BLOCK_SIZE0   0x0A /* R: image size in sectors, little endian 0x0a - 0x0d */
+
+#define BLOCK_CMD_READ   0x01 /* image to memory */
+#define BLOCK_CMD_WRITE  0x02 /* memory to image */
+#define BLOCK_CMD_FLUSH  0x03 /* write the image back to disk */
+
+#define BLOCK_STATUS_BUSY  0x01
+#define BLOCK_STATUS_DONE  0x02
+#define BLOCK_STATUS_ERROR 0x04
+#define BLOCK_STATUS_IRQ   0x80
+
+#define BLOCK_CONTROL_IRQ  0x01 /* interrupt on completion */
+
+/* Block storage on a memory mapped disk image. A command latches count,
+ * address and sector and completes latency cycles later: the sectors are
+ * copied between the mapping and the address space at once, page by page
+ * through the page table, then DONE is set and the IRQ raised if enabled.
+ * Writing the status register acknowledges the completion. */
+struct Block
+{
+  struct Bus *bus;
+  struct Device *dev;
+  int irq;
+  uint8_t asserted;
+  uint64_t latency;
+
+  int fd;
+  uint8_t *image;
+  uint32_t sectors;
+  uint8_t readonly;
+
+  uint8_t command;
+  uint8_t status;
+  uint8_t control;
+  uint8_t count;
+  uint16_t addr;
+  uint32_t lba;
+
+  /* Command in flight */
+  uint8_t job_count;
+  uint16_t job_addr;
+  uint32_t job_lba;
+};
+
+struct Block* block_create(struct Bus *bus, uint16_t start, int irq, const char *image, uint64_t latency);
+void block_destroy(struct Block **block);
+
+#endif /* BLOCK_H */
@@ -11,13 +11,106 @@
 
 #include "core/cpu6502.h"
 #include "core/memory.h"
+#include "core/scheduler.h"
+#include "core/stop.h"
+#include "core/debug.h"
+#include "core/device.h"
+#include "core/shmview.h"
+
+#define BUS_PAGE_SHIFT 8
+#define BUS_PAGE_SIZE  (1 << BUS_PAGE_SHIFT)
+#define BUS_PAGE_MASK  (BUS_PAGE_SIZE - 1)
+#define BUS_PAGES      (0x10000 >> BUS_PAGE_SHIFT)
+
+#define BUS_RUN_FOREVER SCHEDULER_NEVER
+
+#define BUS_IRQ_LINES 8
+
+#define BUS_MAX_REGIONS 32
+
+enum BusStopReason
+{
+  BUS_RUNNING = 0,
+  BUS_STOP_REQUEST,
+  BUS_STOP_IDLE,
+  BUS_STOP_CYCLES,
+  BUS_STOP_INSTRUCTIONS,
+  BUS_STOP_PC,
+  BUS_STOP_BRK,
+  BUS_STOP_WRITE,
+  BUS_STOP_TIMEOUT,
+  BUS_STOP_BREAKPOINT,
+  BUS_STOP_WATCHPOINT,
+  BUS_STOP_EXIT,
+  BUS_STOP_YIELD
+};
+
+enum BusRegionType
+{
+  BUS_REGION_RAM = 0,
+  BUS_REGION_ROM,
+  BUS_REGION_MIRROR
+};
+
+struct Bus;
+
+/* Page aligned part of the address space backed by memory. A mirror
+ * repeats what is mapped at source, later regions cover earlier ones.
+ * Windows show mem from offset on and can be remapped, their memory
+ * belongs to whoever added them. */
+struct BusRegion
+{
+  uint8_t type;
+  uint8_t owned;
+  uint32_t start;
+  uint32_t size;
+  struct Memory *mem;
+  uint32_t offset;
+  uint32_t source;
+};
+
+/* Context of a scheduled IRQ line change */
+struct BusIrqLine
+{
+  struct Bus *bus;
+  uint8_t mask;
+};
 
 struct Bus
 {
+  /* First RAM and ROM region, owned through the region list */
   struct Memory *ram;
   struct Memory *rom;
   struct CPU6502 *cpu;
+  struct Scheduler *sched;
+  struct StopConditions *stopcond;
+  struct Debugger *dbg;
+  struct ShmView *shmview;
   uint8_t stop;
+  uint8_t resumed;
+
+  struct BusIrqLine irq[BUS_IRQ_LINES];
+
+  struct BusRegion region[BUS_MAX_REGIONS];
+  int regions;
+
+  /* Memory behind every page regardless of traps, NULL if unmapped */
+  uint8_t *backing[BUS_PAGES];
+  uint8_t readonly[BUS_PAGES];
+
+  /* Page table: direct host pointers per 256 byte page. NULL routes the
+   * access through bus_read()/bus_write(). */
+  uint8_t *rpage[BUS_PAGES];
+  uint8_t *wpage[BUS_PAGES];
+
+  /* Pages whose accesses have to take the slow path, reference counted */
+  uint8_t rtrap[BUS_PAGES];
+  uint8_t wtrap[BUS_PAGES];
+
+  /* Attached devices sorted by address and per page the first device
+   * reaching into it, consulted on trapped pages only */
+  struct Device *devices;
+  struct Device *dev[BUS_PAGES];
 };
 
 struct Bus* bus_create();
@@ -25,7 +118,70 @@ int bus_destroy(struct Bus** bus);
 
 int bus_reset(struct Bus* bus);
 int bus_clock(struct Bus* bus);
+int bus_run(struct Bus* bus, uint64_t cycles);
 int bus_is_set_to_stop(struct Bus* bus);
 int bus_set_to_stop(struct Bus* bus);
+int bus_stop(struct Bus* bus, int reason);
+int bus_resume(struct Bus* bus);
+const char* bus_stop_reason_string(int reason);
+
+struct Memory* bus_add_memory(struct Bus* bus, uint8_t type, uint32_t start, uint32_t size);
+int bus_add_mirror(struct Bus* bus, uint32_t start, uint32_t size, uint32_t source);
+int bus_add_window(struct Bus* bus, uint8_t type, uint32_t start, uint32_t size, struct Memory *mem, uint32_t offset);
+int bus_remap(struct Bus* bus, int region, uint32_t offset);
+int bus_remove_region(struct Bus* bus, int region);
+int bus_clear_regions(struct Bus* bus);
+
+int bus_map(struct Bus* bus);
+int bus_trap_read(struct Bus* bus, uint16_t addr, uint8_t enable);
+int bus_trap_write(struct Bus* bus, uint16_t addr, uint8_t enable);
+
+int bus_cpu_hook(struct Bus* bus, uint16_t pc);
+int bus_cpu_brk(struct Bus* bus);
+
+int bus_irq_assert(struct Bus* bus, int line);
+int bus_irq_release(struct Bus* bus, int line);
+int bus_nmi_assert(struct Bus* bus);
+int bus_nmi_release(struct Bus* bus);
+int bus_irq_assert_at(struct Bus* bus, int line, uint64_t when);
+int bus_irq_release_at(struct Bus* bus, int line, uint64_t when);
+int bus_nmi_at(struct Bus* bus, uint64_t when);
+
+uint8_t bus_read(struct Bus *bus, uint16_t addr);
+uint8_t bus_peek(struct Bus *bus, uint16_t addr);
+void bus_poke(struct Bus *bus, uint16_t addr, uint8_t data);
+int bus_peek_block(struct Bus *bus, uint16_t addr, uint8_t *dst, uint32_t len);
+int bus_write_block(struct Bus *bus, uint16_t addr, const uint8_t *src, uint32_t len);
+void bus_write(struct Bus *bus, uint16_t addr, uint8_t data);
+
+/* True if addr is backed by memory without side effects on access */
+static inline int bus_is_plain_memory(struct Bus *bus, uint16_t addr)
+{
+  return bus->rpage[addr >> BUS_PAGE_SHIFT] != NULL;
+}
+
+/* Inline fast path used by the statically bound CPU core */
+static inline uint8_t bus_read_fast(struct Bus *bus, uint16_t addr)
+{
+  uint8_t *page = bus->rpage[addr >> BUS_PAGE_SHIFT];
+
+  if(page != NULL)
+  {
+    return page[addr & BUS_PAGE_MASK];
+  }
+  return bus_read(bus, addr);
+}
+
+static inline void bus_write_fast(struct Bus *bus, uint16_t addr, uint8_t data)
+{
+  uint8_t *page = bus->wpage[addr >> BUS_PAGE_SHIFT];
+
+  if(page != NULL)
+  {
+    page[addr & BUS_PAGE_MASK] = data;
+    return;
+  }
+  bus_write(bus, addr, data);
+}
 
 #endif /* BUS_H */
@@ -11,6 +11,62 @@
 
 #include "core/bus.h"
 
+#define CPU6502_VECTOR_NMI   0xFFFA
+#define CPU6502_VECTOR_RESET 0xFFFC
+#define CPU6502_VECTOR_IRQ   0xFFFE
+
+/* Status register bits */
+#define CPU6502_FLAG_CARRY    0x01
+#define CPU6502_FLAG_ZERO     0x02
+#define CPU6502_FLAG_IRQB     0x04
+#define CPU6502_FLAG_DECIMAL  0x08
+#define CPU6502_FLAG_BRK      0x10
+#define CPU6502_FLAG_NU       0x20
+#define CPU6502_FLAG_OVERFLOW 0x40
+#define CPU6502_FLAG_NEGATIVE 0x80
+
+/* Instruction boundary hooks, see bus_cpu_hook() */
+#define CPU6502_HOOK_STOP    0x01
+#define CPU6502_HOOK_DEBUG   0x02
+
+/* Core used by CPU6502_run(), see CPU6502_setAccuracy() */
+enum CPU6502Accuracy
+{
+  CPU6502_ACCURACY_FAST = 0,  /* whole instructions, fusion and recompiled code */
+  CPU6502_ACCURACY_EXACT      /* every bus cycle in order with dummy accesses */
+};
+
+/* Addressing modes as reported by CPU6502_opcodeInfo() */
+enum CPU6502AddrMode
+{
+  CPU6502_MODE_IMP = 0,
+  CPU6502_MODE_IMM,
+  CPU6502_MODE_ZPG,
+  CPU6502_MODE_ZPX,
+  CPU6502_MODE_ZPY,
+  CPU6502_MODE_REL,
+  CPU6502_MODE_ABS,
+  CPU6502_MODE_ABX,
+  CPU6502_MODE_ABY,
+  CPU6502_MODE_IND,
+  CPU6502_MODE_IZX,
+  CPU6502_MODE_IZY
+};
+
+struct CPU6502OpInfo
+{
+  const char *mnemonic;   /* empty for illegal opcodes */
+  uint8_t cycles;         /* base cycles without page crossing or branch */
+  uint8_t mode;           /* enum CPU6502AddrMode */
+  uint8_t length;         /* instruction length in bytes */
+};
+
+struct CPU6502;
+
+/* Recompiled code entered at PC. Executes at least one instruction and
+ * advances PC and clock_count itself. */
+typedef void (*CPU6502_BlockFn)(struct CPU6502 *cpu);
+
 struct CPU6502
 {
   struct {
@@ -43,12 +99,40 @@ struct CPU6502
   } Reg;
 
   uint8_t  cycles;
-  uint32_t clock_count;
+  uint64_t clock_count;
+  uint64_t deadline;    /* CPU6502_run() executes until clock_count reaches it */
+
+  /* Interrupt lines. IRQ is level triggered with one bit per source, NMI
+   * is edge triggered and latched in nmi_edge. pending is non zero while
+   * an interrupt has to be serviced at the next instruction boundary. */
+  uint8_t  irq_lines;
+  uint8_t  nmi_line;
+  uint8_t  nmi_edge;
+  uint8_t  pending;
+
+  /* Non zero while any instruction boundary hook is armed */
+  uint8_t  hooks;
+
+  /* CPU6502_run() executes common instruction sequences as one fused
+   * step while no interrupt or hook is pending */
+  uint8_t  fusion;
+
+  /* enum CPU6502Accuracy, switched at instruction boundaries */
+  uint8_t  accuracy;
+
+  /* Execution count of every opcode pair [previous << 8 | opcode] while
+   * profiling, NULL otherwise */
+  uint64_t *pairs;
+
+  /* Recompiled code per PC, see aot_install(); NULL entries and a NULL
+   * table are interpreted */
+  CPU6502_BlockFn *blocks;
 
   uint8_t  opcode;
   uint8_t  fetched;
   uint16_t addr_abs;
   uint16_t addr_rel;
+  uint16_t addr_unfixed;  /* indexed address before the page carry, exact core */
 
   struct Bus* bus;
 
@@ -63,6 +147,22 @@ int CPU6502_reset(struct CPU6502 *cpu);
 
 int CPU6502_clock(struct CPU6502 *cpu);
 int CPU6502_complete(struct CPU6502 *cpu);
+uint64_t CPU6502_now(struct CPU6502 *cpu);
+int CPU6502_step(struct CPU6502 *cpu);
+int CPU6502_run(struct CPU6502 *cpu);
+
+int CPU6502_irq(struct CPU6502 *cpu);
+int CPU6502_nmi(struct CPU6502 *cpu);
+int CPU6502_setIrqLine(struct CPU6502 *cpu, uint8_t line, uint8_t level);
+int CPU6502_setNmiLine(struct CPU6502 *cpu, uint8_t level);
+
+int CPU6502_setFusion(struct CPU6502 *cpu, uint8_t enable);
+int CPU6502_setAccuracy(struct CPU6502 *cpu, uint8_t accuracy);
+int CPU6502_invalidateBlocks(struct CPU6502 *cpu, uint16_t addr, uint32_t len);
+int CPU6502_profilePairs(struct CPU6502 *cpu, uint8_t enable);
+int CPU6502_reportPairs(struct CPU6502 *cpu, int count);
+
+int CPU6502_opcodeInfo(uint8_t opcode, struct CPU6502OpInfo *info);
 
 int CPU6502_dumpStatus(struct CPU6502 *cpu);
 
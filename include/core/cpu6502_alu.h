@@ -0,0 +1,117 @@
+/*
+ * Copyright (c) 2022, Bernd Bauer <bernd.bauer@gmx.at>
+ *
+ * SPDX-License-Identifier: BSD-2-Clause
+ */
+
+#ifndef CPU6502_ALU_H
+#define CPU6502_ALU_H
+
+#include <stdint.h>
+
+#include "core/cpu6502.h"
+#include "core/bcd.h"
+
+/* Flag kernels shared by the interpreter and recompiled code */
+
+/* N and Z flags of every 8 bit result */
+static const uint8_t CPU6502_nz[256] = {
+  0x02, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+  0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+  0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+  0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+  0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+  0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+  0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+  0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+  0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80,
+  0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80,
+  0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80,
+  0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80,
+  0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80,
+  0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80,
+  0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80,
+  0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80,
+};
+
+#define CPU6502_FLAGS_NZ   (CPU6502_FLAG_NEGATIVE | CPU6502_FLAG_ZERO)
+#define CPU6502_FLAGS_NZC  (CPU6502_FLAGS_NZ | CPU6502_FLAG_CARRY)
+#define CPU6502_FLAGS_NVZC (CPU6502_FLAGS_NZC | CPU6502_FLAG_OVERFLOW)
+
+/* Branch free flag kernels. Each one replaces the affected flags in one
+ * read-modify-write of the status register. */
+static inline void CPU6502_setNZ(struct CPU6502 *cpu, uint8_t value)
+{
+  cpu->Reg.PSR = (cpu->Reg.PSR & ~CPU6502_FLAGS_NZ) | CPU6502_nz[value];
+}
+
+/* sum is a + b + carry; C from bit 8, V if both operands have the same
+ * sign and the result differs from it */
+static inline void CPU6502_setAddFlags(struct CPU6502 *cpu, uint8_t a, uint8_t b, uint16_t sum)
+{
+  cpu->Reg.PSR = (cpu->Reg.PSR & ~CPU6502_FLAGS_NVZC) |
+                 CPU6502_nz[sum & 0xFF] |
+                 (sum >> 8) |
+                 (((a ^ sum) & (b ^ sum) & 0x80) >> 1);
+}
+
+/* reg - value without borrow, C is set if no borrow occurs */
+static inline void CPU6502_setCompareFlags(struct CPU6502 *cpu, uint8_t reg, uint8_t value)
+{
+  uint16_t diff = reg + (value ^ 0xFF) + 1;
+
+  cpu->Reg.PSR = (cpu->Reg.PSR & ~CPU6502_FLAGS_NZC) | CPU6502_nz[diff & 0xFF] | (diff >> 8);
+}
+
+/* Shift and rotate result with the bit shifted out as carry */
+static inline void CPU6502_setShiftFlags(struct CPU6502 *cpu, uint8_t result, uint8_t carry)
+{
+  cpu->Reg.PSR = (cpu->Reg.PSR & ~CPU6502_FLAGS_NZC) | CPU6502_nz[result] | carry;
+}
+
+/* ADC including decimal mode */
+static inline void CPU6502_aluAdc(struct CPU6502 *cpu, uint8_t value)
+{
+  uint16_t temp;
+
+  if(cpu->Reg.DECIMAL)
+  {
+    temp = bcd_adc_table[cpu->Reg.CARRY][cpu->Reg.A][value];
+    cpu->Reg.PSR = (cpu->Reg.PSR & ~BCD_FLAGS) | (temp >> 8);
+    cpu->Reg.A = temp & 0x00FF;
+    return;
+  }
+
+  temp = cpu->Reg.A + value + cpu->Reg.CARRY;
+  CPU6502_setAddFlags(cpu, cpu->Reg.A, value, temp);
+  cpu->Reg.A = 0x00FF & temp;
+}
+
+/* SBC including decimal mode, A - M - !C is A + ~M + C */
+static inline void CPU6502_aluSbc(struct CPU6502 *cpu, uint8_t value)
+{
+  uint16_t temp;
+
+  if(cpu->Reg.DECIMAL)
+  {
+    temp = bcd_sbc_table[cpu->Reg.CARRY][cpu->Reg.A][value];
+    cpu->Reg.PSR = (cpu->Reg.PSR & ~BCD_FLAGS) | (temp >> 8);
+    cpu->Reg.A = temp & 0x00FF;
+    return;
+  }
+
+  value ^= 0xFF;
+  temp = cpu->Reg.A + value + cpu->Reg.CARRY;
+  CPU6502_setAddFlags(cpu, cpu->Reg.A, value, temp);
+  cpu->Reg.A = 0x00FF & temp;
+}
+
+/* BIT: N and V are copied from the operand, Z from A AND operand */
+static inline void CPU6502_aluBit(struct CPU6502 *cpu, uint8_t value)
+{
+  cpu->Reg.PSR = (cpu->Reg.PSR & ~(CPU6502_FLAGS_NZ | CPU6502_FLAG_OVERFLOW)) |
+                 (value & (CPU6502_FLAG_NEGATIVE | CPU6502_FLAG_OVERFLOW)) |
+                 (CPU6502_nz[cpu->Reg.A & value] & CPU6502_FLAG_ZERO);
+}
+
+#endif /* CPU6502_ALU_H */
@@ -0,0 +1,44 @@
+/*
+ * Copyright (c) 2022, Bernd Bauer <bernd.bauer@gmx.at>
+ *
+ * SPDX-License-Identifier: BSD-2-Clause
+ */
+
+#ifndef CPU6502_CORE_H
+#define CPU6502_CORE_H
+
+#include <stdint.h>
+
+#include "core/bus.h"
+#include "core/cpu6502.h"
+
+/* Internals shared by cpu6502.c and the fast and exact cores, which are
+ * both built from the instruction definitions in src/core/cpu6502_ops.h */
+
+/* With CPU6502_STATIC_BUS the core is bound to the bus at compile time so
+ * memory accesses inline into the handlers. Otherwise the read/write
+ * function pointers passed to CPU6502_create() are used. */
+#ifdef CPU6502_STATIC_BUS
+#define CPU6502_busRead(cpu, addr)        bus_read_fast((cpu)->bus, (addr))
+#define CPU6502_busWrite(cpu, addr, data) bus_write_fast((cpu)->bus, (addr), (data))
+#else
+#define CPU6502_busRead(cpu, addr)        (cpu)->read((cpu)->bus, (addr))
+#define CPU6502_busWrite(cpu, addr, data) (cpu)->write((cpu)->bus, (addr), (data))
+#endif
+
+static inline void CPU6502_updatePending(struct CPU6502 *cpu)
+{
+  cpu->pending = cpu->nmi_edge | (cpu->irq_lines != 0 && cpu->Reg.IRQB == 0);
+}
+
+/* Execute one instruction or interrupt, returns its cycles */
+uint8_t CPU6502_executeFast(struct CPU6502 *cpu);
+uint8_t CPU6502_executeExact(struct CPU6502 *cpu);
+
+void CPU6502_interruptFast(struct CPU6502 *cpu, uint16_t vector);
+void CPU6502_interruptExact(struct CPU6502 *cpu, uint16_t vector);
+
+/* Fused instruction sequences, fast core only */
+uint8_t CPU6502_fuse(struct CPU6502 *cpu);
+
+#endif /* CPU6502_CORE_H */
@@ -0,0 +1,73 @@
+/*
+ * Copyright (c) 2022, Bernd Bauer <bernd.bauer@gmx.at>
+ *
+ * SPDX-License-Identifier: BSD-2-Clause
+ */
+
+#ifndef DEBUG_H
+#define DEBUG_H
+
+#include <stdint.h>
+
+struct Bus;
+struct CPU6502;
+
+#define DEBUG_MAX_CONDITIONS 32
+
+#define DEBUG_WATCH_READ  0x01
+#define DEBUG_WATCH_WRITE 0x02
+
+enum DebugHit
+{
+  DEBUG_HIT_NONE = 0,
+  DEBUG_HIT_BREAK,
+  DEBUG_HIT_READ,
+  DEBUG_HIT_WRITE
+};
+
+typedef int (*debug_CondFn)(struct CPU6502 *cpu, void *ctx);
+
+struct DebugCondition
+{
+  uint16_t pc;
+  debug_CondFn fn;
+  void *ctx;
+};
+
+/* Breakpoints and watchpoints as per address bitmaps. Breakpoints enable
+ * the CPU boundary hook, watchpoints trap only the pages they cover, so
+ * pages without anything armed keep their direct page table pointers. */
+struct Debugger
+{
+  struct Bus *bus;
+
+  uint8_t exec[0x10000 / 8];
+  uint8_t rwatch[0x10000 / 8];
+  uint8_t wwatch[0x10000 / 8];
+
+  uint32_t exec_count;
+  uint16_t rcount[256];
+  uint16_t wcount[256];
+
+  struct DebugCondition cond[DEBUG_MAX_CONDITIONS];
+  int cond_count;
+
+  int hit;
+  uint16_t hit_addr;
+};
+
+struct Debugger* debug_create(struct Bus *bus);
+void debug_destroy(struct Debugger **dbg);
+
+int debug_break_set(struct Debugger *dbg, uint16_t pc);
+int debug_break_clear(struct Debugger *dbg, uint16_t pc);
+int debug_break_condition(struct Debugger *dbg, uint16_t pc, debug_CondFn fn, void *ctx);
+
+int debug_watch_set(struct Debugger *dbg, uint16_t start, uint16_t end, uint8_t type);
+int debug_watch_clear(struct Debugger *dbg, uint16_t start, uint16_t end, uint8_t type);
+
+int debug_hook(struct Debugger *dbg, uint16_t pc, uint8_t resumed);
+int debug_read(struct Debugger *dbg, uint16_t addr);
+int debug_write(struct Debugger *dbg, uint16_t addr, uint8_t data);
+
+#endif /* DEBUG_H */
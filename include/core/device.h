@@ -0,0 +1,65 @@
+/*
+ * Copyright (c) 2022, Bernd Bauer <bernd.bauer@gmx.at>
+ *
+ * SPDX-License-Identifier: BSD-2-Clause
+ */
+
+#ifndef DEVICE_H
+#define DEVICE_H
+
+#include <stdint.h>
+
+struct Bus;
+
+/* Callbacks of a memory mapped device. Register accesses get the offset
+ * from the start of the claimed range, tick is called when the event
+ * posted with device_schedule() fires. Every callback but write may be
+ * NULL. Without read only writes are trapped, reads take the fast path to
+ * the memory mapped behind the device.
+ *
+ * Devices are not clocked along with the CPU. sync runs the state machine
+ * forward in bulk from the cycle the device was last synchronized to, right
+ * before a register access reaches read or write and before tick. Idle
+ * devices therefore cost nothing, however many cycles pass. */
+struct DeviceOps
+{
+  const char *name;
+
+  uint8_t (*read)(void *ctx, uint16_t offset);
+  void (*write)(void *ctx, uint16_t offset, uint8_t data);
+  uint8_t (*peek)(void *ctx, uint16_t offset);
+  void (*sync)(void *ctx, uint64_t from, uint64_t to);
+  void (*tick)(void *ctx, uint64_t now);
+  void (*reset)(void *ctx);
+  void (*destroy)(void *ctx);
+};
+
+/* A device claims [start, end] of the address space. Its pages are trapped,
+ * so only accesses to them leave the page table fast path. Devices are kept
+ * sorted by start address, several of them may share a page. */
+struct Device
+{
+  struct Bus *bus;
+  const struct DeviceOps *ops;
+  void *ctx;
+
+  uint16_t start;
+  uint16_t end;
+
+  int event;
+  uint64_t synced;    /* CPU cycle the device state belongs to */
+
+  struct Device *next;
+};
+
+struct Device* device_attach(struct Bus *bus, uint16_t start, uint16_t end, const struct DeviceOps *ops, void *ctx);
+int device_detach(struct Device **dev);
+
+int device_schedule(struct Device *dev, uint64_t when);
+int device_cancel(struct Device *dev);
+int device_sync(struct Device *dev, uint64_t now);
+
+struct Device* device_find(struct Bus *bus, uint16_t addr);
+struct Device* device_lookup(struct Bus *bus, const char *name);
+
+#endif /* DEVICE_H */
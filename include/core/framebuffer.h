@@ -0,0 +1,72 @@
+/*
+ * Copyright (c) 2022, Bernd Bauer <bernd.bauer@gmx.at>
+ *
+ * SPDX-License-Identifier: BSD-2-Clause
+ */
+
+#ifndef FRAMEBUFFER_H
+#define FRAMEBUFFER_H
+
+#include <stdio.h>
+#include <stdint.h>
+
+struct Bus;
+struct Device;
+struct Offload;
+
+#define FRAMEBUFFER_INTERVAL 20000  /* default cycles per frame, 50 Hz at 1 MHz */
+
+#define FRAMEBUFFER_OUTPUT_NONE 0
+#define FRAMEBUFFER_OUTPUT_PPM  1   /* one PPM per frame, a %d in the name numbers them */
+#define FRAMEBUFFER_OUTPUT_RAW  2   /* RGBA frames appended to one file */
+
+/* Memory mapped framebuffer of 1, 2, 4 or 8 bits per pixel, the leftmost
+ * pixel in the high bits. 8 bit pixels are RGB 3:3:2, fewer bits are grey
+ * levels. Rendering converts only dirty scanlines to the RGBA host buffer,
+ * and a frame is only written at the next interval boundary after a
+ * change. An unchanged screen schedules no event and converts nothing.
+ *
+ * Conversion and frame output are the back end of an Offload. The guest
+ * side keeps vram and queues every changed byte as a stamped write, a
+ * frame boundary as an advance. The back end applies the writes to its
+ * own copy in shadow and owns everything below it. framebuffer_render()
+ * is the sync point, only after it the host may look at rgba, frames or
+ * converted. */
+struct Framebuffer
+{
+  struct Bus *bus;
+  struct Device *dev;
+  struct Offload *off;
+
+  uint16_t width;
+  uint16_t height;
+  uint8_t bpp;
+  uint16_t pitch;           /* bytes per scanline */
+  uint32_t size;
+
+  uint8_t *vram;
+  uint8_t booked;           /* changed since the last frame, frame event on */
+  uint64_t interval;
+  uint8_t format;
+
+  uint8_t *shadow;          /* vram as far as the back end got */
+  uint8_t *rgba;            /* width * height * 4, R G B A */
+  uint8_t palette[256][3];
+
+  uint32_t *dirty;          /* one bit per scanline */
+  uint8_t pending;          /* any scanline dirty */
+
+  char *output;
+  FILE *fp;                 /* raw stream */
+  uint32_t frames;          /* frames written */
+  uint64_t converted;       /* scanlines converted */
+};
+
+struct Framebuffer* framebuffer_create(struct Bus *bus, uint16_t start, uint16_t width, uint16_t height, uint8_t bpp,
+                                       const char *output, uint64_t interval, uint64_t max_lag);
+void framebuffer_destroy(struct Framebuffer **fb);
+
+int framebuffer_render(struct Framebuffer *fb);
+int framebuffer_save(struct Framebuffer *fb, const char *filename);
+
+#endif /* FRAMEBUFFER_H */
@@ -0,0 +1,47 @@
+/*
+ * Copyright (c) 2022, Bernd Bauer <bernd.bauer@gmx.at>
+ *
+ * SPDX-License-Identifier: BSD-2-Clause
+ */
+
+#ifndef GDBSTUB_H
+#define GDBSTUB_H
+
+#include <stdint.h>
+#include <stddef.h>
+
+struct Bus;
+
+#define GDBSTUB_PACKET_SIZE 0x4000
+#define GDBSTUB_RUN_SLICE   100000
+
+/* GDB remote serial protocol server. The endpoint is either a TCP port on
+ * the loopback interface or the path of a Unix domain socket.
+ *
+ * Register layout for 'g'/'G': A, X, Y, P, SP as one byte each followed
+ * by PC as 16 bit little endian value. */
+struct GdbStub
+{
+  struct Bus *bus;
+
+  int listen_fd;
+  int fd;
+  char *path;
+
+  uint8_t no_ack;
+
+  char rbuf[4096];
+  size_t rpos;
+  size_t rlen;
+
+  char in[GDBSTUB_PACKET_SIZE + 4];
+  size_t in_len;
+  char out[GDBSTUB_PACKET_SIZE * 2 + 8];
+};
+
+struct GdbStub* gdbstub_create(struct Bus *bus, const char *endpoint);
+void gdbstub_destroy(struct GdbStub **gdb);
+
+int gdbstub_serve(struct GdbStub *gdb);
+
+#endif /* GDBSTUB_H */
@@ -0,0 +1,57 @@
+/*
+ * Copyright (c) 2022, Bernd Bauer <bernd.bauer@gmx.at>
+ *
+ * SPDX-License-Identifier: BSD-2-Clause
+ */
+
+#ifndef HOSTCALL_H
+#define HOSTCALL_H
+
+#include <stdint.h>
+
+struct Bus;
+struct Device;
+
+#define HOSTCALL_DEFAULT_PAGE 0x7F
+#define HOSTCALL_BUFFER_SIZE  0x10000
+#define HOSTCALL_MAX_RESULTS  256
+
+/* Register offsets inside the host call page */
+#define HOSTCALL_PUTC    0x00 /* W: print character */
+#define HOSTCALL_EXIT    0x01 /* W: exit with status code */
+#define HOSTCALL_ADDRL   0x02 /* RW: block address low */
+#define HOSTCALL_ADDRH   0x03 /* RW: block address high */
+#define HOSTCALL_LENL    0x04 /* RW: block length low */
+#define HOSTCALL_LENH    0x05 /* RW: block length high */
+#define HOSTCALL_WRITE   0x06 /* W: write block to host output */
+#define HOSTCALL_RESULT  0x07 /* W: report a result byte */
+
+/* Paravirtual host call page, attached to the bus as a device. Guest output
+ * is collected in a buffer and handed to the host with one write() when it
+ * is full or on exit. */
+struct HostCall
+{
+  struct Bus *bus;
+  struct Device *dev;
+  uint8_t page;
+  int fd;
+
+  uint16_t addr;
+  uint16_t len;
+
+  uint8_t exited;
+  uint8_t exit_status;
+
+  uint8_t results[HOSTCALL_MAX_RESULTS];
+  int result_count;
+
+  uint32_t out_len;
+  uint8_t out[HOSTCALL_BUFFER_SIZE];
+};
+
+struct HostCall* hostcall_create(struct Bus *bus, uint8_t page, int fd);
+void hostcall_destroy(struct HostCall **hc);
+
+int hostcall_flush(struct HostCall *hc);
+
+#endif /* HOSTCALL_H */
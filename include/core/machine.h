@@ -0,0 +1,67 @@
+/*
+ * Copyright (c) 2022, Bernd Bauer <bernd.bauer@gmx.at>
+ *
+ * SPDX-License-Identifier: BSD-2-Clause
+ */
+
+#ifndef MACHINE_H
+#define MACHINE_H
+
+#include <stdint.h>
+
+struct Bus;
+
+#define MACHINE_LINE_SIZE 512
+
+/* Machine description, one region per line, '#' starts a comment. Numbers
+ * are C style, memory regions and mirrors are page aligned. Images are
+ * read from offset (default 0). Images, sockets and outputs are relative
+ * to the description file.
+ *
+ *   ram    <start> <size> [<image> [<offset>]]
+ *   rom    <start> <size> <image> [<offset>]
+ *   mirror <start> <size> <source>
+ *   device <start> <size> <name> [<args>]
+ *
+ * Devices and their arguments
+ *
+ *   hostcall                      one page of host calls
+ *   mapper ram|rom <size> [<image> [<offset>]] <start>:<size> ...
+ *                                 one bank register per window
+ *   via [<irq>]                   6522 VIA, 16 registers on IRQ line irq (0)
+ *   uart [pty|<socket> [<irq>]]   serial port, 4 registers, on a pseudo
+ *                                 terminal (default) or a Unix socket
+ *   block <image> [<latency> [<irq>]]
+ *                                 16 registers of DMA block storage on a
+ *                                 disk image, completion after latency
+ *                                 cycles
+ *   framebuffer <width>x<height> [<bpp> [<output> [<interval> [<max lag>]]]]
+ *                                 video memory of the whole range, 1 to 8
+ *                                 (default) bits per pixel, changed frames
+ *                                 go to output every interval cycles as
+ *                                 PPM (name ends in .ppm, may number them
+ *                                 with %d) or else a raw RGBA stream, made
+ *                                 on a thread at most max lag cycles
+ *                                 behind, 0 makes it inline
+ *
+ * e.g. 24 KB RAM with a 2 KB mirror, host calls, 128 KB of ROM banked
+ * into two 16 KB windows with their registers at 0x7e00 and 0x7e01 and a
+ * VIA behind them
+ *
+ *   ram    0x0000 0x6000
+ *   mirror 0x6000 0x0800 0x0000
+ *   device 0x7f00 0x0100 hostcall
+ *   device 0x7e00 2      mapper rom 0x20000 firmware.bin 0x8000:0x4000 0xc000:0x4000
+ *   device 0x7e10 16     via
+ */
+
+/* Constructor of a device named in a machine description */
+struct MachineDevice
+{
+  const char *name;
+  int (*create)(struct Bus *bus, const char *filename, uint16_t start, uint32_t size, const char *args);
+};
+
+int machine_load(struct Bus *bus, const char *filename);
+
+#endif /* MACHINE_H */
@@ -0,0 +1,42 @@
+/*
+ * Copyright (c) 2022, Bernd Bauer <bernd.bauer@gmx.at>
+ *
+ * SPDX-License-Identifier: BSD-2-Clause
+ */
+
+#ifndef MAPPER_H
+#define MAPPER_H
+
+#include <stdint.h>
+
+struct Bus;
+struct Device;
+struct Memory;
+
+#define MAPPER_MAX_WINDOWS 8
+
+/* Bank switching. Every window of the address space shows one bank of a
+ * larger memory, register n selects the bank of window n. A switch only
+ * rewrites the page table entries of the window, so banked code runs from
+ * direct page pointers like flat code. Bank numbers wrap around the
+ * memory, after reset window n shows bank n. */
+struct Mapper
+{
+  struct Bus *bus;
+  struct Device *dev;
+  struct Memory *mem;
+  uint8_t type;
+
+  int windows;
+  int region[MAPPER_MAX_WINDOWS];
+  uint32_t size[MAPPER_MAX_WINDOWS];
+  uint8_t bank[MAPPER_MAX_WINDOWS];
+};
+
+struct Mapper* mapper_create(struct Bus *bus, uint16_t reg, uint8_t type, uint32_t size, int windows,
+                             const uint16_t *start, const uint32_t *length);
+void mapper_destroy(struct Mapper **mapper);
+
+int mapper_select(struct Mapper *mapper, int window, uint8_t bank);
+
+#endif /* MAPPER_H */
@@ -15,14 +15,19 @@ struct Memory
   uint32_t size;
   uint32_t baseaddr;
   uint8_t readonly;
+  char *shm_name;     /* POSIX shared memory object backing mem or NULL */
 };
 
 struct Memory* memory_create(uint32_t size, uint32_t baseaddr, uint8_t readonly);
+struct Memory* memory_createShared(uint32_t size, uint32_t baseaddr, uint8_t readonly, const char *name);
 void memory_destroy(struct Memory **memory);
 
 int memory_readByte(struct Memory* mem, uint32_t addr, uint8_t *data);
 int memory_writeByte(struct Memory* mem, uint32_t addr, uint8_t data);
 
+/* Hexdump of [start, end) to stderr respectively fd. The whole dump is
+ * formatted into one buffer and handed to the kernel with a single write. */
 int memory_dump(struct Memory* mem, uint32_t start, uint32_t end);
+int memory_dumpToFd(struct Memory* mem, uint32_t start, uint32_t end, int fd);
 
 #endif /* MEMORY_H */
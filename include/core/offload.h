@@ -0,0 +1,71 @@
+/*
+ * Copyright (c) 2022, Bernd Bauer <bernd.bauer@gmx.at>
+ *
+ * SPDX-License-Identifier: BSD-2-Clause
+ */
+
+#ifndef OFFLOAD_H
+#define OFFLOAD_H
+
+#include <stdint.h>
+#include <pthread.h>
+
+struct Ring;
+
+#define OFFLOAD_QUEUE   4096    /* default records in flight, power of two */
+#define OFFLOAD_MAX_LAG 20000   /* default cycles the back end may trail the CPU */
+
+/* Back end of a device, called in stamp order. advance moves the back end
+ * to when without a register write, write applies one at when. */
+struct OffloadOps
+{
+  const char *name;
+
+  void (*write)(void *ctx, uint64_t when, uint16_t offset, uint8_t data);
+  void (*advance)(void *ctx, uint64_t when);
+};
+
+struct OffloadRecord
+{
+  uint64_t when;
+  uint16_t offset;
+  uint8_t data;
+  uint8_t write;
+};
+
+/* Runs the back end of a device on a worker thread. The emulation thread
+ * only stamps register writes with their cycle and pushes them to a Ring
+ * with exactly one producer and one consumer. The worker peeks a record
+ * and drops it only once it is done. The emulation thread waits only when
+ * the queue is full, when the oldest queued record is more than max_lag
+ * cycles old or when offload_sync() needs the state the back end
+ * produces, which waits for every queued record. With a max_lag of 0 the
+ * back end runs inline on the emulation thread. */
+struct Offload
+{
+  const struct OffloadOps *ops;
+  void *ctx;
+  uint64_t max_lag;
+
+  struct Ring *queue;
+
+  uint8_t threaded;
+  pthread_t thread;
+  pthread_mutex_t lock;
+  pthread_cond_t work;      /* the worker sleeps on an empty queue */
+  pthread_cond_t done;      /* the emulation thread waits for the worker */
+  int sleeping;
+  int waiting;
+  int quit;
+
+  uint64_t stalls;          /* waits of the emulation thread */
+};
+
+struct Offload* offload_create(const struct OffloadOps *ops, void *ctx, uint32_t size, uint64_t max_lag);
+void offload_destroy(struct Offload **off);
+
+int offload_write(struct Offload *off, uint64_t when, uint16_t offset, uint8_t data);
+int offload_advance(struct Offload *off, uint64_t when);
+int offload_sync(struct Offload *off);
+
+#endif /* OFFLOAD_H */
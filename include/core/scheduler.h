@@ -0,0 +1,49 @@
+/*
+ * Copyright (c) 2022, Bernd Bauer <bernd.bauer@gmx.at>
+ *
+ * SPDX-License-Identifier: BSD-2-Clause
+ */
+
+#ifndef SCHEDULER_H
+#define SCHEDULER_H
+
+#include <stdint.h>
+
+#define SCHEDULER_NEVER UINT64_MAX
+
+typedef void (*scheduler_EventFn)(void *ctx, uint64_t when);
+
+struct SchedulerEvent
+{
+  uint64_t when;
+  scheduler_EventFn fn;
+  void *ctx;
+  int id;
+};
+
+/* Min-heap of events keyed by the 64 bit cycle timestamp */
+struct Scheduler
+{
+  struct SchedulerEvent *heap;
+  int count;
+  int capacity;
+  int next_id;
+
+  /* Run deadline of the CPU; lowered when an earlier event is added */
+  uint64_t *deadline;
+};
+
+struct Scheduler* scheduler_create(uint64_t *deadline);
+void scheduler_destroy(struct Scheduler **sched);
+
+int scheduler_add(struct Scheduler *sched, uint64_t when, scheduler_EventFn fn, void *ctx);
+int scheduler_cancel(struct Scheduler *sched, int id);
+
+int scheduler_dispatch(struct Scheduler *sched, uint64_t now);
+
+static inline uint64_t scheduler_next(struct Scheduler *sched)
+{
+  return sched->count > 0 ? sched->heap[0].when : SCHEDULER_NEVER;
+}
+
+#endif /* SCHEDULER_H */
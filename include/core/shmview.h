@@ -0,0 +1,69 @@
+/*
+ * Copyright (c) 2022, Bernd Bauer <bernd.bauer@gmx.at>
+ *
+ * SPDX-License-Identifier: BSD-2-Clause
+ */
+
+#ifndef SHMVIEW_H
+#define SHMVIEW_H
+
+#include <stdint.h>
+
+struct Bus;
+
+#define SHMVIEW_MAGIC   "6502"
+#define SHMVIEW_VERSION 1
+
+/* The state header is refreshed whenever bus_run() returns and polled
+ * between its slices every SHMVIEW_PERIOD cycles. The refresh is no
+ * scheduler event, so it does not keep an idle guest running. */
+#define SHMVIEW_PERIOD  0x10000
+
+#define SHMVIEW_STATE_SUFFIX ".state"
+
+/* Machine state published in the shared memory object "<name>.state".
+ * The writer increments seq before and after an update, so a reader
+ * copies the header while seq is even and unchanged:
+ *
+ *   do { s0 = seq; copy; s1 = seq; } while((s0 & 1) || s0 != s1);
+ */
+struct ShmViewState
+{
+  char     magic[4];
+  uint32_t version;
+  uint32_t seq;
+
+  uint32_t ram_base;
+  uint32_t ram_size;
+
+  uint8_t  A;
+  uint8_t  X;
+  uint8_t  Y;
+  uint8_t  P;
+  uint8_t  SP;
+  uint8_t  irq_lines;
+  uint16_t PC;
+
+  uint32_t stop;
+
+  uint64_t clock_count;
+  uint64_t updates;
+};
+
+/* Live view of the machine for external monitors. RAM is moved into the
+ * shared memory object "<name>" so readers see it without copies. */
+struct ShmView
+{
+  struct Bus *bus;
+  char *state_name;
+  struct ShmViewState *state;
+  uint64_t due;
+};
+
+struct ShmView* shmview_create(struct Bus *bus, const char *name);
+void shmview_destroy(struct ShmView **view);
+
+void shmview_update(struct ShmView *view);
+uint64_t shmview_poll(struct ShmView *view, uint64_t now);
+
+#endif /* SHMVIEW_H */
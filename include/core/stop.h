@@ -0,0 +1,59 @@
+/*
+ * Copyright (c) 2022, Bernd Bauer <bernd.bauer@gmx.at>
+ *
+ * SPDX-License-Identifier: BSD-2-Clause
+ */
+
+#ifndef STOP_H
+#define STOP_H
+
+#include <stdint.h>
+#include <time.h>
+
+struct Bus;
+
+/* Wall clock timeout is checked every STOP_TIMEOUT_PERIOD cycles */
+#define STOP_TIMEOUT_PERIOD 0x100000
+
+/* Stop conditions for headless runs. Each condition only costs something
+ * once it is armed: cycle limits and timeouts bound the slices of
+ * bus_run(), which polls them in between, PC hits and instruction limits
+ * enable the CPU boundary hook and magic writes trap a single page on the
+ * bus. Neither of the first two is a scheduler event, so they do not keep
+ * an idle guest from stopping. */
+struct StopConditions
+{
+  struct Bus *bus;
+
+  uint64_t instructions_left;
+  uint8_t  instructions_armed;
+
+  uint8_t  pc[0x10000 / 8];
+  uint32_t pc_count;
+
+  uint8_t  brk;
+
+  int      write_addr;
+
+  uint64_t cycle_limit;     /* SCHEDULER_NEVER when not armed */
+
+  uint64_t timeout_due;     /* next wall clock check, SCHEDULER_NEVER when not armed */
+  struct timespec timeout_end;
+};
+
+struct StopConditions* stop_create(struct Bus *bus);
+void stop_destroy(struct StopConditions **cond);
+
+int stop_at_cycle(struct StopConditions *cond, uint64_t cycle);
+int stop_after_instructions(struct StopConditions *cond, uint64_t count);
+int stop_at_pc(struct StopConditions *cond, uint16_t pc);
+int stop_on_brk(struct StopConditions *cond, uint8_t enable);
+int stop_on_write(struct StopConditions *cond, uint16_t addr);
+int stop_after_seconds(struct StopConditions *cond, double seconds);
+
+uint64_t stop_poll(struct StopConditions *cond, uint64_t now);
+int stop_hook(struct StopConditions *cond, uint16_t pc, uint8_t resumed);
+int stop_brk(struct StopConditions *cond);
+int stop_write(struct StopConditions *cond, uint16_t addr, uint8_t data);
+
+#endif /* STOP_H */
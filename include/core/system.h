@@ -0,0 +1,101 @@
+/*
+ * Copyright (c) 2022, Bernd Bauer <bernd.bauer@gmx.at>
+ *
+ * SPDX-License-Identifier: BSD-2-Clause
+ */
+
+#ifndef SYSTEM_H
+#define SYSTEM_H
+
+#include <stdint.h>
+
+#include "core/bus.h"
+
+#define SYSTEM_MAX_CPUS   4
+#define SYSTEM_MAX_PORTS  16
+
+#define SYSTEM_QUANTUM    1000  /* default cycles a CPU runs ahead of the others */
+#define SYSTEM_TIGHT      16    /* quantum while the CPUs talk to each other */
+#define SYSTEM_BOOST      2000  /* cycles the tight quantum lasts after an access */
+
+/* Mailbox registers, one pair per side */
+#define SYSTEM_MAILBOX_REGISTERS 2
+#define SYSTEM_MAILBOX_DATA      0x00 /* R: received byte / W: send a byte to the peer */
+#define SYSTEM_MAILBOX_STATUS    0x01 /* R: SYSTEM_MAILBOX_* */
+
+#define SYSTEM_MAILBOX_RX_FULL 0x01   /* a byte waits, raises the IRQ line if given */
+#define SYSTEM_MAILBOX_TX_FULL 0x02   /* the peer has not read the last byte yet */
+
+struct System;
+
+/* Shared memory window or mailbox side on one of the buses */
+struct SystemPort
+{
+  struct System *sys;
+  struct Bus *bus;
+  struct Device *dev;
+
+  /* Shared memory */
+  uint8_t *mem;
+
+  /* Mailbox */
+  struct SystemPort *peer;
+  int irq;
+  uint8_t asserted;
+  uint8_t data;
+  uint8_t full;
+};
+
+/* Several CPUs, each on a bus of its own with private memory and devices,
+ * run interleaved in slices. Every slice lets the CPUs run up to quantum
+ * cycles past the one that is furthest behind, so they stay within a
+ * quantum of each other without being clocked in lockstep.
+ *
+ * Shared memory and mailboxes are the only paths between the buses. A
+ * write to shared memory or a mailbox access lets the CPU give up the
+ * rest of its slice and narrows the quantum to tight for the next boost
+ * cycles, so the other side sees the access in time. Reads of shared
+ * memory stay on the page table fast path.
+ *
+ * A CPU idling without pending events waits for the others until the end
+ * of the slice, a shared memory or mailbox access of another CPU wakes it
+ * again. The system stops when every CPU idles or a bus stops for any
+ * other reason. */
+struct System
+{
+  struct Bus *bus[SYSTEM_MAX_CPUS];
+  uint8_t idle[SYSTEM_MAX_CPUS];
+  int cpus;
+
+  uint64_t quantum;
+  uint64_t tight;
+  uint64_t boost;
+  uint64_t boost_until;
+
+  struct Memory *shared[SYSTEM_MAX_PORTS];
+  int memories;
+  struct SystemPort port[SYSTEM_MAX_PORTS];
+  int ports;
+
+  uint8_t running;
+  uint64_t base;        /* start of the current slice, the CPU furthest behind */
+  int stop;             /* enum BusStopReason */
+  int stopped;          /* CPU that stopped the system, -1 if none */
+
+  uint64_t slices;
+  uint64_t contended;
+};
+
+struct System* system_create(uint64_t quantum);
+int system_destroy(struct System **sys);
+
+struct Bus* system_add_cpu(struct System *sys);
+struct Memory* system_add_shared(struct System *sys, uint32_t size);
+int system_share(struct System *sys, struct Memory *mem, int cpu, uint16_t start);
+int system_add_mailbox(struct System *sys, int cpu_a, uint16_t start_a, int irq_a, int cpu_b, uint16_t start_b, int irq_b);
+
+int system_reset(struct System *sys);
+int system_run(struct System *sys, uint64_t cycles);
+uint64_t system_now(struct System *sys);
+
+#endif /* SYSTEM_H */
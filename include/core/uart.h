@@ -0,0 +1,72 @@
+/*
+ * Copyright (c) 2022, Bernd Bauer <bernd.bauer@gmx.at>
+ *
+ * SPDX-License-Identifier: BSD-2-Clause
+ */
+
+#ifndef UART_H
+#define UART_H
+
+#include <stdint.h>
+#include <pthread.h>
+
+struct Bus;
+struct Device;
+struct Ring;
+
+#define UART_REGISTERS 4
+#define UART_RING_SIZE 0x4000
+#define UART_INTERVAL  1000    /* cycles between host flushes and RX polls */
+#define UART_PTY       "pty"
+
+/* Register offsets */
+#define UART_DATA    0x00 /* R: next received byte / W: send byte */
+#define UART_STATUS  0x01 /* R: UART_STATUS_* */
+#define UART_CONTROL 0x02 /* RW: UART_CONTROL_* */
+#define UART_RXCOUNT 0x03 /* R: received bytes waiting, saturates at 255 */
+
+#define UART_STATUS_RX_READY  0x01
+#define UART_STATUS_TX_READY  0x02 /* room in the send queue */
+#define UART_STATUS_CONNECTED 0x04 /* a host peer is attached */
+#define UART_STATUS_IRQ       0x80
+
+#define UART_CONTROL_RX_IRQ   0x01 /* interrupt while received bytes wait */
+
+/* Serial port backed by a host pseudo terminal or a listening Unix domain
+ * socket. A host thread moves the bytes between the file descriptors and
+ * two single producer single consumer rings in an epoll loop. The guest
+ * side only touches the rings; the emulation thread wakes the host thread
+ * at most once per interval cycles through an eventfd and polls the
+ * receive ring at the same rate while the receive interrupt is enabled. */
+struct Uart
+{
+  struct Bus *bus;
+  struct Device *dev;
+  int irq;
+  uint8_t control;
+  uint8_t asserted;
+  uint64_t interval;
+
+  struct Ring *rx;          /* host thread to guest */
+  struct Ring *tx;          /* guest to host thread */
+
+  char name[108];           /* pty slave or socket path */
+  int listen_fd;            /* Unix socket, -1 for a pty */
+  int fd;                   /* peer, -1 while none is connected */
+  int slave_fd;             /* keeps the pty from hanging up */
+  int epoll_fd;
+  int event_fd;
+
+  pthread_t thread;
+  uint8_t running;
+  uint8_t throttled;        /* receive ring was full, reading paused */
+  uint32_t watching;        /* epoll events of the peer */
+  uint8_t pending[256];     /* popped from tx but not yet written */
+  uint32_t pending_len;
+  uint32_t pending_off;
+};
+
+struct Uart* uart_create(struct Bus *bus, uint16_t start, int irq, const char *path);
+void uart_destroy(struct Uart **uart);
+
+#endif /* UART_H */
@@ -0,0 +1,120 @@
+/*
+ * Copyright (c) 2022, Bernd Bauer <bernd.bauer@gmx.at>
+ *
+ * SPDX-License-Identifier: BSD-2-Clause
+ */
+
+#ifndef VIA_H
+#define VIA_H
+
+#include <stdint.h>
+
+struct Bus;
+struct Device;
+
+#define VIA_REGISTERS 16
+
+/* Register offsets */
+#define VIA_ORB   0x00 /* RW: port B */
+#define VIA_ORA   0x01 /* RW: port A, clears CA1/CA2 */
+#define VIA_DDRB  0x02 /* RW: port B direction, 1 is output */
+#define VIA_DDRA  0x03 /* RW: port A direction */
+#define VIA_T1CL  0x04 /* R: timer 1 counter low, clears T1 / W: latch low */
+#define VIA_T1CH  0x05 /* RW: timer 1 counter high, a write starts timer 1 */
+#define VIA_T1LL  0x06 /* RW: timer 1 latch low */
+#define VIA_T1LH  0x07 /* RW: timer 1 latch high, a write clears T1 */
+#define VIA_T2CL  0x08 /* R: timer 2 counter low, clears T2 / W: latch low */
+#define VIA_T2CH  0x09 /* RW: timer 2 counter high, a write starts timer 2 */
+#define VIA_SR    0x0A /* RW: shift register, an access starts a transfer */
+#define VIA_ACR   0x0B /* RW: auxiliary control */
+#define VIA_PCR   0x0C /* RW: peripheral control */
+#define VIA_IFR   0x0D /* RW: interrupt flags, writing 1 clears */
+#define VIA_IER   0x0E /* RW: interrupt enable, bit 7 selects set or clear */
+#define VIA_ORA_NH 0x0F /* RW: port A without handshake */
+
+/* Interrupt flags */
+#define VIA_INT_CA2 0x01
+#define VIA_INT_CA1 0x02
+#define VIA_INT_SR  0x04
+#define VIA_INT_CB2 0x08
+#define VIA_INT_CB1 0x10
+#define VIA_INT_T2  0x20
+#define VIA_INT_T1  0x40
+#define VIA_INT_ANY 0x80
+
+/* Auxiliary control */
+#define VIA_ACR_T1_FREE  0x40 /* timer 1 reloads from its latch */
+#define VIA_ACR_T1_PB7   0x80 /* timer 1 drives PB7 */
+#define VIA_ACR_T2_PULSE 0x20 /* timer 2 counts falling edges on PB6 */
+#define VIA_ACR_SR_SHIFT 2    /* shift register mode in bits 2 - 4 */
+
+/* Ports and control lines of via_input() and via_control() */
+#define VIA_PORT_A  0
+#define VIA_PORT_B  1
+#define VIA_SHIFT   2         /* output only, a byte shifted out */
+
+#define VIA_CA1 0
+#define VIA_CA2 1
+#define VIA_CB1 2
+#define VIA_CB2 3
+
+/* 6522 versatile interface adapter. The timers are not decremented per
+ * cycle. Each keeps the cycle it was loaded and the value loaded, counter
+ * reads and underflows are computed from the distance to the current
+ * cycle when the device is synchronized. A scheduler event is posted only
+ * for the next underflow or shift register transfer whose interrupt is
+ * enabled, so a timer nobody listens to costs nothing.
+ *
+ * Input latching and the CA2/CB2 handshake outputs are not modelled, CA2
+ * and CB2 output modes just keep their level in PCR. */
+struct VIA
+{
+  struct Bus *bus;
+  struct Device *dev;
+  int irq;                /* bus IRQ line */
+  uint8_t asserted;
+
+  uint8_t orb;
+  uint8_t ora;
+  uint8_t ddrb;
+  uint8_t ddra;
+  uint8_t in[2];          /* levels driven on the port pins */
+  uint8_t ctrl[4];        /* CA1, CA2, CB1, CB2 input levels */
+  uint8_t pb7;            /* PB7 while timer 1 drives it */
+
+  uint8_t acr;
+  uint8_t pcr;
+  uint8_t ifr;
+  uint8_t ier;
+
+  /* Timer counters hold value at cycle base and count down from there */
+  uint16_t t1_latch;
+  uint16_t t1_value;
+  uint64_t t1_base;
+  uint8_t  t1_armed;      /* one shot underflow still raises T1 */
+
+  uint8_t  t2_latch;
+  uint16_t t2_value;
+  uint64_t t2_base;
+  uint8_t  t2_armed;
+
+  uint8_t  sr;
+  uint8_t  sr_bits;       /* bits left of the running transfer */
+  uint64_t sr_base;       /* start of a clocked transfer */
+
+  /* Called on port output changes and with VIA_SHIFT for every byte
+   * shifted out, may be NULL */
+  void (*output)(void *ctx, uint8_t port, uint8_t value);
+  void *output_ctx;
+};
+
+struct VIA* via_create(struct Bus *bus, uint16_t start, int irq);
+void via_destroy(struct VIA **via);
+
+int via_connect(struct VIA *via, void (*output)(void *ctx, uint8_t port, uint8_t value), void *ctx);
+int via_input(struct VIA *via, uint8_t port, uint8_t value);
+int via_control(struct VIA *via, uint8_t line, uint8_t level);
+
+uint8_t via_output(struct VIA *via, uint8_t port);
+
+#endif /* VIA_H */
@@ -0,0 +1,38 @@
+/*
+ * Copyright (c) 2022, Bernd Bauer <bernd.bauer@gmx.at>
+ *
+ * SPDX-License-Identifier: BSD-2-Clause
+ */
+
+#ifndef RING_H
+#define RING_H
+
+#include <stdint.h>
+
+/* Lock free queue of fixed size elements for exactly one producer and
+ * one consumer thread. head is only written by the producer, tail only by
+ * the consumer, both count elements, run freely and are masked with the
+ * power of two size on access. ring_peek() leaves the elements in place
+ * until ring_drop() hands them back, the producer may peek too, the
+ * element at tail stays put until the consumer drops it. */
+struct Ring
+{
+  uint8_t *buf;
+  uint32_t size;            /* elements */
+  uint32_t elem;            /* bytes per element */
+  uint32_t head;
+  uint32_t tail;
+};
+
+struct Ring* ring_create(uint32_t size, uint32_t elem);
+void ring_destroy(struct Ring **ring);
+
+uint32_t ring_push(struct Ring *ring, const void *data, uint32_t count);
+uint32_t ring_pop(struct Ring *ring, void *data, uint32_t count);
+uint32_t ring_peek(struct Ring *ring, void *data, uint32_t count);
+void ring_drop(struct Ring *ring, uint32_t count);
+
+uint32_t ring_count(struct Ring *ring);
+uint32_t ring_free(struct Ring *ring);
+
+#endif /* RING_H */
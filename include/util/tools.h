@@ -7,8 +7,14 @@
 #ifndef TOOLS_H
 #define TOOLS_H
 
+#include <stdint.h>
+
 #include "core/memory.h"
 
 int memory_loadFromFile(struct Memory* mem, uint32_t pos, char* filename, uint32_t off, uint32_t count);
 
+int file_saveBinary(const char *filename, const uint8_t *data, uint32_t len);
+int file_saveIntelHex(const char *filename, uint16_t addr, const uint8_t *data, uint32_t len);
+int file_loadIntelHex(const char *filename, uint8_t *data, uint32_t size);
+
 #endif /* TOOLS_H */
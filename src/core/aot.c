@@ -0,0 +1,85 @@
+/*
+ * Copyright (c) 2022, Bernd Bauer <bernd.bauer@gmx.at>
+ *
+ * SPDX-License-Identifier: BSD-2-Clause
+ */
+
+#include <stdlib.h>
+
+#include "util/log.h"
+
+#include "core/aot.h"
+
+/*----------------------------------------------------------------------------*/
+uint32_t aot_hash(const uint8_t *data, uint32_t len)
+{
+  uint32_t hash = 0x811C9DC5;
+  uint32_t i = 0;
+
+  /* FNV-1a */
+  for(i = 0; i < len; i++)
+  {
+    hash = (hash ^ data[i]) * 0x01000193;
+  }
+
+  return hash;
+}
+
+/*----------------------------------------------------------------------------*/
+int aot_install(struct Bus *bus, const struct AotImage *image)
+{
+  uint8_t *data = NULL;
+  uint32_t hash = 0;
+  int installed = 0;
+  int i = 0;
+
+  if(image->size == 0 || image->size > 0x10000 - image->base)
+  {
+    log_error("Invalid recompiled image 0x%04x + 0x%x", image->base, image->size);
+    return -1;
+  }
+
+  data = malloc(image->size);
+  if(data == NULL)
+  {
+    log_error("Could not allocate memory for image check");
+    return -1;
+  }
+  bus_peek_block(bus, image->base, data, image->size);
+  hash = aot_hash(data, image->size);
+  free(data);
+
+  /* Stale code for a different ROM would silently diverge */
+  if(hash != image->hash)
+  {
+    log_warn("Recompiled image does not match 0x%04x - 0x%04x (0x%08x != 0x%08x), interpret",
+             image->base, image->base + image->size - 1, hash, image->hash);
+    return -1;
+  }
+
+  if(bus->cpu->blocks == NULL)
+  {
+    bus->cpu->blocks = calloc(0x10000, sizeof(CPU6502_BlockFn));
+    if(bus->cpu->blocks == NULL)
+    {
+      log_error("Could not allocate memory for block table");
+      return -1;
+    }
+  }
+
+  /* Plain stores do not invalidate blocks, code the guest can change
+   * stays with the interpreter */
+  for(i = 0; i < image->count; i++)
+  {
+    if(bus->readonly[image->entries[i].pc >> BUS_PAGE_SHIFT])
+    {
+      bus->cpu->blocks[image->entries[i].pc] = image->entries[i].fn;
+      installed++;
+    }
+  }
+
+  log_info("Installed %d of %d recompiled entry points for 0x%04x - 0x%04x", installed,
+           image->count, image->base, image->base + image->size - 1);
+
+  return 0;
+}
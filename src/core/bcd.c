@@ -0,0 +1,107 @@
+/*
+ * Copyright (c) 2022, Bernd Bauer <bernd.bauer@gmx.at>
+ *
+ * SPDX-License-Identifier: BSD-2-Clause
+ */
+
+#include "util/log.h"
+
+#include "core/bcd.h"
+
+uint16_t bcd_adc_table[2][256][256];
+uint16_t bcd_sbc_table[2][256][256];
+
+static uint16_t bcd_adc(uint8_t a, uint8_t b, uint8_t c);
+static uint16_t bcd_sbc(uint8_t a, uint8_t b, uint8_t c);
+static uint8_t bcd_binaryFlags(uint8_t result);
+
+/*----------------------------------------------------------------------------*/
+void bcd_init(void)
+{
+  static uint8_t done = 0;
+  int a = 0;
+  int b = 0;
+  int c = 0;
+
+  if(done)
+  {
+    return;
+  }
+
+  log_trace("Build decimal mode tables");
+
+  for(c = 0; c < 2; c++)
+  {
+    for(a = 0; a < 256; a++)
+    {
+      for(b = 0; b < 256; b++)
+      {
+        bcd_adc_table[c][a][b] = bcd_adc(a, b, c);
+        bcd_sbc_table[c][a][b] = bcd_sbc(a, b, c);
+      }
+    }
+  }
+
+  done = 1;
+}
+
+/*----------------------------------------------------------------------------*/
+static uint16_t bcd_adc(uint8_t a, uint8_t b, uint8_t c)
+{
+  uint8_t flags = 0;
+  int lo = (a & 0x0F) + (b & 0x0F) + c;
+  int hi = 0;
+
+  if(lo > 0x09)
+  {
+    lo += 0x06;
+  }
+  hi = (a >> 4) + (b >> 4) + (lo > 0x0F);
+
+  /* N and V are taken before the high nibble is adjusted, Z from the
+   * binary sum */
+  if(((a + b + c) & 0xFF) == 0) flags |= CPU6502_FLAG_ZERO;
+  if(hi & 0x08) flags |= CPU6502_FLAG_NEGATIVE;
+  if(~(a ^ b) & (a ^ (hi << 4)) & 0x80) flags |= CPU6502_FLAG_OVERFLOW;
+
+  if(hi > 0x09)
+  {
+    hi += 0x06;
+  }
+  if(hi > 0x0F) flags |= CPU6502_FLAG_CARRY;
+
+  return (flags << 8) | (((hi << 4) | (lo & 0x0F)) & 0xFF);
+}
+
+/*----------------------------------------------------------------------------*/
+static uint16_t bcd_sbc(uint8_t a, uint8_t b, uint8_t c)
+{
+  uint8_t flags = 0;
+  int diff = a - b - (1 - c);
+  int lo = (a & 0x0F) - (b & 0x0F) - (1 - c);
+  int hi = (a >> 4) - (b >> 4);
+
+  /* Nibble wise correction, the low adjust never borrows from the high
+   * nibble */
+  if(lo < 0)
+  {
+    lo -= 0x06;
+    hi--;
+  }
+  if(hi < 0)
+  {
+    hi -= 0x06;
+  }
+
+  flags = bcd_binaryFlags(diff & 0xFF);
+  if(diff >= 0) flags |= CPU6502_FLAG_CARRY;
+  if((a ^ b) & (a ^ diff) & 0x80) flags |= CPU6502_FLAG_OVERFLOW;
+
+  return (flags << 8) | (((hi << 4) | (lo & 0x0F)) & 0xFF);
+}
+
+/*----------------------------------------------------------------------------*/
+static uint8_t bcd_binaryFlags(uint8_t result)
+{
+  return (result == 0 ? CPU6502_FLAG_ZERO : 0) | (result & CPU6502_FLAG_NEGATIVE);
+}
@@ -0,0 +1,322 @@
+/*
+ * Copyright (c) 2022, Bernd Bauer <bernd.bauer@gmx.at>
+ *
+ * SPDX-License-Identifier: BSD-2-Clause
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include "util/log.h"
+
+#include "core/bus.h"
+#include "core/device.h"
+#include "core/block.h"
+
+static uint8_t block_read(void *ctx, uint16_t offset);
+static void block_write(void *ctx, uint16_t offset, uint8_t data);
+static uint8_t block_peek(void *ctx, uint16_t offset);
+static void block_tick(void *ctx, uint64_t now);
+static void block_reset(void *ctx);
+static void block_release(void *ctx);
+
+static void block_start(struct Block *block, uint8_t command);
+static int block_transfer(struct Block *block);
+static void block_update(struct Block *block);
+
+static const struct DeviceOps block_ops = {
+  .name = "block",
+  .read = block_read,
+  .write = block_write,
+  .peek = block_peek,
+  .tick = block_tick,
+  .reset = block_reset,
+  .destroy = block_release
+};
+
+/*----------------------------------------------------------------------------*/
+struct Block* block_create(struct Bus *bus, uint16_t start, int irq, const char *image, uint64_t latency)
+{
+  struct Block *block = NULL;
+  struct stat st;
+
+  if(irq < 0 || irq >= BUS_IRQ_LINES || start > 0x10000 - BLOCK_REGISTERS)
+  {
+    log_error("Invalid block device at 0x%04x on IRQ line %d", start, irq);
+    return NULL;
+  }
+
+  block = calloc(1, sizeof(struct Block));
+  if(block == NULL)
+  {
+    log_error("Could not allocate memory for struct Block");
+    return NULL;
+  }
+
+  block->bus = bus;
+  block->irq = irq;
+  block->latency = latency;
+
+  /* Read only images serve reads, writes complete with an error */
+  block->fd = open(image, O_RDWR | O_CLOEXEC);
+  if(block->fd < 0)
+  {
+    block->fd = open(image, O_RDONLY | O_CLOEXEC);
+    block->readonly = 1;
+  }
+  if(block->fd < 0 || fstat(block->fd, &st) != 0)
+  {
+    log_error("Could not open disk image %s: %s", image, strerror(errno));
+    block_destroy(&block);
+    return NULL;
+  }
+
+  block->sectors = st.st_size / BLOCK_SECTOR_SIZE;
+  if(block->sectors == 0)
+  {
+    log_error("Disk image %s holds no sector", image);
+    block_destroy(&block);
+    return NULL;
+  }
+
+  block->image = mmap(NULL, (size_t)block->sectors * BLOCK_SECTOR_SIZE,
+                      block->readonly ? PROT_READ : PROT_READ | PROT_WRITE, MAP_SHARED, block->fd, 0);
+  if(block->image == MAP_FAILED)
+  {
+    log_error("Could not map disk image %s: %s", image, strerror(errno));
+    block->image = NULL;
+    block_destroy(&block);
+    return NULL;
+  }
+
+  block->dev = device_attach(bus, start, start + BLOCK_REGISTERS - 1, &block_ops, block);
+  if(block->dev == NULL)
+  {
+    block_destroy(&block);
+    return NULL;
+  }
+
+  log_info("Create block device at 0x%04x on %s with %u sectors%s", start, image, block->sectors,
+           block->readonly ? " read only" : "");
+
+  return block;
+}
+
+/*----------------------------------------------------------------------------*/
+void block_destroy(struct Block **block)
+{
+  if(*block)
+  {
+    struct Block *b = *block;
+
+    if(b->asserted)
+    {
+      bus_irq_release(b->bus, b->irq);
+    }
+    device_detach(&b->dev);
+
+    if(b->image != NULL)
+    {
+      munmap(b->image, (size_t)b->sectors * BLOCK_SECTOR_SIZE);
+    }
+    if(b->fd >= 0)
+    {
+      close(b->fd);
+    }
+
+    free(b);
+    *block = NULL;
+  }
+}
+
+/*----------------------------------------------------------------------------*/
+static uint8_t block_read(void *ctx, uint16_t offset)
+{
+  return block_peek(ctx, offset);
+}
+
+/*----------------------------------------------------------------------------*/
+static void block_write(void *ctx, uint16_t offset, uint8_t data)
+{
+  struct Block *block = ctx;
+
+  switch(offset)
+  {
+    case BLOCK_COMMAND:
+      block_start(block, data);
+      break;
+    case BLOCK_STATUS:
+      block->status &= ~(BLOCK_STATUS_DONE | BLOCK_STATUS_ERROR);
+      break;
+    case BLOCK_CONTROL:
+      block->control = data & BLOCK_CONTROL_IRQ;
+      break;
+    case BLOCK_COUNT:
+      block->count = data;
+      break;
+    case BLOCK_ADDRL:
+      block->addr = (block->addr & 0xFF00) | data;
+      break;
+    case BLOCK_ADDRH:
+      block->addr = (block->addr & 0x00FF) | (data << 8);
+      break;
+    case BLOCK_LBA0:
+    case BLOCK_LBA0 + 1:
+    case BLOCK_LBA0 + 2:
+    case BLOCK_LBA0 + 3:
+      block->lba &= ~(0xFFu << ((offset - BLOCK_LBA0) * 8));
+      block->lba |= (uint32_t)data << ((offset - BLOCK_LBA0) * 8);
+      break;
+  }
+
+  block_update(block);
+}
+
+/*----------------------------------------------------------------------------*/
+static uint8_t block_peek(void *ctx, uint16_t offset)
+{
+  struct Block *block = ctx;
+
+  switch(offset)
+  {
+    case BLOCK_COMMAND:
+      return block->command;
+    case BLOCK_STATUS:
+      return block->status | (block->asserted ? BLOCK_STATUS_IRQ : 0);
+    case BLOCK_CONTROL:
+      return block->control;
+    case BLOCK_COUNT:
+      return block->count;
+    case BLOCK_ADDRL:
+      return block->addr & 0xFF;
+    case BLOCK_ADDRH:
+      return block->addr >> 8;
+    case BLOCK_LBA0:
+    case BLOCK_LBA0 + 1:
+    case BLOCK_LBA0 + 2:
+    case BLOCK_LBA0 + 3:
+      return block->lba >> ((offset - BLOCK_LBA0) * 8);
+    case BLOCK_SIZE0:
+    case BLOCK_SIZE0 + 1:
+    case BLOCK_SIZE0 + 2:
+    case BLOCK_SIZE0 + 3:
+      return block->sectors >> ((offset - BLOCK_SIZE0) * 8);
+  }
+
+  return 0;
+}
+
+/*----------------------------------------------------------------------------*/
+static void block_tick(void *ctx, uint64_t now)
+{
+  struct Block *block = ctx;
+
+  block->status &= ~BLOCK_STATUS_BUSY;
+  block->status |= BLOCK_STATUS_DONE;
+  if(block_transfer(block) != 0)
+  {
+    block->status |= BLOCK_STATUS_ERROR;
+  }
+
+  block_update(block);
+}
+
+/*----------------------------------------------------------------------------*/
+static void block_reset(void *ctx)
+{
+  struct Block *block = ctx;
+
+  device_cancel(block->dev);
+  block->command = 0;
+  block->status = 0;
+  block->control = 0;
+  block_update(block);
+}
+
+/*----------------------------------------------------------------------------*/
+static void block_release(void *ctx)
+{
+  struct Block *block = ctx;
+
+  block_destroy(&block);
+}
+
+/*----------------------------------------------------------------------------*/
+static void block_start(struct Block *block, uint8_t command)
+{
+  if(block->status & BLOCK_STATUS_BUSY)
+  {
+    log_debug("Block device busy, command 0x%02x ignored", command);
+    return;
+  }
+
+  block->command = command;
+  block->job_count = block->count;
+  block->job_addr = block->addr;
+  block->job_lba = block->lba;
+
+  block->status = BLOCK_STATUS_BUSY;
+  if(device_schedule(block->dev, block->dev->synced + block->latency) != 0)
+  {
+    block->status = BLOCK_STATUS_DONE | BLOCK_STATUS_ERROR;
+  }
+}
+
+/*----------------------------------------------------------------------------*/
+static int block_transfer(struct Block *block)
+{
+  uint64_t bytes = (uint64_t)block->job_count * BLOCK_SECTOR_SIZE;
+  uint8_t *data = block->image + (size_t)block->job_lba * BLOCK_SECTOR_SIZE;
+
+  if(block->command == BLOCK_CMD_FLUSH)
+  {
+    return block->readonly ? 0 : msync(block->image, (size_t)block->sectors * BLOCK_SECTOR_SIZE, MS_SYNC);
+  }
+
+  if((block->command != BLOCK_CMD_READ && block->command != BLOCK_CMD_WRITE) ||
+     block->job_count == 0 || (uint64_t)block->job_lba + block->job_count > block->sectors ||
+     block->job_addr + bytes > 0x10000)
+  {
+    log_debug("Invalid block command 0x%02x for %u sectors at %u to 0x%04x", block->command,
+              block->job_count, block->job_lba, block->job_addr);
+    return -1;
+  }
+
+  log_trace("Block command 0x%02x for %u sectors at %u to 0x%04x", block->command,
+            block->job_count, block->job_lba, block->job_addr);
+
+  if(block->command == BLOCK_CMD_READ)
+  {
+    return bus_write_block(block->bus, block->job_addr, data, bytes);
+  }
+  if(block->readonly)
+  {
+    return -1;
+  }
+
+  return bus_peek_block(block->bus, block->job_addr, data, bytes);
+}
+
+/*----------------------------------------------------------------------------*/
+static void block_update(struct Block *block)
+{
+  uint8_t irq = (block->control & BLOCK_CONTROL_IRQ) && (block->status & BLOCK_STATUS_DONE);
+
+  if(irq != block->asserted)
+  {
+    block->asserted = irq;
+    if(irq)
+    {
+      bus_irq_assert(block->bus, block->irq);
+    }
+    else
+    {
+      bus_irq_release(block->bus, block->irq);
+    }
+  }
+}
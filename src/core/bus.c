@@ -5,19 +5,41 @@
  */
 
 #include <stdlib.h>
+#include <string.h>
 #include <ctype.h>
 
 #include "util/log.h"
 
 #include "core/bus.h"
 
-static uint8_t bus_read(struct Bus *bus, uint16_t addr);
-static void bus_write(struct Bus *bus, uint16_t addr, uint8_t data);
+static void bus_irq_assert_event(void *ctx, uint64_t when);
+static void bus_irq_release_event(void *ctx, uint64_t when);
+static void bus_nmi_event(void *ctx, uint64_t when);
+static void bus_map_region(struct Bus* bus, struct BusRegion *region);
+static void bus_map_page(struct Bus* bus, uint32_t page);
+static uint64_t bus_poll(struct Bus* bus);
+
+static const char *stop_reason_strings[] = {
+  "running",
+  "stop requested",
+  "idle without pending events",
+  "cycle limit",
+  "instruction limit",
+  "PC reached",
+  "BRK",
+  "write to stop address",
+  "wall clock timeout",
+  "breakpoint",
+  "watchpoint",
+  "guest exit",
+  "yield to another CPU"
+};
 
 /*----------------------------------------------------------------------------*/
 struct Bus* bus_create()
 {
   struct Bus *bus = NULL;
+  int line = 0;
 
   log_info("Create Bus");
 
@@ -31,14 +53,58 @@ struct Bus* bus_create()
   bus->ram = NULL;
   bus->rom = NULL;
   bus->cpu = NULL;
-  bus->stop = 0;
+  bus->sched = NULL;
+  bus->stopcond = NULL;
+  bus->dbg = NULL;
+  bus->shmview = NULL;
+  bus->stop = BUS_RUNNING;
+  bus->resumed = 0;
+  memset(bus->rtrap, 0, sizeof(bus->rtrap));
+  memset(bus->wtrap, 0, sizeof(bus->wtrap));
+  bus->devices = NULL;
+  memset(bus->dev, 0, sizeof(bus->dev));
+
+  for(line = 0; line < BUS_IRQ_LINES; line++)
+  {
+    bus->irq[line].bus = bus;
+    bus->irq[line].mask = 1 << line;
+  }
+
+  bus->regions = 0;
+  memset(bus->backing, 0, sizeof(bus->backing));
+  memset(bus->readonly, 0, sizeof(bus->readonly));
 
+  /* Default machine, replaced by a machine description */
   log_info("Create RAM");
-  bus->ram = memory_create(0x8000, 0x0000, 0);
+  bus_add_memory(bus, BUS_REGION_RAM, 0x0000, 0x8000);
   log_info("Create ROM");
-  bus->rom = memory_create(0x8000, 0x8000, 0);
+  bus_add_memory(bus, BUS_REGION_ROM, 0x8000, 0x8000);
   log_info("Create CPU");
   bus->cpu = CPU6502_create(bus, bus_read, bus_write);
+  if(bus->cpu == NULL)
+  {
+    bus_destroy(&bus);
+    return NULL;
+  }
+  log_info("Create Scheduler");
+  bus->sched = scheduler_create(&bus->cpu->deadline);
+  if(bus->sched == NULL)
+  {
+    bus_destroy(&bus);
+    return NULL;
+  }
+  bus->stopcond = stop_create(bus);
+  if(bus->stopcond == NULL)
+  {
+    bus_destroy(&bus);
+    return NULL;
+  }
+  bus->dbg = debug_create(bus);
+  if(bus->dbg == NULL)
+  {
+    bus_destroy(&bus);
+    return NULL;
+  }
 
   return bus;
 }
@@ -50,21 +116,43 @@ int bus_destroy(struct Bus** bus)
 
   if(*bus != NULL)
   {
-    if((*bus)->cpu != NULL)
+    if((*bus)->shmview != NULL)
     {
-      log_info("Destroy CPU");
-      CPU6502_destroy(&(*bus)->cpu);
+      shmview_destroy(&(*bus)->shmview);
+    }
+    while((*bus)->devices != NULL)
+    {
+      struct Device *dev = (*bus)->devices;
+
+      /* The owner detaches in its destroy callback, otherwise do it here */
+      if(dev->ops->destroy != NULL)
+      {
+        dev->ops->destroy(dev->ctx);
+      }
+      if((*bus)->devices == dev)
+      {
+        device_detach(&dev);
+      }
+    }
+    if((*bus)->dbg != NULL)
+    {
+      debug_destroy(&(*bus)->dbg);
+    }
+    if((*bus)->stopcond != NULL)
+    {
+      stop_destroy(&(*bus)->stopcond);
     }
-    if((*bus)->ram != NULL)
+    if((*bus)->sched != NULL)
     {
-      log_info("Destroy RAM");
-      memory_destroy(&(*bus)->ram);
+      log_info("Destroy Scheduler");
+      scheduler_destroy(&(*bus)->sched);
     }
-    if((*bus)->rom != NULL)
+    if((*bus)->cpu != NULL)
     {
-      log_info("Destroy ROM");
-      memory_destroy(&(*bus)->rom);
+      log_info("Destroy CPU");
+      CPU6502_destroy(&(*bus)->cpu);
     }
+    bus_clear_regions(*bus);
     free(*bus);
     *bus = NULL;
   }
@@ -75,13 +163,32 @@ int bus_destroy(struct Bus** bus)
 /*----------------------------------------------------------------------------*/
 int bus_reset(struct Bus* bus)
 {
+  struct Device *dev = NULL;
+
+  for(dev = bus->devices; dev != NULL; dev = dev->next)
+  {
+    if(dev->ops->reset != NULL)
+    {
+      dev->ops->reset(dev->ctx);
+    }
+  }
+
   CPU6502_reset(bus->cpu);
+
+  /* The clock starts over */
+  for(dev = bus->devices; dev != NULL; dev = dev->next)
+  {
+    dev->synced = bus->cpu->clock_count;
+  }
+
   return 0;
 }
 
 /*----------------------------------------------------------------------------*/
 int bus_clock(struct Bus* bus)
 {
+  bus->cpu->deadline = scheduler_next(bus->sched);
+
   do
   {
     CPU6502_clock(bus->cpu);
@@ -89,50 +196,656 @@ int bus_clock(struct Bus* bus)
 
   CPU6502_dumpStatus(bus->cpu);
 
+  scheduler_dispatch(bus->sched, bus->cpu->clock_count);
+  bus_poll(bus);
+
   return 0;
 }
 
 /*----------------------------------------------------------------------------*/
-uint8_t bus_read(struct Bus *bus, uint16_t addr)
+int bus_run(struct Bus* bus, uint64_t cycles)
+{
+  struct CPU6502 *cpu = bus->cpu;
+  uint64_t end = SCHEDULER_NEVER;
+
+  if(cycles != BUS_RUN_FOREVER)
+  {
+    end = cpu->clock_count + cycles;
+  }
+
+  while(bus->stop == BUS_RUNNING && cpu->clock_count < end)
+  {
+    uint64_t next = scheduler_next(bus->sched);
+    uint64_t due = bus_poll(bus);
+
+    if(bus->stop != BUS_RUNNING)
+    {
+      break;
+    }
+
+    next = due < next ? due : next;
+    cpu->deadline = next < end ? next : end;
+    CPU6502_run(cpu);
+
+    scheduler_dispatch(bus->sched, cpu->clock_count);
+  }
+
+  if(bus->shmview != NULL)
+  {
+    shmview_update(bus->shmview);
+  }
+
+  return 0;
+}
+
+/*----------------------------------------------------------------------------*/
+struct Memory* bus_add_memory(struct Bus* bus, uint8_t type, uint32_t start, uint32_t size)
 {
-  uint8_t data = 0;
   struct Memory *mem = NULL;
+  int index = 0;
+
+  if(type == BUS_REGION_MIRROR || size == 0 || start > 0xFFFF || size > 0x10000 - start ||
+     ((start | size) & BUS_PAGE_MASK) != 0)
+  {
+    log_error("Invalid memory region 0x%04x size 0x%04x", start, size);
+    return NULL;
+  }
+
+  mem = memory_create(size, start, type == BUS_REGION_ROM);
+  if(mem == NULL)
+  {
+    return NULL;
+  }
+
+  index = bus_add_window(bus, type, start, size, mem, 0);
+  if(index < 0)
+  {
+    memory_destroy(&mem);
+    return NULL;
+  }
+  bus->region[index].owned = 1;
+
+  if(type == BUS_REGION_RAM && bus->ram == NULL)
+  {
+    bus->ram = mem;
+  }
+  else if(type == BUS_REGION_ROM && bus->rom == NULL)
+  {
+    bus->rom = mem;
+  }
+
+  return mem;
+}
+
+/*----------------------------------------------------------------------------*/
+int bus_add_mirror(struct Bus* bus, uint32_t start, uint32_t size, uint32_t source)
+{
+  struct BusRegion *region = NULL;
+
+  if(size == 0 || start > 0xFFFF || size > 0x10000 - start || source > 0xFFFF || size > 0x10000 - source ||
+     ((start | size | source) & BUS_PAGE_MASK) != 0)
+  {
+    log_error("Invalid mirror 0x%04x size 0x%04x of 0x%04x", start, size, source);
+    return -1;
+  }
+  if(bus->regions == BUS_MAX_REGIONS)
+  {
+    log_error("Too many memory regions");
+    return -1;
+  }
+
+  region = &bus->region[bus->regions++];
+  region->type = BUS_REGION_MIRROR;
+  region->owned = 0;
+  region->start = start;
+  region->size = size;
+  region->mem = NULL;
+  region->offset = 0;
+  region->source = source;
+
+  return bus_map(bus);
+}
+
+/*----------------------------------------------------------------------------*/
+int bus_add_window(struct Bus* bus, uint8_t type, uint32_t start, uint32_t size, struct Memory *mem, uint32_t offset)
+{
+  struct BusRegion *region = NULL;
+
+  if(type == BUS_REGION_MIRROR || size == 0 || start > 0xFFFF || size > 0x10000 - start ||
+     ((start | size | offset) & BUS_PAGE_MASK) != 0 || offset > mem->size || size > mem->size - offset)
+  {
+    log_error("Invalid window 0x%04x size 0x%04x at offset 0x%x", start, size, offset);
+    return -1;
+  }
+  if(bus->regions == BUS_MAX_REGIONS)
+  {
+    log_error("Too many memory regions");
+    return -1;
+  }
+
+  region = &bus->region[bus->regions++];
+  region->type = type;
+  region->owned = 0;
+  region->start = start;
+  region->size = size;
+  region->mem = mem;
+  region->offset = offset;
+  region->source = 0;
+
+  bus_map(bus);
+
+  return bus->regions - 1;
+}
+
+/*----------------------------------------------------------------------------*/
+int bus_remap(struct Bus* bus, int index, uint32_t offset)
+{
+  struct BusRegion *region = NULL;
+  uint8_t *old[BUS_PAGES];
+  uint32_t first = BUS_PAGES;
+  uint32_t last = 0;
+  uint32_t page = 0;
+  int i = 0;
+
+  if(index < 0 || index >= bus->regions || bus->region[index].mem == NULL)
+  {
+    log_error("Invalid region %d", index);
+    return -1;
+  }
+  region = &bus->region[index];
+  if((offset & BUS_PAGE_MASK) != 0 || offset + region->size > region->mem->size)
+  {
+    log_error("Invalid remap of region %d to offset 0x%x", index, offset);
+    return -1;
+  }
+  if(region->offset == offset)
+  {
+    return 0;
+  }
+  region->offset = offset;
+
+  /* Regions after the window may cover or mirror it, nothing before can */
+  memcpy(old, bus->backing, sizeof(old));
+  for(i = index; i < bus->regions; i++)
+  {
+    struct BusRegion *r = &bus->region[i];
+
+    if(r->size == 0)
+    {
+      continue;
+    }
+    bus_map_region(bus, r);
+    first = (r->start >> BUS_PAGE_SHIFT) < first ? (r->start >> BUS_PAGE_SHIFT) : first;
+    last = ((r->start + r->size) >> BUS_PAGE_SHIFT) > last ? ((r->start + r->size) >> BUS_PAGE_SHIFT) : last;
+  }
+
+  for(page = first; page < last; page++)
+  {
+    if(bus->backing[page] != old[page])
+    {
+      bus_map_page(bus, page);
+      if(bus->cpu != NULL)
+      {
+        CPU6502_invalidateBlocks(bus->cpu, page << BUS_PAGE_SHIFT, BUS_PAGE_SIZE);
+      }
+    }
+  }
+
+  return 0;
+}
+
+/*----------------------------------------------------------------------------*/
+int bus_remove_region(struct Bus* bus, int index)
+{
+  struct BusRegion *region = NULL;
+
+  if(index < 0 || index >= bus->regions)
+  {
+    log_error("Invalid region %d", index);
+    return -1;
+  }
+  region = &bus->region[index];
+
+  /* Keep the indices of the other regions */
+  if(region->owned)
+  {
+    if(bus->ram == region->mem)
+    {
+      bus->ram = NULL;
+    }
+    if(bus->rom == region->mem)
+    {
+      bus->rom = NULL;
+    }
+    memory_destroy(&region->mem);
+  }
+  region->mem = NULL;
+  region->owned = 0;
+  region->size = 0;
+
+  return bus_map(bus);
+}
+
+/*----------------------------------------------------------------------------*/
+int bus_clear_regions(struct Bus* bus)
+{
+  int i = 0;
+
+  for(i = 0; i < bus->regions; i++)
+  {
+    if(bus->region[i].owned)
+    {
+      memory_destroy(&bus->region[i].mem);
+    }
+  }
+  bus->regions = 0;
+  bus->ram = NULL;
+  bus->rom = NULL;
+
+  return bus_map(bus);
+}
+
+/*----------------------------------------------------------------------------*/
+int bus_map(struct Bus* bus)
+{
+  int page = 0;
+  int i = 0;
+
+  memset(bus->backing, 0, sizeof(bus->backing));
+  memset(bus->readonly, 0, sizeof(bus->readonly));
+
+  for(i = 0; i < bus->regions; i++)
+  {
+    bus_map_region(bus, &bus->region[i]);
+  }
+
+  for(page = 0; page < BUS_PAGES; page++)
+  {
+    bus_map_page(bus, page);
+  }
+
+  log_debug("Bus page table mapped");
+
+  return 0;
+}
+
+/*----------------------------------------------------------------------------*/
+static void bus_map_region(struct Bus* bus, struct BusRegion *region)
+{
+  uint32_t first = region->start >> BUS_PAGE_SHIFT;
+  uint32_t count = region->size >> BUS_PAGE_SHIFT;
+  uint32_t n = 0;
+
+  /* Mirrors see what the regions before them mapped at the source */
+  for(n = 0; n < count; n++)
+  {
+    if(region->type == BUS_REGION_MIRROR)
+    {
+      uint32_t src = (region->source >> BUS_PAGE_SHIFT) + n;
+
+      bus->backing[first + n] = bus->backing[src];
+      bus->readonly[first + n] = bus->readonly[src];
+    }
+    else
+    {
+      bus->backing[first + n] = region->mem->mem + region->offset + (n << BUS_PAGE_SHIFT);
+      bus->readonly[first + n] = region->type == BUS_REGION_ROM;
+    }
+  }
+}
+
+/*----------------------------------------------------------------------------*/
+static void bus_map_page(struct Bus* bus, uint32_t page)
+{
+  bus->rpage[page] = bus->rtrap[page] ? NULL : bus->backing[page];
+  /* ROM writes stay on the slow path so they are reported */
+  bus->wpage[page] = (bus->wtrap[page] || bus->readonly[page]) ? NULL : bus->backing[page];
+}
+
+/*----------------------------------------------------------------------------*/
+int bus_trap_read(struct Bus* bus, uint16_t addr, uint8_t enable)
+{
+  uint8_t page = addr >> BUS_PAGE_SHIFT;
 
-  if(addr >= 0x0000 && addr <=0x7fff)
+  if(enable)
   {
-    mem = bus->ram;
+    bus->rtrap[page]++;
+    bus->rpage[page] = NULL;
   }
-  else if(addr >= 0x8000 && addr <=0xffff)
+  else if(bus->rtrap[page] > 0)
   {
-    mem = bus->rom;
+    bus->rtrap[page]--;
+    if(bus->rtrap[page] == 0)
+    {
+      bus_map_page(bus, page);
+    }
+  }
+
+  return 0;
+}
+
+/*----------------------------------------------------------------------------*/
+int bus_trap_write(struct Bus* bus, uint16_t addr, uint8_t enable)
+{
+  uint8_t page = addr >> BUS_PAGE_SHIFT;
+
+  if(enable)
+  {
+    bus->wtrap[page]++;
+    bus->wpage[page] = NULL;
+  }
+  else if(bus->wtrap[page] > 0)
+  {
+    bus->wtrap[page]--;
+    if(bus->wtrap[page] == 0)
+    {
+      bus_map_page(bus, page);
+    }
+  }
+
+  return 0;
+}
+
+/*----------------------------------------------------------------------------*/
+int bus_cpu_hook(struct Bus* bus, uint16_t pc)
+{
+  uint8_t resumed = bus->resumed;
+
+  bus->resumed = 0;
+
+  if(bus->cpu->hooks & CPU6502_HOOK_STOP)
+  {
+    if(stop_hook(bus->stopcond, pc, resumed) != 0)
+    {
+      return 1;
+    }
+  }
+  if(bus->cpu->hooks & CPU6502_HOOK_DEBUG)
+  {
+    if(debug_hook(bus->dbg, pc, resumed) != 0)
+    {
+      return 1;
+    }
+  }
+
+  return 0;
+}
+
+/*----------------------------------------------------------------------------*/
+int bus_cpu_brk(struct Bus* bus)
+{
+  return stop_brk(bus->stopcond);
+}
+
+/*----------------------------------------------------------------------------*/
+int bus_irq_assert(struct Bus* bus, int line)
+{
+  if(line < 0 || line >= BUS_IRQ_LINES)
+  {
+    log_error("Invalid IRQ line %d", line);
+    return -1;
+  }
+
+  log_debug("Assert IRQ line %d", line);
+  return CPU6502_setIrqLine(bus->cpu, bus->irq[line].mask, 1);
+}
+
+/*----------------------------------------------------------------------------*/
+int bus_irq_release(struct Bus* bus, int line)
+{
+  if(line < 0 || line >= BUS_IRQ_LINES)
+  {
+    log_error("Invalid IRQ line %d", line);
+    return -1;
+  }
+
+  log_debug("Release IRQ line %d", line);
+  return CPU6502_setIrqLine(bus->cpu, bus->irq[line].mask, 0);
+}
+
+/*----------------------------------------------------------------------------*/
+int bus_nmi_assert(struct Bus* bus)
+{
+  log_debug("Assert NMI");
+  return CPU6502_setNmiLine(bus->cpu, 1);
+}
+
+/*----------------------------------------------------------------------------*/
+int bus_nmi_release(struct Bus* bus)
+{
+  log_debug("Release NMI");
+  return CPU6502_setNmiLine(bus->cpu, 0);
+}
+
+/*----------------------------------------------------------------------------*/
+int bus_irq_assert_at(struct Bus* bus, int line, uint64_t when)
+{
+  if(line < 0 || line >= BUS_IRQ_LINES)
+  {
+    log_error("Invalid IRQ line %d", line);
+    return -1;
+  }
+
+  return scheduler_add(bus->sched, when, bus_irq_assert_event, &bus->irq[line]);
+}
+
+/*----------------------------------------------------------------------------*/
+int bus_irq_release_at(struct Bus* bus, int line, uint64_t when)
+{
+  if(line < 0 || line >= BUS_IRQ_LINES)
+  {
+    log_error("Invalid IRQ line %d", line);
+    return -1;
   }
 
-  if(memory_readByte(mem, addr, &data) != 0)
+  return scheduler_add(bus->sched, when, bus_irq_release_event, &bus->irq[line]);
+}
+
+/*----------------------------------------------------------------------------*/
+int bus_nmi_at(struct Bus* bus, uint64_t when)
+{
+  return scheduler_add(bus->sched, when, bus_nmi_event, bus);
+}
+
+/*----------------------------------------------------------------------------*/
+static void bus_irq_assert_event(void *ctx, uint64_t when)
+{
+  struct BusIrqLine *irq = ctx;
+  CPU6502_setIrqLine(irq->bus->cpu, irq->mask, 1);
+}
+
+/*----------------------------------------------------------------------------*/
+static void bus_irq_release_event(void *ctx, uint64_t when)
+{
+  struct BusIrqLine *irq = ctx;
+  CPU6502_setIrqLine(irq->bus->cpu, irq->mask, 0);
+}
+
+/*----------------------------------------------------------------------------*/
+static void bus_nmi_event(void *ctx, uint64_t when)
+{
+  struct Bus *bus = ctx;
+
+  /* Pulse the line; the edge is latched by the CPU */
+  CPU6502_setNmiLine(bus->cpu, 1);
+  CPU6502_setNmiLine(bus->cpu, 0);
+}
+
+/*----------------------------------------------------------------------------*/
+uint8_t bus_read(struct Bus *bus, uint16_t addr)
+{
+  uint8_t data = 0;
+  uint8_t *page = NULL;
+
+  if(bus->rtrap[addr >> BUS_PAGE_SHIFT])
+  {
+    struct Device *dev = NULL;
+
+    debug_read(bus->dbg, addr);
+
+    /* A device without read shares the page with one that has it */
+    dev = device_find(bus, addr);
+    if(dev != NULL && dev->ops->read != NULL)
+    {
+      device_sync(dev, CPU6502_now(bus->cpu));
+      return dev->ops->read(dev->ctx, addr - dev->start);
+    }
+  }
+
+  page = bus->backing[addr >> BUS_PAGE_SHIFT];
+  if(page == NULL)
   {
     log_error("Could not read address 0x%04x from memory", addr);
     return 0;
   }
+  data = page[addr & BUS_PAGE_MASK];
 
   log_trace("Read data 0x%02x from 0x%04x", data, addr);
   return data;
 }
 
+/*----------------------------------------------------------------------------*/
+uint8_t bus_peek(struct Bus *bus, uint16_t addr)
+{
+  uint8_t *page = bus->backing[addr >> BUS_PAGE_SHIFT];
+
+  if(bus->dev[addr >> BUS_PAGE_SHIFT] != NULL)
+  {
+    struct Device *dev = device_find(bus, addr);
+
+    if(dev != NULL && dev->ops->read != NULL)
+    {
+      return dev->ops->peek != NULL ? dev->ops->peek(dev->ctx, addr - dev->start) : 0;
+    }
+  }
+
+  /* Side effect free access for debuggers and code inspection */
+  return page != NULL ? page[addr & BUS_PAGE_MASK] : 0;
+}
+
+/*----------------------------------------------------------------------------*/
+int bus_peek_block(struct Bus *bus, uint16_t addr, uint8_t *dst, uint32_t len)
+{
+  uint32_t done = 0;
+
+  /* Copy whole pages where the page table has a direct pointer */
+  while(done < len)
+  {
+    uint16_t cur = addr + done;
+    uint32_t chunk = BUS_PAGE_SIZE - (cur & BUS_PAGE_MASK);
+    uint8_t *page = bus->rpage[cur >> BUS_PAGE_SHIFT];
+
+    if(chunk > len - done)
+    {
+      chunk = len - done;
+    }
+
+    if(page != NULL)
+    {
+      memcpy(dst + done, page + (cur & BUS_PAGE_MASK), chunk);
+    }
+    else
+    {
+      uint32_t i = 0;
+      for(i = 0; i < chunk; i++)
+      {
+        dst[done + i] = bus_peek(bus, cur + i);
+      }
+    }
+    done += chunk;
+  }
+
+  return 0;
+}
+
+/*----------------------------------------------------------------------------*/
+int bus_write_block(struct Bus *bus, uint16_t addr, const uint8_t *src, uint32_t len)
+{
+  uint32_t done = 0;
+
+  /* DMA: whole pages where writes go straight to memory, trapped pages
+   * byte by byte so devices, ROM and watchpoints see the writes */
+  while(done < len)
+  {
+    uint16_t cur = addr + done;
+    uint32_t chunk = BUS_PAGE_SIZE - (cur & BUS_PAGE_MASK);
+    uint8_t *page = bus->wpage[cur >> BUS_PAGE_SHIFT];
+
+    if(chunk > len - done)
+    {
+      chunk = len - done;
+    }
+
+    if(page != NULL)
+    {
+      memcpy(page + (cur & BUS_PAGE_MASK), src + done, chunk);
+    }
+    else
+    {
+      uint32_t i = 0;
+      for(i = 0; i < chunk; i++)
+      {
+        bus_write(bus, cur + i, src[done + i]);
+      }
+    }
+    CPU6502_invalidateBlocks(bus->cpu, cur, chunk);
+    done += chunk;
+  }
+
+  return 0;
+}
+
+/*----------------------------------------------------------------------------*/
+void bus_poke(struct Bus *bus, uint16_t addr, uint8_t data)
+{
+  uint8_t *page = bus->backing[addr >> BUS_PAGE_SHIFT];
+  struct Device *dev = device_find(bus, addr);
+
+  /* Side effect free write for debuggers, ROM included, devices ignore it
+   * unless they only watch writes to memory */
+  if(page == NULL || (dev != NULL && dev->ops->read != NULL))
+  {
+    return;
+  }
+  page[addr & BUS_PAGE_MASK] = data;
+  CPU6502_invalidateBlocks(bus->cpu, addr, 1);
+}
+
 /*----------------------------------------------------------------------------*/
 void bus_write(struct Bus *bus, uint16_t addr, uint8_t data)
 {
-  if(addr >= 0x0000 && addr <=0x7fff)
+  uint8_t *page = NULL;
+
+  if(bus->wtrap[addr >> BUS_PAGE_SHIFT])
   {
-    if(memory_writeByte(bus->ram, addr, data) != 0)
+    struct Device *dev = NULL;
+
+    stop_write(bus->stopcond, addr, data);
+    debug_write(bus->dbg, addr, data);
+
+    dev = device_find(bus, addr);
+    if(dev != NULL)
     {
-      log_error("Could not write data 0x%02x to address 0x%04x", data, addr);
+      device_sync(dev, CPU6502_now(bus->cpu));
+      dev->ops->write(dev->ctx, addr - dev->start, data);
+      return;
     }
+  }
 
-    log_trace("Write data 0x%02x to 0x%04x", data, addr);
+  page = bus->backing[addr >> BUS_PAGE_SHIFT];
+  if(page == NULL)
+  {
+    log_error("Could not write data 0x%02x to address 0x%04x", data, addr);
   }
-  else if(addr >= 0x8000 && addr <= 0xffff)
+  else if(bus->readonly[addr >> BUS_PAGE_SHIFT])
   {
     log_error("Could not write data 0x%02x to ROM addr 0x%04x", data, addr);
   }
+  else
+  {
+    page[addr & BUS_PAGE_MASK] = data;
+    log_trace("Write data 0x%02x to 0x%04x", data, addr);
+  }
 }
 
 /*----------------------------------------------------------------------------*/
@@ -144,6 +857,57 @@ int bus_is_set_to_stop(struct Bus* bus)
 /*----------------------------------------------------------------------------*/
 int bus_set_to_stop(struct Bus* bus)
 {
-  bus->stop = 1;
+  return bus_stop(bus, BUS_STOP_REQUEST);
+}
+
+/*----------------------------------------------------------------------------*/
+int bus_stop(struct Bus* bus, int reason)
+{
+  if(bus->stop == BUS_RUNNING)
+  {
+    bus->stop = reason;
+  }
+  /* Leave CPU6502_run() at the next instruction boundary */
+  bus->cpu->deadline = 0;
+  return 0;
+}
+
+/*----------------------------------------------------------------------------*/
+int bus_resume(struct Bus* bus)
+{
+  bus->stop = BUS_RUNNING;
+  /* Do not stop again at the PC we stopped at */
+  bus->resumed = bus->cpu->hooks != 0;
   return 0;
 }
+
+/*----------------------------------------------------------------------------*/
+const char* bus_stop_reason_string(int reason)
+{
+  if(reason < 0 || reason >= sizeof(stop_reason_strings) / sizeof(stop_reason_strings[0]))
+  {
+    return "unknown";
+  }
+  return stop_reason_strings[reason];
+}
+
+/*----------------------------------------------------------------------------*/
+static uint64_t bus_poll(struct Bus* bus)
+{
+  uint64_t due = SCHEDULER_NEVER;
+
+  /* Housekeeping between slices. It is no scheduler event, an idle guest
+   * would never run out of events to wait for otherwise. Returns the cycle
+   * it is due again. */
+  if(bus->stopcond != NULL)
+  {
+    due = stop_poll(bus->stopcond, bus->cpu->clock_count);
+  }
+  if(bus->shmview != NULL)
+  {
+    uint64_t view_due = shmview_poll(bus->shmview, bus->cpu->clock_count);
+    due = view_due < due ? view_due : due;
+  }
+
+  return due;
+}
@@ -5,370 +5,20 @@
  */
 
 #include <stdlib.h>
+#include <string.h>
+#include <inttypes.h>
 
 #include "util/log.h"
 
 #include "core/bus.h"
 #include "core/cpu6502.h"
+#include "core/bcd.h"
+#include "core/cpu6502_core.h"
 
-struct OpCodeLUT
-{
-  char *mnemonic;
-  uint8_t cycles;
-  uint8_t (*addrMode)(struct CPU6502 *cpu);
-  uint8_t (*instruction)(struct CPU6502 *cpu);
-};
-
-/* Adressing mode */
-static uint8_t CPU6502_imp(struct CPU6502 *cpu); /* Implied */
-static uint8_t CPU6502_imm(struct CPU6502 *cpu); /* Immediate */
-static uint8_t CPU6502_zpg(struct CPU6502 *cpu); /* Zero Page */
-static uint8_t CPU6502_zpx(struct CPU6502 *cpu); /* Zero Page with X Offset */
-static uint8_t CPU6502_zpy(struct CPU6502 *cpu); /* Zero Page with Y Offset */
-static uint8_t CPU6502_rel(struct CPU6502 *cpu); /* Relative */
-static uint8_t CPU6502_abs(struct CPU6502 *cpu); /* Absolute */
-static uint8_t CPU6502_abx(struct CPU6502 *cpu); /* Absolute with X Offset */
-static uint8_t CPU6502_aby(struct CPU6502 *cpu); /* Absolute with Y Offset */
-static uint8_t CPU6502_ind(struct CPU6502 *cpu); /* Indirect */
-static uint8_t CPU6502_izx(struct CPU6502 *cpu); /* Indirect X */
-static uint8_t CPU6502_izy(struct CPU6502 *cpu); /* Indirect Y */
-
-/* Instructions */
-static uint8_t CPU6502_adc(struct CPU6502 *cpu); /* Add with Carry */
-static uint8_t CPU6502_and(struct CPU6502 *cpu); /* AND */
-static uint8_t CPU6502_asl(struct CPU6502 *cpu); /* Arithmetic shift one CPU6502_bit left */
-static uint8_t CPU6502_bcc(struct CPU6502 *cpu); /* Branch on Carry clear */
-static uint8_t CPU6502_bcs(struct CPU6502 *cpu); /* Branch on Carry set */
-static uint8_t CPU6502_beq(struct CPU6502 *cpu); /* Branch if equal */
-static uint8_t CPU6502_bit(struct CPU6502 *cpu); /* Bit test */
-static uint8_t CPU6502_bmi(struct CPU6502 *cpu); /* Branch if reslut minus */
-static uint8_t CPU6502_bne(struct CPU6502 *cpu); /* Branch if not equal */
-static uint8_t CPU6502_bpl(struct CPU6502 *cpu); /* Branch if relult plus */
-static uint8_t CPU6502_brk(struct CPU6502 *cpu); /* Break */
-static uint8_t CPU6502_bvc(struct CPU6502 *cpu); /* Branch on overflow clear */
-static uint8_t CPU6502_bvs(struct CPU6502 *cpu); /* Branch on overflow set */
-static uint8_t CPU6502_clc(struct CPU6502 *cpu); /* Clear carry flag */
-static uint8_t CPU6502_cld(struct CPU6502 *cpu); /* Clear CPU6502_decimal mode */
-static uint8_t CPU6502_cli(struct CPU6502 *cpu); /* Clear interrupt disable flag */
-static uint8_t CPU6502_clv(struct CPU6502 *cpu); /* Clear overflow flag */
-static uint8_t CPU6502_cmp(struct CPU6502 *cpu); /* Compare memory CPU6502_and accumulator */
-static uint8_t CPU6502_cpx(struct CPU6502 *cpu); /* Compare memory CPU6502_and X register */
-static uint8_t CPU6502_cpy(struct CPU6502 *cpu); /* Compare memory CPU6502_and Y register */
-static uint8_t CPU6502_dec(struct CPU6502 *cpu); /* Decrement memory or accumulator by one */
-static uint8_t CPU6502_dex(struct CPU6502 *cpu); /* Decrement X by one */
-static uint8_t CPU6502_dey(struct CPU6502 *cpu); /* Decrement Y by one */
-static uint8_t CPU6502_eor(struct CPU6502 *cpu); /* Exclusice or memory or accumulator by one */
-static uint8_t CPU6502_inc(struct CPU6502 *cpu); /* Increment memory or accumulator by one */
-static uint8_t CPU6502_inx(struct CPU6502 *cpu); /* Increment X register by one */
-static uint8_t CPU6502_iny(struct CPU6502 *cpu); /* Increment Y register by one */
-static uint8_t CPU6502_jmp(struct CPU6502 *cpu); /* Jump to new location */
-static uint8_t CPU6502_jsr(struct CPU6502 *cpu); /* Jump to new location saving return */
-static uint8_t CPU6502_lda(struct CPU6502 *cpu); /* Load accumulator with memory */
-static uint8_t CPU6502_ldx(struct CPU6502 *cpu); /* Load X register with memory */
-static uint8_t CPU6502_ldy(struct CPU6502 *cpu); /* Load Y register with memory */
-static uint8_t CPU6502_lsr(struct CPU6502 *cpu); /* Logical shift one CPU6502_bit right memory or accumulator */
-static uint8_t CPU6502_nop(struct CPU6502 *cpu); /* No operation */
-static uint8_t CPU6502_ora(struct CPU6502 *cpu); /* Or memory with accumulator */
-static uint8_t CPU6502_pha(struct CPU6502 *cpu); /* Push accumulator on stack */
-static uint8_t CPU6502_php(struct CPU6502 *cpu); /* Push processor status on stack */
-static uint8_t CPU6502_pla(struct CPU6502 *cpu); /* Pull accumulator from stack */
-static uint8_t CPU6502_plp(struct CPU6502 *cpu); /* Pull processor status from stack */
-static uint8_t CPU6502_rol(struct CPU6502 *cpu); /* Rotate one CPU6502_bit left memory or accumulator */
-static uint8_t CPU6502_ror(struct CPU6502 *cpu); /* Rotate one CPU6502_bit right memory or accumulator */
-static uint8_t CPU6502_rti(struct CPU6502 *cpu); /* Return from interrupt */
-static uint8_t CPU6502_rts(struct CPU6502 *cpu); /* Return from subroutine */
-static uint8_t CPU6502_sbc(struct CPU6502 *cpu); /* Substract memory from accumulator with borrow (carry) */
-static uint8_t CPU6502_sec(struct CPU6502 *cpu); /* Set carry */
-static uint8_t CPU6502_sed(struct CPU6502 *cpu); /* Set CPU6502_decimal mode */
-static uint8_t CPU6502_sei(struct CPU6502 *cpu); /* Set interrupt flag */
-static uint8_t CPU6502_sta(struct CPU6502 *cpu); /* Store accumulator in memory */
-static uint8_t CPU6502_stx(struct CPU6502 *cpu); /* Store X register in memory */
-static uint8_t CPU6502_sty(struct CPU6502 *cpu); /* Store Y register in memory */
-static uint8_t CPU6502_tax(struct CPU6502 *cpu); /* Transfer the accumulator to the X register */
-static uint8_t CPU6502_tay(struct CPU6502 *cpu); /* Transfer the accumulator to the Y register */
-static uint8_t CPU6502_tsx(struct CPU6502 *cpu); /* Transfer the stack pointer to the Y register */
-static uint8_t CPU6502_txa(struct CPU6502 *cpu); /* Transfer the X register the accumulator */
-static uint8_t CPU6502_txs(struct CPU6502 *cpu); /* Transfer the X register the stack pointer */
-static uint8_t CPU6502_tya(struct CPU6502 *cpu); /* Transfer the Y register the accumulator */
-
-static uint8_t CPU6502_xxx(struct CPU6502 *cpu); /* Illegal OpCode */
-
-static struct OpCodeLUT opcodes [] = {
-/* 0x0x */
-  { "BRK", 7, CPU6502_imp, CPU6502_brk },
-  { "ORA", 6, CPU6502_izx, CPU6502_ora },
-  { ""   , 0, CPU6502_imp, CPU6502_xxx },
-  { ""   , 0, CPU6502_imp, CPU6502_xxx },
-  { ""   , 0, CPU6502_imp, CPU6502_xxx },
-  { "ORA", 3, CPU6502_zpg, CPU6502_ora },
-  { "ASL", 5, CPU6502_zpg, CPU6502_asl },
-  { ""   , 0, CPU6502_imp, CPU6502_xxx },
-  { "PHP", 3, CPU6502_imp, CPU6502_php },
-  { "ORA", 2, CPU6502_imm, CPU6502_ora },
-  { "ASL", 2, CPU6502_imp, CPU6502_asl },
-  { ""   , 0, CPU6502_imp, CPU6502_xxx },
-  { ""   , 0, CPU6502_imp, CPU6502_xxx },
-  { "ORA", 4, CPU6502_abs, CPU6502_ora },
-  { "ASL", 6, CPU6502_abs, CPU6502_asl },
-  { ""   , 0, CPU6502_imp, CPU6502_xxx },
-/* 0x1x */
-  { "BPL", 2, CPU6502_rel, CPU6502_bpl },
-  { "ORA", 5, CPU6502_izy, CPU6502_ora },
-  { ""   , 0, CPU6502_imp, CPU6502_xxx },
-  { ""   , 0, CPU6502_imp, CPU6502_xxx },
-  { ""   , 0, CPU6502_imp, CPU6502_xxx },
-  { "ORA", 4, CPU6502_zpx, CPU6502_ora },
-  { "ASL", 6, CPU6502_zpx, CPU6502_asl },
-  { ""   , 0, CPU6502_imp, CPU6502_xxx },
-  { "CLC", 2, CPU6502_imp, CPU6502_clc },
-  { "ORA", 4, CPU6502_aby, CPU6502_ora },
-  { ""   , 0, CPU6502_imp, CPU6502_xxx },
-  { ""   , 0, CPU6502_imp, CPU6502_xxx },
-  { ""   , 0, CPU6502_imp, CPU6502_xxx },
-  { "ORA", 4, CPU6502_abx, CPU6502_ora },
-  { "ASL", 7, CPU6502_abx, CPU6502_asl },
-  { ""   , 0, CPU6502_imp, CPU6502_xxx },
-/* 0x2x */
-  { "JSR", 6, CPU6502_abs, CPU6502_jsr },
-  { "AND", 6, CPU6502_izx, CPU6502_and },
-  { ""   , 0, CPU6502_imp, CPU6502_xxx },
-  { "",    0, CPU6502_imp, CPU6502_xxx },
-  { "BIT", 2, CPU6502_zpg, CPU6502_bit },
-  { "AND", 3, CPU6502_zpg, CPU6502_and },
-  { "ROL", 5, CPU6502_zpg, CPU6502_rol },
-  { ""   , 0, CPU6502_imp, CPU6502_xxx },
-  { "PLP", 4, CPU6502_imp, CPU6502_plp },
-  { "AND", 2, CPU6502_imm, CPU6502_and },
-  { "ROL", 2, CPU6502_imp, CPU6502_rol },
-  { ""   , 0, CPU6502_imp, CPU6502_xxx },
-  { "BIT", 4, CPU6502_abs, CPU6502_bit },
-  { "AND", 4, CPU6502_abs, CPU6502_and },
-  { "ROL", 6, CPU6502_abs, CPU6502_rol },
-  { ""   , 0, CPU6502_imp, CPU6502_xxx },
-/* 0x3x */
-  { "BMI", 2, CPU6502_rel, CPU6502_bmi },
-  { "AND", 5, CPU6502_izy, CPU6502_and },
-  { ""   , 0, CPU6502_imp, CPU6502_xxx },
-  { ""   , 0, CPU6502_imp, CPU6502_xxx },
-  { ""   , 0, CPU6502_imp, CPU6502_xxx },
-  { "AND", 4, CPU6502_zpx, CPU6502_and },
-  { "ROL", 6, CPU6502_zpx, CPU6502_rol },
-  { ""   , 0, CPU6502_imp, CPU6502_xxx },
-  { "SEC", 2, CPU6502_imp, CPU6502_sec },
-  { "AND", 4, CPU6502_aby, CPU6502_and },
-  { ""   , 0, CPU6502_imp, CPU6502_xxx },
-  { ""   , 0, CPU6502_imp, CPU6502_xxx },
-  { ""   , 0, CPU6502_imp, CPU6502_xxx },
-  { "AND", 4, CPU6502_abx, CPU6502_and },
-  { "ROL", 7, CPU6502_abx, CPU6502_rol },
-  { ""   , 0, CPU6502_imp, CPU6502_xxx },
-/* 0x4x */
-  { "RTI", 6, CPU6502_imp, CPU6502_rti },
-  { "EOR", 6, CPU6502_izx, CPU6502_eor },
-  { ""   , 0, CPU6502_imp, CPU6502_xxx },
-  { ""   , 0, CPU6502_imp, CPU6502_xxx },
-  { ""   , 0, CPU6502_imp, CPU6502_xxx },
-  { "EOR", 3, CPU6502_zpg, CPU6502_eor },
-  { "LSR", 5, CPU6502_zpg, CPU6502_lsr },
-  { ""   , 0, CPU6502_imp, CPU6502_xxx },
-  { "PHA", 3, CPU6502_imp, CPU6502_pha },
-  { "EOR", 2, CPU6502_imm, CPU6502_eor },
-  { "LSR", 2, CPU6502_imp, CPU6502_lsr },
-  { ""   , 0, CPU6502_imp, CPU6502_xxx },
-  { "JMP", 3, CPU6502_abs, CPU6502_jmp },
-  { "EOR", 4, CPU6502_abs, CPU6502_eor },
-  { "LSR", 6, CPU6502_abs, CPU6502_lsr },
-  { ""   , 0, CPU6502_imp, CPU6502_xxx },
-/* 0x5x */
-  { "BVC", 2, CPU6502_rel, CPU6502_bvc },
-  { "EOR", 5, CPU6502_izy, CPU6502_eor },
-  { ""   , 0, CPU6502_imp, CPU6502_xxx },
-  { ""   , 0, CPU6502_imp, CPU6502_xxx },
-  { ""   , 0, CPU6502_imp, CPU6502_xxx },
-  { "EOR", 4, CPU6502_zpx, CPU6502_eor },
-  { "LSR", 6, CPU6502_zpx, CPU6502_lsr },
-  { ""   , 0, CPU6502_imp, CPU6502_xxx },
-  { "CLI", 2, CPU6502_imp, CPU6502_cli },
-  { "EOR", 4, CPU6502_aby, CPU6502_eor },
-  { ""   , 0, CPU6502_imp, CPU6502_xxx },
-  { ""   , 0, CPU6502_imp, CPU6502_xxx },
-  { ""   , 0, CPU6502_imp, CPU6502_xxx },
-  { "EOR", 4, CPU6502_abx, CPU6502_eor },
-  { "LSR", 7, CPU6502_abx, CPU6502_lsr },
-  { ""   , 0, CPU6502_imp, CPU6502_xxx },
-/* 0x6x */
-  { "RTS", 6, CPU6502_imp, CPU6502_rts },
-  { "ADC", 6, CPU6502_izx, CPU6502_adc },
-  { ""   , 0, CPU6502_imp, CPU6502_xxx },
-  { ""   , 0, CPU6502_imp, CPU6502_xxx },
-  { ""   , 0, CPU6502_imp, CPU6502_xxx },
-  { "ADC", 3, CPU6502_zpg, CPU6502_adc },
-  { "ROR", 5, CPU6502_zpg, CPU6502_ror },
-  { ""   , 0, CPU6502_imp, CPU6502_xxx },
-  { "PLA", 4, CPU6502_imp, CPU6502_pla },
-  { "ADC", 2, CPU6502_imm, CPU6502_adc },
-  { "ROR", 2, CPU6502_imp, CPU6502_ror },
-  { ""   , 0, CPU6502_imp, CPU6502_xxx },
-  { "JMP", 5, CPU6502_ind, CPU6502_jmp },
-  { "ADC", 4, CPU6502_abs, CPU6502_adc },
-  { "ROR", 6, CPU6502_abs, CPU6502_ror },
-  { ""   , 0, CPU6502_imp, CPU6502_xxx },
-/* 0x7x */
-  { "BVS", 2, CPU6502_rel, CPU6502_bvs },
-  { "ADC", 5, CPU6502_izy, CPU6502_adc },
-  { ""   , 0, CPU6502_imp, CPU6502_xxx },
-  { ""   , 0, CPU6502_imp, CPU6502_xxx },
-  { ""   , 0, CPU6502_imp, CPU6502_xxx },
-  { "ADC", 4, CPU6502_zpx, CPU6502_adc },
-  { "ROR", 6, CPU6502_zpx, CPU6502_ror },
-  { ""   , 0, CPU6502_imp, CPU6502_xxx },
-  { "SEI", 2, CPU6502_imp, CPU6502_sei },
-  { "ADC", 4, CPU6502_aby, CPU6502_adc },
-  { ""   , 0, CPU6502_imp, CPU6502_xxx },
-  { ""   , 0, CPU6502_imp, CPU6502_xxx },
-  { ""   , 0, CPU6502_imp, CPU6502_xxx },
-  { "ADC", 4, CPU6502_abx, CPU6502_adc },
-  { "ROR", 7, CPU6502_abx, CPU6502_ror },
-  { ""   , 0, CPU6502_imp, CPU6502_xxx },
-/* 0x8x */
-  { ""   , 0, CPU6502_imp, CPU6502_xxx },
-  { "STA", 6, CPU6502_izx, CPU6502_sta },
-  { ""   , 0, CPU6502_imp, CPU6502_xxx },
-  { ""   , 0, CPU6502_imp, CPU6502_xxx },
-  { "STY", 3, CPU6502_zpg, CPU6502_sty },
-  { "STA", 3, CPU6502_zpg, CPU6502_sta },
-  { "STX", 3, CPU6502_zpg, CPU6502_stx },
-  { ""   , 0, CPU6502_imp, CPU6502_xxx },
-  { "DEY", 2, CPU6502_imp, CPU6502_dey },
-  { ""   , 0, CPU6502_imp, CPU6502_xxx },
-  { "TXA", 2, CPU6502_imp, CPU6502_txa },
-  { ""   , 0, CPU6502_imp, CPU6502_xxx },
-  { "STY", 4, CPU6502_abs, CPU6502_sty },
-  { "STA", 4, CPU6502_abs, CPU6502_sta },
-  { "STX", 4, CPU6502_abs, CPU6502_stx },
-  { ""   , 0, CPU6502_imp, CPU6502_xxx },
-/* 0x9x */
-  { "BCC", 2, CPU6502_rel, CPU6502_bcc },
-  { "STA", 6, CPU6502_izy, CPU6502_sta },
-  { ""   , 0, CPU6502_imp, CPU6502_xxx },
-  { ""   , 0, CPU6502_imp, CPU6502_xxx },
-  { "STY", 4, CPU6502_zpx, CPU6502_sty },
-  { "STA", 4, CPU6502_zpx, CPU6502_sta },
-  { "STX", 4, CPU6502_zpy, CPU6502_stx },
-  { ""   , 0, CPU6502_imp, CPU6502_xxx },
-  { "TYA", 2, CPU6502_imp, CPU6502_tya },
-  { "STA", 5, CPU6502_aby, CPU6502_sta },
-  { "TXS", 2, CPU6502_imp, CPU6502_txs },
-  { ""   , 0, CPU6502_imp, CPU6502_xxx },
-  { ""   , 0, CPU6502_imp, CPU6502_xxx },
-  { "STA", 5, CPU6502_abx, CPU6502_sta },
-  { ""   , 0, CPU6502_imp, CPU6502_xxx },
-  { ""   , 0, CPU6502_imp, CPU6502_xxx },
-/* 0xAx */
-  { "LDY", 2, CPU6502_imm, CPU6502_ldy },
-  { "LDA", 6, CPU6502_izx, CPU6502_lda },
-  { "LDX", 2, CPU6502_imm, CPU6502_ldx },
-  { ""   , 0, CPU6502_imp, CPU6502_xxx },
-  { "LDY", 3, CPU6502_zpg, CPU6502_ldy },
-  { "LDA", 3, CPU6502_zpg, CPU6502_lda },
-  { "LDX", 3, CPU6502_zpg, CPU6502_ldx },
-  { ""   , 0, CPU6502_imp, CPU6502_xxx },
-  { "TAY", 2, CPU6502_imp, CPU6502_tay },
-  { "LDA", 2, CPU6502_imm, CPU6502_lda },
-  { "TAX", 2, CPU6502_imp, CPU6502_tax },
-  { ""   , 0, CPU6502_imp, CPU6502_xxx },
-  { "LDY", 4, CPU6502_abs, CPU6502_ldy },
-  { "LDA", 4, CPU6502_abs, CPU6502_lda },
-  { "LDX", 4, CPU6502_abs, CPU6502_ldx },
-  { ""   , 0, CPU6502_imp, CPU6502_xxx },
-/* 0xBx */
-  { "BCS", 2, CPU6502_rel, CPU6502_bcs },
-  { "LDA", 5, CPU6502_izy, CPU6502_lda },
-  { ""   , 0, CPU6502_imp, CPU6502_xxx },
-  { ""   , 0, CPU6502_imp, CPU6502_xxx },
-  { "LDY", 4, CPU6502_zpx, CPU6502_ldy },
-  { "LDA", 4, CPU6502_zpx, CPU6502_lda },
-  { "LDX", 4, CPU6502_zpy, CPU6502_ldx },
-  { ""   , 0, CPU6502_imp, CPU6502_xxx },
-  { "CLV", 2, CPU6502_imp, CPU6502_clv },
-  { "LDA", 4, CPU6502_aby, CPU6502_lda },
-  { "TSX", 2, CPU6502_imp, CPU6502_tsx },
-  { ""   , 0, CPU6502_imp, CPU6502_xxx },
-  { "LDY", 4, CPU6502_abx, CPU6502_ldy },
-  { "LDA", 4, CPU6502_abx, CPU6502_lda },
-  { "LDX", 4, CPU6502_aby, CPU6502_ldx },
-  { ""   , 0, CPU6502_imp, CPU6502_xxx },
-/* 0xCx */
-  { "CPY", 2, CPU6502_imm, CPU6502_cpy },
-  { "CMP", 6, CPU6502_izx, CPU6502_cmp },
-  { ""   , 0, CPU6502_imp, CPU6502_xxx },
-  { ""   , 0, CPU6502_imp, CPU6502_xxx },
-  { "CPY", 3, CPU6502_zpg, CPU6502_cpy },
-  { "CMP", 3, CPU6502_zpg, CPU6502_cmp },
-  { "DEC", 5, CPU6502_zpg, CPU6502_dec },
-  { ""   , 0, CPU6502_imp, CPU6502_xxx },
-  { "INY", 2, CPU6502_imp, CPU6502_iny },
-  { "CMP", 2, CPU6502_imm, CPU6502_cmp },
-  { "DEX", 2, CPU6502_imp, CPU6502_dex },
-  { ""   , 0, CPU6502_imp, CPU6502_xxx },
-  { "CPY", 4, CPU6502_abs, CPU6502_cpy },
-  { "CMP", 4, CPU6502_abs, CPU6502_cmp },
-  { "DEC", 6, CPU6502_abs, CPU6502_dec },
-  { ""   , 0, CPU6502_imp, CPU6502_xxx },
-/* 0xDx */
-  { "BNE", 2, CPU6502_rel, CPU6502_bne },
-  { "CMP", 5, CPU6502_izy, CPU6502_cmp },
-  { ""   , 0, CPU6502_imp, CPU6502_xxx },
-  { ""   , 0, CPU6502_imp, CPU6502_xxx },
-  { ""   , 0, CPU6502_imp, CPU6502_xxx },
-  { "CMP", 4, CPU6502_zpx, CPU6502_cmp },
-  { "DEC", 6, CPU6502_zpx, CPU6502_dec },
-  { ""   , 0, CPU6502_imp, CPU6502_xxx },
-  { "CLD", 2, CPU6502_imp, CPU6502_cld },
-  { "CMP", 4, CPU6502_aby, CPU6502_cmp },
-  { ""   , 0, CPU6502_imp, CPU6502_xxx },
-  { ""   , 0, CPU6502_imp, CPU6502_xxx },
-  { ""   , 0, CPU6502_imp, CPU6502_xxx },
-  { "CMP", 4, CPU6502_abx, CPU6502_cmp },
-  { "DEC", 7, CPU6502_abx, CPU6502_dec },
-  { ""   , 0, CPU6502_imp, CPU6502_xxx },
-/* 0xEx */
-  { "CPX", 2, CPU6502_imm, CPU6502_cpx },
-  { "SBC", 6, CPU6502_izx, CPU6502_sbc },
-  { ""   , 0, CPU6502_imp, CPU6502_xxx },
-  { ""   , 0, CPU6502_imp, CPU6502_xxx },
-  { "CPX", 3, CPU6502_zpg, CPU6502_cpx },
-  { "SBC", 3, CPU6502_zpg, CPU6502_sbc },
-  { "INC", 5, CPU6502_zpg, CPU6502_inc },
-  { ""   , 0, CPU6502_imp, CPU6502_xxx },
-  { "INX", 2, CPU6502_imp, CPU6502_inx },
-  { "SBC", 2, CPU6502_imm, CPU6502_sbc },
-  { "NOP", 2, CPU6502_imp, CPU6502_nop },
-  { ""   , 0, CPU6502_imp, CPU6502_xxx },
-  { "CPX", 4, CPU6502_abs, CPU6502_cpx },
-  { "SBC", 4, CPU6502_abs, CPU6502_sbc },
-  { "INC", 6, CPU6502_abs, CPU6502_inc },
-  { ""   , 0, CPU6502_imp, CPU6502_xxx },
-/* 0xFx */
-  { "BEQ", 2, CPU6502_rel, CPU6502_beq },
-  { "SBC", 5, CPU6502_izy, CPU6502_sbc },
-  { ""   , 0, CPU6502_imp, CPU6502_xxx },
-  { ""   , 0, CPU6502_imp, CPU6502_xxx },
-  { ""   , 0, CPU6502_imp, CPU6502_xxx },
-  { "SBC", 4, CPU6502_zpx, CPU6502_sbc },
-  { "INC", 6, CPU6502_zpx, CPU6502_inc },
-  { ""   , 0, CPU6502_imp, CPU6502_xxx },
-  { "SED", 2, CPU6502_imp, CPU6502_sed },
-  { "SBC", 4, CPU6502_aby, CPU6502_sbc },
-  { ""   , 0, CPU6502_imp, CPU6502_xxx },
-  { ""   , 0, CPU6502_imp, CPU6502_xxx },
-  { ""   , 0, CPU6502_imp, CPU6502_xxx },
-  { "SBC", 4, CPU6502_abx, CPU6502_sbc },
-  { "INC", 7, CPU6502_abx, CPU6502_inc },
-  { ""   , 0, CPU6502_imp, CPU6502_xxx },
-};
-
-static uint8_t CPU6502_fetch(struct CPU6502 *cpu);
+static uint8_t CPU6502_execute(struct CPU6502 *cpu);
+static void CPU6502_interrupt(struct CPU6502 *cpu, uint16_t vector);
+static uint32_t CPU6502_blockFirst(struct CPU6502 *cpu, uint32_t pc);
+static uint32_t CPU6502_blockLast(struct CPU6502 *cpu, uint32_t pc);
 
 /*----------------------------------------------------------------------------*/
 struct CPU6502* CPU6502_create(struct Bus* bus, uint8_t (*read)(struct Bus*, uint16_t), void (*write)(struct Bus*, uint16_t, uint8_t))
@@ -388,6 +38,22 @@ struct CPU6502* CPU6502_create(struct Bus* bus, uint8_t (*read)(struct Bus*, uin
   cpu->write = write;
   cpu->bus = bus;
 
+  cpu->cycles = 0;
+  cpu->clock_count = 0;
+  cpu->deadline = 0;
+
+  cpu->irq_lines = 0;
+  cpu->nmi_line = 0;
+  cpu->nmi_edge = 0;
+  cpu->pending = 0;
+  cpu->hooks = 0;
+  cpu->fusion = 1;
+  cpu->accuracy = CPU6502_ACCURACY_FAST;
+  cpu->pairs = NULL;
+  cpu->blocks = NULL;
+
+  bcd_init();
+
   return cpu;
 }
 
@@ -398,6 +64,8 @@ int CPU6502_destroy(struct CPU6502 **cpu)
 
   if(*cpu != NULL)
   {
+    free((*cpu)->pairs);
+    free((*cpu)->blocks);
     free(*cpu);
 
     *cpu = NULL;
@@ -427,14 +95,18 @@ int CPU6502_reset(struct CPU6502 *cpu)
 
   cpu->cycles = 7;
   cpu->clock_count = 0;
+  cpu->deadline = 0;
 
   cpu->opcode = 0;
   cpu->fetched = 0;
-  cpu->addr_abs = 0xFFFC;
+  cpu->addr_abs = CPU6502_VECTOR_RESET;
   cpu->addr_rel = 0;
 
-  cpu->Reg.PCL = cpu->read(cpu->bus, cpu->addr_abs);
-  cpu->Reg.PCH = cpu->read(cpu->bus, cpu->addr_abs+1);
+  cpu->nmi_edge = 0;
+  CPU6502_updatePending(cpu);
+
+  cpu->Reg.PCL = CPU6502_busRead(cpu, cpu->addr_abs);
+  cpu->Reg.PCH = CPU6502_busRead(cpu, cpu->addr_abs+1);
 
   return 0;
 }
@@ -444,20 +116,11 @@ int CPU6502_clock(struct CPU6502 *cpu)
 {
   if(cpu->cycles == 0)
   {
-    uint8_t extra_cycles1 = 0;
-    uint8_t extra_cycles2 = 0;
-
-    cpu->opcode = cpu->read(cpu->bus, cpu->Reg.PC);
-    log_trace("OP <%s> at 0x%04x", opcodes[cpu->opcode].mnemonic, cpu->Reg.PC);
-
-    cpu->Reg.PC_old = cpu->Reg.PC;
-    cpu->Reg.PC++;
-    cpu->cycles = opcodes[cpu->opcode].cycles;
-
-    extra_cycles1 = opcodes[cpu->opcode].addrMode(cpu);
-    extra_cycles2 = opcodes[cpu->opcode].instruction(cpu);
-
-    cpu->cycles += (extra_cycles1 & extra_cycles2);
+    CPU6502_execute(cpu);
+    if(cpu->cycles == 0)
+    {
+      return -1;
+    }
   }
 
   cpu->cycles--;
@@ -467,623 +130,363 @@ int CPU6502_clock(struct CPU6502 *cpu)
 }
 
 /*----------------------------------------------------------------------------*/
-int CPU6502_complete(struct CPU6502 *cpu)
+int CPU6502_step(struct CPU6502 *cpu)
 {
-  return cpu->cycles == 0;
-}
-
-/*----------------------------------------------------------------------------*/
-int CPU6502_dumpStatus(struct CPU6502 *cpu)
-{
-  log_dump("Processor Status\n");
-  log_dump("----------------\n");
-  log_dump(" A: 0x%02x  Y: 0x%02x     X: 0x%02x\n", cpu->Reg.A, cpu->Reg.Y, cpu->Reg.X);
-  log_dump("SP: 0x%02x PC: 0x%04x\n", cpu->Reg.SP, cpu->Reg.PC, cpu->Reg.X);
-  log_dump("Flags: N V - B D I Z C\n");
-  log_dump("       %c %c   %c %c %c %c %c\n",
-           (cpu->Reg.NEGATIVE == 1 ? '1': '0'),
-           (cpu->Reg.OVERFLOW == 1 ? '1': '0'),
-           (cpu->Reg.BRK      == 1 ? '1': '0'),
-           (cpu->Reg.DECIMAL  == 1 ? '1': '0'),
-           (cpu->Reg.IRQB     == 1 ? '1': '0'),
-           (cpu->Reg.ZERO     == 1 ? '1': '0'),
-           (cpu->Reg.CARRY    == 1 ? '1': '0'));
-
-  return 0;
-}
-
-/*----------------------------------------------------------------------------*/
-uint8_t CPU6502_fetch(struct CPU6502 *cpu)
-{
-  if(opcodes[cpu->opcode].addrMode != CPU6502_imp)
-  {
-    cpu->fetched = cpu->read(cpu->bus, cpu->addr_abs);
-    log_trace("Fetch data <0x%02x> from addr <0x%04x>", cpu->fetched, cpu->addr_abs);
-  }
-  return cpu->fetched;
-}
-
-/* Implied */
-uint8_t CPU6502_imp(struct CPU6502 *cpu)
-{
-  log_trace("Addr mode: Implied");
-  cpu->fetched = cpu->Reg.A;
-  return 0;
-}
+  int cycles = 0;
 
-/* Immediate */
-uint8_t CPU6502_imm(struct CPU6502 *cpu)
-{
-  log_trace("Addr mode: Immediate");
-  cpu->addr_abs = cpu->Reg.PC++;
-  return 0;
-}
-
-/* Zero Page */
-uint8_t CPU6502_zpg(struct CPU6502 *cpu)
-{
-  log_trace("Addr mode: Zero Page");
-  return 0;
-}
-
-/* Zero Page with X Offset */
-uint8_t CPU6502_zpx(struct CPU6502 *cpu)
-{
-  log_trace("Addr mode: Zero Page X Offset");
-  return 0;
-}
-
-/* Zero Page with Y Offset */
-uint8_t CPU6502_zpy(struct CPU6502 *cpu)
-{
-  log_trace("Addr mode: Zero Page Y Offset");
-  return 0;
-}
-
-/* Relative */
-uint8_t CPU6502_rel(struct CPU6502 *cpu)
-{
-  log_trace("Addr mode: Relative");
-  cpu->addr_rel = cpu->read(cpu->bus, cpu->Reg.PC);
-  cpu->Reg.PC++;
-  if(cpu->addr_rel & 0x80)
+  if(cpu->cycles == 0)
   {
-    cpu->addr_rel |= 0xFF00;
+    CPU6502_execute(cpu);
   }
-  return 0;
-}
-
-/* Absolute */
-uint8_t CPU6502_abs(struct CPU6502 *cpu)
-{
-  uint8_t lo;
-  uint8_t hi;
-  log_trace("Addr mode: Absolute");
 
-  lo = cpu->read(cpu->bus, cpu->Reg.PC);
-  cpu->Reg.PC++;
-  hi = cpu->read(cpu->bus, cpu->Reg.PC);
-  cpu->Reg.PC++;
+  cycles = cpu->cycles;
+  cpu->clock_count += cpu->cycles;
+  cpu->cycles = 0;
 
-  cpu->addr_abs = (hi << 8 ) | lo;
-
-  return 0;
-}
-
-/* Absolute with X Offset */
-uint8_t CPU6502_abx(struct CPU6502 *cpu)
-{
-  log_trace("Addr mode: Absolute X Offset");
-  return 0;
-}
-
-/* Absolute with Y Offset */
-uint8_t CPU6502_aby(struct CPU6502 *cpu)
-{
-  log_trace("Addr mode: Absolute Y Offset");
-  return 0;
-}
-
-/* Indirect */
-uint8_t CPU6502_ind(struct CPU6502 *cpu)
-{
-  log_trace("Addr mode: Indirect");
-  return 0;
-}
-
-/* Indirect X */
-uint8_t CPU6502_izx(struct CPU6502 *cpu)
-{
-  log_trace("Addr mode: Indirect X");
-  return 0;
-}
-
-/* Indirect Y */
-uint8_t CPU6502_izy(struct CPU6502 *cpu)
-{
-  log_trace("Addr mode: Indirect Y");
-  return 0;
+  return cycles;
 }
 
-/* Add with Carry */
-uint8_t CPU6502_adc(struct CPU6502 *cpu)
-{
-  uint16_t temp;
-  CPU6502_fetch(cpu);
-
-  log_debug("ADC Add <0x%02x> to A <0x%02x> (C: <0x%02x>)", cpu->fetched, cpu->Reg.A, cpu->Reg.CARRY);
-
-  temp = cpu->Reg.A + cpu->fetched + cpu->Reg.CARRY;
-
-  if(temp > 0xff) cpu->Reg.CARRY = 1; else cpu->Reg.CARRY = 0;
-  if((temp & 0x00FF) == 0) cpu->Reg.ZERO = 1; else cpu->Reg.ZERO = 0;
-  if(cpu->Reg.A & 0x80) cpu->Reg.NEGATIVE = 1; else cpu->Reg.NEGATIVE = 0;
-  if((~(cpu->Reg.A ^ cpu->fetched) & (cpu->Reg.A ^ temp)) & 0x0080) cpu->Reg.OVERFLOW = 1; else cpu->Reg.OVERFLOW = 0;
-  if(temp & 0x80) cpu->Reg.OVERFLOW = 1; else cpu->Reg.OVERFLOW = 0;
-
-  cpu->Reg.A = 0x00FF & temp;
-
-  return 1;
-}
-
-/* AND */
-uint8_t CPU6502_and(struct CPU6502 *cpu)
-{
-  return 0;
-}
-
-/* Arithmetic shift one CPU6502_bit left */
-uint8_t CPU6502_asl(struct CPU6502 *cpu)
-{
-  return 0;
-}
-
-/* Branch on Carry clear */
-uint8_t CPU6502_bcc(struct CPU6502 *cpu)
-{
-  return 0;
-}
-
-/* Branch on Carry set */
-uint8_t CPU6502_bcs(struct CPU6502 *cpu)
-{
-  return 0;
-}
-
-/* Branch if equal */
-uint8_t CPU6502_beq(struct CPU6502 *cpu)
+/*----------------------------------------------------------------------------*/
+int CPU6502_run(struct CPU6502 *cpu)
 {
+  /* Finish an instruction started by CPU6502_clock() */
+  cpu->clock_count += cpu->cycles;
+  cpu->cycles = 0;
 
-  if(cpu->Reg.ZERO == 1)
+  while(cpu->clock_count < cpu->deadline)
   {
-    cpu->cycles++;
-
-    cpu->addr_abs = cpu->Reg.PC + cpu->addr_rel;
+    if(cpu->accuracy == CPU6502_ACCURACY_EXACT)
+    {
+      CPU6502_executeExact(cpu);
+      cpu->clock_count += cpu->cycles;
+      cpu->cycles = 0;
+      continue;
+    }
 
-    if((cpu->addr_abs & 0xFF00) != (cpu->Reg.PC & 0xFF00))
+    if(cpu->blocks != NULL && (cpu->pending | cpu->hooks) == 0 && cpu->blocks[cpu->Reg.PC] != NULL)
     {
-      cpu->cycles++;
+      cpu->blocks[cpu->Reg.PC](cpu);
+      continue;
     }
- 
-    cpu->Reg.PC = cpu->addr_abs;
 
-    log_debug("BEQ jump to addr <0x%04x>", cpu->Reg.PC);
+    if(cpu->fusion && (cpu->pending | cpu->hooks) == 0 && CPU6502_fuse(cpu) != 0)
+    {
+      cpu->clock_count += cpu->cycles;
+      cpu->cycles = 0;
+      continue;
+    }
 
-    return 0;
+    CPU6502_executeFast(cpu);
+    cpu->clock_count += cpu->cycles;
+    cpu->cycles = 0;
   }
 
-  log_debug("BEQ Zero Flag not set; continue");
-
-  return 0;
-}
-
-/* Bit test */
-uint8_t CPU6502_bit(struct CPU6502 *cpu)
-{
-  return 0;
-}
-
-/* Branch if reslut minus */
-uint8_t CPU6502_bmi(struct CPU6502 *cpu)
-{
-  return 0;
-}
-
-/* Branch if not equal */
-uint8_t CPU6502_bne(struct CPU6502 *cpu)
-{
-  return 0;
-}
-
-/* Branch if relult plus */
-uint8_t CPU6502_bpl(struct CPU6502 *cpu)
-{
-  return 0;
-}
-
-/* Break */
-uint8_t CPU6502_brk(struct CPU6502 *cpu)
-{
-  return 0;
-}
-
-/* Branch on overflow clear */
-uint8_t CPU6502_bvc(struct CPU6502 *cpu)
-{
-  return 0;
-}
-
-/* Branch on overflow set */
-uint8_t CPU6502_bvs(struct CPU6502 *cpu)
-{
-  return 0;
-}
-
-/* Clear carry flag */
-uint8_t CPU6502_clc(struct CPU6502 *cpu)
-{
-  log_debug("CLC Clear Carry Flag");
-  cpu->Reg.CARRY = 0;
-  return 0;
-}
-
-/* Clear CPU6502_decimal mode */
-uint8_t CPU6502_cld(struct CPU6502 *cpu)
-{
-  return 0;
-}
-
-/* Clear interrupt disable flag */
-uint8_t CPU6502_cli(struct CPU6502 *cpu)
-{
-  return 0;
-}
-
-/* Clear overflow flag */
-uint8_t CPU6502_clv(struct CPU6502 *cpu)
-{
-  return 0;
-}
-
-/* Compare memory CPU6502_and accumulator */
-uint8_t CPU6502_cmp(struct CPU6502 *cpu)
-{
-  return 0;
-}
-
-/* Compare memory CPU6502_and X register */
-uint8_t CPU6502_cpx(struct CPU6502 *cpu)
-{
-  return 0;
-}
-
-/* Compare memory CPU6502_and Y register */
-uint8_t CPU6502_cpy(struct CPU6502 *cpu)
-{
   return 0;
 }
 
-/* Decrement memory or accumulator by one */
-uint8_t CPU6502_dec(struct CPU6502 *cpu)
-{
-  return 0;
-}
-
-/* Decrement X by one */
-uint8_t CPU6502_dex(struct CPU6502 *cpu)
-{
-  return 0;
-}
-
-/* Decrement Y by one */
-uint8_t CPU6502_dey(struct CPU6502 *cpu)
-{
-  return 0;
-}
-
-/* Exclusice or memory or accumulator by one */
-uint8_t CPU6502_eor(struct CPU6502 *cpu)
-{
-  return 0;
-}
-
-/* Increment memory or accumulator by one */
-uint8_t CPU6502_inc(struct CPU6502 *cpu)
-{
-  return 0;
-}
-
-/* Increment X register by one */
-uint8_t CPU6502_inx(struct CPU6502 *cpu)
+/*----------------------------------------------------------------------------*/
+int CPU6502_complete(struct CPU6502 *cpu)
 {
-  return 0;
+  return cpu->cycles == 0;
 }
 
-/* Increment Y register by one */
-uint8_t CPU6502_iny(struct CPU6502 *cpu)
+/*----------------------------------------------------------------------------*/
+uint64_t CPU6502_now(struct CPU6502 *cpu)
 {
-  return 0;
+  /* Inside an instruction cycles holds what it has used so far, all of the
+   * table cycles in the fast core, the accesses up to this one in the exact
+   * core */
+  return cpu->clock_count + cpu->cycles;
 }
 
-/* Jump to new location */
-uint8_t CPU6502_jmp(struct CPU6502 *cpu)
+/*----------------------------------------------------------------------------*/
+int CPU6502_irq(struct CPU6502 *cpu)
 {
-  log_debug("JMP to address <0x%04x>", cpu->addr_abs);
-  if(cpu->Reg.PC_old == cpu->addr_abs)
+  if(cpu->Reg.IRQB == 1)
   {
-    log_info("JMP to same address. Stop Emulator...");
-    bus_set_to_stop(cpu->bus);
+    return -1;
   }
-  cpu->Reg.PC = cpu->addr_abs;
-  return 0;
-}
-
-/* Jump to new location saving return */
-uint8_t CPU6502_jsr(struct CPU6502 *cpu)
-{
-  cpu->Reg.PC--;
 
-  cpu->write(cpu->bus, 0x0100 + cpu->Reg.SP, (cpu->Reg.PC >> 8) & 0x00FF);
-  cpu->Reg.SP--;
-  cpu->write(cpu->bus, 0x0100 + cpu->Reg.SP, cpu->Reg.PC & 0x00FF);
-  cpu->Reg.SP--;
+  log_debug("IRQ at <0x%04x>", cpu->Reg.PC);
+  CPU6502_interrupt(cpu, CPU6502_VECTOR_IRQ);
 
-  log_debug("JSR Jump to subroutine at <0x%04x>", cpu->addr_abs);
-
-  cpu->Reg.PC = cpu->addr_abs;
   return 0;
 }
 
-/* Load accumulator with memory */
-uint8_t CPU6502_lda(struct CPU6502 *cpu)
+/*----------------------------------------------------------------------------*/
+int CPU6502_nmi(struct CPU6502 *cpu)
 {
-  CPU6502_fetch(cpu);
-  cpu->Reg.A = cpu->fetched;
+  log_debug("NMI at <0x%04x>", cpu->Reg.PC);
+  cpu->nmi_edge = 0;
+  CPU6502_interrupt(cpu, CPU6502_VECTOR_NMI);
 
-  log_debug("LDA Load <0x%02x> from addr <0x%04x> into A", cpu->Reg.A, cpu->addr_abs);
-
-  if(cpu->Reg.A == 0x00) cpu->Reg.ZERO = 1; else cpu->Reg.ZERO = 0;
-  if(cpu->Reg.A & 0x80) cpu->Reg.NEGATIVE = 1; else cpu->Reg.NEGATIVE = 0;
-  
   return 0;
 }
 
-/* Load X register with memory */
-uint8_t CPU6502_ldx(struct CPU6502 *cpu)
+/*----------------------------------------------------------------------------*/
+int CPU6502_setIrqLine(struct CPU6502 *cpu, uint8_t line, uint8_t level)
 {
-  return 0;
-}
+  if(level)
+  {
+    cpu->irq_lines |= line;
+  }
+  else
+  {
+    cpu->irq_lines &= ~line;
+  }
+  CPU6502_updatePending(cpu);
 
-/* Load Y register with memory */
-uint8_t CPU6502_ldy(struct CPU6502 *cpu)
-{
   return 0;
 }
 
-/* Logical shift one CPU6502_bit right memory or accumulator */
-uint8_t CPU6502_lsr(struct CPU6502 *cpu)
+/*----------------------------------------------------------------------------*/
+int CPU6502_setNmiLine(struct CPU6502 *cpu, uint8_t level)
 {
-  return 0;
-}
+  if(level && cpu->nmi_line == 0)
+  {
+    cpu->nmi_edge = 1;
+  }
+  cpu->nmi_line = level ? 1 : 0;
+  CPU6502_updatePending(cpu);
 
-/* No operation */
-uint8_t CPU6502_nop(struct CPU6502 *cpu)
-{
   return 0;
 }
 
-/* Or memory with accumulator */
-uint8_t CPU6502_ora(struct CPU6502 *cpu)
+/*----------------------------------------------------------------------------*/
+int CPU6502_setFusion(struct CPU6502 *cpu, uint8_t enable)
 {
+  log_info("Instruction fusion %s", enable ? "enabled" : "disabled");
+  cpu->fusion = enable ? 1 : 0;
   return 0;
 }
 
-/* Push accumulator on stack */
-uint8_t CPU6502_pha(struct CPU6502 *cpu)
+/*----------------------------------------------------------------------------*/
+int CPU6502_setAccuracy(struct CPU6502 *cpu, uint8_t accuracy)
 {
-  uint16_t addr = 0x0100 + cpu->Reg.SP;
-
-  log_debug("PHA Push A <0x%02x> to STACK <0x%04x>", cpu->Reg.A, addr);
+  if(accuracy != CPU6502_ACCURACY_FAST && accuracy != CPU6502_ACCURACY_EXACT)
+  {
+    log_error("Invalid CPU accuracy %d", accuracy);
+    return -1;
+  }
 
-  cpu->write(cpu->bus, addr, cpu->Reg.A);
+  if(cpu->accuracy != accuracy)
+  {
+    log_debug("Switch to %s core at <0x%04x>", accuracy == CPU6502_ACCURACY_EXACT ? "exact" : "fast", cpu->Reg.PC);
+  }
 
-  cpu->Reg.SP--;
+  /* Both cores work on the same state, the next instruction picks it up */
+  cpu->accuracy = accuracy;
 
   return 0;
 }
 
-/* Push processor status on stack */
-uint8_t CPU6502_php(struct CPU6502 *cpu)
+/*----------------------------------------------------------------------------*/
+int CPU6502_invalidateBlocks(struct CPU6502 *cpu, uint16_t addr, uint32_t len)
 {
-  uint16_t addr = 0x0100 + cpu->Reg.SP;
-  uint8_t data = 0x00;
-
-  cpu->Reg.BRK = 1;
-  cpu->Reg.NU = 1;
-
-  data = cpu->Reg.PSR;
-
-  log_debug("PHP Push PSR <0x%02x> to STACK <0x%04x>", data, addr);
-
-  cpu->write(cpu->bus, addr, data);
-
-  cpu->Reg.BRK = 0;
-  cpu->Reg.NU = 0;
+  uint32_t first = addr >= 2 ? addr - 2 : 0;
+  uint32_t last = addr + len > 0x10000 ? 0xFFFF : addr + len - 1;
 
-  cpu->Reg.SP--;
-
-  return 0;
-}
-
-/* Pull accumulator from stack */
-uint8_t CPU6502_pla(struct CPU6502 *cpu)
-{
-  uint16_t addr = 0x0000;
+  if(cpu->blocks == NULL || len == 0)
+  {
+    return 0;
+  }
 
-  cpu->Reg.SP++;
-  addr = 0x0100 + cpu->Reg.SP;
-  cpu->Reg.A = cpu->read(cpu->bus, addr);
+  /* An instruction up to two bytes before the range reaches into it. A
+   * block function runs on from its entry point through the following
+   * instructions, so every entry of a function that covers the range
+   * goes with it. */
+  while(first < last && cpu->blocks[first] == NULL)
+  {
+    first++;
+  }
+  while(last > first && cpu->blocks[last] == NULL)
+  {
+    last--;
+  }
 
-  log_debug("PLA Pull A <0x%02x> from STACK <0x%04x>", cpu->Reg.A, addr);
+  /* Recompiled code of the old content is gone, interpret from now on */
+  if(cpu->blocks[first] != NULL)
+  {
+    first = CPU6502_blockFirst(cpu, first);
+    last = CPU6502_blockLast(cpu, last);
+    memset(&cpu->blocks[first], 0, (last - first + 1) * sizeof(CPU6502_BlockFn));
+  }
 
-  if(cpu->Reg.A == 0x00) cpu->Reg.ZERO = 1; else cpu->Reg.ZERO = 0;
-  if(cpu->Reg.A & 0x80) cpu->Reg.NEGATIVE = 1; else cpu->Reg.NEGATIVE = 0;
+  /* A recompiled block that caused this, e.g. by a bank switch, must not
+   * go on with the old code. AOT_STOP sees the deadline after the access. */
+  cpu->deadline = 0;
 
   return 0;
 }
 
-/* Pull processor status from stack */
-uint8_t CPU6502_plp(struct CPU6502 *cpu)
+/*----------------------------------------------------------------------------*/
+int CPU6502_profilePairs(struct CPU6502 *cpu, uint8_t enable)
 {
-  uint16_t addr = 0x0000;
-
-  cpu->Reg.SP++;
-  addr = 0x0100 + cpu->Reg.SP;
-  cpu->Reg.PSR = cpu->read(cpu->bus, addr);
-
-  cpu->Reg.NU = 1;
-
-  log_debug("PLP Pull PSR <0x%02x> from STACK <0x%04x>", cpu->Reg.PSR, addr);
-
-  return 0;
-}
+  if(!enable)
+  {
+    free(cpu->pairs);
+    cpu->pairs = NULL;
+    return 0;
+  }
 
-/* Rotate one CPU6502_bit left memory or accumulator */
-uint8_t CPU6502_rol(struct CPU6502 *cpu)
-{
-  return 0;
-}
+  if(cpu->pairs == NULL)
+  {
+    cpu->pairs = calloc(0x10000, sizeof(uint64_t));
+    if(cpu->pairs == NULL)
+    {
+      log_error("Could not allocate memory for the pair profile");
+      return -1;
+    }
+  }
 
-/* Rotate one CPU6502_bit right memory or accumulator */
-uint8_t CPU6502_ror(struct CPU6502 *cpu)
-{
-  return 0;
-}
+  /* Fused sequences would hide their pairs from the profile */
+  cpu->fusion = 0;
 
-/* Return from interrupt */
-uint8_t CPU6502_rti(struct CPU6502 *cpu)
-{
   return 0;
 }
 
-/* Return from subroutine */
-uint8_t CPU6502_rts(struct CPU6502 *cpu)
+/*----------------------------------------------------------------------------*/
+static int CPU6502_comparePairs(const void *a, const void *b)
 {
-  cpu->Reg.SP++;
-  cpu->Reg.PC = (uint16_t)cpu->read(cpu->bus, 0x0100 + cpu->Reg.SP);
-  cpu->Reg.SP++;
-  cpu->Reg.PC |= (uint16_t)cpu->read(cpu->bus, 0x0100 + cpu->Reg.SP) << 8;
-
-  cpu->Reg.PC++;
-
-  log_debug("RTS Return from subroutine to <0x%04x>", cpu->Reg.PC);
+  const uint64_t *x = a;
+  const uint64_t *y = b;
 
-  return 0;
+  return (x[1] < y[1]) - (x[1] > y[1]);
 }
 
-/* Substract memory from accumulator with borrow (carry) */
-uint8_t CPU6502_sbc(struct CPU6502 *cpu)
+/*----------------------------------------------------------------------------*/
+int CPU6502_reportPairs(struct CPU6502 *cpu, int count)
 {
-  uint16_t temp = 0;
-  uint16_t value = 0;
-
-  CPU6502_fetch(cpu);
+  uint64_t (*list)[2] = NULL;
+  uint64_t total = 0;
+  int used = 0;
+  int i = 0;
 
-  value = cpu->fetched ^ 0x00FF;
-
-  temp = cpu->Reg.A + value + cpu->Reg.CARRY;
+  if(cpu->pairs == NULL)
+  {
+    log_error("Pair profiling is not enabled");
+    return -1;
+  }
 
-  log_debug("SBC <0x%02x> from A <0x%02x> (C: <0x%02x>)", cpu->fetched, cpu->Reg.A, cpu->Reg.CARRY);
+  list = malloc(0x10000 * sizeof(*list));
+  if(list == NULL)
+  {
+    log_error("Could not allocate memory for the pair report");
+    return -1;
+  }
 
-  if(temp & 0xFF00) cpu->Reg.CARRY = 1; else cpu->Reg.CARRY = 0;
-  if((temp & 0xFF00)  == 0) cpu->Reg.ZERO = 1; else cpu->Reg.ZERO = 0;
-  if((temp ^ cpu->Reg.A) & (temp ^ value) & 0x0080) cpu->Reg.OVERFLOW = 1; else cpu->Reg.OVERFLOW = 0;
-  if(temp & 0x0080) cpu->Reg.NEGATIVE = 1; else cpu->Reg.NEGATIVE = 0;
+  for(i = 0; i < 0x10000; i++)
+  {
+    if(cpu->pairs[i] != 0)
+    {
+      list[used][0] = i;
+      list[used][1] = cpu->pairs[i];
+      total += cpu->pairs[i];
+      used++;
+    }
+  }
+  qsort(list, used, sizeof(*list), CPU6502_comparePairs);
 
-  cpu->Reg.A = 0x00FF & temp;
+  log_info("Most frequent instruction pairs (%" PRIu64 " pairs)", total);
+  for(i = 0; i < used && i < count; i++)
+  {
+    struct CPU6502OpInfo first;
+    struct CPU6502OpInfo second;
 
-  return 1;
-}
+    CPU6502_opcodeInfo(list[i][0] >> 8, &first);
+    CPU6502_opcodeInfo(list[i][0] & 0xFF, &second);
 
-/* Set carry */
-uint8_t CPU6502_sec(struct CPU6502 *cpu)
-{
-  log_debug("SEC Set Carry Flag");
-  cpu->Reg.CARRY = 1;
-  return 0;
-}
+    log_info("%3s %3s (0x%02x 0x%02x) %12" PRIu64 " %6.2f%%",
+             first.mnemonic, second.mnemonic, (int)(list[i][0] >> 8), (int)(list[i][0] & 0xFF),
+             list[i][1], 100.0 * list[i][1] / total);
+  }
 
-/* Set CPU6502_decimal mode */
-uint8_t CPU6502_sed(struct CPU6502 *cpu)
-{
-  return 0;
-}
+  free(list);
 
-/* Set interrupt flag */
-uint8_t CPU6502_sei(struct CPU6502 *cpu)
-{
   return 0;
 }
 
-/* Store accumulator in memory */
-uint8_t CPU6502_sta(struct CPU6502 *cpu)
+/*----------------------------------------------------------------------------*/
+int CPU6502_dumpStatus(struct CPU6502 *cpu)
 {
-  log_debug("STA Store content from A <0x%02x> to addr <0x%04x>", cpu->Reg.A, cpu->addr_abs);
-
-  cpu->write(cpu->bus, cpu->addr_abs, cpu->Reg.A);
-  return 0;
-}
+  log_dump("Processor Status\n");
+  log_dump("----------------\n");
+  log_dump(" A: 0x%02x  Y: 0x%02x     X: 0x%02x\n", cpu->Reg.A, cpu->Reg.Y, cpu->Reg.X);
+  log_dump("SP: 0x%02x PC: 0x%04x\n", cpu->Reg.SP, cpu->Reg.PC, cpu->Reg.X);
+  log_dump("Cycles: %" PRIu64 "\n", cpu->clock_count);
+  log_dump("Flags: N V - B D I Z C\n");
+  log_dump("       %c %c   %c %c %c %c %c\n",
+           (cpu->Reg.NEGATIVE == 1 ? '1': '0'),
+           (cpu->Reg.OVERFLOW == 1 ? '1': '0'),
+           (cpu->Reg.BRK      == 1 ? '1': '0'),
+           (cpu->Reg.DECIMAL  == 1 ? '1': '0'),
+           (cpu->Reg.IRQB     == 1 ? '1': '0'),
+           (cpu->Reg.ZERO     == 1 ? '1': '0'),
+           (cpu->Reg.CARRY    == 1 ? '1': '0'));
 
-/* Store X register in memory */
-uint8_t CPU6502_stx(struct CPU6502 *cpu)
-{
   return 0;
 }
 
-/* Store Y register in memory */
-uint8_t CPU6502_sty(struct CPU6502 *cpu)
+/*----------------------------------------------------------------------------*/
+uint8_t CPU6502_execute(struct CPU6502 *cpu)
 {
-  return 0;
+  if(cpu->accuracy == CPU6502_ACCURACY_EXACT)
+  {
+    return CPU6502_executeExact(cpu);
+  }
+  return CPU6502_executeFast(cpu);
 }
 
-/* Transfer the accumulator to the X register */
-uint8_t CPU6502_tax(struct CPU6502 *cpu)
+/*----------------------------------------------------------------------------*/
+void CPU6502_interrupt(struct CPU6502 *cpu, uint16_t vector)
 {
-  return 0;
+  if(cpu->accuracy == CPU6502_ACCURACY_EXACT)
+  {
+    CPU6502_interruptExact(cpu, vector);
+    return;
+  }
+  CPU6502_interruptFast(cpu, vector);
 }
 
-/* Transfer the accumulator to the Y register */
-uint8_t CPU6502_tay(struct CPU6502 *cpu)
+/*----------------------------------------------------------------------------*/
+uint32_t CPU6502_blockFirst(struct CPU6502 *cpu, uint32_t pc)
 {
-  return 0;
-}
+  CPU6502_BlockFn fn = cpu->blocks[pc];
+  uint32_t p = 0;
 
-/* Transfer the stack pointer to the Y register */
-uint8_t CPU6502_tsx(struct CPU6502 *cpu)
-{
-  return 0;
-}
+  /* Entries of one function are at most an instruction apart */
+  for(p = pc; p > 0 && pc - p < 3; p--)
+  {
+    if(cpu->blocks[p - 1] == fn)
+    {
+      pc = p - 1;
+    }
+    else if(cpu->blocks[p - 1] != NULL)
+    {
+      break;
+    }
+  }
 
-/* Transfer the X register the accumulator */
-uint8_t CPU6502_txa(struct CPU6502 *cpu)
-{
-  return 0;
+  return pc;
 }
 
-/* Transfer the X register the stack pointer */
-uint8_t CPU6502_txs(struct CPU6502 *cpu)
+/*----------------------------------------------------------------------------*/
+uint32_t CPU6502_blockLast(struct CPU6502 *cpu, uint32_t pc)
 {
-  return 0;
-}
+  CPU6502_BlockFn fn = cpu->blocks[pc];
+  uint32_t p = 0;
 
-/* Transfer the Y register the accumulator */
-uint8_t CPU6502_tya(struct CPU6502 *cpu)
-{
-  return 0;
-}
+  for(p = pc; p < 0xFFFF && p - pc < 3; p++)
+  {
+    if(cpu->blocks[p + 1] == fn)
+    {
+      pc = p + 1;
+    }
+    else if(cpu->blocks[p + 1] != NULL)
+    {
+      break;
+    }
+  }
 
-/* Illegal OpCode */
-uint8_t CPU6502_xxx(struct CPU6502 *cpu)
-{
-  return 0;
+  return pc;
 }
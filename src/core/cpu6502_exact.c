@@ -0,0 +1,22 @@
+/*
+ * Copyright (c) 2022, Bernd Bauer <bernd.bauer@gmx.at>
+ *
+ * SPDX-License-Identifier: BSD-2-Clause
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include <inttypes.h>
+
+#include "util/log.h"
+
+#include "core/bus.h"
+#include "core/cpu6502.h"
+#include "core/cpu6502_alu.h"
+#include "core/cpu6502_core.h"
+
+/* Cycle exact core: every bus cycle including dummy accesses */
+#define CPU6502_EXACT 1
+#define CPU6502_TIER(name) name##Exact
+
+#include "cpu6502_ops.h"
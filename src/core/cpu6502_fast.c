@@ -0,0 +1,220 @@
+/*
+ * Copyright (c) 2022, Bernd Bauer <bernd.bauer@gmx.at>
+ *
+ * SPDX-License-Identifier: BSD-2-Clause
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include <inttypes.h>
+
+#include "util/log.h"
+
+#include "core/bus.h"
+#include "core/cpu6502.h"
+#include "core/cpu6502_alu.h"
+#include "core/cpu6502_core.h"
+
+/* Instruction level core: no per cycle bookkeeping, fusion and recompiled
+ * blocks run on top of it */
+#define CPU6502_EXACT 0
+#define CPU6502_TIER(name) name##Fast
+
+#include "cpu6502_ops.h"
+
+/*----------------------------------------------------------------------------*/
+int CPU6502_opcodeInfo(uint8_t opcode, struct CPU6502OpInfo *info)
+{
+  static const struct
+  {
+    uint8_t (*fn)(struct CPU6502 *cpu);
+    uint8_t mode;
+    uint8_t length;
+  } modes[] = {
+    { CPU6502_imp, CPU6502_MODE_IMP, 1 },
+    { CPU6502_imm, CPU6502_MODE_IMM, 2 },
+    { CPU6502_zpg, CPU6502_MODE_ZPG, 2 },
+    { CPU6502_zpx, CPU6502_MODE_ZPX, 2 },
+    { CPU6502_zpy, CPU6502_MODE_ZPY, 2 },
+    { CPU6502_rel, CPU6502_MODE_REL, 2 },
+    { CPU6502_abs, CPU6502_MODE_ABS, 3 },
+    { CPU6502_abx, CPU6502_MODE_ABX, 3 },
+    { CPU6502_aby, CPU6502_MODE_ABY, 3 },
+    { CPU6502_ind, CPU6502_MODE_IND, 3 },
+    { CPU6502_izx, CPU6502_MODE_IZX, 2 },
+    { CPU6502_izy, CPU6502_MODE_IZY, 2 },
+  };
+  int i = 0;
+
+  info->mnemonic = opcodes[opcode].mnemonic;
+  info->cycles = opcodes[opcode].cycles;
+
+  for(i = 0; i < sizeof(modes) / sizeof(modes[0]); i++)
+  {
+    if(opcodes[opcode].addrMode == modes[i].fn)
+    {
+      info->mode = modes[i].mode;
+      info->length = modes[i].length;
+      return 0;
+    }
+  }
+
+  return -1;
+}
+
+
+/* Longest fused sequence: LDA abs; CLC; ADC #imm; STA abs */
+#define CPU6502_FUSE_MAX 9
+
+/*----------------------------------------------------------------------------*/
+static inline uint8_t CPU6502_fused(struct CPU6502 *cpu, const uint8_t *last, uint8_t length, uint8_t cycles)
+{
+  cpu->opcode = *last;
+  cpu->Reg.PC_old = cpu->Reg.PC;
+  cpu->Reg.PC += length;
+  cpu->cycles = cycles;
+  return cycles;
+}
+
+/*----------------------------------------------------------------------------*/
+static inline uint8_t* CPU6502_fuseAddr(struct CPU6502 *cpu, const uint8_t *code, uint8_t * const *page, uint8_t *length)
+{
+  uint8_t (*mode)(struct CPU6502 *) = opcodes[code[0]].addrMode;
+  uint8_t *ptr = NULL;
+
+  /* Operands of fused instructions must be plain memory so the sequence
+   * has no side effects between its instructions */
+  if(mode == CPU6502_zpg)
+  {
+    ptr = page[0];
+    *length = 2;
+    return ptr ? ptr + code[1] : NULL;
+  }
+  if(mode == CPU6502_abs)
+  {
+    ptr = page[code[2]];
+    *length = 3;
+    return ptr ? ptr + code[1] : NULL;
+  }
+  if(mode == CPU6502_imm && page == cpu->bus->rpage)
+  {
+    *length = 2;
+    return (uint8_t*)&code[1];
+  }
+  return NULL;
+}
+
+/*----------------------------------------------------------------------------*/
+uint8_t CPU6502_fuse(struct CPU6502 *cpu)
+{
+  struct Bus *bus = cpu->bus;
+  const uint8_t *code = bus->rpage[cpu->Reg.PC >> BUS_PAGE_SHIFT];
+  const uint8_t *src = NULL;
+  uint8_t *dst = NULL;
+  uint8_t len1 = 0;
+  uint8_t len2 = 0;
+  uint16_t temp = 0;
+  uint8_t value = 0;
+
+  /* Only code in plain memory with the longest sequence inside the page */
+  if(code == NULL || (cpu->Reg.PC & BUS_PAGE_MASK) > BUS_PAGE_SIZE - CPU6502_FUSE_MAX)
+  {
+    return 0;
+  }
+  code += cpu->Reg.PC & BUS_PAGE_MASK;
+
+  switch(code[0])
+  {
+    case 0x18: /* CLC; ADC imm/zpg/abs */
+      if(opcodes[code[1]].instruction != CPU6502_adc || cpu->Reg.DECIMAL ||
+         (src = CPU6502_fuseAddr(cpu, &code[1], bus->rpage, &len2)) == NULL)
+      {
+        return 0;
+      }
+      temp = cpu->Reg.A + *src;
+      CPU6502_setAddFlags(cpu, cpu->Reg.A, *src, temp);
+      cpu->Reg.A = temp;
+      return CPU6502_fused(cpu, &code[1], 1 + len2, 2 + opcodes[code[1]].cycles);
+
+    case 0x38: /* SEC; SBC imm/zpg/abs */
+      if(opcodes[code[1]].instruction != CPU6502_sbc || cpu->Reg.DECIMAL ||
+         (src = CPU6502_fuseAddr(cpu, &code[1], bus->rpage, &len2)) == NULL)
+      {
+        return 0;
+      }
+      value = *src ^ 0xFF;
+      temp = cpu->Reg.A + value + 1;
+      CPU6502_setAddFlags(cpu, cpu->Reg.A, value, temp);
+      cpu->Reg.A = temp;
+      return CPU6502_fused(cpu, &code[1], 1 + len2, 2 + opcodes[code[1]].cycles);
+
+    case 0xA9: /* LDA imm/zpg/abs; STA zpg/abs */
+    case 0xA5: /* LDA imm/zpg/abs; CLC; ADC #imm; STA zpg/abs */
+    case 0xAD:
+      if((src = CPU6502_fuseAddr(cpu, code, bus->rpage, &len1)) == NULL)
+      {
+        return 0;
+      }
+      code += len1;
+
+      if(opcodes[code[0]].instruction == CPU6502_sta)
+      {
+        if((dst = CPU6502_fuseAddr(cpu, code, bus->wpage, &len2)) == NULL)
+        {
+          return 0;
+        }
+        cpu->Reg.A = *src;
+        CPU6502_setNZ(cpu, cpu->Reg.A);
+        *dst = cpu->Reg.A;
+        return CPU6502_fused(cpu, code, len1 + len2, opcodes[code[-len1]].cycles + opcodes[code[0]].cycles);
+      }
+
+      if(code[0] == 0x18 && code[1] == 0x69 && !cpu->Reg.DECIMAL &&
+         opcodes[code[3]].instruction == CPU6502_sta &&
+         (dst = CPU6502_fuseAddr(cpu, &code[3], bus->wpage, &len2)) != NULL)
+      {
+        temp = *src + code[2];
+        CPU6502_setAddFlags(cpu, *src, code[2], temp);
+        cpu->Reg.A = temp;
+        *dst = cpu->Reg.A;
+        return CPU6502_fused(cpu, &code[3], len1 + 3 + len2,
+                             opcodes[code[-len1]].cycles + 4 + opcodes[code[3]].cycles);
+      }
+      return 0;
+
+    case 0xCA: /* DEX; BNE */
+    case 0x88: /* DEY; BNE */
+      if(code[1] != 0xD0)
+      {
+        return 0;
+      }
+      if(code[0] == 0xCA)
+      {
+        value = --cpu->Reg.X;
+      }
+      else
+      {
+        value = --cpu->Reg.Y;
+      }
+      CPU6502_setNZ(cpu, value);
+
+      if(value == 0)
+      {
+        return CPU6502_fused(cpu, &code[1], 3, 4);
+      }
+
+      /* Taken branch, one more cycle when the target is in another page */
+      temp = cpu->Reg.PC + 3;
+      CPU6502_fused(cpu, &code[1], 3, 5);
+      cpu->Reg.PC = temp + (int8_t)code[2];
+      if((cpu->Reg.PC ^ temp) & 0xFF00)
+      {
+        cpu->cycles++;
+      }
+      return cpu->cycles;
+
+    default:
+      return 0;
+  }
+}
+
@@ -0,0 +1,1527 @@
+/*
+ * Copyright (c) 2022, Bernd Bauer <bernd.bauer@gmx.at>
+ *
+ * SPDX-License-Identifier: BSD-2-Clause
+ */
+
+/* Instruction definitions of both CPU cores. cpu6502_fast.c and
+ * cpu6502_exact.c include this file with CPU6502_EXACT set to 0 or 1 and
+ * CPU6502_TIER() naming the exported functions.
+ *
+ * The fast core does all work of an instruction at once and accounts the
+ * cycles from the opcode table. The exact core performs every bus cycle of
+ * the NMOS 6502 in order, including the dummy reads and writes, and
+ * counts cycles per access so CPU6502_now() is exact inside handlers. Both
+ * share the CPU state, so switching takes effect at the next instruction. */
+
+#ifndef CPU6502_EXACT
+#error "CPU6502_EXACT has to be defined before including cpu6502_ops.h"
+#endif
+
+#if CPU6502_EXACT
+static inline uint8_t CPU6502_cycleRead(struct CPU6502 *cpu, uint16_t addr)
+{
+  cpu->cycles++;
+  return CPU6502_busRead(cpu, addr);
+}
+
+static inline void CPU6502_cycleWrite(struct CPU6502 *cpu, uint16_t addr, uint8_t data)
+{
+  cpu->cycles++;
+  CPU6502_busWrite(cpu, addr, data);
+}
+
+#define CPU6502_read(cpu, addr)              CPU6502_cycleRead((cpu), (addr))
+#define CPU6502_write(cpu, addr, data)       CPU6502_cycleWrite((cpu), (addr), (data))
+#define CPU6502_dummyRead(cpu, addr)         ((void)CPU6502_cycleRead((cpu), (addr)))
+#define CPU6502_dummyWrite(cpu, addr, data)  CPU6502_cycleWrite((cpu), (addr), (data))
+#define CPU6502_addCycles(cpu, n)            ((void)(n))
+#define CPU6502_dummyIndexed(cpu, always)    CPU6502_indexedRead((cpu), (always))
+#else
+#define CPU6502_read(cpu, addr)              CPU6502_busRead((cpu), (addr))
+#define CPU6502_write(cpu, addr, data)       CPU6502_busWrite((cpu), (addr), (data))
+#define CPU6502_dummyRead(cpu, addr)         ((void)0)
+#define CPU6502_dummyWrite(cpu, addr, data)  ((void)0)
+#define CPU6502_addCycles(cpu, n)            ((cpu)->cycles += (n))
+#define CPU6502_dummyIndexed(cpu, always)    ((void)0)
+#endif
+
+struct OpCodeLUT
+{
+  char *mnemonic;
+  uint8_t cycles;
+  uint8_t (*addrMode)(struct CPU6502 *cpu);
+  uint8_t (*instruction)(struct CPU6502 *cpu);
+};
+
+/* Adressing mode */
+static uint8_t CPU6502_imp(struct CPU6502 *cpu); /* Implied */
+static uint8_t CPU6502_imm(struct CPU6502 *cpu); /* Immediate */
+static uint8_t CPU6502_zpg(struct CPU6502 *cpu); /* Zero Page */
+static uint8_t CPU6502_zpx(struct CPU6502 *cpu); /* Zero Page with X Offset */
+static uint8_t CPU6502_zpy(struct CPU6502 *cpu); /* Zero Page with Y Offset */
+static uint8_t CPU6502_rel(struct CPU6502 *cpu); /* Relative */
+static uint8_t CPU6502_abs(struct CPU6502 *cpu); /* Absolute */
+static uint8_t CPU6502_abx(struct CPU6502 *cpu); /* Absolute with X Offset */
+static uint8_t CPU6502_aby(struct CPU6502 *cpu); /* Absolute with Y Offset */
+static uint8_t CPU6502_ind(struct CPU6502 *cpu); /* Indirect */
+static uint8_t CPU6502_izx(struct CPU6502 *cpu); /* Indirect X */
+static uint8_t CPU6502_izy(struct CPU6502 *cpu); /* Indirect Y */
+
+/* Instructions */
+static uint8_t CPU6502_adc(struct CPU6502 *cpu); /* Add with Carry */
+static uint8_t CPU6502_and(struct CPU6502 *cpu); /* AND */
+static uint8_t CPU6502_asl(struct CPU6502 *cpu); /* Arithmetic shift one CPU6502_bit left */
+static uint8_t CPU6502_bcc(struct CPU6502 *cpu); /* Branch on Carry clear */
+static uint8_t CPU6502_bcs(struct CPU6502 *cpu); /* Branch on Carry set */
+static uint8_t CPU6502_beq(struct CPU6502 *cpu); /* Branch if equal */
+static uint8_t CPU6502_bit(struct CPU6502 *cpu); /* Bit test */
+static uint8_t CPU6502_bmi(struct CPU6502 *cpu); /* Branch if reslut minus */
+static uint8_t CPU6502_bne(struct CPU6502 *cpu); /* Branch if not equal */
+static uint8_t CPU6502_bpl(struct CPU6502 *cpu); /* Branch if relult plus */
+static uint8_t CPU6502_brk(struct CPU6502 *cpu); /* Break */
+static uint8_t CPU6502_bvc(struct CPU6502 *cpu); /* Branch on overflow clear */
+static uint8_t CPU6502_bvs(struct CPU6502 *cpu); /* Branch on overflow set */
+static uint8_t CPU6502_clc(struct CPU6502 *cpu); /* Clear carry flag */
+static uint8_t CPU6502_cld(struct CPU6502 *cpu); /* Clear CPU6502_decimal mode */
+static uint8_t CPU6502_cli(struct CPU6502 *cpu); /* Clear interrupt disable flag */
+static uint8_t CPU6502_clv(struct CPU6502 *cpu); /* Clear overflow flag */
+static uint8_t CPU6502_cmp(struct CPU6502 *cpu); /* Compare memory CPU6502_and accumulator */
+static uint8_t CPU6502_cpx(struct CPU6502 *cpu); /* Compare memory CPU6502_and X register */
+static uint8_t CPU6502_cpy(struct CPU6502 *cpu); /* Compare memory CPU6502_and Y register */
+static uint8_t CPU6502_dec(struct CPU6502 *cpu); /* Decrement memory or accumulator by one */
+static uint8_t CPU6502_dex(struct CPU6502 *cpu); /* Decrement X by one */
+static uint8_t CPU6502_dey(struct CPU6502 *cpu); /* Decrement Y by one */
+static uint8_t CPU6502_eor(struct CPU6502 *cpu); /* Exclusice or memory or accumulator by one */
+static uint8_t CPU6502_inc(struct CPU6502 *cpu); /* Increment memory or accumulator by one */
+static uint8_t CPU6502_inx(struct CPU6502 *cpu); /* Increment X register by one */
+static uint8_t CPU6502_iny(struct CPU6502 *cpu); /* Increment Y register by one */
+static uint8_t CPU6502_jmp(struct CPU6502 *cpu); /* Jump to new location */
+static uint8_t CPU6502_jsr(struct CPU6502 *cpu); /* Jump to new location saving return */
+static uint8_t CPU6502_lda(struct CPU6502 *cpu); /* Load accumulator with memory */
+static uint8_t CPU6502_ldx(struct CPU6502 *cpu); /* Load X register with memory */
+static uint8_t CPU6502_ldy(struct CPU6502 *cpu); /* Load Y register with memory */
+static uint8_t CPU6502_lsr(struct CPU6502 *cpu); /* Logical shift one CPU6502_bit right memory or accumulator */
+static uint8_t CPU6502_nop(struct CPU6502 *cpu); /* No operation */
+static uint8_t CPU6502_ora(struct CPU6502 *cpu); /* Or memory with accumulator */
+static uint8_t CPU6502_pha(struct CPU6502 *cpu); /* Push accumulator on stack */
+static uint8_t CPU6502_php(struct CPU6502 *cpu); /* Push processor status on stack */
+static uint8_t CPU6502_pla(struct CPU6502 *cpu); /* Pull accumulator from stack */
+static uint8_t CPU6502_plp(struct CPU6502 *cpu); /* Pull processor status from stack */
+static uint8_t CPU6502_rol(struct CPU6502 *cpu); /* Rotate one CPU6502_bit left memory or accumulator */
+static uint8_t CPU6502_ror(struct CPU6502 *cpu); /* Rotate one CPU6502_bit right memory or accumulator */
+static uint8_t CPU6502_rti(struct CPU6502 *cpu); /* Return from interrupt */
+static uint8_t CPU6502_rts(struct CPU6502 *cpu); /* Return from subroutine */
+static uint8_t CPU6502_sbc(struct CPU6502 *cpu); /* Substract memory from accumulator with borrow (carry) */
+static uint8_t CPU6502_sec(struct CPU6502 *cpu); /* Set carry */
+static uint8_t CPU6502_sed(struct CPU6502 *cpu); /* Set CPU6502_decimal mode */
+static uint8_t CPU6502_sei(struct CPU6502 *cpu); /* Set interrupt flag */
+static uint8_t CPU6502_sta(struct CPU6502 *cpu); /* Store accumulator in memory */
+static uint8_t CPU6502_stx(struct CPU6502 *cpu); /* Store X register in memory */
+static uint8_t CPU6502_sty(struct CPU6502 *cpu); /* Store Y register in memory */
+static uint8_t CPU6502_tax(struct CPU6502 *cpu); /* Transfer the accumulator to the X register */
+static uint8_t CPU6502_tay(struct CPU6502 *cpu); /* Transfer the accumulator to the Y register */
+static uint8_t CPU6502_tsx(struct CPU6502 *cpu); /* Transfer the stack pointer to the Y register */
+static uint8_t CPU6502_txa(struct CPU6502 *cpu); /* Transfer the X register the accumulator */
+static uint8_t CPU6502_txs(struct CPU6502 *cpu); /* Transfer the X register the stack pointer */
+static uint8_t CPU6502_tya(struct CPU6502 *cpu); /* Transfer the Y register the accumulator */
+
+static uint8_t CPU6502_xxx(struct CPU6502 *cpu); /* Illegal OpCode */
+
+static struct OpCodeLUT opcodes [] = {
+/* 0x0x */
+  { "BRK", 7, CPU6502_imp, CPU6502_brk },
+  { "ORA", 6, CPU6502_izx, CPU6502_ora },
+  { ""   , 0, CPU6502_imp, CPU6502_xxx },
+  { ""   , 0, CPU6502_imp, CPU6502_xxx },
+  { ""   , 0, CPU6502_imp, CPU6502_xxx },
+  { "ORA", 3, CPU6502_zpg, CPU6502_ora },
+  { "ASL", 5, CPU6502_zpg, CPU6502_asl },
+  { ""   , 0, CPU6502_imp, CPU6502_xxx },
+  { "PHP", 3, CPU6502_imp, CPU6502_php },
+  { "ORA", 2, CPU6502_imm, CPU6502_ora },
+  { "ASL", 2, CPU6502_imp, CPU6502_asl },
+  { ""   , 0, CPU6502_imp, CPU6502_xxx },
+  { ""   , 0, CPU6502_imp, CPU6502_xxx },
+  { "ORA", 4, CPU6502_abs, CPU6502_ora },
+  { "ASL", 6, CPU6502_abs, CPU6502_asl },
+  { ""   , 0, CPU6502_imp, CPU6502_xxx },
+/* 0x1x */
+  { "BPL", 2, CPU6502_rel, CPU6502_bpl },
+  { "ORA", 5, CPU6502_izy, CPU6502_ora },
+  { ""   , 0, CPU6502_imp, CPU6502_xxx },
+  { ""   , 0, CPU6502_imp, CPU6502_xxx },
+  { ""   , 0, CPU6502_imp, CPU6502_xxx },
+  { "ORA", 4, CPU6502_zpx, CPU6502_ora },
+  { "ASL", 6, CPU6502_zpx, CPU6502_asl },
+  { ""   , 0, CPU6502_imp, CPU6502_xxx },
+  { "CLC", 2, CPU6502_imp, CPU6502_clc },
+  { "ORA", 4, CPU6502_aby, CPU6502_ora },
+  { ""   , 0, CPU6502_imp, CPU6502_xxx },
+  { ""   , 0, CPU6502_imp, CPU6502_xxx },
+  { ""   , 0, CPU6502_imp, CPU6502_xxx },
+  { "ORA", 4, CPU6502_abx, CPU6502_ora },
+  { "ASL", 7, CPU6502_abx, CPU6502_asl },
+  { ""   , 0, CPU6502_imp, CPU6502_xxx },
+/* 0x2x */
+  { "JSR", 6, CPU6502_abs, CPU6502_jsr },
+  { "AND", 6, CPU6502_izx, CPU6502_and },
+  { ""   , 0, CPU6502_imp, CPU6502_xxx },
+  { "",    0, CPU6502_imp, CPU6502_xxx },
+  { "BIT", 3, CPU6502_zpg, CPU6502_bit },
+  { "AND", 3, CPU6502_zpg, CPU6502_and },
+  { "ROL", 5, CPU6502_zpg, CPU6502_rol },
+  { ""   , 0, CPU6502_imp, CPU6502_xxx },
+  { "PLP", 4, CPU6502_imp, CPU6502_plp },
+  { "AND", 2, CPU6502_imm, CPU6502_and },
+  { "ROL", 2, CPU6502_imp, CPU6502_rol },
+  { ""   , 0, CPU6502_imp, CPU6502_xxx },
+  { "BIT", 4, CPU6502_abs, CPU6502_bit },
+  { "AND", 4, CPU6502_abs, CPU6502_and },
+  { "ROL", 6, CPU6502_abs, CPU6502_rol },
+  { ""   , 0, CPU6502_imp, CPU6502_xxx },
+/* 0x3x */
+  { "BMI", 2, CPU6502_rel, CPU6502_bmi },
+  { "AND", 5, CPU6502_izy, CPU6502_and },
+  { ""   , 0, CPU6502_imp, CPU6502_xxx },
+  { ""   , 0, CPU6502_imp, CPU6502_xxx },
+  { ""   , 0, CPU6502_imp, CPU6502_xxx },
+  { "AND", 4, CPU6502_zpx, CPU6502_and },
+  { "ROL", 6, CPU6502_zpx, CPU6502_rol },
+  { ""   , 0, CPU6502_imp, CPU6502_xxx },
+  { "SEC", 2, CPU6502_imp, CPU6502_sec },
+  { "AND", 4, CPU6502_aby, CPU6502_and },
+  { ""   , 0, CPU6502_imp, CPU6502_xxx },
+  { ""   , 0, CPU6502_imp, CPU6502_xxx },
+  { ""   , 0, CPU6502_imp, CPU6502_xxx },
+  { "AND", 4, CPU6502_abx, CPU6502_and },
+  { "ROL", 7, CPU6502_abx, CPU6502_rol },
+  { ""   , 0, CPU6502_imp, CPU6502_xxx },
+/* 0x4x */
+  { "RTI", 6, CPU6502_imp, CPU6502_rti },
+  { "EOR", 6, CPU6502_izx, CPU6502_eor },
+  { ""   , 0, CPU6502_imp, CPU6502_xxx },
+  { ""   , 0, CPU6502_imp, CPU6502_xxx },
+  { ""   , 0, CPU6502_imp, CPU6502_xxx },
+  { "EOR", 3, CPU6502_zpg, CPU6502_eor },
+  { "LSR", 5, CPU6502_zpg, CPU6502_lsr },
+  { ""   , 0, CPU6502_imp, CPU6502_xxx },
+  { "PHA", 3, CPU6502_imp, CPU6502_pha },
+  { "EOR", 2, CPU6502_imm, CPU6502_eor },
+  { "LSR", 2, CPU6502_imp, CPU6502_lsr },
+  { ""   , 0, CPU6502_imp, CPU6502_xxx },
+  { "JMP", 3, CPU6502_abs, CPU6502_jmp },
+  { "EOR", 4, CPU6502_abs, CPU6502_eor },
+  { "LSR", 6, CPU6502_abs, CPU6502_lsr },
+  { ""   , 0, CPU6502_imp, CPU6502_xxx },
+/* 0x5x */
+  { "BVC", 2, CPU6502_rel, CPU6502_bvc },
+  { "EOR", 5, CPU6502_izy, CPU6502_eor },
+  { ""   , 0, CPU6502_imp, CPU6502_xxx },
+  { ""   , 0, CPU6502_imp, CPU6502_xxx },
+  { ""   , 0, CPU6502_imp, CPU6502_xxx },
+  { "EOR", 4, CPU6502_zpx, CPU6502_eor },
+  { "LSR", 6, CPU6502_zpx, CPU6502_lsr },
+  { ""   , 0, CPU6502_imp, CPU6502_xxx },
+  { "CLI", 2, CPU6502_imp, CPU6502_cli },
+  { "EOR", 4, CPU6502_aby, CPU6502_eor },
+  { ""   , 0, CPU6502_imp, CPU6502_xxx },
+  { ""   , 0, CPU6502_imp, CPU6502_xxx },
+  { ""   , 0, CPU6502_imp, CPU6502_xxx },
+  { "EOR", 4, CPU6502_abx, CPU6502_eor },
+  { "LSR", 7, CPU6502_abx, CPU6502_lsr },
+  { ""   , 0, CPU6502_imp, CPU6502_xxx },
+/* 0x6x */
+  { "RTS", 6, CPU6502_imp, CPU6502_rts },
+  { "ADC", 6, CPU6502_izx, CPU6502_adc },
+  { ""   , 0, CPU6502_imp, CPU6502_xxx },
+  { ""   , 0, CPU6502_imp, CPU6502_xxx },
+  { ""   , 0, CPU6502_imp, CPU6502_xxx },
+  { "ADC", 3, CPU6502_zpg, CPU6502_adc },
+  { "ROR", 5, CPU6502_zpg, CPU6502_ror },
+  { ""   , 0, CPU6502_imp, CPU6502_xxx },
+  { "PLA", 4, CPU6502_imp, CPU6502_pla },
+  { "ADC", 2, CPU6502_imm, CPU6502_adc },
+  { "ROR", 2, CPU6502_imp, CPU6502_ror },
+  { ""   , 0, CPU6502_imp, CPU6502_xxx },
+  { "JMP", 5, CPU6502_ind, CPU6502_jmp },
+  { "ADC", 4, CPU6502_abs, CPU6502_adc },
+  { "ROR", 6, CPU6502_abs, CPU6502_ror },
+  { ""   , 0, CPU6502_imp, CPU6502_xxx },
+/* 0x7x */
+  { "BVS", 2, CPU6502_rel, CPU6502_bvs },
+  { "ADC", 5, CPU6502_izy, CPU6502_adc },
+  { ""   , 0, CPU6502_imp, CPU6502_xxx },
+  { ""   , 0, CPU6502_imp, CPU6502_xxx },
+  { ""   , 0, CPU6502_imp, CPU6502_xxx },
+  { "ADC", 4, CPU6502_zpx, CPU6502_adc },
+  { "ROR", 6, CPU6502_zpx, CPU6502_ror },
+  { ""   , 0, CPU6502_imp, CPU6502_xxx },
+  { "SEI", 2, CPU6502_imp, CPU6502_sei },
+  { "ADC", 4, CPU6502_aby, CPU6502_adc },
+  { ""   , 0, CPU6502_imp, CPU6502_xxx },
+  { ""   , 0, CPU6502_imp, CPU6502_xxx },
+  { ""   , 0, CPU6502_imp, CPU6502_xxx },
+  { "ADC", 4, CPU6502_abx, CPU6502_adc },
+  { "ROR", 7, CPU6502_abx, CPU6502_ror },
+  { ""   , 0, CPU6502_imp, CPU6502_xxx },
+/* 0x8x */
+  { ""   , 0, CPU6502_imp, CPU6502_xxx },
+  { "STA", 6, CPU6502_izx, CPU6502_sta },
+  { ""   , 0, CPU6502_imp, CPU6502_xxx },
+  { ""   , 0, CPU6502_imp, CPU6502_xxx },
+  { "STY", 3, CPU6502_zpg, CPU6502_sty },
+  { "STA", 3, CPU6502_zpg, CPU6502_sta },
+  { "STX", 3, CPU6502_zpg, CPU6502_stx },
+  { ""   , 0, CPU6502_imp, CPU6502_xxx },
+  { "DEY", 2, CPU6502_imp, CPU6502_dey },
+  { ""   , 0, CPU6502_imp, CPU6502_xxx },
+  { "TXA", 2, CPU6502_imp, CPU6502_txa },
+  { ""   , 0, CPU6502_imp, CPU6502_xxx },
+  { "STY", 4, CPU6502_abs, CPU6502_sty },
+  { "STA", 4, CPU6502_abs, CPU6502_sta },
+  { "STX", 4, CPU6502_abs, CPU6502_stx },
+  { ""   , 0, CPU6502_imp, CPU6502_xxx },
+/* 0x9x */
+  { "BCC", 2, CPU6502_rel, CPU6502_bcc },
+  { "STA", 6, CPU6502_izy, CPU6502_sta },
+  { ""   , 0, CPU6502_imp, CPU6502_xxx },
+  { ""   , 0, CPU6502_imp, CPU6502_xxx },
+  { "STY", 4, CPU6502_zpx, CPU6502_sty },
+  { "STA", 4, CPU6502_zpx, CPU6502_sta },
+  { "STX", 4, CPU6502_zpy, CPU6502_stx },
+  { ""   , 0, CPU6502_imp, CPU6502_xxx },
+  { "TYA", 2, CPU6502_imp, CPU6502_tya },
+  { "STA", 5, CPU6502_aby, CPU6502_sta },
+  { "TXS", 2, CPU6502_imp, CPU6502_txs },
+  { ""   , 0, CPU6502_imp, CPU6502_xxx },
+  { ""   , 0, CPU6502_imp, CPU6502_xxx },
+  { "STA", 5, CPU6502_abx, CPU6502_sta },
+  { ""   , 0, CPU6502_imp, CPU6502_xxx },
+  { ""   , 0, CPU6502_imp, CPU6502_xxx },
+/* 0xAx */
+  { "LDY", 2, CPU6502_imm, CPU6502_ldy },
+  { "LDA", 6, CPU6502_izx, CPU6502_lda },
+  { "LDX", 2, CPU6502_imm, CPU6502_ldx },
+  { ""   , 0, CPU6502_imp, CPU6502_xxx },
+  { "LDY", 3, CPU6502_zpg, CPU6502_ldy },
+  { "LDA", 3, CPU6502_zpg, CPU6502_lda },
+  { "LDX", 3, CPU6502_zpg, CPU6502_ldx },
+  { ""   , 0, CPU6502_imp, CPU6502_xxx },
+  { "TAY", 2, CPU6502_imp, CPU6502_tay },
+  { "LDA", 2, CPU6502_imm, CPU6502_lda },
+  { "TAX", 2, CPU6502_imp, CPU6502_tax },
+  { ""   , 0, CPU6502_imp, CPU6502_xxx },
+  { "LDY", 4, CPU6502_abs, CPU6502_ldy },
+  { "LDA", 4, CPU6502_abs, CPU6502_lda },
+  { "LDX", 4, CPU6502_abs, CPU6502_ldx },
+  { ""   , 0, CPU6502_imp, CPU6502_xxx },
+/* 0xBx */
+  { "BCS", 2, CPU6502_rel, CPU6502_bcs },
+  { "LDA", 5, CPU6502_izy, CPU6502_lda },
+  { ""   , 0, CPU6502_imp, CPU6502_xxx },
+  { ""   , 0, CPU6502_imp, CPU6502_xxx },
+  { "LDY", 4, CPU6502_zpx, CPU6502_ldy },
+  { "LDA", 4, CPU6502_zpx, CPU6502_lda },
+  { "LDX", 4, CPU6502_zpy, CPU6502_ldx },
+  { ""   , 0, CPU6502_imp, CPU6502_xxx },
+  { "CLV", 2, CPU6502_imp, CPU6502_clv },
+  { "LDA", 4, CPU6502_aby, CPU6502_lda },
+  { "TSX", 2, CPU6502_imp, CPU6502_tsx },
+  { ""   , 0, CPU6502_imp, CPU6502_xxx },
+  { "LDY", 4, CPU6502_abx, CPU6502_ldy },
+  { "LDA", 4, CPU6502_abx, CPU6502_lda },
+  { "LDX", 4, CPU6502_aby, CPU6502_ldx },
+  { ""   , 0, CPU6502_imp, CPU6502_xxx },
+/* 0xCx */
+  { "CPY", 2, CPU6502_imm, CPU6502_cpy },
+  { "CMP", 6, CPU6502_izx, CPU6502_cmp },
+  { ""   , 0, CPU6502_imp, CPU6502_xxx },
+  { ""   , 0, CPU6502_imp, CPU6502_xxx },
+  { "CPY", 3, CPU6502_zpg, CPU6502_cpy },
+  { "CMP", 3, CPU6502_zpg, CPU6502_cmp },
+  { "DEC", 5, CPU6502_zpg, CPU6502_dec },
+  { ""   , 0, CPU6502_imp, CPU6502_xxx },
+  { "INY", 2, CPU6502_imp, CPU6502_iny },
+  { "CMP", 2, CPU6502_imm, CPU6502_cmp },
+  { "DEX", 2, CPU6502_imp, CPU6502_dex },
+  { ""   , 0, CPU6502_imp, CPU6502_xxx },
+  { "CPY", 4, CPU6502_abs, CPU6502_cpy },
+  { "CMP", 4, CPU6502_abs, CPU6502_cmp },
+  { "DEC", 6, CPU6502_abs, CPU6502_dec },
+  { ""   , 0, CPU6502_imp, CPU6502_xxx },
+/* 0xDx */
+  { "BNE", 2, CPU6502_rel, CPU6502_bne },
+  { "CMP", 5, CPU6502_izy, CPU6502_cmp },
+  { ""   , 0, CPU6502_imp, CPU6502_xxx },
+  { ""   , 0, CPU6502_imp, CPU6502_xxx },
+  { ""   , 0, CPU6502_imp, CPU6502_xxx },
+  { "CMP", 4, CPU6502_zpx, CPU6502_cmp },
+  { "DEC", 6, CPU6502_zpx, CPU6502_dec },
+  { ""   , 0, CPU6502_imp, CPU6502_xxx },
+  { "CLD", 2, CPU6502_imp, CPU6502_cld },
+  { "CMP", 4, CPU6502_aby, CPU6502_cmp },
+  { ""   , 0, CPU6502_imp, CPU6502_xxx },
+  { ""   , 0, CPU6502_imp, CPU6502_xxx },
+  { ""   , 0, CPU6502_imp, CPU6502_xxx },
+  { "CMP", 4, CPU6502_abx, CPU6502_cmp },
+  { "DEC", 7, CPU6502_abx, CPU6502_dec },
+  { ""   , 0, CPU6502_imp, CPU6502_xxx },
+/* 0xEx */
+  { "CPX", 2, CPU6502_imm, CPU6502_cpx },
+  { "SBC", 6, CPU6502_izx, CPU6502_sbc },
+  { ""   , 0, CPU6502_imp, CPU6502_xxx },
+  { ""   , 0, CPU6502_imp, CPU6502_xxx },
+  { "CPX", 3, CPU6502_zpg, CPU6502_cpx },
+  { "SBC", 3, CPU6502_zpg, CPU6502_sbc },
+  { "INC", 5, CPU6502_zpg, CPU6502_inc },
+  { ""   , 0, CPU6502_imp, CPU6502_xxx },
+  { "INX", 2, CPU6502_imp, CPU6502_inx },
+  { "SBC", 2, CPU6502_imm, CPU6502_sbc },
+  { "NOP", 2, CPU6502_imp, CPU6502_nop },
+  { ""   , 0, CPU6502_imp, CPU6502_xxx },
+  { "CPX", 4, CPU6502_abs, CPU6502_cpx },
+  { "SBC", 4, CPU6502_abs, CPU6502_sbc },
+  { "INC", 6, CPU6502_abs, CPU6502_inc },
+  { ""   , 0, CPU6502_imp, CPU6502_xxx },
+/* 0xFx */
+  { "BEQ", 2, CPU6502_rel, CPU6502_beq },
+  { "SBC", 5, CPU6502_izy, CPU6502_sbc },
+  { ""   , 0, CPU6502_imp, CPU6502_xxx },
+  { ""   , 0, CPU6502_imp, CPU6502_xxx },
+  { ""   , 0, CPU6502_imp, CPU6502_xxx },
+  { "SBC", 4, CPU6502_zpx, CPU6502_sbc },
+  { "INC", 6, CPU6502_zpx, CPU6502_inc },
+  { ""   , 0, CPU6502_imp, CPU6502_xxx },
+  { "SED", 2, CPU6502_imp, CPU6502_sed },
+  { "SBC", 4, CPU6502_aby, CPU6502_sbc },
+  { ""   , 0, CPU6502_imp, CPU6502_xxx },
+  { ""   , 0, CPU6502_imp, CPU6502_xxx },
+  { ""   , 0, CPU6502_imp, CPU6502_xxx },
+  { "SBC", 4, CPU6502_abx, CPU6502_sbc },
+  { "INC", 7, CPU6502_abx, CPU6502_inc },
+  { ""   , 0, CPU6502_imp, CPU6502_xxx },
+};
+
+static void CPU6502_writeBack(struct CPU6502 *cpu, uint8_t data);
+static uint8_t CPU6502_fetch(struct CPU6502 *cpu);
+static uint8_t CPU6502_fetchModify(struct CPU6502 *cpu);
+#if CPU6502_EXACT
+static void CPU6502_indexedRead(struct CPU6502 *cpu, uint8_t always);
+#endif
+static void CPU6502_push(struct CPU6502 *cpu, uint8_t data);
+static uint8_t CPU6502_pull(struct CPU6502 *cpu);
+static uint8_t CPU6502_branch(struct CPU6502 *cpu, uint8_t condition);
+static uint8_t CPU6502_pollLoopCycles(struct CPU6502 *cpu, uint16_t target);
+static void CPU6502_idle(struct CPU6502 *cpu, uint8_t loop_cycles);
+
+/*----------------------------------------------------------------------------*/
+uint8_t CPU6502_TIER(CPU6502_execute)(struct CPU6502 *cpu)
+{
+  uint8_t opcode = 0;
+  uint8_t extra_cycles1 = 0;
+  uint8_t extra_cycles2 = 0;
+
+  /* Interrupts and hooks are only checked at instruction boundaries */
+  if(cpu->pending | cpu->hooks)
+  {
+    if(cpu->hooks && bus_cpu_hook(cpu->bus, cpu->Reg.PC) != 0)
+    {
+      cpu->cycles = 0;
+      return 0;
+    }
+
+    if(cpu->nmi_edge)
+    {
+      CPU6502_nmi(cpu);
+      return cpu->cycles;
+    }
+    if(cpu->pending)
+    {
+      CPU6502_irq(cpu);
+      return cpu->cycles;
+    }
+  }
+
+#if CPU6502_EXACT
+  cpu->cycles = 0;
+#endif
+  opcode = CPU6502_read(cpu, cpu->Reg.PC);
+  if(cpu->pairs != NULL)
+  {
+    cpu->pairs[(cpu->opcode << 8) | opcode]++;
+  }
+  cpu->opcode = opcode;
+  log_trace("OP <%s> at 0x%04x", opcodes[cpu->opcode].mnemonic, cpu->Reg.PC);
+
+  cpu->Reg.PC_old = cpu->Reg.PC;
+  cpu->Reg.PC++;
+#if !CPU6502_EXACT
+  cpu->cycles = opcodes[cpu->opcode].cycles;
+#endif
+
+  extra_cycles1 = opcodes[cpu->opcode].addrMode(cpu);
+  extra_cycles2 = opcodes[cpu->opcode].instruction(cpu);
+
+  CPU6502_addCycles(cpu, extra_cycles1 & extra_cycles2);
+
+  return cpu->cycles;
+}
+
+/*----------------------------------------------------------------------------*/
+void CPU6502_push(struct CPU6502 *cpu, uint8_t data)
+{
+  CPU6502_write(cpu, 0x0100 + cpu->Reg.SP, data);
+  cpu->Reg.SP--;
+}
+
+/*----------------------------------------------------------------------------*/
+uint8_t CPU6502_pull(struct CPU6502 *cpu)
+{
+  cpu->Reg.SP++;
+  return CPU6502_read(cpu, 0x0100 + cpu->Reg.SP);
+}
+
+/*----------------------------------------------------------------------------*/
+void CPU6502_TIER(CPU6502_interrupt)(struct CPU6502 *cpu, uint16_t vector)
+{
+#if CPU6502_EXACT
+  /* The opcode fetch and the following read are discarded */
+  cpu->cycles = 0;
+  CPU6502_dummyRead(cpu, cpu->Reg.PC);
+  CPU6502_dummyRead(cpu, cpu->Reg.PC);
+#endif
+
+  CPU6502_push(cpu, (cpu->Reg.PC >> 8) & 0x00FF);
+  CPU6502_push(cpu, cpu->Reg.PC & 0x00FF);
+
+  cpu->Reg.BRK = 0;
+  cpu->Reg.NU = 1;
+  CPU6502_push(cpu, cpu->Reg.PSR);
+  cpu->Reg.IRQB = 1;
+  CPU6502_updatePending(cpu);
+
+  cpu->Reg.PCL = CPU6502_read(cpu, vector);
+  cpu->Reg.PCH = CPU6502_read(cpu, vector + 1);
+
+#if !CPU6502_EXACT
+  cpu->cycles = 7;
+#endif
+}
+
+/*----------------------------------------------------------------------------*/
+uint8_t CPU6502_branch(struct CPU6502 *cpu, uint8_t condition)
+{
+  if(condition)
+  {
+    /* The next opcode is read while the offset is added to PCL, a carry
+     * into PCH costs another read from the unfixed address */
+    CPU6502_addCycles(cpu, 1);
+    CPU6502_dummyRead(cpu, cpu->Reg.PC);
+
+    cpu->addr_abs = cpu->Reg.PC + cpu->addr_rel;
+
+    if((cpu->addr_abs & 0xFF00) != (cpu->Reg.PC & 0xFF00))
+    {
+      CPU6502_addCycles(cpu, 1);
+      CPU6502_dummyRead(cpu, (cpu->Reg.PC & 0xFF00) | (cpu->addr_abs & 0x00FF));
+    }
+
+    cpu->Reg.PC = cpu->addr_abs;
+
+    log_debug("%s jump to addr <0x%04x>", opcodes[cpu->opcode].mnemonic, cpu->Reg.PC);
+
+    /* Branch to itself or back to a side effect free poll */
+    if(cpu->Reg.PC == cpu->Reg.PC_old)
+    {
+      CPU6502_idle(cpu, cpu->cycles);
+    }
+    else if(cpu->Reg.PC < cpu->Reg.PC_old)
+    {
+      uint8_t poll_cycles = CPU6502_pollLoopCycles(cpu, cpu->Reg.PC);
+
+      if(poll_cycles != 0)
+      {
+        CPU6502_idle(cpu, cpu->cycles + poll_cycles);
+      }
+    }
+
+    return 0;
+  }
+
+  log_debug("%s condition not met; continue", opcodes[cpu->opcode].mnemonic);
+
+  return 0;
+}
+
+/*----------------------------------------------------------------------------*/
+uint8_t CPU6502_pollLoopCycles(struct CPU6502 *cpu, uint16_t target)
+{
+  uint16_t len = cpu->Reg.PC_old - target;
+  uint8_t op = bus_peek(cpu->bus, target);
+  uint8_t cycles = opcodes[op].cycles;
+  uint8_t mask = 0xFF;
+  uint8_t value = 0;
+  uint8_t flags = 0;
+  uint8_t bit_flags = CPU6502_FLAG_NEGATIVE | CPU6502_FLAG_OVERFLOW | CPU6502_FLAG_ZERO;
+  uint16_t addr = 0;
+
+  /* Either <load> <branch> or <load> AND #imm <branch>. Returns the cycles
+   * of the loop body without the branch, 0 if it is not a poll loop. */
+  if(len == 5 || len == 4)
+  {
+    if(bus_peek(cpu->bus, cpu->Reg.PC_old - 2) != 0x29)
+    {
+      return 0;
+    }
+    len -= 2;
+    cycles += opcodes[0x29].cycles;
+    mask = bus_peek(cpu->bus, cpu->Reg.PC_old - 1);
+    bit_flags = CPU6502_FLAG_OVERFLOW;
+  }
+
+  switch(op)
+  {
+    case 0xA5: /* LDA zpg */
+    case 0xA6: /* LDX zpg */
+    case 0xA4: /* LDY zpg */
+    case 0x24: /* BIT zpg */
+      if(len != 2)
+      {
+        return 0;
+      }
+      addr = bus_peek(cpu->bus, target + 1);
+      break;
+    case 0xAD: /* LDA abs */
+    case 0xAE: /* LDX abs */
+    case 0xAC: /* LDY abs */
+    case 0x2C: /* BIT abs */
+      if(len != 3)
+      {
+        return 0;
+      }
+      addr = bus_peek(cpu->bus, target + 1) | (bus_peek(cpu->bus, target + 2) << 8);
+      break;
+    default:
+      return 0;
+  }
+
+  /* Only plain memory can not change until an external event happens */
+  if(!bus_is_plain_memory(cpu->bus, addr))
+  {
+    return 0;
+  }
+
+  /* An event may have written the value after the load of this iteration,
+   * the next iteration then sees it and the loop is not idle */
+  value = bus_peek(cpu->bus, addr);
+  switch(op)
+  {
+    case 0xA5:
+    case 0xAD:
+      return (value & mask) == cpu->Reg.A ? cycles : 0;
+    case 0xA6:
+    case 0xAE:
+      return value == cpu->Reg.X ? cycles : 0;
+    case 0xA4:
+    case 0xAC:
+      return value == cpu->Reg.Y ? cycles : 0;
+    default:
+      /* BIT, an AND after it only leaves the overflow flag to the value */
+      flags = (value & (CPU6502_FLAG_NEGATIVE | CPU6502_FLAG_OVERFLOW)) |
+              ((value & cpu->Reg.A) == 0 ? CPU6502_FLAG_ZERO : 0);
+      return (cpu->Reg.PSR & bit_flags) == (flags & bit_flags) ? cycles : 0;
+  }
+}
+
+/*----------------------------------------------------------------------------*/
+void CPU6502_idle(struct CPU6502 *cpu, uint8_t loop_cycles)
+{
+  uint64_t now = cpu->clock_count + cpu->cycles;
+  uint64_t iterations = 0;
+
+  if(cpu->pending)
+  {
+    return;
+  }
+
+  if(scheduler_next(cpu->bus->sched) == SCHEDULER_NEVER)
+  {
+    log_debug("Idle loop at <0x%04x> without pending events. Stop Emulator...", cpu->Reg.PC);
+    bus_stop(cpu->bus, BUS_STOP_IDLE);
+    return;
+  }
+
+  /* Hooks have to see every instruction, an instruction limit counts them */
+  if(now >= cpu->deadline || cpu->hooks != 0)
+  {
+    return;
+  }
+
+  /* Skip whole loop iterations up to the next event */
+  iterations = (cpu->deadline - now + loop_cycles - 1) / loop_cycles;
+  cpu->clock_count += iterations * loop_cycles;
+
+  log_trace("Idle loop at <0x%04x>; fast forward %" PRIu64 " cycles", cpu->Reg.PC, iterations * loop_cycles);
+}
+
+/*----------------------------------------------------------------------------*/
+uint8_t CPU6502_fetch(struct CPU6502 *cpu)
+{
+  if(opcodes[cpu->opcode].addrMode != CPU6502_imp)
+  {
+    CPU6502_dummyIndexed(cpu, 0);
+    cpu->fetched = CPU6502_read(cpu, cpu->addr_abs);
+    log_trace("Fetch data <0x%02x> from addr <0x%04x>", cpu->fetched, cpu->addr_abs);
+  }
+  return cpu->fetched;
+}
+
+/*----------------------------------------------------------------------------*/
+uint8_t CPU6502_fetchModify(struct CPU6502 *cpu)
+{
+  /* Read-modify-write instructions never skip the unfixed address */
+  if(opcodes[cpu->opcode].addrMode != CPU6502_imp)
+  {
+    CPU6502_dummyIndexed(cpu, 1);
+    cpu->fetched = CPU6502_read(cpu, cpu->addr_abs);
+  }
+  return cpu->fetched;
+}
+
+#if CPU6502_EXACT
+/*----------------------------------------------------------------------------*/
+static void CPU6502_indexedRead(struct CPU6502 *cpu, uint8_t always)
+{
+  uint8_t (*mode)(struct CPU6502 *) = opcodes[cpu->opcode].addrMode;
+
+  /* Indexed absolute and (zp),Y read before the carry reaches the high
+   * byte. Reads only pay for it when a page is crossed. */
+  if((mode == CPU6502_abx || mode == CPU6502_aby || mode == CPU6502_izy) &&
+     (always || cpu->addr_unfixed != cpu->addr_abs))
+  {
+    CPU6502_dummyRead(cpu, cpu->addr_unfixed);
+  }
+}
+#endif
+
+/*----------------------------------------------------------------------------*/
+void CPU6502_writeBack(struct CPU6502 *cpu, uint8_t data)
+{
+  /* Shifts and rotates in implied mode work on the accumulator */
+  if(opcodes[cpu->opcode].addrMode == CPU6502_imp)
+  {
+    cpu->Reg.A = data;
+  }
+  else
+  {
+    /* The unmodified value is written back first */
+    CPU6502_dummyWrite(cpu, cpu->addr_abs, cpu->fetched);
+    CPU6502_write(cpu, cpu->addr_abs, data);
+  }
+}
+
+/* Implied */
+uint8_t CPU6502_imp(struct CPU6502 *cpu)
+{
+  log_trace("Addr mode: Implied");
+  cpu->fetched = cpu->Reg.A;
+  /* The byte after the opcode is read and ignored */
+  CPU6502_dummyRead(cpu, cpu->Reg.PC);
+  return 0;
+}
+
+/* Immediate */
+uint8_t CPU6502_imm(struct CPU6502 *cpu)
+{
+  log_trace("Addr mode: Immediate");
+  cpu->addr_abs = cpu->Reg.PC++;
+  return 0;
+}
+
+/* Zero Page */
+uint8_t CPU6502_zpg(struct CPU6502 *cpu)
+{
+  log_trace("Addr mode: Zero Page");
+  cpu->addr_abs = CPU6502_read(cpu, cpu->Reg.PC);
+  cpu->Reg.PC++;
+  return 0;
+}
+
+/* Zero Page with X Offset */
+uint8_t CPU6502_zpx(struct CPU6502 *cpu)
+{
+  uint8_t base;
+
+  log_trace("Addr mode: Zero Page X Offset");
+  base = CPU6502_read(cpu, cpu->Reg.PC);
+  cpu->Reg.PC++;
+
+  /* The unindexed address is read while the index is added */
+  CPU6502_dummyRead(cpu, base);
+  cpu->addr_abs = (base + cpu->Reg.X) & 0x00FF;
+  return 0;
+}
+
+/* Zero Page with Y Offset */
+uint8_t CPU6502_zpy(struct CPU6502 *cpu)
+{
+  uint8_t base;
+
+  log_trace("Addr mode: Zero Page Y Offset");
+  base = CPU6502_read(cpu, cpu->Reg.PC);
+  cpu->Reg.PC++;
+
+  /* The unindexed address is read while the index is added */
+  CPU6502_dummyRead(cpu, base);
+  cpu->addr_abs = (base + cpu->Reg.Y) & 0x00FF;
+  return 0;
+}
+
+/* Relative */
+uint8_t CPU6502_rel(struct CPU6502 *cpu)
+{
+  log_trace("Addr mode: Relative");
+  cpu->addr_rel = CPU6502_read(cpu, cpu->Reg.PC);
+  cpu->Reg.PC++;
+  if(cpu->addr_rel & 0x80)
+  {
+    cpu->addr_rel |= 0xFF00;
+  }
+  return 0;
+}
+
+/* Absolute */
+uint8_t CPU6502_abs(struct CPU6502 *cpu)
+{
+  uint8_t lo;
+  uint8_t hi;
+  log_trace("Addr mode: Absolute");
+
+  lo = CPU6502_read(cpu, cpu->Reg.PC);
+  cpu->Reg.PC++;
+  hi = CPU6502_read(cpu, cpu->Reg.PC);
+  cpu->Reg.PC++;
+
+  cpu->addr_abs = (hi << 8 ) | lo;
+
+  return 0;
+}
+
+/* Absolute with X Offset */
+uint8_t CPU6502_abx(struct CPU6502 *cpu)
+{
+  uint8_t lo;
+  uint8_t hi;
+  log_trace("Addr mode: Absolute X Offset");
+
+  lo = CPU6502_read(cpu, cpu->Reg.PC);
+  cpu->Reg.PC++;
+  hi = CPU6502_read(cpu, cpu->Reg.PC);
+  cpu->Reg.PC++;
+
+  cpu->addr_abs = ((hi << 8) | lo) + cpu->Reg.X;
+#if CPU6502_EXACT
+  cpu->addr_unfixed = (hi << 8) | (cpu->addr_abs & 0x00FF);
+#endif
+
+  /* Crossing a page costs one cycle for read instructions */
+  return (cpu->addr_abs >> 8) != hi;
+}
+
+/* Absolute with Y Offset */
+uint8_t CPU6502_aby(struct CPU6502 *cpu)
+{
+  uint8_t lo;
+  uint8_t hi;
+  log_trace("Addr mode: Absolute Y Offset");
+
+  lo = CPU6502_read(cpu, cpu->Reg.PC);
+  cpu->Reg.PC++;
+  hi = CPU6502_read(cpu, cpu->Reg.PC);
+  cpu->Reg.PC++;
+
+  cpu->addr_abs = ((hi << 8) | lo) + cpu->Reg.Y;
+#if CPU6502_EXACT
+  cpu->addr_unfixed = (hi << 8) | (cpu->addr_abs & 0x00FF);
+#endif
+
+  return (cpu->addr_abs >> 8) != hi;
+}
+
+/* Indirect */
+uint8_t CPU6502_ind(struct CPU6502 *cpu)
+{
+  uint16_t ptr;
+  uint8_t lo;
+  uint8_t hi;
+  log_trace("Addr mode: Indirect");
+
+  ptr = CPU6502_read(cpu, cpu->Reg.PC);
+  cpu->Reg.PC++;
+  ptr |= CPU6502_read(cpu, cpu->Reg.PC) << 8;
+  cpu->Reg.PC++;
+
+  /* The high byte is fetched without carry into the pointer's page */
+  lo = CPU6502_read(cpu, ptr);
+  hi = CPU6502_read(cpu, (ptr & 0xFF00) | ((ptr + 1) & 0x00FF));
+  cpu->addr_abs = (hi << 8) | lo;
+
+  return 0;
+}
+
+/* Indirect X */
+uint8_t CPU6502_izx(struct CPU6502 *cpu)
+{
+  uint8_t ptr;
+  uint8_t lo;
+  uint8_t hi;
+  log_trace("Addr mode: Indirect X");
+
+  ptr = CPU6502_read(cpu, cpu->Reg.PC);
+  cpu->Reg.PC++;
+  CPU6502_dummyRead(cpu, ptr);
+  ptr += cpu->Reg.X;
+
+  lo = CPU6502_read(cpu, ptr);
+  hi = CPU6502_read(cpu, (uint8_t)(ptr + 1));
+  cpu->addr_abs = (hi << 8) | lo;
+
+  return 0;
+}
+
+/* Indirect Y */
+uint8_t CPU6502_izy(struct CPU6502 *cpu)
+{
+  uint8_t ptr;
+  uint8_t lo;
+  uint8_t hi;
+  log_trace("Addr mode: Indirect Y");
+
+  ptr = CPU6502_read(cpu, cpu->Reg.PC);
+  cpu->Reg.PC++;
+
+  lo = CPU6502_read(cpu, ptr);
+  hi = CPU6502_read(cpu, (uint8_t)(ptr + 1));
+  cpu->addr_abs = ((hi << 8) | lo) + cpu->Reg.Y;
+#if CPU6502_EXACT
+  cpu->addr_unfixed = (hi << 8) | (cpu->addr_abs & 0x00FF);
+#endif
+
+  return (cpu->addr_abs >> 8) != hi;
+}
+
+/* Add with Carry */
+uint8_t CPU6502_adc(struct CPU6502 *cpu)
+{
+  CPU6502_fetch(cpu);
+
+  log_debug("ADC Add <0x%02x> to A <0x%02x> (C: <0x%02x>)", cpu->fetched, cpu->Reg.A, cpu->Reg.CARRY);
+
+  CPU6502_aluAdc(cpu, cpu->fetched);
+
+  return 1;
+}
+
+/* AND */
+uint8_t CPU6502_and(struct CPU6502 *cpu)
+{
+  CPU6502_fetch(cpu);
+  log_debug("AND <0x%02x> with A <0x%02x>", cpu->fetched, cpu->Reg.A);
+  cpu->Reg.A &= cpu->fetched;
+  CPU6502_setNZ(cpu, cpu->Reg.A);
+  return 1;
+}
+
+/* Arithmetic shift one CPU6502_bit left */
+uint8_t CPU6502_asl(struct CPU6502 *cpu)
+{
+  uint8_t result;
+
+  CPU6502_fetchModify(cpu);
+  result = cpu->fetched << 1;
+  log_debug("ASL <0x%02x> -> <0x%02x>", cpu->fetched, result);
+
+  CPU6502_setShiftFlags(cpu, result, cpu->fetched >> 7);
+  CPU6502_writeBack(cpu, result);
+  return 0;
+}
+
+/* Branch on Carry clear */
+uint8_t CPU6502_bcc(struct CPU6502 *cpu)
+{
+  return CPU6502_branch(cpu, cpu->Reg.CARRY == 0);
+}
+
+/* Branch on Carry set */
+uint8_t CPU6502_bcs(struct CPU6502 *cpu)
+{
+  return CPU6502_branch(cpu, cpu->Reg.CARRY == 1);
+}
+
+/* Branch if equal */
+uint8_t CPU6502_beq(struct CPU6502 *cpu)
+{
+  return CPU6502_branch(cpu, cpu->Reg.ZERO == 1);
+}
+
+/* Bit test */
+uint8_t CPU6502_bit(struct CPU6502 *cpu)
+{
+  CPU6502_fetch(cpu);
+  log_debug("BIT Test <0x%02x> with A <0x%02x>", cpu->fetched, cpu->Reg.A);
+  CPU6502_aluBit(cpu, cpu->fetched);
+  return 0;
+}
+
+/* Branch if reslut minus */
+uint8_t CPU6502_bmi(struct CPU6502 *cpu)
+{
+  return CPU6502_branch(cpu, cpu->Reg.NEGATIVE == 1);
+}
+
+/* Branch if not equal */
+uint8_t CPU6502_bne(struct CPU6502 *cpu)
+{
+  return CPU6502_branch(cpu, cpu->Reg.ZERO == 0);
+}
+
+/* Branch if relult plus */
+uint8_t CPU6502_bpl(struct CPU6502 *cpu)
+{
+  return CPU6502_branch(cpu, cpu->Reg.NEGATIVE == 0);
+}
+
+/* Break */
+uint8_t CPU6502_brk(struct CPU6502 *cpu)
+{
+  if(bus_cpu_brk(cpu->bus) != 0)
+  {
+    cpu->Reg.PC = cpu->Reg.PC_old;
+    cpu->cycles = 0;
+    return 0;
+  }
+
+  /* Skip the padding byte */
+  cpu->Reg.PC++;
+
+  log_debug("BRK at <0x%04x>", cpu->Reg.PC_old);
+
+  CPU6502_push(cpu, (cpu->Reg.PC >> 8) & 0x00FF);
+  CPU6502_push(cpu, cpu->Reg.PC & 0x00FF);
+
+  cpu->Reg.BRK = 1;
+  cpu->Reg.NU = 1;
+  CPU6502_push(cpu, cpu->Reg.PSR);
+  cpu->Reg.BRK = 0;
+  cpu->Reg.IRQB = 1;
+  CPU6502_updatePending(cpu);
+
+  cpu->Reg.PCL = CPU6502_read(cpu, CPU6502_VECTOR_IRQ);
+  cpu->Reg.PCH = CPU6502_read(cpu, CPU6502_VECTOR_IRQ + 1);
+
+  return 0;
+}
+
+/* Branch on overflow clear */
+uint8_t CPU6502_bvc(struct CPU6502 *cpu)
+{
+  return CPU6502_branch(cpu, cpu->Reg.OVERFLOW == 0);
+}
+
+/* Branch on overflow set */
+uint8_t CPU6502_bvs(struct CPU6502 *cpu)
+{
+  return CPU6502_branch(cpu, cpu->Reg.OVERFLOW == 1);
+}
+
+/* Clear carry flag */
+uint8_t CPU6502_clc(struct CPU6502 *cpu)
+{
+  log_debug("CLC Clear Carry Flag");
+  cpu->Reg.CARRY = 0;
+  return 0;
+}
+
+/* Clear CPU6502_decimal mode */
+uint8_t CPU6502_cld(struct CPU6502 *cpu)
+{
+  log_debug("CLD Clear Decimal Mode");
+  cpu->Reg.DECIMAL = 0;
+  return 0;
+}
+
+/* Clear interrupt disable flag */
+uint8_t CPU6502_cli(struct CPU6502 *cpu)
+{
+  log_debug("CLI Clear Interrupt Disable Flag");
+  cpu->Reg.IRQB = 0;
+  CPU6502_updatePending(cpu);
+  return 0;
+}
+
+/* Clear overflow flag */
+uint8_t CPU6502_clv(struct CPU6502 *cpu)
+{
+  log_debug("CLV Clear Overflow Flag");
+  cpu->Reg.OVERFLOW = 0;
+  return 0;
+}
+
+/* Compare memory CPU6502_and accumulator */
+uint8_t CPU6502_cmp(struct CPU6502 *cpu)
+{
+  CPU6502_fetch(cpu);
+  log_debug("CMP <0x%02x> with A <0x%02x>", cpu->fetched, cpu->Reg.A);
+  CPU6502_setCompareFlags(cpu, cpu->Reg.A, cpu->fetched);
+  return 1;
+}
+
+/* Compare memory CPU6502_and X register */
+uint8_t CPU6502_cpx(struct CPU6502 *cpu)
+{
+  CPU6502_fetch(cpu);
+  log_debug("CPX <0x%02x> with X <0x%02x>", cpu->fetched, cpu->Reg.X);
+  CPU6502_setCompareFlags(cpu, cpu->Reg.X, cpu->fetched);
+  return 0;
+}
+
+/* Compare memory CPU6502_and Y register */
+uint8_t CPU6502_cpy(struct CPU6502 *cpu)
+{
+  CPU6502_fetch(cpu);
+  log_debug("CPY <0x%02x> with Y <0x%02x>", cpu->fetched, cpu->Reg.Y);
+  CPU6502_setCompareFlags(cpu, cpu->Reg.Y, cpu->fetched);
+  return 0;
+}
+
+/* Decrement memory or accumulator by one */
+uint8_t CPU6502_dec(struct CPU6502 *cpu)
+{
+  uint8_t result;
+
+  CPU6502_fetchModify(cpu);
+  result = cpu->fetched - 1;
+  log_debug("DEC <0x%04x> to <0x%02x>", cpu->addr_abs, result);
+
+  CPU6502_writeBack(cpu, result);
+  CPU6502_setNZ(cpu, result);
+  return 0;
+}
+
+/* Decrement X by one */
+uint8_t CPU6502_dex(struct CPU6502 *cpu)
+{
+  cpu->Reg.X--;
+  log_debug("DEX Decrement X to <0x%02x>", cpu->Reg.X);
+  CPU6502_setNZ(cpu, cpu->Reg.X);
+  return 0;
+}
+
+/* Decrement Y by one */
+uint8_t CPU6502_dey(struct CPU6502 *cpu)
+{
+  cpu->Reg.Y--;
+  log_debug("DEY Decrement Y to <0x%02x>", cpu->Reg.Y);
+  CPU6502_setNZ(cpu, cpu->Reg.Y);
+  return 0;
+}
+
+/* Exclusice or memory or accumulator by one */
+uint8_t CPU6502_eor(struct CPU6502 *cpu)
+{
+  CPU6502_fetch(cpu);
+  log_debug("EOR <0x%02x> with A <0x%02x>", cpu->fetched, cpu->Reg.A);
+  cpu->Reg.A ^= cpu->fetched;
+  CPU6502_setNZ(cpu, cpu->Reg.A);
+  return 1;
+}
+
+/* Increment memory or accumulator by one */
+uint8_t CPU6502_inc(struct CPU6502 *cpu)
+{
+  uint8_t result;
+
+  CPU6502_fetchModify(cpu);
+  result = cpu->fetched + 1;
+  log_debug("INC <0x%04x> to <0x%02x>", cpu->addr_abs, result);
+
+  CPU6502_writeBack(cpu, result);
+  CPU6502_setNZ(cpu, result);
+  return 0;
+}
+
+/* Increment X register by one */
+uint8_t CPU6502_inx(struct CPU6502 *cpu)
+{
+  cpu->Reg.X++;
+  log_debug("INX Increment X to <0x%02x>", cpu->Reg.X);
+  CPU6502_setNZ(cpu, cpu->Reg.X);
+  return 0;
+}
+
+/* Increment Y register by one */
+uint8_t CPU6502_iny(struct CPU6502 *cpu)
+{
+  cpu->Reg.Y++;
+  log_debug("INY Increment Y to <0x%02x>", cpu->Reg.Y);
+  CPU6502_setNZ(cpu, cpu->Reg.Y);
+  return 0;
+}
+
+/* Jump to new location */
+uint8_t CPU6502_jmp(struct CPU6502 *cpu)
+{
+  log_debug("JMP to address <0x%04x>", cpu->addr_abs);
+  cpu->Reg.PC = cpu->addr_abs;
+  if(cpu->Reg.PC_old == cpu->addr_abs)
+  {
+    CPU6502_idle(cpu, cpu->cycles);
+  }
+  return 0;
+}
+
+/* Jump to new location saving return */
+uint8_t CPU6502_jsr(struct CPU6502 *cpu)
+{
+  cpu->Reg.PC--;
+
+  /* The exact core reads the high address byte before the pushes where
+   * the 6502 reads it last; the number of bus cycles is the same */
+  CPU6502_dummyRead(cpu, 0x0100 + cpu->Reg.SP);
+
+  CPU6502_write(cpu, 0x0100 + cpu->Reg.SP, (cpu->Reg.PC >> 8) & 0x00FF);
+  cpu->Reg.SP--;
+  CPU6502_write(cpu, 0x0100 + cpu->Reg.SP, cpu->Reg.PC & 0x00FF);
+  cpu->Reg.SP--;
+
+  log_debug("JSR Jump to subroutine at <0x%04x>", cpu->addr_abs);
+
+  cpu->Reg.PC = cpu->addr_abs;
+  return 0;
+}
+
+/* Load accumulator with memory */
+uint8_t CPU6502_lda(struct CPU6502 *cpu)
+{
+  CPU6502_fetch(cpu);
+  cpu->Reg.A = cpu->fetched;
+
+  log_debug("LDA Load <0x%02x> from addr <0x%04x> into A", cpu->Reg.A, cpu->addr_abs);
+
+  CPU6502_setNZ(cpu, cpu->Reg.A);
+  return 1;
+}
+
+/* Load X register with memory */
+uint8_t CPU6502_ldx(struct CPU6502 *cpu)
+{
+  CPU6502_fetch(cpu);
+  cpu->Reg.X = cpu->fetched;
+
+  log_debug("LDX Load <0x%02x> from addr <0x%04x> into X", cpu->Reg.X, cpu->addr_abs);
+
+  CPU6502_setNZ(cpu, cpu->Reg.X);
+  return 1;
+}
+
+/* Load Y register with memory */
+uint8_t CPU6502_ldy(struct CPU6502 *cpu)
+{
+  CPU6502_fetch(cpu);
+  cpu->Reg.Y = cpu->fetched;
+
+  log_debug("LDY Load <0x%02x> from addr <0x%04x> into Y", cpu->Reg.Y, cpu->addr_abs);
+
+  CPU6502_setNZ(cpu, cpu->Reg.Y);
+  return 1;
+}
+
+/* Logical shift one CPU6502_bit right memory or accumulator */
+uint8_t CPU6502_lsr(struct CPU6502 *cpu)
+{
+  uint8_t result;
+
+  CPU6502_fetchModify(cpu);
+  result = cpu->fetched >> 1;
+  log_debug("LSR <0x%02x> -> <0x%02x>", cpu->fetched, result);
+
+  CPU6502_setShiftFlags(cpu, result, cpu->fetched & 0x01);
+  CPU6502_writeBack(cpu, result);
+  return 0;
+}
+
+/* No operation */
+uint8_t CPU6502_nop(struct CPU6502 *cpu)
+{
+  return 0;
+}
+
+/* Or memory with accumulator */
+uint8_t CPU6502_ora(struct CPU6502 *cpu)
+{
+  CPU6502_fetch(cpu);
+  log_debug("ORA <0x%02x> with A <0x%02x>", cpu->fetched, cpu->Reg.A);
+  cpu->Reg.A |= cpu->fetched;
+  CPU6502_setNZ(cpu, cpu->Reg.A);
+  return 1;
+}
+
+/* Push accumulator on stack */
+uint8_t CPU6502_pha(struct CPU6502 *cpu)
+{
+  uint16_t addr = 0x0100 + cpu->Reg.SP;
+
+  log_debug("PHA Push A <0x%02x> to STACK <0x%04x>", cpu->Reg.A, addr);
+
+  CPU6502_write(cpu, addr, cpu->Reg.A);
+
+  cpu->Reg.SP--;
+
+  return 0;
+}
+
+/* Push processor status on stack */
+uint8_t CPU6502_php(struct CPU6502 *cpu)
+{
+  uint16_t addr = 0x0100 + cpu->Reg.SP;
+  uint8_t data = 0x00;
+
+  cpu->Reg.BRK = 1;
+  cpu->Reg.NU = 1;
+
+  data = cpu->Reg.PSR;
+
+  log_debug("PHP Push PSR <0x%02x> to STACK <0x%04x>", data, addr);
+
+  CPU6502_write(cpu, addr, data);
+
+  cpu->Reg.BRK = 0;
+  cpu->Reg.NU = 0;
+
+  cpu->Reg.SP--;
+
+  return 0;
+}
+
+/* Pull accumulator from stack */
+uint8_t CPU6502_pla(struct CPU6502 *cpu)
+{
+  uint16_t addr = 0x0000;
+
+  CPU6502_dummyRead(cpu, 0x0100 + cpu->Reg.SP);
+  cpu->Reg.SP++;
+  addr = 0x0100 + cpu->Reg.SP;
+  cpu->Reg.A = CPU6502_read(cpu, addr);
+
+  log_debug("PLA Pull A <0x%02x> from STACK <0x%04x>", cpu->Reg.A, addr);
+
+  CPU6502_setNZ(cpu, cpu->Reg.A);
+
+  return 0;
+}
+
+/* Pull processor status from stack */
+uint8_t CPU6502_plp(struct CPU6502 *cpu)
+{
+  uint16_t addr = 0x0000;
+
+  CPU6502_dummyRead(cpu, 0x0100 + cpu->Reg.SP);
+  cpu->Reg.SP++;
+  addr = 0x0100 + cpu->Reg.SP;
+  cpu->Reg.PSR = CPU6502_read(cpu, addr);
+
+  cpu->Reg.NU = 1;
+  CPU6502_updatePending(cpu);
+
+  log_debug("PLP Pull PSR <0x%02x> from STACK <0x%04x>", cpu->Reg.PSR, addr);
+
+  return 0;
+}
+
+/* Rotate one CPU6502_bit left memory or accumulator */
+uint8_t CPU6502_rol(struct CPU6502 *cpu)
+{
+  uint8_t result;
+
+  CPU6502_fetchModify(cpu);
+  result = (cpu->fetched << 1) | cpu->Reg.CARRY;
+  log_debug("ROL <0x%02x> -> <0x%02x>", cpu->fetched, result);
+
+  CPU6502_setShiftFlags(cpu, result, cpu->fetched >> 7);
+  CPU6502_writeBack(cpu, result);
+  return 0;
+}
+
+/* Rotate one CPU6502_bit right memory or accumulator */
+uint8_t CPU6502_ror(struct CPU6502 *cpu)
+{
+  uint8_t result;
+
+  CPU6502_fetchModify(cpu);
+  result = (cpu->fetched >> 1) | (cpu->Reg.CARRY << 7);
+  log_debug("ROR <0x%02x> -> <0x%02x>", cpu->fetched, result);
+
+  CPU6502_setShiftFlags(cpu, result, cpu->fetched & 0x01);
+  CPU6502_writeBack(cpu, result);
+  return 0;
+}
+
+/* Return from interrupt */
+uint8_t CPU6502_rti(struct CPU6502 *cpu)
+{
+  CPU6502_dummyRead(cpu, 0x0100 + cpu->Reg.SP);
+  cpu->Reg.PSR = CPU6502_pull(cpu);
+  cpu->Reg.NU = 1;
+  CPU6502_updatePending(cpu);
+
+  cpu->Reg.PC = (uint16_t)CPU6502_pull(cpu);
+  cpu->Reg.PC |= (uint16_t)CPU6502_pull(cpu) << 8;
+
+  log_debug("RTI Return from interrupt to <0x%04x>", cpu->Reg.PC);
+
+  return 0;
+}
+
+/* Return from subroutine */
+uint8_t CPU6502_rts(struct CPU6502 *cpu)
+{
+  CPU6502_dummyRead(cpu, 0x0100 + cpu->Reg.SP);
+  cpu->Reg.SP++;
+  cpu->Reg.PC = (uint16_t)CPU6502_read(cpu, 0x0100 + cpu->Reg.SP);
+  cpu->Reg.SP++;
+  cpu->Reg.PC |= (uint16_t)CPU6502_read(cpu, 0x0100 + cpu->Reg.SP) << 8;
+
+  CPU6502_dummyRead(cpu, cpu->Reg.PC);
+  cpu->Reg.PC++;
+
+  log_debug("RTS Return from subroutine to <0x%04x>", cpu->Reg.PC);
+
+  return 0;
+}
+
+/* Substract memory from accumulator with borrow (carry) */
+uint8_t CPU6502_sbc(struct CPU6502 *cpu)
+{
+  CPU6502_fetch(cpu);
+
+  log_debug("SBC <0x%02x> from A <0x%02x> (C: <0x%02x>)", cpu->fetched, cpu->Reg.A, cpu->Reg.CARRY);
+
+  CPU6502_aluSbc(cpu, cpu->fetched);
+
+  return 1;
+}
+
+/* Set carry */
+uint8_t CPU6502_sec(struct CPU6502 *cpu)
+{
+  log_debug("SEC Set Carry Flag");
+  cpu->Reg.CARRY = 1;
+  return 0;
+}
+
+/* Set CPU6502_decimal mode */
+uint8_t CPU6502_sed(struct CPU6502 *cpu)
+{
+  log_debug("SED Set Decimal Mode");
+  cpu->Reg.DECIMAL = 1;
+  return 0;
+}
+
+/* Set interrupt flag */
+uint8_t CPU6502_sei(struct CPU6502 *cpu)
+{
+  log_debug("SEI Set Interrupt Disable Flag");
+  cpu->Reg.IRQB = 1;
+  CPU6502_updatePending(cpu);
+  return 0;
+}
+
+/* Store accumulator in memory */
+uint8_t CPU6502_sta(struct CPU6502 *cpu)
+{
+  log_debug("STA Store content from A <0x%02x> to addr <0x%04x>", cpu->Reg.A, cpu->addr_abs);
+
+  CPU6502_dummyIndexed(cpu, 1);
+  CPU6502_write(cpu, cpu->addr_abs, cpu->Reg.A);
+  return 0;
+}
+
+/* Store X register in memory */
+uint8_t CPU6502_stx(struct CPU6502 *cpu)
+{
+  log_debug("STX Store content from X <0x%02x> to addr <0x%04x>", cpu->Reg.X, cpu->addr_abs);
+
+  CPU6502_dummyIndexed(cpu, 1);
+  CPU6502_write(cpu, cpu->addr_abs, cpu->Reg.X);
+  return 0;
+}
+
+/* Store Y register in memory */
+uint8_t CPU6502_sty(struct CPU6502 *cpu)
+{
+  log_debug("STY Store content from Y <0x%02x> to addr <0x%04x>", cpu->Reg.Y, cpu->addr_abs);
+
+  CPU6502_dummyIndexed(cpu, 1);
+  CPU6502_write(cpu, cpu->addr_abs, cpu->Reg.Y);
+  return 0;
+}
+
+/* Transfer the accumulator to the X register */
+uint8_t CPU6502_tax(struct CPU6502 *cpu)
+{
+  cpu->Reg.X = cpu->Reg.A;
+  log_debug("TAX Transfer <0x%02x>", cpu->Reg.X);
+  CPU6502_setNZ(cpu, cpu->Reg.X);
+  return 0;
+}
+
+/* Transfer the accumulator to the Y register */
+uint8_t CPU6502_tay(struct CPU6502 *cpu)
+{
+  cpu->Reg.Y = cpu->Reg.A;
+  log_debug("TAY Transfer <0x%02x>", cpu->Reg.Y);
+  CPU6502_setNZ(cpu, cpu->Reg.Y);
+  return 0;
+}
+
+/* Transfer the stack pointer to the Y register */
+uint8_t CPU6502_tsx(struct CPU6502 *cpu)
+{
+  cpu->Reg.X = cpu->Reg.SP;
+  log_debug("TSX Transfer <0x%02x>", cpu->Reg.X);
+  CPU6502_setNZ(cpu, cpu->Reg.X);
+  return 0;
+}
+
+/* Transfer the X register the accumulator */
+uint8_t CPU6502_txa(struct CPU6502 *cpu)
+{
+  cpu->Reg.A = cpu->Reg.X;
+  log_debug("TXA Transfer <0x%02x>", cpu->Reg.A);
+  CPU6502_setNZ(cpu, cpu->Reg.A);
+  return 0;
+}
+
+/* Transfer the X register the stack pointer */
+uint8_t CPU6502_txs(struct CPU6502 *cpu)
+{
+  cpu->Reg.SP = cpu->Reg.X;
+  log_debug("TXS Transfer <0x%02x>", cpu->Reg.SP);
+  return 0;
+}
+
+/* Transfer the Y register the accumulator */
+uint8_t CPU6502_tya(struct CPU6502 *cpu)
+{
+  cpu->Reg.A = cpu->Reg.Y;
+  log_debug("TYA Transfer <0x%02x>", cpu->Reg.A);
+  CPU6502_setNZ(cpu, cpu->Reg.A);
+  return 0;
+}
+
+/* Illegal OpCode */
+uint8_t CPU6502_xxx(struct CPU6502 *cpu)
+{
+  return 0;
+}
@@ -0,0 +1,251 @@
+/*
+ * Copyright (c) 2022, Bernd Bauer <bernd.bauer@gmx.at>
+ *
+ * SPDX-License-Identifier: BSD-2-Clause
+ */
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "util/log.h"
+
+#include "core/bus.h"
+#include "core/debug.h"
+
+#define DEBUG_BIT(map, addr)   ((map)[(addr) >> 3] & (1 << ((addr) & 7)))
+#define DEBUG_SET(map, addr)   ((map)[(addr) >> 3] |= (1 << ((addr) & 7)))
+#define DEBUG_CLEAR(map, addr) ((map)[(addr) >> 3] &= ~(1 << ((addr) & 7)))
+
+static void debug_update_hook(struct Debugger *dbg);
+
+/*----------------------------------------------------------------------------*/
+struct Debugger* debug_create(struct Bus *bus)
+{
+  struct Debugger *dbg = NULL;
+
+  log_trace("Create Debugger");
+
+  dbg = malloc(sizeof(struct Debugger));
+  if(dbg == NULL)
+  {
+    log_error("Could not allocate memory for struct Debugger");
+    return NULL;
+  }
+
+  memset(dbg, 0, sizeof(struct Debugger));
+  dbg->bus = bus;
+
+  return dbg;
+}
+
+/*----------------------------------------------------------------------------*/
+void debug_destroy(struct Debugger **dbg)
+{
+  if(*dbg)
+  {
+    free(*dbg);
+    *dbg = NULL;
+  }
+}
+
+/*----------------------------------------------------------------------------*/
+int debug_break_set(struct Debugger *dbg, uint16_t pc)
+{
+  if(!DEBUG_BIT(dbg->exec, pc))
+  {
+    log_debug("Set breakpoint at 0x%04x", pc);
+    DEBUG_SET(dbg->exec, pc);
+    dbg->exec_count++;
+    debug_update_hook(dbg);
+  }
+
+  return 0;
+}
+
+/*----------------------------------------------------------------------------*/
+int debug_break_clear(struct Debugger *dbg, uint16_t pc)
+{
+  int i = 0;
+
+  for(i = 0; i < dbg->cond_count; i++)
+  {
+    if(dbg->cond[i].pc == pc)
+    {
+      dbg->cond[i] = dbg->cond[--dbg->cond_count];
+      i--;
+    }
+  }
+
+  if(DEBUG_BIT(dbg->exec, pc))
+  {
+    log_debug("Clear breakpoint at 0x%04x", pc);
+    DEBUG_CLEAR(dbg->exec, pc);
+    dbg->exec_count--;
+    debug_update_hook(dbg);
+  }
+
+  return 0;
+}
+
+/*----------------------------------------------------------------------------*/
+int debug_break_condition(struct Debugger *dbg, uint16_t pc, debug_CondFn fn, void *ctx)
+{
+  if(dbg->cond_count == DEBUG_MAX_CONDITIONS)
+  {
+    log_error("Too many conditional breakpoints");
+    return -1;
+  }
+
+  dbg->cond[dbg->cond_count].pc = pc;
+  dbg->cond[dbg->cond_count].fn = fn;
+  dbg->cond[dbg->cond_count].ctx = ctx;
+  dbg->cond_count++;
+
+  return debug_break_set(dbg, pc);
+}
+
+/*----------------------------------------------------------------------------*/
+int debug_watch_set(struct Debugger *dbg, uint16_t start, uint16_t end, uint8_t type)
+{
+  uint32_t addr = 0;
+
+  log_debug("Set watchpoint 0x%04x - 0x%04x type %d", start, end, type);
+
+  for(addr = start; addr <= end; addr++)
+  {
+    uint8_t page = addr >> BUS_PAGE_SHIFT;
+
+    if((type & DEBUG_WATCH_READ) && !DEBUG_BIT(dbg->rwatch, addr))
+    {
+      DEBUG_SET(dbg->rwatch, addr);
+      if(dbg->rcount[page]++ == 0)
+      {
+        bus_trap_read(dbg->bus, addr, 1);
+      }
+    }
+    if((type & DEBUG_WATCH_WRITE) && !DEBUG_BIT(dbg->wwatch, addr))
+    {
+      DEBUG_SET(dbg->wwatch, addr);
+      if(dbg->wcount[page]++ == 0)
+      {
+        bus_trap_write(dbg->bus, addr, 1);
+      }
+    }
+  }
+
+  return 0;
+}
+
+/*----------------------------------------------------------------------------*/
+int debug_watch_clear(struct Debugger *dbg, uint16_t start, uint16_t end, uint8_t type)
+{
+  uint32_t addr = 0;
+
+  log_debug("Clear watchpoint 0x%04x - 0x%04x type %d", start, end, type);
+
+  for(addr = start; addr <= end; addr++)
+  {
+    uint8_t page = addr >> BUS_PAGE_SHIFT;
+
+    if((type & DEBUG_WATCH_READ) && DEBUG_BIT(dbg->rwatch, addr))
+    {
+      DEBUG_CLEAR(dbg->rwatch, addr);
+      if(--dbg->rcount[page] == 0)
+      {
+        bus_trap_read(dbg->bus, addr, 0);
+      }
+    }
+    if((type & DEBUG_WATCH_WRITE) && DEBUG_BIT(dbg->wwatch, addr))
+    {
+      DEBUG_CLEAR(dbg->wwatch, addr);
+      if(--dbg->wcount[page] == 0)
+      {
+        bus_trap_write(dbg->bus, addr, 0);
+      }
+    }
+  }
+
+  return 0;
+}
+
+/*----------------------------------------------------------------------------*/
+int debug_hook(struct Debugger *dbg, uint16_t pc, uint8_t resumed)
+{
+  int i = 0;
+  int conditional = 0;
+
+  if(resumed || !DEBUG_BIT(dbg->exec, pc))
+  {
+    return 0;
+  }
+
+  for(i = 0; i < dbg->cond_count; i++)
+  {
+    if(dbg->cond[i].pc == pc)
+    {
+      conditional = 1;
+      if(dbg->cond[i].fn(dbg->bus->cpu, dbg->cond[i].ctx))
+      {
+        conditional = 0;
+        break;
+      }
+    }
+  }
+
+  if(conditional)
+  {
+    return 0;
+  }
+
+  log_debug("Breakpoint at 0x%04x", pc);
+  dbg->hit = DEBUG_HIT_BREAK;
+  dbg->hit_addr = pc;
+  bus_stop(dbg->bus, BUS_STOP_BREAKPOINT);
+
+  return 1;
+}
+
+/*----------------------------------------------------------------------------*/
+int debug_read(struct Debugger *dbg, uint16_t addr)
+{
+  if(!DEBUG_BIT(dbg->rwatch, addr))
+  {
+    return 0;
+  }
+
+  log_debug("Read watchpoint at 0x%04x", addr);
+  dbg->hit = DEBUG_HIT_READ;
+  dbg->hit_addr = addr;
+  bus_stop(dbg->bus, BUS_STOP_WATCHPOINT);
+
+  return 1;
+}
+
+/*----------------------------------------------------------------------------*/
+int debug_write(struct Debugger *dbg, uint16_t addr, uint8_t data)
+{
+  if(!DEBUG_BIT(dbg->wwatch, addr))
+  {
+    return 0;
+  }
+
+  log_debug("Write watchpoint at 0x%04x data 0x%02x", addr, data);
+  dbg->hit = DEBUG_HIT_WRITE;
+  dbg->hit_addr = addr;
+  bus_stop(dbg->bus, BUS_STOP_WATCHPOINT);
+
+  return 1;
+}
+
+/*----------------------------------------------------------------------------*/
+static void debug_update_hook(struct Debugger *dbg)
+{
+  if(dbg->exec_count != 0)
+  {
+    dbg->bus->cpu->hooks |= CPU6502_HOOK_DEBUG;
+  }
+  else
+  {
+    dbg->bus->cpu->hooks &= ~CPU6502_HOOK_DEBUG;
+  }
+}
@@ -0,0 +1,220 @@
+/*
+ * Copyright (c) 2022, Bernd Bauer <bernd.bauer@gmx.at>
+ *
+ * SPDX-License-Identifier: BSD-2-Clause
+ */
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "util/log.h"
+
+#include "core/bus.h"
+#include "core/device.h"
+
+static void device_index(struct Bus *bus, uint16_t start, uint16_t end);
+static void device_trap(struct Device *dev, uint8_t enable);
+static void device_event(void *ctx, uint64_t when);
+
+/*----------------------------------------------------------------------------*/
+struct Device* device_attach(struct Bus *bus, uint16_t start, uint16_t end, const struct DeviceOps *ops, void *ctx)
+{
+  struct Device *dev = NULL;
+  struct Device *prev = NULL;
+  struct Device **link = &bus->devices;
+
+  if(start > end || ops == NULL || ops->write == NULL)
+  {
+    log_error("Invalid device 0x%04x - 0x%04x", start, end);
+    return NULL;
+  }
+
+  /* Keep the list sorted and free of overlaps */
+  while(*link != NULL && (*link)->start < start)
+  {
+    prev = *link;
+    link = &(*link)->next;
+  }
+  if((prev != NULL && prev->end >= start) || (*link != NULL && (*link)->start <= end))
+  {
+    log_error("Device %s at 0x%04x - 0x%04x overlaps another device", ops->name, start, end);
+    return NULL;
+  }
+
+  log_info("Attach device %s at 0x%04x - 0x%04x", ops->name, start, end);
+
+  dev = malloc(sizeof(struct Device));
+  if(dev == NULL)
+  {
+    log_error("Could not allocate memory for struct Device");
+    return NULL;
+  }
+
+  dev->bus = bus;
+  dev->ops = ops;
+  dev->ctx = ctx;
+  dev->start = start;
+  dev->end = end;
+  dev->event = -1;
+  dev->synced = CPU6502_now(bus->cpu);
+  dev->next = *link;
+  *link = dev;
+
+  device_index(bus, start, end);
+  device_trap(dev, 1);
+
+  return dev;
+}
+
+/*----------------------------------------------------------------------------*/
+int device_detach(struct Device **dev)
+{
+  if(*dev != NULL)
+  {
+    struct Device *d = *dev;
+    struct Device **link = &d->bus->devices;
+
+    log_info("Detach device %s", d->ops->name);
+
+    device_cancel(d);
+
+    while(*link != NULL && *link != d)
+    {
+      link = &(*link)->next;
+    }
+    if(*link == d)
+    {
+      *link = d->next;
+    }
+
+    device_index(d->bus, d->start, d->end);
+    device_trap(d, 0);
+
+    free(d);
+    *dev = NULL;
+  }
+
+  return 0;
+}
+
+/*----------------------------------------------------------------------------*/
+int device_schedule(struct Device *dev, uint64_t when)
+{
+  if(dev->ops->tick == NULL)
+  {
+    log_error("Device %s has no tick callback", dev->ops->name);
+    return -1;
+  }
+
+  device_cancel(dev);
+  dev->event = scheduler_add(dev->bus->sched, when, device_event, dev);
+
+  return dev->event < 0 ? -1 : 0;
+}
+
+/*----------------------------------------------------------------------------*/
+int device_cancel(struct Device *dev)
+{
+  if(dev->event >= 0)
+  {
+    scheduler_cancel(dev->bus->sched, dev->event);
+    dev->event = -1;
+  }
+
+  return 0;
+}
+
+/*----------------------------------------------------------------------------*/
+int device_sync(struct Device *dev, uint64_t now)
+{
+  /* Time only moves forward, an access after the event time may have
+   * synchronized past it already */
+  if(now > dev->synced)
+  {
+    if(dev->ops->sync != NULL)
+    {
+      dev->ops->sync(dev->ctx, dev->synced, now);
+    }
+    dev->synced = now;
+  }
+
+  return 0;
+}
+
+/*----------------------------------------------------------------------------*/
+struct Device* device_find(struct Bus *bus, uint16_t addr)
+{
+  struct Device *dev = bus->dev[addr >> BUS_PAGE_SHIFT];
+
+  while(dev != NULL && dev->start <= addr)
+  {
+    if(addr <= dev->end)
+    {
+      return dev;
+    }
+    dev = dev->next;
+  }
+
+  return NULL;
+}
+
+/*----------------------------------------------------------------------------*/
+struct Device* device_lookup(struct Bus *bus, const char *name)
+{
+  struct Device *dev = NULL;
+
+  for(dev = bus->devices; dev != NULL; dev = dev->next)
+  {
+    if(strcmp(dev->ops->name, name) == 0)
+    {
+      return dev;
+    }
+  }
+
+  return NULL;
+}
+
+/*----------------------------------------------------------------------------*/
+static void device_index(struct Bus *bus, uint16_t start, uint16_t end)
+{
+  int page = 0;
+
+  /* Per page the first device reaching into it, device_find() walks on */
+  for(page = start >> BUS_PAGE_SHIFT; page <= end >> BUS_PAGE_SHIFT; page++)
+  {
+    uint32_t first = page << BUS_PAGE_SHIFT;
+    uint32_t last = first + BUS_PAGE_MASK;
+    struct Device *dev = bus->devices;
+
+    while(dev != NULL && dev->end < first)
+    {
+      dev = dev->next;
+    }
+    bus->dev[page] = (dev != NULL && dev->start <= last) ? dev : NULL;
+  }
+}
+
+/*----------------------------------------------------------------------------*/
+static void device_trap(struct Device *dev, uint8_t enable)
+{
+  int page = 0;
+
+  for(page = dev->start >> BUS_PAGE_SHIFT; page <= dev->end >> BUS_PAGE_SHIFT; page++)
+  {
+    if(dev->ops->read != NULL)
+    {
+      bus_trap_read(dev->bus, page << BUS_PAGE_SHIFT, enable);
+    }
+    bus_trap_write(dev->bus, page << BUS_PAGE_SHIFT, enable);
+  }
+}
+
+/*----------------------------------------------------------------------------*/
+static void device_event(void *ctx, uint64_t when)
+{
+  struct Device *dev = ctx;
+
+  dev->event = -1;
+  device_sync(dev, when);
+  dev->ops->tick(dev->ctx, when);
+}
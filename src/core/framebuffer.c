@@ -0,0 +1,431 @@
+/*
+ * Copyright (c) 2022, Bernd Bauer <bernd.bauer@gmx.at>
+ *
+ * SPDX-License-Identifier: BSD-2-Clause
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+
+#include "util/log.h"
+
+#include "core/bus.h"
+#include "core/device.h"
+#include "core/offload.h"
+#include "core/framebuffer.h"
+
+static uint8_t framebuffer_read(void *ctx, uint16_t offset);
+static void framebuffer_write(void *ctx, uint16_t offset, uint8_t data);
+static void framebuffer_tick(void *ctx, uint64_t now);
+static void framebuffer_reset(void *ctx);
+static void framebuffer_release(void *ctx);
+
+static void framebuffer_backend_write(void *ctx, uint64_t when, uint16_t offset, uint8_t data);
+static void framebuffer_backend_advance(void *ctx, uint64_t when);
+
+static void framebuffer_palette(struct Framebuffer *fb);
+static int framebuffer_convert(struct Framebuffer *fb);
+static void framebuffer_line(struct Framebuffer *fb, uint16_t y);
+static int framebuffer_frame(struct Framebuffer *fb);
+static int framebuffer_pattern(const char *output);
+
+static const struct DeviceOps framebuffer_ops = {
+  .name = "framebuffer",
+  .read = framebuffer_read,
+  .write = framebuffer_write,
+  .peek = framebuffer_read,
+  .tick = framebuffer_tick,
+  .reset = framebuffer_reset,
+  .destroy = framebuffer_release
+};
+
+static const struct OffloadOps framebuffer_backend_ops = {
+  .name = "framebuffer",
+  .write = framebuffer_backend_write,
+  .advance = framebuffer_backend_advance
+};
+
+/*----------------------------------------------------------------------------*/
+struct Framebuffer* framebuffer_create(struct Bus *bus, uint16_t start, uint16_t width, uint16_t height, uint8_t bpp,
+                                       const char *output, uint64_t interval, uint64_t max_lag)
+{
+  struct Framebuffer *fb = NULL;
+  const char *ext = NULL;
+  uint32_t pitch = ((uint32_t)width * bpp + 7) / 8;
+
+  if((bpp != 1 && bpp != 2 && bpp != 4 && bpp != 8) || width == 0 || height == 0 ||
+     pitch * height > 0x10000 - start || interval == 0)
+  {
+    log_error("Invalid framebuffer of %ux%u with %u bits per pixel at 0x%04x", width, height, bpp, start);
+    return NULL;
+  }
+
+  fb = calloc(1, sizeof(struct Framebuffer));
+  if(fb == NULL)
+  {
+    log_error("Could not allocate memory for struct Framebuffer");
+    return NULL;
+  }
+
+  fb->bus = bus;
+  fb->width = width;
+  fb->height = height;
+  fb->bpp = bpp;
+  fb->pitch = pitch;
+  fb->size = pitch * height;
+  fb->interval = interval;
+
+  fb->vram = calloc(fb->size, 1);
+  fb->shadow = calloc(fb->size, 1);
+  fb->rgba = calloc((size_t)width * height, 4);
+  fb->dirty = calloc((height + 31) / 32, sizeof(uint32_t));
+  if(fb->vram == NULL || fb->shadow == NULL || fb->rgba == NULL || fb->dirty == NULL)
+  {
+    log_error("Could not allocate memory for framebuffer of %ux%u", width, height);
+    framebuffer_destroy(&fb);
+    return NULL;
+  }
+
+  /* Everything is converted once, the host buffer starts out valid */
+  framebuffer_palette(fb);
+  memset(fb->dirty, 0xFF, (height + 31) / 32 * sizeof(uint32_t));
+  fb->pending = 1;
+  framebuffer_convert(fb);
+
+  if(output != NULL)
+  {
+    ext = strrchr(output, '.');
+    fb->format = ext != NULL && strcmp(ext, ".ppm") == 0 ? FRAMEBUFFER_OUTPUT_PPM : FRAMEBUFFER_OUTPUT_RAW;
+    fb->output = strdup(output);
+    if(fb->output == NULL || (fb->format == FRAMEBUFFER_OUTPUT_PPM && framebuffer_pattern(output) != 0))
+    {
+      log_error("Invalid framebuffer output %s", output);
+      framebuffer_destroy(&fb);
+      return NULL;
+    }
+    if(fb->format == FRAMEBUFFER_OUTPUT_RAW && (fb->fp = fopen(output, "wb")) == NULL)
+    {
+      log_error("Could not open framebuffer output %s: %s", output, strerror(errno));
+      framebuffer_destroy(&fb);
+      return NULL;
+    }
+  }
+
+  fb->off = offload_create(&framebuffer_backend_ops, fb, OFFLOAD_QUEUE, max_lag);
+  if(fb->off == NULL)
+  {
+    framebuffer_destroy(&fb);
+    return NULL;
+  }
+
+  fb->dev = device_attach(bus, start, start + fb->size - 1, &framebuffer_ops, fb);
+  if(fb->dev == NULL)
+  {
+    framebuffer_destroy(&fb);
+    return NULL;
+  }
+
+  log_info("Create framebuffer of %ux%u with %u bits per pixel at 0x%04x%s%s", width, height, bpp, start,
+           output != NULL ? " to " : "", output != NULL ? output : "");
+
+  return fb;
+}
+
+/*----------------------------------------------------------------------------*/
+void framebuffer_destroy(struct Framebuffer **fb)
+{
+  if(*fb)
+  {
+    struct Framebuffer *f = *fb;
+
+    /* The last change is not lost to a frame that never came, the back
+     * end is done once the offload is gone */
+    if(f->booked)
+    {
+      offload_advance(f->off, CPU6502_now(f->bus->cpu));
+    }
+    offload_destroy(&f->off);
+    device_detach(&f->dev);
+
+    if(f->fp != NULL)
+    {
+      fclose(f->fp);
+    }
+    free(f->output);
+    free(f->dirty);
+    free(f->rgba);
+    free(f->shadow);
+    free(f->vram);
+
+    free(f);
+    *fb = NULL;
+  }
+}
+
+/*----------------------------------------------------------------------------*/
+int framebuffer_render(struct Framebuffer *fb)
+{
+  /* The host buffer is only valid once the back end caught up */
+  offload_sync(fb->off);
+
+  return framebuffer_convert(fb);
+}
+
+/*----------------------------------------------------------------------------*/
+int framebuffer_save(struct Framebuffer *fb, const char *filename)
+{
+  uint8_t *row = NULL;
+  FILE *fp = NULL;
+  uint32_t x = 0;
+  uint32_t y = 0;
+  int ret = 0;
+
+  row = malloc((size_t)fb->width * 3);
+  if(row == NULL)
+  {
+    log_error("Could not allocate memory for framebuffer row");
+    return -1;
+  }
+
+  fp = fopen(filename, "wb");
+  if(fp == NULL)
+  {
+    log_error("Could not open %s: %s", filename, strerror(errno));
+    free(row);
+    return -1;
+  }
+
+  fprintf(fp, "P6\n%u %u\n255\n", fb->width, fb->height);
+  for(y = 0; y < fb->height && ret == 0; y++)
+  {
+    const uint8_t *src = fb->rgba + (size_t)y * fb->width * 4;
+
+    for(x = 0; x < fb->width; x++)
+    {
+      memcpy(row + x * 3, src + x * 4, 3);
+    }
+    if(fwrite(row, 3, fb->width, fp) != fb->width)
+    {
+      ret = -1;
+    }
+  }
+
+  if(fclose(fp) != 0 || ret != 0)
+  {
+    log_error("Could not write %s", filename);
+    ret = -1;
+  }
+  free(row);
+
+  return ret;
+}
+
+/*----------------------------------------------------------------------------*/
+static uint8_t framebuffer_read(void *ctx, uint16_t offset)
+{
+  struct Framebuffer *fb = ctx;
+
+  return fb->vram[offset];
+}
+
+/*----------------------------------------------------------------------------*/
+static void framebuffer_write(void *ctx, uint16_t offset, uint8_t data)
+{
+  struct Framebuffer *fb = ctx;
+
+  /* Redrawing the same pixels changes nothing */
+  if(fb->vram[offset] == data)
+  {
+    return;
+  }
+  fb->vram[offset] = data;
+  offload_write(fb->off, fb->dev->synced, offset, data);
+
+  /* The first change after a frame books the next one */
+  if(!fb->booked && fb->format != FRAMEBUFFER_OUTPUT_NONE)
+  {
+    fb->booked = 1;
+    device_schedule(fb->dev, (fb->dev->synced / fb->interval + 1) * fb->interval);
+  }
+}
+
+/*----------------------------------------------------------------------------*/
+static void framebuffer_tick(void *ctx, uint64_t now)
+{
+  struct Framebuffer *fb = ctx;
+
+  fb->booked = 0;
+  offload_advance(fb->off, now);
+}
+
+/*----------------------------------------------------------------------------*/
+static void framebuffer_reset(void *ctx)
+{
+  struct Framebuffer *fb = ctx;
+
+  /* Video memory survives the reset, the clock restarts at zero */
+  device_cancel(fb->dev);
+  if(fb->booked)
+  {
+    device_schedule(fb->dev, fb->interval);
+  }
+}
+
+/*----------------------------------------------------------------------------*/
+static void framebuffer_release(void *ctx)
+{
+  struct Framebuffer *fb = ctx;
+
+  framebuffer_destroy(&fb);
+}
+
+/*----------------------------------------------------------------------------*/
+static void framebuffer_backend_write(void *ctx, uint64_t when, uint16_t offset, uint8_t data)
+{
+  struct Framebuffer *fb = ctx;
+  uint16_t y = offset / fb->pitch;
+
+  fb->shadow[offset] = data;
+  fb->dirty[y / 32] |= 1u << (y % 32);
+  fb->pending = 1;
+}
+
+/*----------------------------------------------------------------------------*/
+static void framebuffer_backend_advance(void *ctx, uint64_t when)
+{
+  struct Framebuffer *fb = ctx;
+
+  /* Only frame boundaries are queued */
+  framebuffer_convert(fb);
+  framebuffer_frame(fb);
+}
+
+/*----------------------------------------------------------------------------*/
+static void framebuffer_palette(struct Framebuffer *fb)
+{
+  uint32_t levels = (1u << fb->bpp) - 1;
+  uint32_t i = 0;
+
+  for(i = 0; i <= levels; i++)
+  {
+    if(fb->bpp == 8)
+    {
+      fb->palette[i][0] = (i >> 5) * 255 / 7;
+      fb->palette[i][1] = ((i >> 2) & 7) * 255 / 7;
+      fb->palette[i][2] = (i & 3) * 255 / 3;
+    }
+    else
+    {
+      fb->palette[i][0] = i * 255 / levels;
+      fb->palette[i][1] = i * 255 / levels;
+      fb->palette[i][2] = i * 255 / levels;
+    }
+  }
+}
+
+/*----------------------------------------------------------------------------*/
+static int framebuffer_convert(struct Framebuffer *fb)
+{
+  uint32_t words = (fb->height + 31) / 32;
+  uint32_t i = 0;
+  int lines = 0;
+
+  if(!fb->pending)
+  {
+    return 0;
+  }
+
+  for(i = 0; i < words; i++)
+  {
+    while(fb->dirty[i] != 0)
+    {
+      uint16_t y = i * 32 + __builtin_ctz(fb->dirty[i]);
+
+      fb->dirty[i] &= fb->dirty[i] - 1;
+      if(y < fb->height)
+      {
+        framebuffer_line(fb, y);
+        lines++;
+      }
+    }
+  }
+
+  fb->pending = 0;
+  fb->converted += lines;
+
+  return lines;
+}
+
+/*----------------------------------------------------------------------------*/
+static void framebuffer_line(struct Framebuffer *fb, uint16_t y)
+{
+  const uint8_t *src = fb->shadow + (uint32_t)y * fb->pitch;
+  uint8_t *dst = fb->rgba + (size_t)y * fb->width * 4;
+  uint8_t mask = (1u << fb->bpp) - 1;
+  uint32_t x = 0;
+
+  for(x = 0; x < fb->width; x++, dst += 4)
+  {
+    uint32_t bit = x * fb->bpp;
+    uint8_t index = (src[bit >> 3] >> (8 - fb->bpp - (bit & 7))) & mask;
+
+    dst[0] = fb->palette[index][0];
+    dst[1] = fb->palette[index][1];
+    dst[2] = fb->palette[index][2];
+    dst[3] = 0xFF;
+  }
+}
+
+/*----------------------------------------------------------------------------*/
+static int framebuffer_frame(struct Framebuffer *fb)
+{
+  char name[FILENAME_MAX];
+  size_t bytes = (size_t)fb->width * fb->height * 4;
+
+  switch(fb->format)
+  {
+    case FRAMEBUFFER_OUTPUT_PPM:
+      snprintf(name, sizeof(name), fb->output, fb->frames);
+      if(framebuffer_save(fb, name) != 0)
+      {
+        return -1;
+      }
+      break;
+    case FRAMEBUFFER_OUTPUT_RAW:
+      if(fwrite(fb->rgba, 1, bytes, fb->fp) != bytes)
+      {
+        log_error("Could not write framebuffer output %s", fb->output);
+        return -1;
+      }
+      break;
+    default:
+      return 0;
+  }
+
+  log_trace("Framebuffer frame %u written", fb->frames);
+  fb->frames++;
+
+  return 0;
+}
+
+/*----------------------------------------------------------------------------*/
+static int framebuffer_pattern(const char *output)
+{
+  const char *p = strchr(output, '%');
+
+  /* At most one decimal frame number like %d or %05d, the name is a format */
+  if(p == NULL)
+  {
+    return 0;
+  }
+  for(p++; *p >= '0' && *p <= '9'; p++)
+  {
+  }
+  if(*p != 'd' || strchr(p, '%') != NULL)
+  {
+    return -1;
+  }
+
+  return 0;
+}
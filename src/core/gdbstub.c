@@ -0,0 +1,639 @@
+/*
+ * Copyright (c) 2022, Bernd Bauer <bernd.bauer@gmx.at>
+ *
+ * SPDX-License-Identifier: BSD-2-Clause
+ */
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <errno.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <arpa/inet.h>
+
+#include "util/log.h"
+
+#include "core/bus.h"
+#include "core/gdbstub.h"
+
+#define GDBSTUB_SIGTRAP 5
+#define GDBSTUB_SIGINT  2
+
+static const char hexdigits[] = "0123456789abcdef";
+
+static int gdbstub_hexval(char c);
+static size_t gdbstub_hexencode(char *dst, const uint8_t *src, size_t len);
+static size_t gdbstub_hexdecode(uint8_t *dst, const char *src, size_t len);
+static int gdbstub_getc(struct GdbStub *gdb);
+static int gdbstub_recv(struct GdbStub *gdb);
+static int gdbstub_send(struct GdbStub *gdb, const char *data, size_t len);
+static int gdbstub_handle(struct GdbStub *gdb);
+static int gdbstub_continue(struct GdbStub *gdb);
+static int gdbstub_step(struct GdbStub *gdb);
+static int gdbstub_stopReply(struct GdbStub *gdb, int signal);
+static int gdbstub_readRegs(struct GdbStub *gdb);
+static int gdbstub_writeRegs(struct GdbStub *gdb, const char *hex, size_t len);
+static int gdbstub_readMem(struct GdbStub *gdb, const char *args);
+static int gdbstub_writeMem(struct GdbStub *gdb, const char *args);
+static int gdbstub_point(struct GdbStub *gdb, const char *args, int insert);
+
+/*----------------------------------------------------------------------------*/
+struct GdbStub* gdbstub_create(struct Bus *bus, const char *endpoint)
+{
+  struct GdbStub *gdb = NULL;
+  char *end = NULL;
+  long port = 0;
+  int one = 1;
+
+  log_trace("Create GdbStub");
+
+  gdb = malloc(sizeof(struct GdbStub));
+  if(gdb == NULL)
+  {
+    log_error("Could not allocate memory for struct GdbStub");
+    return NULL;
+  }
+
+  gdb->bus = bus;
+  gdb->fd = -1;
+  gdb->path = NULL;
+  gdb->no_ack = 0;
+  gdb->rpos = 0;
+  gdb->rlen = 0;
+  gdb->in_len = 0;
+
+  port = strtol(endpoint, &end, 0);
+  if(*end == '\0' && port > 0 && port < 65536)
+  {
+    struct sockaddr_in addr;
+
+    gdb->listen_fd = socket(AF_INET, SOCK_STREAM, 0);
+    if(gdb->listen_fd < 0)
+    {
+      log_error("Could not create socket: %s", strerror(errno));
+      free(gdb);
+      return NULL;
+    }
+    setsockopt(gdb->listen_fd, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one));
+
+    memset(&addr, 0, sizeof(addr));
+    addr.sin_family = AF_INET;
+    addr.sin_port = htons(port);
+    addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+
+    if(bind(gdb->listen_fd, (struct sockaddr*)&addr, sizeof(addr)) != 0)
+    {
+      log_error("Could not bind to port %ld: %s", port, strerror(errno));
+      close(gdb->listen_fd);
+      free(gdb);
+      return NULL;
+    }
+  }
+  else
+  {
+    struct sockaddr_un addr;
+
+    if(strlen(endpoint) >= sizeof(addr.sun_path))
+    {
+      log_error("Socket path %s too long", endpoint);
+      free(gdb);
+      return NULL;
+    }
+
+    gdb->listen_fd = socket(AF_UNIX, SOCK_STREAM, 0);
+    if(gdb->listen_fd < 0)
+    {
+      log_error("Could not create socket: %s", strerror(errno));
+      free(gdb);
+      return NULL;
+    }
+
+    memset(&addr, 0, sizeof(addr));
+    addr.sun_family = AF_UNIX;
+    strcpy(addr.sun_path, endpoint);
+    unlink(endpoint);
+
+    if(bind(gdb->listen_fd, (struct sockaddr*)&addr, sizeof(addr)) != 0)
+    {
+      log_error("Could not bind to %s: %s", endpoint, strerror(errno));
+      close(gdb->listen_fd);
+      free(gdb);
+      return NULL;
+    }
+    gdb->path = strdup(endpoint);
+  }
+
+  if(listen(gdb->listen_fd, 1) != 0)
+  {
+    log_error("Could not listen on %s: %s", endpoint, strerror(errno));
+    gdbstub_destroy(&gdb);
+    return NULL;
+  }
+
+  log_info("GDB stub listening on %s", endpoint);
+
+  return gdb;
+}
+
+/*----------------------------------------------------------------------------*/
+void gdbstub_destroy(struct GdbStub **gdb)
+{
+  if(*gdb)
+  {
+    if((*gdb)->fd >= 0)
+    {
+      close((*gdb)->fd);
+    }
+    if((*gdb)->listen_fd >= 0)
+    {
+      close((*gdb)->listen_fd);
+    }
+    if((*gdb)->path != NULL)
+    {
+      unlink((*gdb)->path);
+      free((*gdb)->path);
+    }
+    free(*gdb);
+    *gdb = NULL;
+  }
+}
+
+/*----------------------------------------------------------------------------*/
+int gdbstub_serve(struct GdbStub *gdb)
+{
+  int one = 1;
+  int ret = 0;
+
+  log_info("Waiting for GDB connection");
+
+  gdb->fd = accept(gdb->listen_fd, NULL, NULL);
+  if(gdb->fd < 0)
+  {
+    log_error("Could not accept connection: %s", strerror(errno));
+    return -1;
+  }
+  setsockopt(gdb->fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+
+  log_info("GDB connected");
+
+  /* The target is halted until the first continue or step */
+  bus_stop(gdb->bus, BUS_STOP_REQUEST);
+
+  while((ret = gdbstub_recv(gdb)) > 0)
+  {
+    ret = gdbstub_handle(gdb);
+    if(ret != 0)
+    {
+      break;
+    }
+  }
+
+  log_info("GDB disconnected");
+  close(gdb->fd);
+  gdb->fd = -1;
+
+  return ret < 0 ? -1 : 0;
+}
+
+/*----------------------------------------------------------------------------*/
+static int gdbstub_hexval(char c)
+{
+  if(c >= '0' && c <= '9') return c - '0';
+  if(c >= 'a' && c <= 'f') return c - 'a' + 10;
+  if(c >= 'A' && c <= 'F') return c - 'A' + 10;
+  return -1;
+}
+
+/*----------------------------------------------------------------------------*/
+static size_t gdbstub_hexencode(char *dst, const uint8_t *src, size_t len)
+{
+  size_t i = 0;
+
+  for(i = 0; i < len; i++)
+  {
+    dst[i * 2] = hexdigits[src[i] >> 4];
+    dst[i * 2 + 1] = hexdigits[src[i] & 0x0f];
+  }
+
+  return len * 2;
+}
+
+/*----------------------------------------------------------------------------*/
+static size_t gdbstub_hexdecode(uint8_t *dst, const char *src, size_t len)
+{
+  size_t i = 0;
+
+  for(i = 0; i + 1 < len; i += 2)
+  {
+    int hi = gdbstub_hexval(src[i]);
+    int lo = gdbstub_hexval(src[i + 1]);
+
+    if(hi < 0 || lo < 0)
+    {
+      break;
+    }
+    dst[i / 2] = (hi << 4) | lo;
+  }
+
+  return i / 2;
+}
+
+/*----------------------------------------------------------------------------*/
+static int gdbstub_getc(struct GdbStub *gdb)
+{
+  if(gdb->rpos == gdb->rlen)
+  {
+    ssize_t n = recv(gdb->fd, gdb->rbuf, sizeof(gdb->rbuf), 0);
+    if(n <= 0)
+    {
+      return -1;
+    }
+    gdb->rpos = 0;
+    gdb->rlen = n;
+  }
+
+  return (uint8_t)gdb->rbuf[gdb->rpos++];
+}
+
+/*----------------------------------------------------------------------------*/
+static int gdbstub_recv(struct GdbStub *gdb)
+{
+  int c = 0;
+
+  for(;;)
+  {
+    uint8_t sum = 0;
+    int hi = 0;
+    int lo = 0;
+
+    /* Skip acks and anything else up to the packet start */
+    do
+    {
+      c = gdbstub_getc(gdb);
+      if(c < 0)
+      {
+        return 0;
+      }
+      if(c == 0x03)
+      {
+        /* Interrupt while halted: report the current state */
+        strcpy(gdb->in, "?");
+        gdb->in_len = 1;
+        return 1;
+      }
+    }while(c != '$');
+
+    gdb->in_len = 0;
+    while((c = gdbstub_getc(gdb)) >= 0 && c != '#')
+    {
+      if(gdb->in_len < GDBSTUB_PACKET_SIZE)
+      {
+        gdb->in[gdb->in_len++] = c;
+      }
+      sum += c;
+    }
+    gdb->in[gdb->in_len] = '\0';
+
+    if(c < 0 || (hi = gdbstub_getc(gdb)) < 0 || (lo = gdbstub_getc(gdb)) < 0)
+    {
+      return 0;
+    }
+
+    if(gdb->no_ack)
+    {
+      return 1;
+    }
+
+    if(((gdbstub_hexval(hi) << 4) | gdbstub_hexval(lo)) == sum)
+    {
+      send(gdb->fd, "+", 1, MSG_NOSIGNAL);
+      return 1;
+    }
+
+    log_warn("GDB packet checksum mismatch");
+    send(gdb->fd, "-", 1, MSG_NOSIGNAL);
+  }
+}
+
+/*----------------------------------------------------------------------------*/
+static int gdbstub_send(struct GdbStub *gdb, const char *data, size_t len)
+{
+  uint8_t sum = 0;
+  size_t i = 0;
+
+  /* Build the whole packet in one buffer and send it with one call */
+  gdb->out[0] = '$';
+  for(i = 0; i < len; i++)
+  {
+    gdb->out[i + 1] = data[i];
+    sum += (uint8_t)data[i];
+  }
+  gdb->out[len + 1] = '#';
+  gdb->out[len + 2] = hexdigits[sum >> 4];
+  gdb->out[len + 3] = hexdigits[sum & 0x0f];
+
+  if(send(gdb->fd, gdb->out, len + 4, MSG_NOSIGNAL) != (ssize_t)(len + 4))
+  {
+    log_error("Could not send GDB packet: %s", strerror(errno));
+    return -1;
+  }
+
+  return 0;
+}
+
+/*----------------------------------------------------------------------------*/
+static int gdbstub_handle(struct GdbStub *gdb)
+{
+  const char *pkt = gdb->in;
+
+  log_trace("GDB packet <%s>", pkt);
+
+  switch(pkt[0])
+  {
+    case '?':
+      return gdbstub_stopReply(gdb, GDBSTUB_SIGTRAP);
+    case 'g':
+      return gdbstub_readRegs(gdb);
+    case 'G':
+      return gdbstub_writeRegs(gdb, pkt + 1, gdb->in_len - 1);
+    case 'm':
+      return gdbstub_readMem(gdb, pkt + 1);
+    case 'M':
+      return gdbstub_writeMem(gdb, pkt + 1);
+    case 'c':
+      return gdbstub_continue(gdb);
+    case 's':
+      return gdbstub_step(gdb);
+    case 'Z':
+      return gdbstub_point(gdb, pkt + 1, 1);
+    case 'z':
+      return gdbstub_point(gdb, pkt + 1, 0);
+    case 'H':
+      return gdbstub_send(gdb, "OK", 2);
+    case 'D':
+      gdbstub_send(gdb, "OK", 2);
+      bus_resume(gdb->bus);
+      return 1;
+    case 'k':
+      bus_stop(gdb->bus, BUS_STOP_REQUEST);
+      return 1;
+    case 'q':
+      if(strncmp(pkt, "qSupported", 10) == 0)
+      {
+        char reply[64];
+        int n = snprintf(reply, sizeof(reply), "PacketSize=%x;swbreak+;hwbreak+;QStartNoAckMode+", GDBSTUB_PACKET_SIZE);
+        return gdbstub_send(gdb, reply, n);
+      }
+      if(strcmp(pkt, "qAttached") == 0)
+      {
+        return gdbstub_send(gdb, "1", 1);
+      }
+      if(strcmp(pkt, "qC") == 0)
+      {
+        return gdbstub_send(gdb, "QC1", 3);
+      }
+      break;
+    case 'Q':
+      if(strcmp(pkt, "QStartNoAckMode") == 0)
+      {
+        gdbstub_send(gdb, "OK", 2);
+        gdb->no_ack = 1;
+        return 0;
+      }
+      break;
+    default:
+      break;
+  }
+
+  /* Unsupported packet */
+  return gdbstub_send(gdb, "", 0);
+}
+
+/*----------------------------------------------------------------------------*/
+static int gdbstub_continue(struct GdbStub *gdb)
+{
+  struct Bus *bus = gdb->bus;
+
+  bus_resume(bus);
+
+  /* Run at full speed in slices and look for a break request in between */
+  while(bus->stop == BUS_RUNNING)
+  {
+    char c = 0;
+
+    bus_run(bus, GDBSTUB_RUN_SLICE);
+
+    if(recv(gdb->fd, &c, 1, MSG_DONTWAIT) == 1 && c == 0x03)
+    {
+      log_info("GDB interrupt");
+      bus_stop(bus, BUS_STOP_REQUEST);
+      return gdbstub_stopReply(gdb, GDBSTUB_SIGINT);
+    }
+  }
+
+  if(bus->stop == BUS_STOP_IDLE)
+  {
+    return gdbstub_send(gdb, "W00", 3);
+  }
+
+  return gdbstub_stopReply(gdb, GDBSTUB_SIGTRAP);
+}
+
+/*----------------------------------------------------------------------------*/
+static int gdbstub_step(struct GdbStub *gdb)
+{
+  struct Bus *bus = gdb->bus;
+  uint8_t hooks = bus->cpu->hooks;
+
+  bus_resume(bus);
+
+  /* Single steps ignore breakpoints at the current PC */
+  bus->cpu->hooks = 0;
+  CPU6502_step(bus->cpu);
+  bus->cpu->hooks = hooks;
+
+  scheduler_dispatch(bus->sched, bus->cpu->clock_count);
+  bus_stop(bus, BUS_STOP_REQUEST);
+
+  return gdbstub_stopReply(gdb, GDBSTUB_SIGTRAP);
+}
+
+/*----------------------------------------------------------------------------*/
+static int gdbstub_stopReply(struct GdbStub *gdb, int signal)
+{
+  char reply[48];
+  int n = 0;
+
+  if(gdb->bus->stop == BUS_STOP_WATCHPOINT)
+  {
+    const char *kind = gdb->bus->dbg->hit == DEBUG_HIT_READ ? "rwatch" : "watch";
+    n = snprintf(reply, sizeof(reply), "T%02x%s:%04x;", signal, kind, gdb->bus->dbg->hit_addr);
+  }
+  else if(gdb->bus->stop == BUS_STOP_BREAKPOINT)
+  {
+    n = snprintf(reply, sizeof(reply), "T%02xswbreak:;", signal);
+  }
+  else
+  {
+    n = snprintf(reply, sizeof(reply), "S%02x", signal);
+  }
+
+  return gdbstub_send(gdb, reply, n);
+}
+
+/*----------------------------------------------------------------------------*/
+static int gdbstub_readRegs(struct GdbStub *gdb)
+{
+  struct CPU6502 *cpu = gdb->bus->cpu;
+  uint8_t regs[7];
+  char reply[14];
+
+  regs[0] = cpu->Reg.A;
+  regs[1] = cpu->Reg.X;
+  regs[2] = cpu->Reg.Y;
+  regs[3] = cpu->Reg.PSR;
+  regs[4] = cpu->Reg.SP;
+  regs[5] = cpu->Reg.PCL;
+  regs[6] = cpu->Reg.PCH;
+
+  return gdbstub_send(gdb, reply, gdbstub_hexencode(reply, regs, sizeof(regs)));
+}
+
+/*----------------------------------------------------------------------------*/
+static int gdbstub_writeRegs(struct GdbStub *gdb, const char *hex, size_t len)
+{
+  struct CPU6502 *cpu = gdb->bus->cpu;
+  uint8_t regs[7];
+
+  if(gdbstub_hexdecode(regs, hex, len) != sizeof(regs))
+  {
+    return gdbstub_send(gdb, "E01", 3);
+  }
+
+  cpu->Reg.A = regs[0];
+  cpu->Reg.X = regs[1];
+  cpu->Reg.Y = regs[2];
+  cpu->Reg.PSR = regs[3];
+  cpu->Reg.SP = regs[4];
+  cpu->Reg.PCL = regs[5];
+  cpu->Reg.PCH = regs[6];
+
+  return gdbstub_send(gdb, "OK", 2);
+}
+
+/*----------------------------------------------------------------------------*/
+static int gdbstub_readMem(struct GdbStub *gdb, const char *args)
+{
+  uint8_t block[GDBSTUB_PACKET_SIZE / 2];
+  char *end = NULL;
+  unsigned long addr = strtoul(args, &end, 16);
+  unsigned long len = 0;
+
+  if(*end != ',')
+  {
+    return gdbstub_send(gdb, "E01", 3);
+  }
+  len = strtoul(end + 1, NULL, 16);
+  if(len > sizeof(block))
+  {
+    len = sizeof(block);
+  }
+
+  /* Copy the whole block first, then encode it into one reply */
+  bus_peek_block(gdb->bus, addr, block, len);
+
+  return gdbstub_send(gdb, gdb->in, gdbstub_hexencode(gdb->in, block, len));
+}
+
+/*----------------------------------------------------------------------------*/
+static int gdbstub_writeMem(struct GdbStub *gdb, const char *args)
+{
+  uint8_t block[GDBSTUB_PACKET_SIZE / 2];
+  char *end = NULL;
+  unsigned long addr = strtoul(args, &end, 16);
+  unsigned long len = 0;
+  unsigned long i = 0;
+
+  if(*end != ',')
+  {
+    return gdbstub_send(gdb, "E01", 3);
+  }
+  len = strtoul(end + 1, &end, 16);
+  if(*end != ':' || len > sizeof(block) || gdbstub_hexdecode(block, end + 1, strlen(end + 1)) != len)
+  {
+    return gdbstub_send(gdb, "E01", 3);
+  }
+
+  for(i = 0; i < len; i++)
+  {
+    bus_poke(gdb->bus, (addr + i) & 0xffff, block[i]);
+  }
+
+  return gdbstub_send(gdb, "OK", 2);
+}
+
+/*----------------------------------------------------------------------------*/
+static int gdbstub_point(struct GdbStub *gdb, const char *args, int insert)
+{
+  char *end = NULL;
+  int type = args[0] - '0';
+  unsigned long addr = 0;
+  unsigned long len = 1;
+  uint8_t watch = 0;
+
+  if(args[1] != ',')
+  {
+    return gdbstub_send(gdb, "E01", 3);
+  }
+  addr = strtoul(args + 2, &end, 16);
+  if(*end == ',')
+  {
+    len = strtoul(end + 1, NULL, 16);
+  }
+
+  switch(type)
+  {
+    case 0:
+    case 1:
+      if(insert)
+      {
+        debug_break_set(gdb->bus->dbg, addr);
+      }
+      else
+      {
+        debug_break_clear(gdb->bus->dbg, addr);
+      }
+      return gdbstub_send(gdb, "OK", 2);
+    case 2:
+      watch = DEBUG_WATCH_WRITE;
+      break;
+    case 3:
+      watch = DEBUG_WATCH_READ;
+      break;
+    case 4:
+      watch = DEBUG_WATCH_READ | DEBUG_WATCH_WRITE;
+      break;
+    default:
+      return gdbstub_send(gdb, "", 0);
+  }
+
+  if(len == 0 || addr + len > 0x10000)
+  {
+    return gdbstub_send(gdb, "E01", 3);
+  }
+
+  if(insert)
+  {
+    debug_watch_set(gdb->bus->dbg, addr, addr + len - 1, watch);
+  }
+  else
+  {
+    debug_watch_clear(gdb->bus->dbg, addr, addr + len - 1, watch);
+  }
+
+  return gdbstub_send(gdb, "OK", 2);
+}
@@ -0,0 +1,204 @@
+/*
+ * Copyright (c) 2022, Bernd Bauer <bernd.bauer@gmx.at>
+ *
+ * SPDX-License-Identifier: BSD-2-Clause
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <unistd.h>
+
+#include "util/log.h"
+
+#include "core/bus.h"
+#include "core/device.h"
+#include "core/hostcall.h"
+
+static uint8_t hostcall_read(void *ctx, uint16_t offset);
+static void hostcall_write(void *ctx, uint16_t offset, uint8_t data);
+static void hostcall_release(void *ctx);
+static void hostcall_append(struct HostCall *hc, const uint8_t *data, uint32_t len);
+
+static const struct DeviceOps hostcall_ops = {
+  .name = "hostcall",
+  .read = hostcall_read,
+  .write = hostcall_write,
+  .peek = hostcall_read,
+  .destroy = hostcall_release
+};
+
+/*----------------------------------------------------------------------------*/
+struct HostCall* hostcall_create(struct Bus *bus, uint8_t page, int fd)
+{
+  struct HostCall *hc = NULL;
+
+  log_info("Create host call page at 0x%02x00", page);
+
+  hc = malloc(sizeof(struct HostCall));
+  if(hc == NULL)
+  {
+    log_error("Could not allocate memory for struct HostCall");
+    return NULL;
+  }
+
+  hc->bus = bus;
+  hc->page = page;
+  hc->fd = fd;
+  hc->addr = 0;
+  hc->len = 0;
+  hc->exited = 0;
+  hc->exit_status = 0;
+  hc->result_count = 0;
+  hc->out_len = 0;
+
+  hc->dev = device_attach(bus, page << BUS_PAGE_SHIFT, (page << BUS_PAGE_SHIFT) | BUS_PAGE_MASK, &hostcall_ops, hc);
+  if(hc->dev == NULL)
+  {
+    free(hc);
+    return NULL;
+  }
+
+  return hc;
+}
+
+/*----------------------------------------------------------------------------*/
+void hostcall_destroy(struct HostCall **hc)
+{
+  if(*hc)
+  {
+    struct HostCall *h = *hc;
+
+    hostcall_flush(h);
+    device_detach(&h->dev);
+
+    free(h);
+    *hc = NULL;
+  }
+}
+
+/*----------------------------------------------------------------------------*/
+static uint8_t hostcall_read(void *ctx, uint16_t offset)
+{
+  struct HostCall *hc = ctx;
+
+  switch(offset)
+  {
+    case HOSTCALL_ADDRL:
+      return hc->addr & 0xff;
+    case HOSTCALL_ADDRH:
+      return hc->addr >> 8;
+    case HOSTCALL_LENL:
+      return hc->len & 0xff;
+    case HOSTCALL_LENH:
+      return hc->len >> 8;
+    default:
+      return 0;
+  }
+}
+
+/*----------------------------------------------------------------------------*/
+static void hostcall_write(void *ctx, uint16_t offset, uint8_t data)
+{
+  struct HostCall *hc = ctx;
+
+  switch(offset)
+  {
+    case HOSTCALL_PUTC:
+      if(hc->out_len == HOSTCALL_BUFFER_SIZE)
+      {
+        hostcall_flush(hc);
+      }
+      hc->out[hc->out_len++] = data;
+      break;
+    case HOSTCALL_EXIT:
+      log_info("Guest exit with status %d", data);
+      hc->exited = 1;
+      hc->exit_status = data;
+      hostcall_flush(hc);
+      bus_stop(hc->bus, BUS_STOP_EXIT);
+      break;
+    case HOSTCALL_ADDRL:
+      hc->addr = (hc->addr & 0xff00) | data;
+      break;
+    case HOSTCALL_ADDRH:
+      hc->addr = (hc->addr & 0x00ff) | (data << 8);
+      break;
+    case HOSTCALL_LENL:
+      hc->len = (hc->len & 0xff00) | data;
+      break;
+    case HOSTCALL_LENH:
+      hc->len = (hc->len & 0x00ff) | (data << 8);
+      break;
+    case HOSTCALL_WRITE:
+    {
+      uint8_t block[BUS_PAGE_SIZE];
+      uint32_t done = 0;
+
+      while(done < hc->len)
+      {
+        uint32_t chunk = hc->len - done < sizeof(block) ? hc->len - done : sizeof(block);
+
+        bus_peek_block(hc->bus, hc->addr + done, block, chunk);
+        hostcall_append(hc, block, chunk);
+        done += chunk;
+      }
+      break;
+    }
+    case HOSTCALL_RESULT:
+      log_debug("Guest result %d: 0x%02x", hc->result_count, data);
+      if(hc->result_count < HOSTCALL_MAX_RESULTS)
+      {
+        hc->results[hc->result_count++] = data;
+      }
+      break;
+    default:
+      log_warn("Write 0x%02x to unknown host call register 0x%02x", data, offset);
+      break;
+  }
+}
+
+/*----------------------------------------------------------------------------*/
+int hostcall_flush(struct HostCall *hc)
+{
+  uint32_t done = 0;
+
+  while(done < hc->out_len)
+  {
+    ssize_t n = write(hc->fd, hc->out + done, hc->out_len - done);
+    if(n < 0)
+    {
+      if(errno == EINTR)
+      {
+        continue;
+      }
+      log_error("Could not write guest output: %s", strerror(errno));
+      hc->out_len = 0;
+      return -1;
+    }
+    done += n;
+  }
+
+  hc->out_len = 0;
+
+  return 0;
+}
+
+/*----------------------------------------------------------------------------*/
+static void hostcall_release(void *ctx)
+{
+  struct HostCall *hc = ctx;
+
+  hostcall_destroy(&hc);
+}
+
+/*----------------------------------------------------------------------------*/
+static void hostcall_append(struct HostCall *hc, const uint8_t *data, uint32_t len)
+{
+  if(hc->out_len + len > HOSTCALL_BUFFER_SIZE)
+  {
+    hostcall_flush(hc);
+  }
+  memcpy(hc->out + hc->out_len, data, len);
+  hc->out_len += len;
+}
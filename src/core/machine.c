@@ -0,0 +1,534 @@
+/*
+ * Copyright (c) 2022, Bernd Bauer <bernd.bauer@gmx.at>
+ *
+ * SPDX-License-Identifier: BSD-2-Clause
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <ctype.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/stat.h>
+
+#include "util/log.h"
+#include "util/tools.h"
+
+#include "core/bus.h"
+#include "core/block.h"
+#include "core/framebuffer.h"
+#include "core/hostcall.h"
+#include "core/mapper.h"
+#include "core/offload.h"
+#include "core/uart.h"
+#include "core/via.h"
+#include "core/machine.h"
+
+static int machine_line(struct Bus *bus, const char *filename, char *line);
+static int machine_image(struct Memory *mem, uint32_t start, uint32_t size, const char *filename, const char *image, const char *offset);
+static void machine_path(char *path, size_t len, const char *filename, const char *image);
+static char* machine_token(char **p);
+static int machine_number(const char *token, uint32_t *value);
+static int machine_hostcall(struct Bus *bus, const char *filename, uint16_t start, uint32_t size, const char *args);
+static int machine_mapper(struct Bus *bus, const char *filename, uint16_t start, uint32_t size, const char *args);
+static int machine_via(struct Bus *bus, const char *filename, uint16_t start, uint32_t size, const char *args);
+static int machine_uart(struct Bus *bus, const char *filename, uint16_t start, uint32_t size, const char *args);
+static int machine_block(struct Bus *bus, const char *filename, uint16_t start, uint32_t size, const char *args);
+static int machine_framebuffer(struct Bus *bus, const char *filename, uint16_t start, uint32_t size, const char *args);
+
+static const struct MachineDevice machine_devices[] = {
+  { "hostcall", machine_hostcall },
+  { "mapper", machine_mapper },
+  { "via", machine_via },
+  { "uart", machine_uart },
+  { "block", machine_block },
+  { "framebuffer", machine_framebuffer }
+};
+
+/*----------------------------------------------------------------------------*/
+int machine_load(struct Bus *bus, const char *filename)
+{
+  char line[MACHINE_LINE_SIZE];
+  struct timespec t0;
+  struct timespec t1;
+  FILE *fp = NULL;
+  int lineno = 0;
+  int ret = 0;
+
+  clock_gettime(CLOCK_MONOTONIC, &t0);
+
+  fp = fopen(filename, "r");
+  if(fp == NULL)
+  {
+    log_error("Could not open machine description %s", filename);
+    return -1;
+  }
+
+  log_info("Load machine description %s", filename);
+  bus_clear_regions(bus);
+
+  while(ret == 0 && fgets(line, sizeof(line), fp) != NULL)
+  {
+    lineno++;
+    if(machine_line(bus, filename, line) != 0)
+    {
+      log_error("%s:%d: Invalid machine description", filename, lineno);
+      ret = -1;
+    }
+  }
+  fclose(fp);
+
+  clock_gettime(CLOCK_MONOTONIC, &t1);
+  log_debug("Machine mapped with %d regions in %ld us", bus->regions,
+            (long)((t1.tv_sec - t0.tv_sec) * 1000000 + (t1.tv_nsec - t0.tv_nsec) / 1000));
+
+  return ret;
+}
+
+/*----------------------------------------------------------------------------*/
+static int machine_line(struct Bus *bus, const char *filename, char *line)
+{
+  char *p = strchr(line, '#');
+  char *type = NULL;
+  char *arg[4] = { NULL, NULL, NULL, NULL };
+  uint32_t start = 0;
+  uint32_t size = 0;
+  int i = 0;
+
+  if(p != NULL)
+  {
+    *p = '\0';
+  }
+  p = line;
+
+  type = machine_token(&p);
+  if(type == NULL)
+  {
+    return 0;
+  }
+  if(machine_number(machine_token(&p), &start) != 0 ||
+     machine_number(machine_token(&p), &size) != 0 ||
+     start > 0xFFFF || size > 0x10000 - start)
+  {
+    return -1;
+  }
+
+  if(strcmp(type, "device") == 0)
+  {
+    char *name = machine_token(&p);
+    char *end = p + strlen(p);
+
+    /* Rest of the line without surrounding space goes to the device */
+    while(isspace((unsigned char)*p))
+    {
+      p++;
+    }
+    while(end > p && isspace((unsigned char)end[-1]))
+    {
+      *--end = '\0';
+    }
+
+    for(i = 0; name != NULL && i < sizeof(machine_devices) / sizeof(machine_devices[0]); i++)
+    {
+      if(strcmp(name, machine_devices[i].name) == 0)
+      {
+        return machine_devices[i].create(bus, filename, start, size, p);
+      }
+    }
+    log_error("Unknown device %s", name != NULL ? name : "");
+    return -1;
+  }
+
+  for(i = 0; i < 4; i++)
+  {
+    arg[i] = machine_token(&p);
+  }
+  if(arg[3] != NULL)
+  {
+    return -1;
+  }
+
+  if(strcmp(type, "ram") == 0 || strcmp(type, "rom") == 0)
+  {
+    uint8_t rom = strcmp(type, "rom") == 0;
+    struct Memory *mem = NULL;
+
+    if(arg[2] != NULL || (rom && arg[0] == NULL))
+    {
+      return -1;
+    }
+
+    mem = bus_add_memory(bus, rom ? BUS_REGION_ROM : BUS_REGION_RAM, start, size);
+    if(mem == NULL)
+    {
+      return -1;
+    }
+    if(arg[0] != NULL)
+    {
+      return machine_image(mem, start, size, filename, arg[0], arg[1]);
+    }
+    return 0;
+  }
+  else if(strcmp(type, "mirror") == 0)
+  {
+    uint32_t source = 0;
+
+    if(arg[1] != NULL || machine_number(arg[0], &source) != 0)
+    {
+      return -1;
+    }
+    return bus_add_mirror(bus, start, size, source);
+  }
+
+  log_error("Unknown region type %s", type);
+  return -1;
+}
+
+/*----------------------------------------------------------------------------*/
+static int machine_image(struct Memory *mem, uint32_t start, uint32_t size, const char *filename, const char *image, const char *offset)
+{
+  char path[MACHINE_LINE_SIZE * 2];
+  uint32_t off = 0;
+  uint32_t count = 0;
+  struct stat st;
+
+  if(offset != NULL && machine_number(offset, &off) != 0)
+  {
+    return -1;
+  }
+
+  machine_path(path, sizeof(path), filename, image);
+
+  if(stat(path, &st) != 0 || off >= st.st_size)
+  {
+    log_error("Could not load image %s at offset 0x%x", path, off);
+    return -1;
+  }
+
+  /* Shorter images fill the region from its start */
+  count = st.st_size - off < size ? st.st_size - off : size;
+  log_info("Load 0x%04x bytes of %s to 0x%04x", count, path, start);
+
+  return memory_loadFromFile(mem, start, path, off, count);
+}
+
+/*----------------------------------------------------------------------------*/
+static void machine_path(char *path, size_t len, const char *filename, const char *image)
+{
+  const char *dir = strrchr(filename, '/');
+
+  /* Files are relative to the description, not to the working directory */
+  if(image[0] != '/' && dir != NULL)
+  {
+    snprintf(path, len, "%.*s/%s", (int)(dir - filename), filename, image);
+  }
+  else
+  {
+    snprintf(path, len, "%s", image);
+  }
+}
+
+/*----------------------------------------------------------------------------*/
+static char* machine_token(char **p)
+{
+  char *token = NULL;
+
+  while(isspace((unsigned char)**p))
+  {
+    (*p)++;
+  }
+  if(**p == '\0')
+  {
+    return NULL;
+  }
+
+  token = *p;
+  while(**p != '\0' && !isspace((unsigned char)**p))
+  {
+    (*p)++;
+  }
+  if(**p != '\0')
+  {
+    *(*p)++ = '\0';
+  }
+
+  return token;
+}
+
+/*----------------------------------------------------------------------------*/
+static int machine_number(const char *token, uint32_t *value)
+{
+  char *end = NULL;
+  unsigned long v = 0;
+
+  if(token == NULL)
+  {
+    return -1;
+  }
+
+  v = strtoul(token, &end, 0);
+  if(end == token || *end != '\0' || v > UINT32_MAX)
+  {
+    return -1;
+  }
+  *value = v;
+
+  return 0;
+}
+
+/*----------------------------------------------------------------------------*/
+static int machine_hostcall(struct Bus *bus, const char *filename, uint16_t start, uint32_t size, const char *args)
+{
+  if((start & BUS_PAGE_MASK) != 0 || size != BUS_PAGE_SIZE)
+  {
+    log_error("The host call device takes one aligned page");
+    return -1;
+  }
+
+  return hostcall_create(bus, start >> BUS_PAGE_SHIFT, STDOUT_FILENO) != NULL ? 0 : -1;
+}
+
+/*----------------------------------------------------------------------------*/
+static int machine_mapper(struct Bus *bus, const char *filename, uint16_t start, uint32_t size, const char *args)
+{
+  char buf[MACHINE_LINE_SIZE];
+  char *p = buf;
+  char *type = NULL;
+  char *token = NULL;
+  char *image = NULL;
+  char *offset = NULL;
+  uint16_t window[MAPPER_MAX_WINDOWS];
+  uint32_t length[MAPPER_MAX_WINDOWS];
+  uint32_t total = 0;
+  struct Mapper *mapper = NULL;
+  int windows = 0;
+
+  snprintf(buf, sizeof(buf), "%s", args);
+
+  type = machine_token(&p);
+  if(type == NULL || (strcmp(type, "ram") != 0 && strcmp(type, "rom") != 0) ||
+     machine_number(machine_token(&p), &total) != 0)
+  {
+    return -1;
+  }
+
+  /* Optional image and offset before the start:size windows */
+  while((token = machine_token(&p)) != NULL)
+  {
+    char *sep = strchr(token, ':');
+    uint32_t base = 0;
+
+    if(sep == NULL && windows == 0 && image == NULL)
+    {
+      image = token;
+      continue;
+    }
+    if(sep == NULL && windows == 0 && offset == NULL)
+    {
+      offset = token;
+      continue;
+    }
+    if(sep == NULL || windows == MAPPER_MAX_WINDOWS)
+    {
+      return -1;
+    }
+
+    *sep = '\0';
+    if(machine_number(token, &base) != 0 || base > 0xFFFF || machine_number(sep + 1, &length[windows]) != 0)
+    {
+      return -1;
+    }
+    window[windows++] = base;
+  }
+
+  /* One bank register per window */
+  if(windows != size)
+  {
+    log_error("The mapper needs one register per window");
+    return -1;
+  }
+
+  mapper = mapper_create(bus, start, strcmp(type, "rom") == 0 ? BUS_REGION_ROM : BUS_REGION_RAM, total,
+                         windows, window, length);
+  if(mapper == NULL)
+  {
+    return -1;
+  }
+  if(image != NULL)
+  {
+    return machine_image(mapper->mem, 0, total, filename, image, offset);
+  }
+
+  return 0;
+}
+
+/*----------------------------------------------------------------------------*/
+static int machine_via(struct Bus *bus, const char *filename, uint16_t start, uint32_t size, const char *args)
+{
+  char buf[MACHINE_LINE_SIZE];
+  char *p = buf;
+  char *token = NULL;
+  uint32_t irq = 0;
+
+  if(size != VIA_REGISTERS)
+  {
+    log_error("The VIA takes %d registers", VIA_REGISTERS);
+    return -1;
+  }
+
+  snprintf(buf, sizeof(buf), "%s", args);
+
+  token = machine_token(&p);
+  if(token != NULL && (machine_number(token, &irq) != 0 || machine_token(&p) != NULL))
+  {
+    return -1;
+  }
+
+  return via_create(bus, start, irq) != NULL ? 0 : -1;
+}
+
+/*----------------------------------------------------------------------------*/
+static int machine_uart(struct Bus *bus, const char *filename, uint16_t start, uint32_t size, const char *args)
+{
+  char buf[MACHINE_LINE_SIZE];
+  char name[MACHINE_LINE_SIZE * 2];
+  char *p = buf;
+  char *path = NULL;
+  char *token = NULL;
+  uint32_t irq = 0;
+
+  if(size != UART_REGISTERS)
+  {
+    log_error("The UART takes %d registers", UART_REGISTERS);
+    return -1;
+  }
+
+  snprintf(buf, sizeof(buf), "%s", args);
+
+  path = machine_token(&p);
+  token = machine_token(&p);
+  if(token != NULL && (machine_number(token, &irq) != 0 || machine_token(&p) != NULL))
+  {
+    return -1;
+  }
+
+  if(path != NULL && strcmp(path, UART_PTY) != 0)
+  {
+    machine_path(name, sizeof(name), filename, path);
+    path = name;
+  }
+
+  return uart_create(bus, start, irq, path) != NULL ? 0 : -1;
+}
+
+/*----------------------------------------------------------------------------*/
+static int machine_block(struct Bus *bus, const char *filename, uint16_t start, uint32_t size, const char *args)
+{
+  char buf[MACHINE_LINE_SIZE];
+  char path[MACHINE_LINE_SIZE * 2];
+  char *p = buf;
+  char *image = NULL;
+  char *token = NULL;
+  uint32_t latency = BLOCK_LATENCY;
+  uint32_t irq = 0;
+
+  if(size != BLOCK_REGISTERS)
+  {
+    log_error("The block device takes %d registers", BLOCK_REGISTERS);
+    return -1;
+  }
+
+  snprintf(buf, sizeof(buf), "%s", args);
+
+  image = machine_token(&p);
+  if(image == NULL)
+  {
+    log_error("The block device needs a disk image");
+    return -1;
+  }
+  if((token = machine_token(&p)) != NULL && machine_number(token, &latency) != 0)
+  {
+    return -1;
+  }
+  if(token != NULL && (token = machine_token(&p)) != NULL &&
+     (machine_number(token, &irq) != 0 || machine_token(&p) != NULL))
+  {
+    return -1;
+  }
+
+  machine_path(path, sizeof(path), filename, image);
+
+  return block_create(bus, start, irq, path, latency) != NULL ? 0 : -1;
+}
+
+/*----------------------------------------------------------------------------*/
+static int machine_framebuffer(struct Bus *bus, const char *filename, uint16_t start, uint32_t size, const char *args)
+{
+  char buf[MACHINE_LINE_SIZE];
+  char path[MACHINE_LINE_SIZE * 2];
+  char *p = buf;
+  char *geometry = NULL;
+  char *output = NULL;
+  char *token = NULL;
+  char *end = NULL;
+  unsigned long width = 0;
+  unsigned long height = 0;
+  uint32_t bpp = 8;
+  uint32_t interval = FRAMEBUFFER_INTERVAL;
+  uint32_t max_lag = OFFLOAD_MAX_LAG;
+
+  snprintf(buf, sizeof(buf), "%s", args);
+
+  geometry = machine_token(&p);
+  if(geometry == NULL)
+  {
+    log_error("The framebuffer needs a <width>x<height> geometry");
+    return -1;
+  }
+  width = strtoul(geometry, &end, 0);
+  if(end == geometry || *end != 'x' || width > 0xFFFF)
+  {
+    return -1;
+  }
+  geometry = end + 1;
+  height = strtoul(geometry, &end, 0);
+  if(end == geometry || *end != '\0' || height > 0xFFFF)
+  {
+    return -1;
+  }
+
+  if((token = machine_token(&p)) != NULL && machine_number(token, &bpp) != 0)
+  {
+    return -1;
+  }
+  if(token != NULL)
+  {
+    output = machine_token(&p);
+  }
+  if(output != NULL && (token = machine_token(&p)) != NULL && machine_number(token, &interval) != 0)
+  {
+    return -1;
+  }
+  if(output != NULL && token != NULL && (token = machine_token(&p)) != NULL &&
+     (machine_number(token, &max_lag) != 0 || machine_token(&p) != NULL))
+  {
+    return -1;
+  }
+
+  /* The range covers the video memory exactly */
+  if(bpp > 8 || size != (width * bpp + 7) / 8 * height)
+  {
+    log_error("The framebuffer of %lux%lu with %u bits per pixel takes 0x%lx bytes", width, height, bpp,
+              (width * bpp + 7) / 8 * height);
+    return -1;
+  }
+
+  if(output != NULL)
+  {
+    machine_path(path, sizeof(path), filename, output);
+    output = path;
+  }
+
+  return framebuffer_create(bus, start, width, height, bpp, output, interval, max_lag) != NULL ? 0 : -1;
+}
@@ -0,0 +1,161 @@
+/*
+ * Copyright (c) 2022, Bernd Bauer <bernd.bauer@gmx.at>
+ *
+ * SPDX-License-Identifier: BSD-2-Clause
+ */
+
+#include <stdlib.h>
+
+#include "util/log.h"
+
+#include "core/bus.h"
+#include "core/device.h"
+#include "core/mapper.h"
+
+static uint8_t mapper_read(void *ctx, uint16_t offset);
+static void mapper_write(void *ctx, uint16_t offset, uint8_t data);
+static void mapper_reset(void *ctx);
+static void mapper_release(void *ctx);
+
+static const struct DeviceOps mapper_ops = {
+  .name = "mapper",
+  .read = mapper_read,
+  .write = mapper_write,
+  .peek = mapper_read,
+  .reset = mapper_reset,
+  .destroy = mapper_release
+};
+
+/*----------------------------------------------------------------------------*/
+struct Mapper* mapper_create(struct Bus *bus, uint16_t reg, uint8_t type, uint32_t size, int windows,
+                             const uint16_t *start, const uint32_t *length)
+{
+  struct Mapper *mapper = NULL;
+  int i = 0;
+
+  if(windows < 1 || windows > MAPPER_MAX_WINDOWS || reg + windows > 0x10000 || type == BUS_REGION_MIRROR)
+  {
+    log_error("Invalid mapper with %d windows at 0x%04x", windows, reg);
+    return NULL;
+  }
+
+  log_info("Create mapper with %d windows on 0x%x bytes at 0x%04x", windows, size, reg);
+
+  mapper = malloc(sizeof(struct Mapper));
+  if(mapper == NULL)
+  {
+    log_error("Could not allocate memory for struct Mapper");
+    return NULL;
+  }
+
+  mapper->bus = bus;
+  mapper->dev = NULL;
+  mapper->type = type;
+  mapper->windows = 0;
+
+  mapper->mem = memory_create(size, 0, type == BUS_REGION_ROM);
+  if(mapper->mem == NULL)
+  {
+    free(mapper);
+    return NULL;
+  }
+
+  for(i = 0; i < windows; i++)
+  {
+    uint32_t banks = length[i] > 0 ? size / length[i] : 0;
+
+    mapper->size[i] = length[i];
+    mapper->bank[i] = i;
+    mapper->region[i] = banks > 0 ? bus_add_window(bus, type, start[i], length[i], mapper->mem, (i % banks) * length[i]) : -1;
+    if(mapper->region[i] < 0)
+    {
+      mapper_destroy(&mapper);
+      return NULL;
+    }
+    mapper->windows++;
+  }
+
+  mapper->dev = device_attach(bus, reg, reg + windows - 1, &mapper_ops, mapper);
+  if(mapper->dev == NULL)
+  {
+    mapper_destroy(&mapper);
+    return NULL;
+  }
+
+  return mapper;
+}
+
+/*----------------------------------------------------------------------------*/
+void mapper_destroy(struct Mapper **mapper)
+{
+  if(*mapper)
+  {
+    struct Mapper *m = *mapper;
+    int i = 0;
+
+    device_detach(&m->dev);
+    for(i = 0; i < m->windows; i++)
+    {
+      bus_remove_region(m->bus, m->region[i]);
+    }
+    memory_destroy(&m->mem);
+
+    free(m);
+    *mapper = NULL;
+  }
+}
+
+/*----------------------------------------------------------------------------*/
+int mapper_select(struct Mapper *mapper, int window, uint8_t bank)
+{
+  uint32_t banks = 0;
+
+  if(window < 0 || window >= mapper->windows)
+  {
+    log_error("Invalid mapper window %d", window);
+    return -1;
+  }
+
+  banks = mapper->mem->size / mapper->size[window];
+  mapper->bank[window] = bank;
+
+  log_trace("Mapper window %d to bank %d", window, bank);
+
+  return bus_remap(mapper->bus, mapper->region[window], (bank % banks) * mapper->size[window]);
+}
+
+/*----------------------------------------------------------------------------*/
+static uint8_t mapper_read(void *ctx, uint16_t offset)
+{
+  struct Mapper *mapper = ctx;
+
+  return mapper->bank[offset];
+}
+
+/*----------------------------------------------------------------------------*/
+static void mapper_write(void *ctx, uint16_t offset, uint8_t data)
+{
+  struct Mapper *mapper = ctx;
+
+  mapper_select(mapper, offset, data);
+}
+
+/*----------------------------------------------------------------------------*/
+static void mapper_reset(void *ctx)
+{
+  struct Mapper *mapper = ctx;
+  int i = 0;
+
+  for(i = 0; i < mapper->windows; i++)
+  {
+    mapper_select(mapper, i, i);
+  }
+}
+
+/*----------------------------------------------------------------------------*/
+static void mapper_release(void *ctx)
+{
+  struct Mapper *mapper = ctx;
+
+  mapper_destroy(&mapper);
+}
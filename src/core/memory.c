@@ -6,12 +6,33 @@
 
 #include <stdlib.h>
 #include <string.h>
-#include <ctype.h>
+#include <stdio.h>
+#include <errno.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/mman.h>
 
 #include "util/log.h"
 
 #include "core/memory.h"
 
+/* Worst case size of one formatted hexdump line and of the header */
+#define MEMORY_DUMP_LINE_SIZE   80
+#define MEMORY_DUMP_HEADER_SIZE 64
+
+/* Two hex digits for every byte value, "000102...feff" */
+#define MEMORY_HEX_ROW(h) \
+  h "0" h "1" h "2" h "3" h "4" h "5" h "6" h "7" \
+  h "8" h "9" h "a" h "b" h "c" h "d" h "e" h "f"
+
+static const char memory_hexTable[] =
+  MEMORY_HEX_ROW("0") MEMORY_HEX_ROW("1") MEMORY_HEX_ROW("2") MEMORY_HEX_ROW("3")
+  MEMORY_HEX_ROW("4") MEMORY_HEX_ROW("5") MEMORY_HEX_ROW("6") MEMORY_HEX_ROW("7")
+  MEMORY_HEX_ROW("8") MEMORY_HEX_ROW("9") MEMORY_HEX_ROW("a") MEMORY_HEX_ROW("b")
+  MEMORY_HEX_ROW("c") MEMORY_HEX_ROW("d") MEMORY_HEX_ROW("e") MEMORY_HEX_ROW("f");
+
+static char* memory_hex(char *p, uint8_t data);
+
 /*----------------------------------------------------------------------------*/
 struct Memory* memory_create(uint32_t size, uint32_t baseaddr, uint8_t readonly)
 {
@@ -40,6 +61,62 @@ struct Memory* memory_create(uint32_t size, uint32_t baseaddr, uint8_t readonly)
   mem->readonly = readonly;
   mem->size = size;
   mem->baseaddr = baseaddr;
+  mem->shm_name = NULL;
+
+  return mem;
+}
+
+/*----------------------------------------------------------------------------*/
+struct Memory* memory_createShared(uint32_t size, uint32_t baseaddr, uint8_t readonly, const char *name)
+{
+  struct Memory *mem = NULL;
+  void *map = NULL;
+  int fd = -1;
+
+  log_trace("Memory: Try to allocate struct Memory");
+  mem = malloc(sizeof(struct Memory));
+  if(!mem)
+  {
+    log_error("Could not allocate memory for struct Memory");
+    return NULL;
+  }
+
+  mem->shm_name = strdup(name);
+  if(!mem->shm_name)
+  {
+    log_error("Could not allocate memory for struct Memory");
+    free(mem);
+    return NULL;
+  }
+
+  fd = shm_open(name, O_RDWR | O_CREAT | O_TRUNC, 0644);
+  if(fd < 0)
+  {
+    log_error("Could not open shared memory %s: %s", name, strerror(errno));
+    free(mem->shm_name);
+    free(mem);
+    return NULL;
+  }
+
+  /* A freshly truncated object reads as zero, like memory_create() */
+  if(ftruncate(fd, size) != 0 ||
+     (map = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0)) == MAP_FAILED)
+  {
+    log_error("Could not map shared memory %s: %s", name, strerror(errno));
+    close(fd);
+    shm_unlink(name);
+    free(mem->shm_name);
+    free(mem);
+    return NULL;
+  }
+  close(fd);
+
+  log_trace("Create shared Memory %s size 0x%04x and baseaddr 0x%04x", name, size, baseaddr);
+
+  mem->mem = map;
+  mem->readonly = readonly;
+  mem->size = size;
+  mem->baseaddr = baseaddr;
 
   return mem;
 }
@@ -49,7 +126,13 @@ void memory_destroy(struct Memory **memory)
 {
   if(*memory)
   {
-    if((*memory)->mem)
+    if((*memory)->shm_name)
+    {
+      munmap((*memory)->mem, (*memory)->size);
+      shm_unlink((*memory)->shm_name);
+      free((*memory)->shm_name);
+    }
+    else if((*memory)->mem)
     {
       free((*memory)->mem);
     }
@@ -113,8 +196,20 @@ int memory_writeByte(struct Memory* mem, uint32_t addr, uint8_t data)
 /*----------------------------------------------------------------------------*/
 int memory_dump(struct Memory* mem, uint32_t start, uint32_t end)
 {
-  int line = 0;
-  int col = 0;
+  return memory_dumpToFd(mem, start, end, STDERR_FILENO);
+}
+
+/*----------------------------------------------------------------------------*/
+int memory_dumpToFd(struct Memory* mem, uint32_t start, uint32_t end, int fd)
+{
+  uint32_t lines = 0;
+  uint32_t line = 0;
+  uint32_t last = 0;
+  char *buf = NULL;
+  char *p = NULL;
+  size_t len = 0;
+  size_t done = 0;
+  int ret = 0;
 
   if(mem == NULL)
   {
@@ -132,35 +227,83 @@ int memory_dump(struct Memory* mem, uint32_t start, uint32_t end)
     return -1;
   }
 
-  log_dump("Hexdump from 0x%04x to 0x%04x\n", start, end);
+  lines = (end - start + 15) / 16;
+  last = mem->baseaddr + mem->size;
 
-  for(line = 0; line * 16 < (end - start); line++)
+  buf = malloc(MEMORY_DUMP_HEADER_SIZE + lines * MEMORY_DUMP_LINE_SIZE);
+  if(buf == NULL)
   {
-    log_dump("0x%04x: ", start + (line * 16));
+    log_error("Could not allocate memory for hexdump");
+    return -1;
+  }
 
-    for(col = 0; col < 16; col++)
-    {
-      log_dump("%02x ", mem->mem[start - mem->baseaddr + (line * 16) + col]);
-    }
+  p = buf + snprintf(buf, MEMORY_DUMP_HEADER_SIZE, "Hexdump from 0x%04x to 0x%04x\n", start, end);
+
+  for(line = 0; line < lines; line++)
+  {
+    uint32_t addr = start + line * 16;
+    int col = 0;
 
-    log_dump(" | ");
+    /* Address column "0x1234: " */
+    *p++ = '0';
+    *p++ = 'x';
+    p = memory_hex(p, addr >> 8);
+    p = memory_hex(p, addr);
+    *p++ = ':';
+    *p++ = ' ';
 
     for(col = 0; col < 16; col++)
     {
-      if(isprint(mem->mem[start - mem->baseaddr + (line * 16) + col]) == 0)
+      if(addr + col < last)
       {
-        log_dump(".");
+        p = memory_hex(p, mem->mem[addr - mem->baseaddr + col]);
       }
       else
       {
-        log_dump("%c", mem->mem[start - mem->baseaddr + (line * 16) + col]);
+        *p++ = ' ';
+        *p++ = ' ';
       }
+      *p++ = ' ';
     }
 
-    log_dump(" | ");
+    memcpy(p, " | ", 3);
+    p += 3;
 
-    log_dump("\n");
+    for(col = 0; col < 16; col++)
+    {
+      uint8_t c = addr + col < last ? mem->mem[addr - mem->baseaddr + col] : ' ';
+      *p++ = (c >= 0x20 && c < 0x7f) ? c : '.';
+    }
+
+    memcpy(p, " | \n", 4);
+    p += 4;
   }
 
-  return 0;
+  len = p - buf;
+  while(done < len)
+  {
+    ssize_t n = write(fd, buf + done, len - done);
+    if(n < 0)
+    {
+      if(errno == EINTR)
+      {
+        continue;
+      }
+      log_error("Could not write hexdump: %s", strerror(errno));
+      ret = -1;
+      break;
+    }
+    done += n;
+  }
+
+  free(buf);
+
+  return ret;
+}
+
+/*----------------------------------------------------------------------------*/
+static char* memory_hex(char *p, uint8_t data)
+{
+  memcpy(p, &memory_hexTable[data * 2], 2);
+  return p + 2;
 }
@@ -0,0 +1,249 @@
+/*
+ * Copyright (c) 2022, Bernd Bauer <bernd.bauer@gmx.at>
+ *
+ * SPDX-License-Identifier: BSD-2-Clause
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include <inttypes.h>
+
+#include "util/log.h"
+#include "util/ring.h"
+
+#include "core/offload.h"
+
+static void* offload_thread(void *arg);
+static int offload_push(struct Offload *off, uint64_t when, uint16_t offset, uint8_t data, uint8_t write);
+static void offload_apply(struct Offload *off, const struct OffloadRecord *rec);
+static int offload_behind(struct Offload *off, uint64_t when, uint8_t drain);
+static void offload_wait(struct Offload *off, uint64_t when, uint8_t drain);
+
+/*----------------------------------------------------------------------------*/
+struct Offload* offload_create(const struct OffloadOps *ops, void *ctx, uint32_t size, uint64_t max_lag)
+{
+  struct Offload *off = NULL;
+
+  off = calloc(1, sizeof(struct Offload));
+  if(off == NULL)
+  {
+    log_error("Could not allocate memory for struct Offload");
+    return NULL;
+  }
+
+  off->ops = ops;
+  off->ctx = ctx;
+  off->max_lag = max_lag;
+
+  if(max_lag == 0)
+  {
+    log_info("Run %s back end inline", ops->name);
+    return off;
+  }
+
+  off->queue = ring_create(size, sizeof(struct OffloadRecord));
+  if(off->queue == NULL)
+  {
+    free(off);
+    return NULL;
+  }
+
+  pthread_mutex_init(&off->lock, NULL);
+  pthread_cond_init(&off->work, NULL);
+  pthread_cond_init(&off->done, NULL);
+
+  if(pthread_create(&off->thread, NULL, offload_thread, off) != 0)
+  {
+    log_error("Could not start %s back end thread", ops->name);
+    pthread_cond_destroy(&off->done);
+    pthread_cond_destroy(&off->work);
+    pthread_mutex_destroy(&off->lock);
+    ring_destroy(&off->queue);
+    free(off);
+    return NULL;
+  }
+  off->threaded = 1;
+
+  log_info("Run %s back end on a thread, at most %" PRIu64 " cycles behind", ops->name, max_lag);
+
+  return off;
+}
+
+/*----------------------------------------------------------------------------*/
+void offload_destroy(struct Offload **off)
+{
+  if(*off)
+  {
+    struct Offload *o = *off;
+
+    /* The worker drains the queue before it quits */
+    if(o->threaded)
+    {
+      pthread_mutex_lock(&o->lock);
+      o->quit = 1;
+      pthread_cond_signal(&o->work);
+      pthread_mutex_unlock(&o->lock);
+      pthread_join(o->thread, NULL);
+
+      log_debug("%s back end stalled the emulation %" PRIu64 " times", o->ops->name, o->stalls);
+
+      pthread_cond_destroy(&o->done);
+      pthread_cond_destroy(&o->work);
+      pthread_mutex_destroy(&o->lock);
+    }
+
+    ring_destroy(&o->queue);
+    free(o);
+    *off = NULL;
+  }
+}
+
+/*----------------------------------------------------------------------------*/
+int offload_write(struct Offload *off, uint64_t when, uint16_t offset, uint8_t data)
+{
+  return offload_push(off, when, offset, data, 1);
+}
+
+/*----------------------------------------------------------------------------*/
+int offload_advance(struct Offload *off, uint64_t when)
+{
+  return offload_push(off, when, 0, 0, 0);
+}
+
+/*----------------------------------------------------------------------------*/
+int offload_sync(struct Offload *off)
+{
+  /* Everything queued has to be done before its result is read */
+  if(off->threaded)
+  {
+    offload_wait(off, 0, 1);
+  }
+
+  return 0;
+}
+
+/*----------------------------------------------------------------------------*/
+static void* offload_thread(void *arg)
+{
+  struct Offload *off = arg;
+  struct OffloadRecord rec;
+
+  for(;;)
+  {
+    if(ring_peek(off->queue, &rec, 1) == 0)
+    {
+      int quit = 0;
+
+      /* Sleeping is announced before the last look at the queue, the
+       * emulation thread checks it after publishing a record */
+      pthread_mutex_lock(&off->lock);
+      __atomic_store_n(&off->sleeping, 1, __ATOMIC_SEQ_CST);
+      __atomic_thread_fence(__ATOMIC_SEQ_CST);
+      while(ring_count(off->queue) == 0 && !off->quit)
+      {
+        pthread_cond_wait(&off->work, &off->lock);
+      }
+      __atomic_store_n(&off->sleeping, 0, __ATOMIC_RELAXED);
+      quit = off->quit && ring_count(off->queue) == 0;
+      pthread_mutex_unlock(&off->lock);
+
+      if(quit)
+      {
+        break;
+      }
+      continue;
+    }
+
+    offload_apply(off, &rec);
+
+    /* The slot is free and the record done only from here on */
+    ring_drop(off->queue, 1);
+    __atomic_thread_fence(__ATOMIC_SEQ_CST);
+    if(__atomic_load_n(&off->waiting, __ATOMIC_SEQ_CST))
+    {
+      pthread_mutex_lock(&off->lock);
+      pthread_cond_signal(&off->done);
+      pthread_mutex_unlock(&off->lock);
+    }
+  }
+
+  return NULL;
+}
+
+/*----------------------------------------------------------------------------*/
+static int offload_push(struct Offload *off, uint64_t when, uint16_t offset, uint8_t data, uint8_t write)
+{
+  struct OffloadRecord rec = { .when = when, .offset = offset, .data = data, .write = write };
+
+  if(!off->threaded)
+  {
+    offload_apply(off, &rec);
+    return 0;
+  }
+
+  offload_wait(off, when, 0);
+
+  ring_push(off->queue, &rec, 1);
+  __atomic_thread_fence(__ATOMIC_SEQ_CST);
+  if(__atomic_load_n(&off->sleeping, __ATOMIC_SEQ_CST))
+  {
+    pthread_mutex_lock(&off->lock);
+    pthread_cond_signal(&off->work);
+    pthread_mutex_unlock(&off->lock);
+  }
+
+  return 0;
+}
+
+/*----------------------------------------------------------------------------*/
+static void offload_apply(struct Offload *off, const struct OffloadRecord *rec)
+{
+  if(rec->write)
+  {
+    off->ops->write(off->ctx, rec->when, rec->offset, rec->data);
+  }
+  else if(off->ops->advance != NULL)
+  {
+    off->ops->advance(off->ctx, rec->when);
+  }
+}
+
+/*----------------------------------------------------------------------------*/
+static int offload_behind(struct Offload *off, uint64_t when, uint8_t drain)
+{
+  struct OffloadRecord oldest;
+
+  /* Only the emulation thread writes records, the oldest one stays put
+   * while the worker is busy with it */
+  if(ring_peek(off->queue, &oldest, 1) == 0)
+  {
+    return 0;
+  }
+  if(drain || ring_free(off->queue) == 0)
+  {
+    return 1;
+  }
+
+  return oldest.when + off->max_lag < when;
+}
+
+/*----------------------------------------------------------------------------*/
+static void offload_wait(struct Offload *off, uint64_t when, uint8_t drain)
+{
+  if(!offload_behind(off, when, drain))
+  {
+    return;
+  }
+
+  off->stalls++;
+
+  pthread_mutex_lock(&off->lock);
+  __atomic_store_n(&off->waiting, 1, __ATOMIC_SEQ_CST);
+  __atomic_thread_fence(__ATOMIC_SEQ_CST);
+  while(offload_behind(off, when, drain))
+  {
+    pthread_cond_wait(&off->done, &off->lock);
+  }
+  __atomic_store_n(&off->waiting, 0, __ATOMIC_RELAXED);
+  pthread_mutex_unlock(&off->lock);
+}
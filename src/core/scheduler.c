@@ -0,0 +1,199 @@
+/*
+ * Copyright (c) 2022, Bernd Bauer <bernd.bauer@gmx.at>
+ *
+ * SPDX-License-Identifier: BSD-2-Clause
+ */
+
+#include <stdlib.h>
+#include <inttypes.h>
+
+#include "util/log.h"
+
+#include "core/scheduler.h"
+
+#define SCHEDULER_INITIAL_CAPACITY 16
+
+static void scheduler_swap(struct Scheduler *sched, int a, int b);
+static void scheduler_up(struct Scheduler *sched, int pos);
+static void scheduler_down(struct Scheduler *sched, int pos);
+static void scheduler_remove(struct Scheduler *sched, int pos);
+
+/*----------------------------------------------------------------------------*/
+struct Scheduler* scheduler_create(uint64_t *deadline)
+{
+  struct Scheduler *sched = NULL;
+
+  log_trace("Create Scheduler");
+
+  sched = malloc(sizeof(struct Scheduler));
+  if(sched == NULL)
+  {
+    log_error("Could not allocate memory for struct Scheduler");
+    return NULL;
+  }
+
+  sched->heap = malloc(sizeof(struct SchedulerEvent) * SCHEDULER_INITIAL_CAPACITY);
+  if(sched->heap == NULL)
+  {
+    log_error("Could not allocate memory for scheduler events");
+    free(sched);
+    return NULL;
+  }
+
+  sched->count = 0;
+  sched->capacity = SCHEDULER_INITIAL_CAPACITY;
+  sched->next_id = 1;
+  sched->deadline = deadline;
+
+  return sched;
+}
+
+/*----------------------------------------------------------------------------*/
+void scheduler_destroy(struct Scheduler **sched)
+{
+  if(*sched)
+  {
+    free((*sched)->heap);
+    free(*sched);
+    *sched = NULL;
+  }
+}
+
+/*----------------------------------------------------------------------------*/
+int scheduler_add(struct Scheduler *sched, uint64_t when, scheduler_EventFn fn, void *ctx)
+{
+  struct SchedulerEvent *ev = NULL;
+  int id = 0;
+
+  if(sched->count == sched->capacity)
+  {
+    struct SchedulerEvent *heap = realloc(sched->heap, sizeof(struct SchedulerEvent) * sched->capacity * 2);
+    if(heap == NULL)
+    {
+      log_error("Could not grow scheduler event heap");
+      return -1;
+    }
+    sched->heap = heap;
+    sched->capacity *= 2;
+  }
+
+  ev = &sched->heap[sched->count];
+  ev->when = when;
+  ev->fn = fn;
+  ev->ctx = ctx;
+  ev->id = id = sched->next_id++;
+  if(sched->next_id <= 0)
+  {
+    sched->next_id = 1;
+  }
+
+  sched->count++;
+  scheduler_up(sched, sched->count - 1);
+
+  if(sched->deadline != NULL && when < *sched->deadline)
+  {
+    *sched->deadline = when;
+  }
+
+  log_trace("Scheduled event %d at cycle %" PRIu64, id, when);
+
+  return id;
+}
+
+/*----------------------------------------------------------------------------*/
+int scheduler_cancel(struct Scheduler *sched, int id)
+{
+  int i = 0;
+
+  for(i = 0; i < sched->count; i++)
+  {
+    if(sched->heap[i].id == id)
+    {
+      scheduler_remove(sched, i);
+      return 0;
+    }
+  }
+
+  return -1;
+}
+
+/*----------------------------------------------------------------------------*/
+int scheduler_dispatch(struct Scheduler *sched, uint64_t now)
+{
+  int fired = 0;
+
+  while(sched->count > 0 && sched->heap[0].when <= now)
+  {
+    struct SchedulerEvent ev = sched->heap[0];
+
+    scheduler_remove(sched, 0);
+    ev.fn(ev.ctx, ev.when);
+    fired++;
+  }
+
+  return fired;
+}
+
+/*----------------------------------------------------------------------------*/
+static void scheduler_swap(struct Scheduler *sched, int a, int b)
+{
+  struct SchedulerEvent tmp = sched->heap[a];
+  sched->heap[a] = sched->heap[b];
+  sched->heap[b] = tmp;
+}
+
+/*----------------------------------------------------------------------------*/
+static void scheduler_up(struct Scheduler *sched, int pos)
+{
+  while(pos > 0)
+  {
+    int parent = (pos - 1) / 2;
+
+    if(sched->heap[parent].when <= sched->heap[pos].when)
+    {
+      break;
+    }
+    scheduler_swap(sched, parent, pos);
+    pos = parent;
+  }
+}
+
+/*----------------------------------------------------------------------------*/
+static void scheduler_down(struct Scheduler *sched, int pos)
+{
+  for(;;)
+  {
+    int left = pos * 2 + 1;
+    int right = left + 1;
+    int min = pos;
+
+    if(left < sched->count && sched->heap[left].when < sched->heap[min].when)
+    {
+      min = left;
+    }
+    if(right < sched->count && sched->heap[right].when < sched->heap[min].when)
+    {
+      min = right;
+    }
+    if(min == pos)
+    {
+      break;
+    }
+    scheduler_swap(sched, min, pos);
+    pos = min;
+  }
+}
+
+/*----------------------------------------------------------------------------*/
+static void scheduler_remove(struct Scheduler *sched, int pos)
+{
+  sched->count--;
+  if(pos == sched->count)
+  {
+    return;
+  }
+
+  sched->heap[pos] = sched->heap[sched->count];
+  scheduler_up(sched, pos);
+  scheduler_down(sched, pos);
+}
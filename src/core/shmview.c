@@ -0,0 +1,179 @@
+/*
+ * Copyright (c) 2022, Bernd Bauer <bernd.bauer@gmx.at>
+ *
+ * SPDX-License-Identifier: BSD-2-Clause
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+
+#include "util/log.h"
+
+#include "core/bus.h"
+#include "core/shmview.h"
+
+static int shmview_share_ram(struct Bus *bus, const char *name);
+
+/*----------------------------------------------------------------------------*/
+struct ShmView* shmview_create(struct Bus *bus, const char *name)
+{
+  struct ShmView *view = NULL;
+  void *map = NULL;
+  int fd = -1;
+
+  log_info("Create shared memory view %s", name);
+
+  view = malloc(sizeof(struct ShmView));
+  if(view == NULL)
+  {
+    log_error("Could not allocate memory for struct ShmView");
+    return NULL;
+  }
+
+  view->bus = bus;
+  view->state = NULL;
+  view->due = SCHEDULER_NEVER;
+  view->state_name = malloc(strlen(name) + sizeof(SHMVIEW_STATE_SUFFIX));
+  if(view->state_name == NULL)
+  {
+    log_error("Could not allocate memory for struct ShmView");
+    free(view);
+    return NULL;
+  }
+  strcpy(view->state_name, name);
+  strcat(view->state_name, SHMVIEW_STATE_SUFFIX);
+
+  fd = shm_open(view->state_name, O_RDWR | O_CREAT | O_TRUNC, 0644);
+  if(fd < 0)
+  {
+    log_error("Could not open shared memory %s: %s", view->state_name, strerror(errno));
+    free(view->state_name);
+    free(view);
+    return NULL;
+  }
+  if(ftruncate(fd, sizeof(struct ShmViewState)) != 0 ||
+     (map = mmap(NULL, sizeof(struct ShmViewState), PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0)) == MAP_FAILED)
+  {
+    log_error("Could not map shared memory %s: %s", view->state_name, strerror(errno));
+    close(fd);
+    shm_unlink(view->state_name);
+    free(view->state_name);
+    free(view);
+    return NULL;
+  }
+  close(fd);
+  view->state = map;
+
+  if(shmview_share_ram(bus, name) != 0)
+  {
+    munmap(view->state, sizeof(struct ShmViewState));
+    shm_unlink(view->state_name);
+    free(view->state_name);
+    free(view);
+    return NULL;
+  }
+
+  memcpy(view->state->magic, SHMVIEW_MAGIC, sizeof(view->state->magic));
+  view->state->version = SHMVIEW_VERSION;
+  view->state->ram_base = bus->ram->baseaddr;
+  view->state->ram_size = bus->ram->size;
+
+  bus->shmview = view;
+  shmview_update(view);
+  view->due = bus->cpu->clock_count + SHMVIEW_PERIOD;
+
+  return view;
+}
+
+/*----------------------------------------------------------------------------*/
+void shmview_destroy(struct ShmView **view)
+{
+  if(*view)
+  {
+    struct ShmView *v = *view;
+
+    if(v->bus->shmview == v)
+    {
+      v->bus->shmview = NULL;
+    }
+
+    munmap(v->state, sizeof(struct ShmViewState));
+    shm_unlink(v->state_name);
+    free(v->state_name);
+    free(v);
+    *view = NULL;
+  }
+}
+
+/*----------------------------------------------------------------------------*/
+void shmview_update(struct ShmView *view)
+{
+  struct ShmViewState *st = view->state;
+  struct CPU6502 *cpu = view->bus->cpu;
+  uint32_t seq = st->seq;
+
+  __atomic_store_n(&st->seq, seq + 1, __ATOMIC_RELAXED);
+  __atomic_thread_fence(__ATOMIC_RELEASE);
+
+  st->A = cpu->Reg.A;
+  st->X = cpu->Reg.X;
+  st->Y = cpu->Reg.Y;
+  st->P = cpu->Reg.PSR;
+  st->SP = cpu->Reg.SP;
+  st->PC = cpu->Reg.PC;
+  st->irq_lines = cpu->irq_lines;
+  st->stop = view->bus->stop;
+  st->clock_count = cpu->clock_count;
+  st->updates++;
+
+  __atomic_store_n(&st->seq, seq + 2, __ATOMIC_RELEASE);
+}
+
+/*----------------------------------------------------------------------------*/
+uint64_t shmview_poll(struct ShmView *view, uint64_t now)
+{
+  if(now >= view->due)
+  {
+    shmview_update(view);
+    view->due = now + SHMVIEW_PERIOD;
+  }
+
+  return view->due;
+}
+
+/*----------------------------------------------------------------------------*/
+static int shmview_share_ram(struct Bus *bus, const char *name)
+{
+  struct Memory *ram = NULL;
+  int i = 0;
+
+  if(bus->ram == NULL)
+  {
+    log_error("No RAM to share");
+    return -1;
+  }
+
+  ram = memory_createShared(bus->ram->size, bus->ram->baseaddr, bus->ram->readonly, name);
+  if(ram == NULL)
+  {
+    return -1;
+  }
+
+  memcpy(ram->mem, bus->ram->mem, ram->size);
+  for(i = 0; i < bus->regions; i++)
+  {
+    if(bus->region[i].mem == bus->ram)
+    {
+      bus->region[i].mem = ram;
+    }
+  }
+  memory_destroy(&bus->ram);
+  bus->ram = ram;
+
+  /* The page table still points into the old buffer */
+  return bus_map(bus);
+}
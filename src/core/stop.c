@@ -0,0 +1,239 @@
+/*
+ * Copyright (c) 2022, Bernd Bauer <bernd.bauer@gmx.at>
+ *
+ * SPDX-License-Identifier: BSD-2-Clause
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include <inttypes.h>
+
+#include "util/log.h"
+
+#include "core/bus.h"
+#include "core/stop.h"
+
+static void stop_update_hook(struct StopConditions *cond);
+static void stop_bound(struct StopConditions *cond, uint64_t when);
+static int stop_timeout_expired(struct StopConditions *cond);
+
+/*----------------------------------------------------------------------------*/
+struct StopConditions* stop_create(struct Bus *bus)
+{
+  struct StopConditions *cond = NULL;
+
+  log_trace("Create StopConditions");
+
+  cond = malloc(sizeof(struct StopConditions));
+  if(cond == NULL)
+  {
+    log_error("Could not allocate memory for struct StopConditions");
+    return NULL;
+  }
+
+  memset(cond, 0, sizeof(struct StopConditions));
+  cond->bus = bus;
+  cond->write_addr = -1;
+  cond->cycle_limit = SCHEDULER_NEVER;
+  cond->timeout_due = SCHEDULER_NEVER;
+
+  return cond;
+}
+
+/*----------------------------------------------------------------------------*/
+void stop_destroy(struct StopConditions **cond)
+{
+  if(*cond)
+  {
+    free(*cond);
+    *cond = NULL;
+  }
+}
+
+/*----------------------------------------------------------------------------*/
+int stop_at_cycle(struct StopConditions *cond, uint64_t cycle)
+{
+  log_info("Stop at cycle %" PRIu64, cycle);
+  cond->cycle_limit = cycle;
+  stop_bound(cond, cycle);
+
+  return 0;
+}
+
+/*----------------------------------------------------------------------------*/
+int stop_after_instructions(struct StopConditions *cond, uint64_t count)
+{
+  log_info("Stop after %" PRIu64 " instructions", count);
+
+  cond->instructions_left = count;
+  cond->instructions_armed = 1;
+  stop_update_hook(cond);
+
+  return 0;
+}
+
+/*----------------------------------------------------------------------------*/
+int stop_at_pc(struct StopConditions *cond, uint16_t pc)
+{
+  if((cond->pc[pc >> 3] & (1 << (pc & 7))) == 0)
+  {
+    log_info("Stop at PC 0x%04x", pc);
+    cond->pc[pc >> 3] |= 1 << (pc & 7);
+    cond->pc_count++;
+  }
+  stop_update_hook(cond);
+
+  return 0;
+}
+
+/*----------------------------------------------------------------------------*/
+int stop_on_brk(struct StopConditions *cond, uint8_t enable)
+{
+  cond->brk = enable;
+  return 0;
+}
+
+/*----------------------------------------------------------------------------*/
+int stop_on_write(struct StopConditions *cond, uint16_t addr)
+{
+  if(cond->write_addr >= 0)
+  {
+    bus_trap_write(cond->bus, cond->write_addr, 0);
+  }
+
+  log_info("Stop on write to 0x%04x", addr);
+  cond->write_addr = addr;
+  bus_trap_write(cond->bus, addr, 1);
+
+  return 0;
+}
+
+/*----------------------------------------------------------------------------*/
+int stop_after_seconds(struct StopConditions *cond, double seconds)
+{
+  clock_gettime(CLOCK_MONOTONIC, &cond->timeout_end);
+  cond->timeout_end.tv_sec += (time_t)seconds;
+  cond->timeout_end.tv_nsec += (long)((seconds - (time_t)seconds) * 1e9);
+  if(cond->timeout_end.tv_nsec >= 1000000000L)
+  {
+    cond->timeout_end.tv_sec++;
+    cond->timeout_end.tv_nsec -= 1000000000L;
+  }
+
+  log_info("Stop after %.3f seconds wall clock time", seconds);
+  cond->timeout_due = cond->bus->cpu->clock_count + STOP_TIMEOUT_PERIOD;
+  stop_bound(cond, cond->timeout_due);
+
+  return 0;
+}
+
+/*----------------------------------------------------------------------------*/
+uint64_t stop_poll(struct StopConditions *cond, uint64_t now)
+{
+  if(now >= cond->cycle_limit)
+  {
+    log_info("Reached cycle limit %" PRIu64, cond->cycle_limit);
+    cond->cycle_limit = SCHEDULER_NEVER;
+    bus_stop(cond->bus, BUS_STOP_CYCLES);
+  }
+
+  if(now >= cond->timeout_due)
+  {
+    if(stop_timeout_expired(cond))
+    {
+      log_warn("Wall clock timeout reached at cycle %" PRIu64, now);
+      cond->timeout_due = SCHEDULER_NEVER;
+      bus_stop(cond->bus, BUS_STOP_TIMEOUT);
+    }
+    else
+    {
+      cond->timeout_due = now + STOP_TIMEOUT_PERIOD;
+    }
+  }
+
+  return cond->cycle_limit < cond->timeout_due ? cond->cycle_limit : cond->timeout_due;
+}
+
+/*----------------------------------------------------------------------------*/
+int stop_hook(struct StopConditions *cond, uint16_t pc, uint8_t resumed)
+{
+  if(cond->instructions_armed)
+  {
+    if(cond->instructions_left == 0)
+    {
+      cond->instructions_armed = 0;
+      stop_update_hook(cond);
+      bus_stop(cond->bus, BUS_STOP_INSTRUCTIONS);
+      return 1;
+    }
+    cond->instructions_left--;
+  }
+
+  if(cond->pc_count != 0 && !resumed && (cond->pc[pc >> 3] & (1 << (pc & 7))))
+  {
+    log_info("Reached PC 0x%04x", pc);
+    bus_stop(cond->bus, BUS_STOP_PC);
+    return 1;
+  }
+
+  return 0;
+}
+
+/*----------------------------------------------------------------------------*/
+int stop_brk(struct StopConditions *cond)
+{
+  if(cond->brk)
+  {
+    bus_stop(cond->bus, BUS_STOP_BRK);
+    return 1;
+  }
+
+  return 0;
+}
+
+/*----------------------------------------------------------------------------*/
+int stop_write(struct StopConditions *cond, uint16_t addr, uint8_t data)
+{
+  if(cond->write_addr == addr)
+  {
+    log_info("Write 0x%02x to stop address 0x%04x", data, addr);
+    bus_stop(cond->bus, BUS_STOP_WRITE);
+    return 1;
+  }
+
+  return 0;
+}
+
+/*----------------------------------------------------------------------------*/
+static void stop_update_hook(struct StopConditions *cond)
+{
+  if(cond->instructions_armed || cond->pc_count != 0)
+  {
+    cond->bus->cpu->hooks |= CPU6502_HOOK_STOP;
+  }
+  else
+  {
+    cond->bus->cpu->hooks &= ~CPU6502_HOOK_STOP;
+  }
+}
+
+/*----------------------------------------------------------------------------*/
+static void stop_bound(struct StopConditions *cond, uint64_t when)
+{
+  /* Armed while running, the current slice ends in time */
+  if(when < cond->bus->cpu->deadline)
+  {
+    cond->bus->cpu->deadline = when;
+  }
+}
+
+/*----------------------------------------------------------------------------*/
+static int stop_timeout_expired(struct StopConditions *cond)
+{
+  struct timespec now;
+
+  clock_gettime(CLOCK_MONOTONIC, &now);
+
+  return now.tv_sec > cond->timeout_end.tv_sec ||
+         (now.tv_sec == cond->timeout_end.tv_sec && now.tv_nsec >= cond->timeout_end.tv_nsec);
+}
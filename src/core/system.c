@@ -0,0 +1,475 @@
+/*
+ * Copyright (c) 2022, Bernd Bauer <bernd.bauer@gmx.at>
+ *
+ * SPDX-License-Identifier: BSD-2-Clause
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include <inttypes.h>
+
+#include "util/log.h"
+
+#include "core/bus.h"
+#include "core/device.h"
+#include "core/memory.h"
+#include "core/system.h"
+
+static void system_shared_write(void *ctx, uint16_t offset, uint8_t data);
+static uint8_t system_mailbox_read(void *ctx, uint16_t offset);
+static void system_mailbox_write(void *ctx, uint16_t offset, uint8_t data);
+static uint8_t system_mailbox_peek(void *ctx, uint16_t offset);
+static void system_mailbox_reset(void *ctx);
+
+static struct SystemPort* system_port(struct System *sys, int cpu, int n);
+static void system_slice(struct System *sys, int cpu, uint64_t target);
+static void system_contend(struct System *sys, struct Bus *bus);
+static void system_mailbox_update(struct SystemPort *port);
+
+/* Reads see the window directly, only writes are trapped */
+static const struct DeviceOps system_shared_ops = {
+  .name = "shared",
+  .write = system_shared_write
+};
+
+static const struct DeviceOps system_mailbox_ops = {
+  .name = "mailbox",
+  .read = system_mailbox_read,
+  .write = system_mailbox_write,
+  .peek = system_mailbox_peek,
+  .reset = system_mailbox_reset
+};
+
+/*----------------------------------------------------------------------------*/
+struct System* system_create(uint64_t quantum)
+{
+  struct System *sys = NULL;
+
+  if(quantum == 0)
+  {
+    log_error("Invalid quantum of 0 cycles");
+    return NULL;
+  }
+
+  sys = calloc(1, sizeof(struct System));
+  if(sys == NULL)
+  {
+    log_error("Could not allocate memory for struct System");
+    return NULL;
+  }
+
+  sys->quantum = quantum;
+  sys->tight = quantum < SYSTEM_TIGHT ? quantum : SYSTEM_TIGHT;
+  sys->boost = SYSTEM_BOOST;
+  sys->stop = BUS_RUNNING;
+  sys->stopped = -1;
+
+  log_info("Create system with a quantum of %" PRIu64 " cycles", quantum);
+
+  return sys;
+}
+
+/*----------------------------------------------------------------------------*/
+int system_destroy(struct System **sys)
+{
+  if(*sys != NULL)
+  {
+    struct System *s = *sys;
+    int i = 0;
+
+    /* The buses detach the ports, the shared memory outlives them */
+    for(i = 0; i < s->cpus; i++)
+    {
+      bus_destroy(&s->bus[i]);
+    }
+    for(i = 0; i < s->memories; i++)
+    {
+      memory_destroy(&s->shared[i]);
+    }
+
+    free(s);
+    *sys = NULL;
+  }
+
+  return 0;
+}
+
+/*----------------------------------------------------------------------------*/
+struct Bus* system_add_cpu(struct System *sys)
+{
+  struct Bus *bus = NULL;
+
+  if(sys->cpus == SYSTEM_MAX_CPUS)
+  {
+    log_error("Too many CPUs");
+    return NULL;
+  }
+
+  bus = bus_create();
+  if(bus == NULL)
+  {
+    return NULL;
+  }
+
+  /* A late CPU starts where the others are */
+  bus->cpu->clock_count = sys->cpus > 0 ? system_now(sys) : 0;
+
+  log_info("Add CPU %d", sys->cpus);
+  sys->idle[sys->cpus] = 0;
+  sys->bus[sys->cpus++] = bus;
+
+  return bus;
+}
+
+/*----------------------------------------------------------------------------*/
+struct Memory* system_add_shared(struct System *sys, uint32_t size)
+{
+  struct Memory *mem = NULL;
+
+  if(sys->memories == SYSTEM_MAX_PORTS)
+  {
+    log_error("Too many shared memories");
+    return NULL;
+  }
+
+  mem = memory_create(size, 0, 0);
+  if(mem == NULL)
+  {
+    return NULL;
+  }
+  sys->shared[sys->memories++] = mem;
+
+  return mem;
+}
+
+/*----------------------------------------------------------------------------*/
+int system_share(struct System *sys, struct Memory *mem, int cpu, uint16_t start)
+{
+  struct SystemPort *port = NULL;
+  int region = 0;
+
+  port = system_port(sys, cpu, 0);
+  if(port == NULL)
+  {
+    return -1;
+  }
+
+  /* The window maps the memory, the device on top of it sees the writes */
+  region = bus_add_window(sys->bus[cpu], BUS_REGION_RAM, start, mem->size, mem, 0);
+  if(region < 0)
+  {
+    return -1;
+  }
+  port->mem = mem->mem;
+  port->dev = device_attach(sys->bus[cpu], start, start + mem->size - 1, &system_shared_ops, port);
+  if(port->dev == NULL)
+  {
+    bus_remove_region(sys->bus[cpu], region);
+    return -1;
+  }
+  sys->ports++;
+
+  return 0;
+}
+
+/*----------------------------------------------------------------------------*/
+int system_add_mailbox(struct System *sys, int cpu_a, uint16_t start_a, int irq_a, int cpu_b, uint16_t start_b, int irq_b)
+{
+  struct SystemPort *a = NULL;
+  struct SystemPort *b = NULL;
+
+  if(irq_a >= BUS_IRQ_LINES || irq_b >= BUS_IRQ_LINES)
+  {
+    log_error("Invalid mailbox between CPU %d and %d", cpu_a, cpu_b);
+    return -1;
+  }
+
+  a = system_port(sys, cpu_a, 0);
+  b = system_port(sys, cpu_b, 1);
+  if(a == NULL || b == NULL)
+  {
+    return -1;
+  }
+  a->peer = b;
+  a->irq = irq_a;
+  b->peer = a;
+  b->irq = irq_b;
+
+  a->dev = device_attach(a->bus, start_a, start_a + SYSTEM_MAILBOX_REGISTERS - 1, &system_mailbox_ops, a);
+  if(a->dev == NULL)
+  {
+    return -1;
+  }
+  b->dev = device_attach(b->bus, start_b, start_b + SYSTEM_MAILBOX_REGISTERS - 1, &system_mailbox_ops, b);
+  if(b->dev == NULL)
+  {
+    device_detach(&a->dev);
+    return -1;
+  }
+  sys->ports += 2;
+
+  return 0;
+}
+
+/*----------------------------------------------------------------------------*/
+int system_reset(struct System *sys)
+{
+  int i = 0;
+
+  for(i = 0; i < sys->cpus; i++)
+  {
+    bus_reset(sys->bus[i]);
+    sys->idle[i] = 0;
+  }
+  sys->boost_until = 0;
+  sys->stop = BUS_RUNNING;
+  sys->stopped = -1;
+
+  return 0;
+}
+
+/*----------------------------------------------------------------------------*/
+int system_run(struct System *sys, uint64_t cycles)
+{
+  uint64_t end = SCHEDULER_NEVER;
+  int i = 0;
+
+  if(sys->cpus == 0)
+  {
+    log_error("System without CPU");
+    return -1;
+  }
+
+  if(cycles != BUS_RUN_FOREVER)
+  {
+    end = system_now(sys) + cycles;
+  }
+
+  sys->stop = BUS_RUNNING;
+  sys->stopped = -1;
+  sys->running = 1;
+
+  while(sys->stop == BUS_RUNNING && (sys->base = system_now(sys)) < end)
+  {
+    uint64_t quantum = sys->base < sys->boost_until ? sys->tight : sys->quantum;
+    uint64_t target = end - sys->base > quantum ? sys->base + quantum : end;
+    int idle = 0;
+
+    sys->slices++;
+    for(i = 0; i < sys->cpus && sys->stop == BUS_RUNNING; i++)
+    {
+      system_slice(sys, i, target);
+    }
+
+    /* Counted after the slice, a later CPU may have woken an earlier one */
+    for(i = 0; i < sys->cpus; i++)
+    {
+      idle += sys->idle[i];
+    }
+
+    if(sys->stop == BUS_RUNNING && idle == sys->cpus)
+    {
+      log_info("All CPUs idle without pending events. Stop system...");
+      sys->stop = BUS_STOP_IDLE;
+    }
+  }
+
+  sys->running = 0;
+
+  return 0;
+}
+
+/*----------------------------------------------------------------------------*/
+uint64_t system_now(struct System *sys)
+{
+  uint64_t now = SCHEDULER_NEVER;
+  int i = 0;
+
+  /* Everything before the CPU furthest behind has happened on every bus */
+  for(i = 0; i < sys->cpus; i++)
+  {
+    if(sys->bus[i]->cpu->clock_count < now)
+    {
+      now = sys->bus[i]->cpu->clock_count;
+    }
+  }
+
+  return now;
+}
+
+/*----------------------------------------------------------------------------*/
+static void system_shared_write(void *ctx, uint16_t offset, uint8_t data)
+{
+  struct SystemPort *port = ctx;
+
+  port->mem[offset] = data;
+  system_contend(port->sys, port->bus);
+}
+
+/*----------------------------------------------------------------------------*/
+static uint8_t system_mailbox_read(void *ctx, uint16_t offset)
+{
+  struct SystemPort *port = ctx;
+  uint8_t data = system_mailbox_peek(ctx, offset);
+
+  if(offset == SYSTEM_MAILBOX_DATA)
+  {
+    port->full = 0;
+    system_mailbox_update(port);
+    system_contend(port->sys, port->bus);
+  }
+
+  return data;
+}
+
+/*----------------------------------------------------------------------------*/
+static void system_mailbox_write(void *ctx, uint16_t offset, uint8_t data)
+{
+  struct SystemPort *port = ctx;
+
+  /* An unread byte is overwritten */
+  if(offset == SYSTEM_MAILBOX_DATA)
+  {
+    port->peer->data = data;
+    port->peer->full = 1;
+    system_mailbox_update(port->peer);
+    system_contend(port->sys, port->bus);
+  }
+}
+
+/*----------------------------------------------------------------------------*/
+static uint8_t system_mailbox_peek(void *ctx, uint16_t offset)
+{
+  struct SystemPort *port = ctx;
+
+  switch(offset)
+  {
+    case SYSTEM_MAILBOX_DATA:
+      return port->data;
+    case SYSTEM_MAILBOX_STATUS:
+      return (port->full ? SYSTEM_MAILBOX_RX_FULL : 0) | (port->peer->full ? SYSTEM_MAILBOX_TX_FULL : 0);
+  }
+
+  return 0;
+}
+
+/*----------------------------------------------------------------------------*/
+static void system_mailbox_reset(void *ctx)
+{
+  struct SystemPort *port = ctx;
+
+  port->full = 0;
+  system_mailbox_update(port);
+}
+
+/*----------------------------------------------------------------------------*/
+static struct SystemPort* system_port(struct System *sys, int cpu, int n)
+{
+  struct SystemPort *port = NULL;
+
+  if(cpu < 0 || cpu >= sys->cpus)
+  {
+    log_error("Invalid CPU %d", cpu);
+    return NULL;
+  }
+  if(sys->ports + n >= SYSTEM_MAX_PORTS)
+  {
+    log_error("Too many shared memory and mailbox ports");
+    return NULL;
+  }
+
+  /* Taken for good once the caller counts it in ports */
+  port = &sys->port[sys->ports + n];
+  memset(port, 0, sizeof(struct SystemPort));
+  port->sys = sys;
+  port->bus = sys->bus[cpu];
+  port->irq = -1;
+
+  return port;
+}
+
+/*----------------------------------------------------------------------------*/
+static void system_slice(struct System *sys, int cpu, uint64_t target)
+{
+  struct Bus *bus = sys->bus[cpu];
+
+  if(bus->cpu->clock_count >= target)
+  {
+    return;
+  }
+
+  bus_run(bus, target - bus->cpu->clock_count);
+
+  switch(bus->stop)
+  {
+    case BUS_RUNNING:
+      sys->idle[cpu] = 0;
+      break;
+    case BUS_STOP_YIELD:
+      bus->stop = BUS_RUNNING;
+      sys->idle[cpu] = 0;
+      break;
+    case BUS_STOP_IDLE:
+      /* Only another CPU can wake it, wait for them at the end of the slice */
+      bus->stop = BUS_RUNNING;
+      if(bus->cpu->clock_count < target)
+      {
+        bus->cpu->clock_count = target;
+      }
+      sys->idle[cpu] = 1;
+      break;
+    default:
+      log_info("CPU %d stopped: %s", cpu, bus_stop_reason_string(bus->stop));
+      sys->stop = bus->stop;
+      sys->stopped = cpu;
+      break;
+  }
+}
+
+/*----------------------------------------------------------------------------*/
+static void system_contend(struct System *sys, struct Bus *bus)
+{
+  uint64_t now = CPU6502_now(bus->cpu);
+  int i = 0;
+
+  sys->contended++;
+  if(now + sys->boost > sys->boost_until)
+  {
+    sys->boost_until = now + sys->boost;
+  }
+
+  /* The access may wake a CPU that went idle earlier in this slice, it has
+   * to run again before the system may stop */
+  for(i = 0; i < sys->cpus; i++)
+  {
+    if(sys->bus[i] != bus)
+    {
+      sys->idle[i] = 0;
+    }
+  }
+
+  /* Hand over to the CPUs behind unless they are close enough already */
+  if(sys->running && now > sys->base + sys->tight)
+  {
+    bus_stop(bus, BUS_STOP_YIELD);
+  }
+}
+
+/*----------------------------------------------------------------------------*/
+static void system_mailbox_update(struct SystemPort *port)
+{
+  uint8_t irq = port->irq >= 0 && port->full;
+
+  if(irq != port->asserted)
+  {
+    port->asserted = irq;
+    if(irq)
+    {
+      bus_irq_assert(port->bus, port->irq);
+    }
+    else
+    {
+      bus_irq_release(port->bus, port->irq);
+    }
+  }
+}
@@ -0,0 +1,586 @@
+/*
+ * Copyright (c) 2022, Bernd Bauer <bernd.bauer@gmx.at>
+ *
+ * SPDX-License-Identifier: BSD-2-Clause
+ */
+
+#define _GNU_SOURCE
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <termios.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+
+#include "util/log.h"
+#include "util/ring.h"
+
+#include "core/bus.h"
+#include "core/device.h"
+#include "core/uart.h"
+
+static uint8_t uart_read(void *ctx, uint16_t offset);
+static void uart_write(void *ctx, uint16_t offset, uint8_t data);
+static uint8_t uart_peek(void *ctx, uint16_t offset);
+static void uart_tick(void *ctx, uint64_t now);
+static void uart_reset(void *ctx);
+static void uart_release(void *ctx);
+
+static int uart_open_pty(struct Uart *uart);
+static int uart_open_socket(struct Uart *uart, const char *path);
+static void uart_update(struct Uart *uart);
+static void uart_schedule(struct Uart *uart, uint64_t now);
+static void uart_kick(struct Uart *uart);
+
+static void* uart_thread(void *arg);
+static void uart_accept(struct Uart *uart);
+static void uart_receive(struct Uart *uart);
+static void uart_send(struct Uart *uart);
+static void uart_watch(struct Uart *uart);
+static void uart_hangup(struct Uart *uart);
+
+static const struct DeviceOps uart_ops = {
+  .name = "uart",
+  .read = uart_read,
+  .write = uart_write,
+  .peek = uart_peek,
+  .tick = uart_tick,
+  .reset = uart_reset,
+  .destroy = uart_release
+};
+
+/*----------------------------------------------------------------------------*/
+struct Uart* uart_create(struct Bus *bus, uint16_t start, int irq, const char *path)
+{
+  struct Uart *uart = NULL;
+  struct epoll_event ev;
+  int ret = 0;
+
+  if(irq < 0 || irq >= BUS_IRQ_LINES || start > 0x10000 - UART_REGISTERS)
+  {
+    log_error("Invalid UART at 0x%04x on IRQ line %d", start, irq);
+    return NULL;
+  }
+
+  uart = calloc(1, sizeof(struct Uart));
+  if(uart == NULL)
+  {
+    log_error("Could not allocate memory for struct Uart");
+    return NULL;
+  }
+
+  uart->bus = bus;
+  uart->irq = irq;
+  uart->interval = UART_INTERVAL;
+  uart->listen_fd = -1;
+  uart->fd = -1;
+  uart->slave_fd = -1;
+  uart->epoll_fd = -1;
+  uart->event_fd = -1;
+
+  uart->rx = ring_create(UART_RING_SIZE, 1);
+  uart->tx = ring_create(UART_RING_SIZE, 1);
+  if(uart->rx == NULL || uart->tx == NULL)
+  {
+    uart_destroy(&uart);
+    return NULL;
+  }
+
+  uart->epoll_fd = epoll_create1(EPOLL_CLOEXEC);
+  uart->event_fd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+  if(uart->epoll_fd < 0 || uart->event_fd < 0)
+  {
+    log_error("Could not create UART event loop: %s", strerror(errno));
+    uart_destroy(&uart);
+    return NULL;
+  }
+  ev.events = EPOLLIN;
+  ev.data.fd = uart->event_fd;
+  epoll_ctl(uart->epoll_fd, EPOLL_CTL_ADD, uart->event_fd, &ev);
+
+  if(path == NULL || strcmp(path, UART_PTY) == 0)
+  {
+    ret = uart_open_pty(uart);
+  }
+  else
+  {
+    ret = uart_open_socket(uart, path);
+  }
+  if(ret != 0)
+  {
+    uart_destroy(&uart);
+    return NULL;
+  }
+
+  uart->dev = device_attach(bus, start, start + UART_REGISTERS - 1, &uart_ops, uart);
+  if(uart->dev == NULL)
+  {
+    uart_destroy(&uart);
+    return NULL;
+  }
+
+  uart->running = 1;
+  if(pthread_create(&uart->thread, NULL, uart_thread, uart) != 0)
+  {
+    log_error("Could not start UART thread");
+    uart->running = 0;
+    uart_destroy(&uart);
+    return NULL;
+  }
+
+  log_info("Create UART at 0x%04x on %s", start, uart->name);
+
+  return uart;
+}
+
+/*----------------------------------------------------------------------------*/
+void uart_destroy(struct Uart **uart)
+{
+  if(*uart)
+  {
+    struct Uart *u = *uart;
+
+    if(u->running)
+    {
+      __atomic_store_n(&u->running, 0, __ATOMIC_RELEASE);
+      uart_kick(u);
+      pthread_join(u->thread, NULL);
+    }
+    if(u->asserted)
+    {
+      bus_irq_release(u->bus, u->irq);
+    }
+    device_detach(&u->dev);
+
+    if(u->fd >= 0)
+    {
+      close(u->fd);
+    }
+    if(u->slave_fd >= 0)
+    {
+      close(u->slave_fd);
+    }
+    if(u->listen_fd >= 0)
+    {
+      close(u->listen_fd);
+      unlink(u->name);
+    }
+    if(u->epoll_fd >= 0)
+    {
+      close(u->epoll_fd);
+    }
+    if(u->event_fd >= 0)
+    {
+      close(u->event_fd);
+    }
+    ring_destroy(&u->rx);
+    ring_destroy(&u->tx);
+
+    free(u);
+    *uart = NULL;
+  }
+}
+
+/*----------------------------------------------------------------------------*/
+static uint8_t uart_read(void *ctx, uint16_t offset)
+{
+  struct Uart *uart = ctx;
+  uint8_t data = 0;
+
+  if(offset != UART_DATA)
+  {
+    return uart_peek(ctx, offset);
+  }
+
+  ring_pop(uart->rx, &data, 1);
+  uart_update(uart);
+
+  /* Pairs with the check in uart_receive(), either side sees the other */
+  __atomic_thread_fence(__ATOMIC_SEQ_CST);
+  uart_schedule(uart, uart->dev->synced);
+
+  return data;
+}
+
+/*----------------------------------------------------------------------------*/
+static void uart_write(void *ctx, uint16_t offset, uint8_t data)
+{
+  struct Uart *uart = ctx;
+
+  switch(offset)
+  {
+    case UART_DATA:
+      if(ring_push(uart->tx, &data, 1) == 0)
+      {
+        log_debug("UART send queue full, byte 0x%02x dropped", data);
+      }
+      break;
+    case UART_CONTROL:
+      uart->control = data & UART_CONTROL_RX_IRQ;
+      uart_update(uart);
+      break;
+  }
+
+  uart_schedule(uart, uart->dev->synced);
+}
+
+/*----------------------------------------------------------------------------*/
+static uint8_t uart_peek(void *ctx, uint16_t offset)
+{
+  struct Uart *uart = ctx;
+  uint8_t status = 0;
+  uint32_t count = 0;
+
+  switch(offset)
+  {
+    case UART_STATUS:
+      status |= ring_count(uart->rx) > 0 ? UART_STATUS_RX_READY : 0;
+      status |= ring_free(uart->tx) > 0 ? UART_STATUS_TX_READY : 0;
+      status |= __atomic_load_n(&uart->fd, __ATOMIC_RELAXED) >= 0 ? UART_STATUS_CONNECTED : 0;
+      status |= uart->asserted ? UART_STATUS_IRQ : 0;
+      return status;
+    case UART_CONTROL:
+      return uart->control;
+    case UART_RXCOUNT:
+      count = ring_count(uart->rx);
+      return count > 0xFF ? 0xFF : count;
+  }
+
+  return 0;
+}
+
+/*----------------------------------------------------------------------------*/
+static void uart_tick(void *ctx, uint64_t now)
+{
+  struct Uart *uart = ctx;
+
+  /* One wake up of the host thread for everything sent since the last */
+  if(ring_count(uart->tx) > 0 ||
+     (__atomic_load_n(&uart->throttled, __ATOMIC_ACQUIRE) && ring_free(uart->rx) > 0))
+  {
+    uart_kick(uart);
+  }
+
+  uart_update(uart);
+  uart_schedule(uart, now);
+}
+
+/*----------------------------------------------------------------------------*/
+static void uart_reset(void *ctx)
+{
+  struct Uart *uart = ctx;
+
+  /* The clock restarts at zero, queued output is flushed from there */
+  uart->control = 0;
+  device_cancel(uart->dev);
+  uart_update(uart);
+  uart_schedule(uart, 0);
+}
+
+/*----------------------------------------------------------------------------*/
+static void uart_release(void *ctx)
+{
+  struct Uart *uart = ctx;
+
+  uart_destroy(&uart);
+}
+
+/*----------------------------------------------------------------------------*/
+static int uart_open_pty(struct Uart *uart)
+{
+  struct termios tio;
+  struct epoll_event ev;
+
+  uart->fd = posix_openpt(O_RDWR | O_NOCTTY | O_NONBLOCK | O_CLOEXEC);
+  if(uart->fd < 0 || grantpt(uart->fd) != 0 || unlockpt(uart->fd) != 0 ||
+     ptsname_r(uart->fd, uart->name, sizeof(uart->name)) != 0)
+  {
+    log_error("Could not open pseudo terminal: %s", strerror(errno));
+    return -1;
+  }
+
+  /* Hold the slave open, the master would report a hang up between two
+   * clients otherwise */
+  uart->slave_fd = open(uart->name, O_RDWR | O_NOCTTY | O_CLOEXEC);
+  if(uart->slave_fd < 0)
+  {
+    log_error("Could not open %s: %s", uart->name, strerror(errno));
+    return -1;
+  }
+  if(tcgetattr(uart->slave_fd, &tio) == 0)
+  {
+    cfmakeraw(&tio);
+    tcsetattr(uart->slave_fd, TCSANOW, &tio);
+  }
+
+  uart->watching = EPOLLIN;
+  ev.events = uart->watching;
+  ev.data.fd = uart->fd;
+
+  return epoll_ctl(uart->epoll_fd, EPOLL_CTL_ADD, uart->fd, &ev);
+}
+
+/*----------------------------------------------------------------------------*/
+static int uart_open_socket(struct Uart *uart, const char *path)
+{
+  struct sockaddr_un addr;
+  struct epoll_event ev;
+
+  if(strlen(path) >= sizeof(addr.sun_path))
+  {
+    log_error("Socket path %s too long", path);
+    return -1;
+  }
+
+  memset(&addr, 0, sizeof(addr));
+  addr.sun_family = AF_UNIX;
+  strcpy(addr.sun_path, path);
+  unlink(path);
+
+  uart->listen_fd = socket(AF_UNIX, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+  if(uart->listen_fd < 0 || bind(uart->listen_fd, (struct sockaddr *)&addr, sizeof(addr)) != 0 ||
+     listen(uart->listen_fd, 1) != 0)
+  {
+    log_error("Could not listen on %s: %s", path, strerror(errno));
+    return -1;
+  }
+  snprintf(uart->name, sizeof(uart->name), "%s", path);
+
+  ev.events = EPOLLIN;
+  ev.data.fd = uart->listen_fd;
+
+  return epoll_ctl(uart->epoll_fd, EPOLL_CTL_ADD, uart->listen_fd, &ev);
+}
+
+/*----------------------------------------------------------------------------*/
+static void uart_update(struct Uart *uart)
+{
+  uint8_t irq = (uart->control & UART_CONTROL_RX_IRQ) && ring_count(uart->rx) > 0;
+
+  if(irq != uart->asserted)
+  {
+    uart->asserted = irq;
+    if(irq)
+    {
+      bus_irq_assert(uart->bus, uart->irq);
+    }
+    else
+    {
+      bus_irq_release(uart->bus, uart->irq);
+    }
+  }
+}
+
+/*----------------------------------------------------------------------------*/
+static void uart_schedule(struct Uart *uart, uint64_t now)
+{
+  /* Poll while somebody waits for received bytes or sent bytes wait for
+   * the host thread */
+  if(uart->dev->event < 0 &&
+     ((uart->control & UART_CONTROL_RX_IRQ) || ring_count(uart->tx) > 0 ||
+      __atomic_load_n(&uart->throttled, __ATOMIC_ACQUIRE)))
+  {
+    device_schedule(uart->dev, now + uart->interval);
+  }
+}
+
+/*----------------------------------------------------------------------------*/
+static void uart_kick(struct Uart *uart)
+{
+  uint64_t one = 1;
+
+  if(write(uart->event_fd, &one, sizeof(one)) < 0 && errno != EAGAIN)
+  {
+    log_error("Could not wake UART thread: %s", strerror(errno));
+  }
+}
+
+/*----------------------------------------------------------------------------*/
+static void* uart_thread(void *arg)
+{
+  struct Uart *uart = arg;
+  struct epoll_event events[4];
+
+  while(__atomic_load_n(&uart->running, __ATOMIC_ACQUIRE))
+  {
+    int n = epoll_wait(uart->epoll_fd, events, 4, -1);
+    int i = 0;
+
+    if(n < 0 && errno != EINTR)
+    {
+      log_error("UART event loop failed: %s", strerror(errno));
+      break;
+    }
+
+    for(i = 0; i < n; i++)
+    {
+      int fd = events[i].data.fd;
+
+      if(fd == uart->event_fd)
+      {
+        uint64_t count = 0;
+
+        if(read(uart->event_fd, &count, sizeof(count)) < 0 && errno != EAGAIN)
+        {
+          log_error("Could not read UART event: %s", strerror(errno));
+        }
+      }
+      else if(fd == uart->listen_fd)
+      {
+        uart_accept(uart);
+      }
+      else if(fd == uart->fd && (events[i].events & EPOLLIN))
+      {
+        uart_receive(uart);
+      }
+      else if(fd == uart->fd && (events[i].events & (EPOLLHUP | EPOLLERR)))
+      {
+        uart_hangup(uart);
+      }
+    }
+
+    /* The guest made room again */
+    if(uart->throttled && ring_free(uart->rx) > 0)
+    {
+      __atomic_store_n(&uart->throttled, 0, __ATOMIC_RELEASE);
+    }
+
+    uart_send(uart);
+    uart_watch(uart);
+  }
+
+  return NULL;
+}
+
+/*----------------------------------------------------------------------------*/
+static void uart_accept(struct Uart *uart)
+{
+  struct epoll_event ev;
+  int fd = accept4(uart->listen_fd, NULL, NULL, SOCK_NONBLOCK | SOCK_CLOEXEC);
+
+  if(fd < 0)
+  {
+    return;
+  }
+  if(uart->fd >= 0)
+  {
+    log_info("UART %s already connected, refuse peer", uart->name);
+    close(fd);
+    return;
+  }
+
+  log_info("UART %s connected", uart->name);
+
+  /* uart_watch() enables the events */
+  uart->watching = 0;
+  ev.events = 0;
+  ev.data.fd = fd;
+  epoll_ctl(uart->epoll_fd, EPOLL_CTL_ADD, fd, &ev);
+
+  __atomic_store_n(&uart->fd, fd, __ATOMIC_RELEASE);
+}
+
+/*----------------------------------------------------------------------------*/
+static void uart_receive(struct Uart *uart)
+{
+  uint8_t buf[4096];
+  uint32_t space = ring_free(uart->rx);
+  ssize_t n = 0;
+
+  /* Stop reading until the guest drains the ring, the peer blocks. The
+   * guest may have made room before it could see the flag. */
+  if(space == 0)
+  {
+    __atomic_store_n(&uart->throttled, 1, __ATOMIC_SEQ_CST);
+    space = ring_free(uart->rx);
+    if(space == 0)
+    {
+      return;
+    }
+    __atomic_store_n(&uart->throttled, 0, __ATOMIC_RELEASE);
+  }
+
+  n = read(uart->fd, buf, space < sizeof(buf) ? space : sizeof(buf));
+  if(n > 0)
+  {
+    ring_push(uart->rx, buf, n);
+  }
+  else if(n == 0 || (errno != EAGAIN && errno != EINTR))
+  {
+    uart_hangup(uart);
+  }
+}
+
+/*----------------------------------------------------------------------------*/
+static void uart_send(struct Uart *uart)
+{
+  /* Without a peer the bytes wait in the ring */
+  while(uart->fd >= 0)
+  {
+    ssize_t n = 0;
+
+    if(uart->pending_off == uart->pending_len)
+    {
+      uart->pending_len = ring_pop(uart->tx, uart->pending, sizeof(uart->pending));
+      uart->pending_off = 0;
+      if(uart->pending_len == 0)
+      {
+        break;
+      }
+    }
+
+    n = write(uart->fd, uart->pending + uart->pending_off, uart->pending_len - uart->pending_off);
+    if(n > 0)
+    {
+      uart->pending_off += n;
+    }
+    else if(n < 0 && errno == EAGAIN)
+    {
+      break;
+    }
+    else if(n < 0 && errno != EINTR)
+    {
+      uart_hangup(uart);
+    }
+  }
+}
+
+/*----------------------------------------------------------------------------*/
+static void uart_watch(struct Uart *uart)
+{
+  struct epoll_event ev;
+
+  if(uart->fd < 0)
+  {
+    return;
+  }
+
+  ev.events = (uart->throttled ? 0 : EPOLLIN) | (uart->pending_off < uart->pending_len ? EPOLLOUT : 0);
+  ev.data.fd = uart->fd;
+  if(ev.events != uart->watching)
+  {
+    uart->watching = ev.events;
+    epoll_ctl(uart->epoll_fd, EPOLL_CTL_MOD, uart->fd, &ev);
+  }
+}
+
+/*----------------------------------------------------------------------------*/
+static void uart_hangup(struct Uart *uart)
+{
+  int fd = uart->fd;
+
+  log_info("UART %s disconnected", uart->name);
+
+  epoll_ctl(uart->epoll_fd, EPOLL_CTL_DEL, fd, NULL);
+  __atomic_store_n(&uart->fd, -1, __ATOMIC_RELEASE);
+  close(fd);
+
+  uart->pending_len = 0;
+  uart->pending_off = 0;
+}
@@ -0,0 +1,673 @@
+/*
+ * Copyright (c) 2022, Bernd Bauer <bernd.bauer@gmx.at>
+ *
+ * SPDX-License-Identifier: BSD-2-Clause
+ */
+
+#include <stdlib.h>
+
+#include "util/log.h"
+
+#include "core/bus.h"
+#include "core/device.h"
+#include "core/via.h"
+
+static uint8_t via_read(void *ctx, uint16_t offset);
+static void via_write(void *ctx, uint16_t offset, uint8_t data);
+static uint8_t via_peek(void *ctx, uint16_t offset);
+static void via_sync(void *ctx, uint64_t from, uint64_t to);
+static void via_tick(void *ctx, uint64_t now);
+static void via_reset(void *ctx);
+static void via_release(void *ctx);
+
+static uint16_t via_t1(struct VIA *via, uint64_t now);
+static uint16_t via_t2(struct VIA *via, uint64_t now);
+static uint8_t via_port(struct VIA *via, uint8_t port);
+static uint64_t via_shift_period(struct VIA *via);
+static void via_shift_start(struct VIA *via, uint64_t now);
+static void via_shift_done(struct VIA *via);
+static void via_clear_port(struct VIA *via, uint8_t port);
+static void via_notify(struct VIA *via, uint8_t port, uint8_t value);
+static void via_update(struct VIA *via);
+static void via_schedule(struct VIA *via);
+
+static const struct DeviceOps via_ops = {
+  .name = "via",
+  .read = via_read,
+  .write = via_write,
+  .peek = via_peek,
+  .sync = via_sync,
+  .tick = via_tick,
+  .reset = via_reset,
+  .destroy = via_release
+};
+
+/*----------------------------------------------------------------------------*/
+struct VIA* via_create(struct Bus *bus, uint16_t start, int irq)
+{
+  struct VIA *via = NULL;
+
+  if(irq < 0 || irq >= BUS_IRQ_LINES || start > 0x10000 - VIA_REGISTERS)
+  {
+    log_error("Invalid VIA at 0x%04x on IRQ line %d", start, irq);
+    return NULL;
+  }
+
+  log_info("Create VIA at 0x%04x on IRQ line %d", start, irq);
+
+  via = calloc(1, sizeof(struct VIA));
+  if(via == NULL)
+  {
+    log_error("Could not allocate memory for struct VIA");
+    return NULL;
+  }
+
+  via->bus = bus;
+  via->irq = irq;
+  via->in[VIA_PORT_A] = 0xFF;
+  via->in[VIA_PORT_B] = 0xFF;
+  via->pb7 = 1;
+
+  via->dev = device_attach(bus, start, start + VIA_REGISTERS - 1, &via_ops, via);
+  if(via->dev == NULL)
+  {
+    free(via);
+    return NULL;
+  }
+  via->t1_base = via->dev->synced;
+  via->t2_base = via->dev->synced;
+
+  return via;
+}
+
+/*----------------------------------------------------------------------------*/
+void via_destroy(struct VIA **via)
+{
+  if(*via)
+  {
+    struct VIA *v = *via;
+
+    if(v->asserted)
+    {
+      bus_irq_release(v->bus, v->irq);
+    }
+    device_detach(&v->dev);
+
+    free(v);
+    *via = NULL;
+  }
+}
+
+/*----------------------------------------------------------------------------*/
+int via_connect(struct VIA *via, void (*output)(void *ctx, uint8_t port, uint8_t value), void *ctx)
+{
+  via->output = output;
+  via->output_ctx = ctx;
+
+  return 0;
+}
+
+/*----------------------------------------------------------------------------*/
+int via_input(struct VIA *via, uint8_t port, uint8_t value)
+{
+  if(port > VIA_PORT_B)
+  {
+    log_error("Invalid VIA port %d", port);
+    return -1;
+  }
+
+  device_sync(via->dev, CPU6502_now(via->bus->cpu));
+
+  /* Timer 2 counts falling edges on PB6 in pulse mode */
+  if(port == VIA_PORT_B && (via->acr & VIA_ACR_T2_PULSE) && (via->in[port] & ~value & 0x40))
+  {
+    via->t2_value--;
+    if(via->t2_value == 0 && via->t2_armed)
+    {
+      via->ifr |= VIA_INT_T2;
+      via->t2_armed = 0;
+    }
+  }
+  via->in[port] = value;
+
+  via_update(via);
+  via_schedule(via);
+
+  return 0;
+}
+
+/*----------------------------------------------------------------------------*/
+int via_control(struct VIA *via, uint8_t line, uint8_t level)
+{
+  static const uint8_t flag[] = { VIA_INT_CA1, VIA_INT_CA2, VIA_INT_CB1, VIA_INT_CB2 };
+  uint8_t control = 0;
+  uint8_t active = 0;
+  uint8_t rising = 0;
+
+  if(line > VIA_CB2)
+  {
+    log_error("Invalid VIA control line %d", line);
+    return -1;
+  }
+
+  level = level ? 1 : 0;
+  if(level == via->ctrl[line])
+  {
+    return 0;
+  }
+
+  device_sync(via->dev, CPU6502_now(via->bus->cpu));
+  via->ctrl[line] = level;
+  rising = level;
+
+  /* PCR holds 4 bits per port: CA1 edge, then CA2 input/output and edge */
+  control = (line < VIA_CB1) ? via->pcr : via->pcr >> 4;
+  if((line & 1) == 0)
+  {
+    active = ((control & 0x01) != 0) == rising;
+  }
+  else
+  {
+    active = (control & 0x08) == 0 && ((control & 0x04) != 0) == rising;
+  }
+  if(active)
+  {
+    via->ifr |= flag[line];
+  }
+
+  /* Shift register clocked by CB1, a bit per rising edge */
+  if(line == VIA_CB1 && rising && via->sr_bits > 0)
+  {
+    uint8_t mode = (via->acr >> VIA_ACR_SR_SHIFT) & 0x07;
+
+    if(mode == 3)
+    {
+      via->sr = (via->sr << 1) | via->ctrl[VIA_CB2];
+      if(--via->sr_bits == 0)
+      {
+        via_shift_done(via);
+      }
+    }
+    else if(mode == 7)
+    {
+      via->sr = (via->sr << 1) | (via->sr >> 7);
+      if(--via->sr_bits == 0)
+      {
+        via_shift_done(via);
+      }
+    }
+  }
+
+  via_update(via);
+  via_schedule(via);
+
+  return 0;
+}
+
+/*----------------------------------------------------------------------------*/
+uint8_t via_output(struct VIA *via, uint8_t port)
+{
+  if(port == VIA_PORT_A)
+  {
+    return via->ora & via->ddra;
+  }
+  if(port == VIA_PORT_B)
+  {
+    uint8_t value = via->orb & via->ddrb;
+
+    if(via->acr & VIA_ACR_T1_PB7)
+    {
+      value = (value & 0x7F) | (via->pb7 << 7);
+    }
+    return value;
+  }
+
+  return via->sr;
+}
+
+/*----------------------------------------------------------------------------*/
+static uint8_t via_read(void *ctx, uint16_t offset)
+{
+  struct VIA *via = ctx;
+  uint8_t data = via_peek(ctx, offset);
+
+  switch(offset)
+  {
+    case VIA_ORB:
+      via_clear_port(via, VIA_PORT_B);
+      break;
+    case VIA_ORA:
+      via_clear_port(via, VIA_PORT_A);
+      break;
+    case VIA_T1CL:
+      via->ifr &= ~VIA_INT_T1;
+      break;
+    case VIA_T2CL:
+      via->ifr &= ~VIA_INT_T2;
+      break;
+    case VIA_SR:
+      via_shift_start(via, via->dev->synced);
+      break;
+    default:
+      return data;
+  }
+
+  via_update(via);
+  via_schedule(via);
+
+  return data;
+}
+
+/*----------------------------------------------------------------------------*/
+static void via_write(void *ctx, uint16_t offset, uint8_t data)
+{
+  struct VIA *via = ctx;
+  uint64_t now = via->dev->synced;
+
+  switch(offset)
+  {
+    case VIA_ORB:
+      via->orb = data;
+      via_clear_port(via, VIA_PORT_B);
+      via_notify(via, VIA_PORT_B, via_output(via, VIA_PORT_B));
+      break;
+    case VIA_ORA:
+      via_clear_port(via, VIA_PORT_A);
+      /* fall through */
+    case VIA_ORA_NH:
+      via->ora = data;
+      via_notify(via, VIA_PORT_A, via_output(via, VIA_PORT_A));
+      break;
+    case VIA_DDRB:
+      via->ddrb = data;
+      via_notify(via, VIA_PORT_B, via_output(via, VIA_PORT_B));
+      break;
+    case VIA_DDRA:
+      via->ddra = data;
+      via_notify(via, VIA_PORT_A, via_output(via, VIA_PORT_A));
+      break;
+    case VIA_T1CL:
+    case VIA_T1LL:
+      via->t1_latch = (via->t1_latch & 0xFF00) | data;
+      break;
+    case VIA_T1CH:
+      /* Load the counter, the underflow follows latch + 1 cycles later */
+      via->t1_latch = (via->t1_latch & 0x00FF) | (data << 8);
+      via->t1_value = via->t1_latch;
+      via->t1_base = now;
+      via->t1_armed = 1;
+      via->ifr &= ~VIA_INT_T1;
+      if(via->acr & VIA_ACR_T1_PB7)
+      {
+        via->pb7 = 0;
+        via_notify(via, VIA_PORT_B, via_output(via, VIA_PORT_B));
+      }
+      break;
+    case VIA_T1LH:
+      via->t1_latch = (via->t1_latch & 0x00FF) | (data << 8);
+      via->ifr &= ~VIA_INT_T1;
+      break;
+    case VIA_T2CL:
+      via->t2_latch = data;
+      break;
+    case VIA_T2CH:
+      via->t2_value = via->t2_latch | (data << 8);
+      via->t2_base = now;
+      via->t2_armed = 1;
+      via->ifr &= ~VIA_INT_T2;
+      break;
+    case VIA_SR:
+      via->sr = data;
+      via_shift_start(via, now);
+      break;
+    case VIA_ACR:
+      /* Rebase the timers, the new modes count from here */
+      via->t1_value = via_t1(via, now);
+      via->t1_base = now;
+      via->t2_value = via_t2(via, now);
+      via->t2_base = now;
+      via->acr = data;
+      break;
+    case VIA_PCR:
+      via->pcr = data;
+      break;
+    case VIA_IFR:
+      via->ifr &= ~(data & 0x7F);
+      break;
+    case VIA_IER:
+      if(data & 0x80)
+      {
+        via->ier |= data & 0x7F;
+      }
+      else
+      {
+        via->ier &= ~(data & 0x7F);
+      }
+      break;
+  }
+
+  via_update(via);
+  via_schedule(via);
+}
+
+/*----------------------------------------------------------------------------*/
+static uint8_t via_peek(void *ctx, uint16_t offset)
+{
+  struct VIA *via = ctx;
+  uint64_t now = via->dev->synced;
+
+  switch(offset)
+  {
+    case VIA_ORB:
+      return via_port(via, VIA_PORT_B);
+    case VIA_ORA:
+    case VIA_ORA_NH:
+      return via_port(via, VIA_PORT_A);
+    case VIA_DDRB:
+      return via->ddrb;
+    case VIA_DDRA:
+      return via->ddra;
+    case VIA_T1CL:
+      return via_t1(via, now) & 0xFF;
+    case VIA_T1CH:
+      return via_t1(via, now) >> 8;
+    case VIA_T1LL:
+      return via->t1_latch & 0xFF;
+    case VIA_T1LH:
+      return via->t1_latch >> 8;
+    case VIA_T2CL:
+      return via_t2(via, now) & 0xFF;
+    case VIA_T2CH:
+      return via_t2(via, now) >> 8;
+    case VIA_SR:
+      return via->sr;
+    case VIA_ACR:
+      return via->acr;
+    case VIA_PCR:
+      return via->pcr;
+    case VIA_IFR:
+      return via->ifr | ((via->ifr & via->ier & 0x7F) ? VIA_INT_ANY : 0);
+    case VIA_IER:
+      return via->ier | 0x80;
+  }
+
+  return 0;
+}
+
+/*----------------------------------------------------------------------------*/
+static void via_sync(void *ctx, uint64_t from, uint64_t to)
+{
+  struct VIA *via = ctx;
+  uint64_t underflow = via->t1_base + via->t1_value + 1;
+  uint64_t period = 0;
+  uint8_t pb7 = via->pb7;
+
+  /* Timer 1, every underflow in (from, to] at once */
+  if(underflow <= to)
+  {
+    if(via->acr & VIA_ACR_T1_FREE)
+    {
+      uint64_t n = 0;
+
+      /* 0xFFFF for one cycle, then the latch is reloaded */
+      period = (uint64_t)via->t1_latch + 2;
+      n = (to - underflow) / period + 1;
+
+      via->ifr |= VIA_INT_T1;
+      via->pb7 ^= n & 1;
+      via->t1_base = underflow + 1 + (n - 1) * period;
+      via->t1_value = via->t1_latch;
+    }
+    else if(via->t1_armed)
+    {
+      via->ifr |= VIA_INT_T1;
+      via->t1_armed = 0;
+      via->pb7 = 1;
+    }
+
+    if((via->acr & VIA_ACR_T1_PB7) && via->pb7 != pb7)
+    {
+      via_notify(via, VIA_PORT_B, via_output(via, VIA_PORT_B));
+    }
+  }
+
+  /* Timer 2 interrupts once per load and counts on */
+  if(via->t2_armed && !(via->acr & VIA_ACR_T2_PULSE) && via->t2_base + via->t2_value + 1 <= to)
+  {
+    via->ifr |= VIA_INT_T2;
+    via->t2_armed = 0;
+  }
+
+  period = via_shift_period(via);
+  if(via->sr_bits > 0 && period > 0 && via->sr_base + 8 * period <= to)
+  {
+    via_shift_done(via);
+  }
+
+  via_update(via);
+}
+
+/*----------------------------------------------------------------------------*/
+static void via_tick(void *ctx, uint64_t now)
+{
+  struct VIA *via = ctx;
+
+  /* via_sync() already ran up to the event */
+  via_schedule(via);
+}
+
+/*----------------------------------------------------------------------------*/
+static void via_reset(void *ctx)
+{
+  struct VIA *via = ctx;
+
+  log_debug("Reset VIA");
+
+  /* Timers and the shift register keep their contents, the clock restarts
+   * at zero with the bus reset */
+  via->t1_value = via_t1(via, via->dev->synced);
+  via->t1_base = 0;
+  via->t1_armed = 0;
+  via->t2_value = via_t2(via, via->dev->synced);
+  via->t2_base = 0;
+  via->t2_armed = 0;
+  via->sr_bits = 0;
+
+  via->orb = 0;
+  via->ora = 0;
+  via->ddrb = 0;
+  via->ddra = 0;
+  via->acr = 0;
+  via->pcr = 0;
+  via->ifr = 0;
+  via->ier = 0;
+  via->pb7 = 1;
+
+  device_cancel(via->dev);
+  via_update(via);
+}
+
+/*----------------------------------------------------------------------------*/
+static void via_release(void *ctx)
+{
+  struct VIA *via = ctx;
+
+  via_destroy(&via);
+}
+
+/*----------------------------------------------------------------------------*/
+static uint16_t via_t1(struct VIA *via, uint64_t now)
+{
+  /* A free running timer shows 0xFFFF in the cycle before the reload */
+  if(now < via->t1_base)
+  {
+    return 0xFFFF;
+  }
+
+  return (uint16_t)(via->t1_value - (now - via->t1_base));
+}
+
+/*----------------------------------------------------------------------------*/
+static uint16_t via_t2(struct VIA *via, uint64_t now)
+{
+  if(via->acr & VIA_ACR_T2_PULSE)
+  {
+    return via->t2_value;
+  }
+
+  return (uint16_t)(via->t2_value - (now - via->t2_base));
+}
+
+/*----------------------------------------------------------------------------*/
+static uint8_t via_port(struct VIA *via, uint8_t port)
+{
+  uint8_t value = 0;
+
+  if(port == VIA_PORT_A)
+  {
+    return (via->ora & via->ddra) | (via->in[port] & ~via->ddra);
+  }
+
+  value = (via->orb & via->ddrb) | (via->in[port] & ~via->ddrb);
+  if(via->acr & VIA_ACR_T1_PB7)
+  {
+    value = (value & 0x7F) | (via->pb7 << 7);
+  }
+
+  return value;
+}
+
+/*----------------------------------------------------------------------------*/
+static uint64_t via_shift_period(struct VIA *via)
+{
+  /* Cycles per bit, 0 for shifting by CB1 or disabled */
+  switch((via->acr >> VIA_ACR_SR_SHIFT) & 0x07)
+  {
+    case 1:
+    case 4:
+    case 5:
+      return 2 * ((uint64_t)via->t2_latch + 2);
+    case 2:
+    case 6:
+      return 2;
+  }
+
+  return 0;
+}
+
+/*----------------------------------------------------------------------------*/
+static void via_shift_start(struct VIA *via, uint64_t now)
+{
+  via->ifr &= ~VIA_INT_SR;
+  if(((via->acr >> VIA_ACR_SR_SHIFT) & 0x07) != 0)
+  {
+    via->sr_bits = 8;
+    via->sr_base = now;
+  }
+}
+
+/*----------------------------------------------------------------------------*/
+static void via_shift_done(struct VIA *via)
+{
+  uint8_t mode = (via->acr >> VIA_ACR_SR_SHIFT) & 0x07;
+
+  /* Free running output repeats without interrupts */
+  if(mode == 4)
+  {
+    return;
+  }
+
+  via->sr_bits = 0;
+  via->ifr |= VIA_INT_SR;
+
+  /* A clocked shift in reads eight times the CB2 level */
+  if(mode == 1 || mode == 2)
+  {
+    via->sr = via->ctrl[VIA_CB2] ? 0xFF : 0x00;
+  }
+  else if(mode >= 5)
+  {
+    via_notify(via, VIA_SHIFT, via->sr);
+  }
+}
+
+/*----------------------------------------------------------------------------*/
+static void via_clear_port(struct VIA *via, uint8_t port)
+{
+  uint8_t control = port == VIA_PORT_A ? via->pcr : via->pcr >> 4;
+  uint8_t flags = port == VIA_PORT_A ? VIA_INT_CA1 : VIA_INT_CB1;
+
+  /* CA2/CB2 in independent interrupt mode keep their flag */
+  if((control & 0x0A) != 0x02)
+  {
+    flags |= port == VIA_PORT_A ? VIA_INT_CA2 : VIA_INT_CB2;
+  }
+
+  via->ifr &= ~flags;
+}
+
+/*----------------------------------------------------------------------------*/
+static void via_notify(struct VIA *via, uint8_t port, uint8_t value)
+{
+  if(via->output != NULL)
+  {
+    via->output(via->output_ctx, port, value);
+  }
+}
+
+/*----------------------------------------------------------------------------*/
+static void via_update(struct VIA *via)
+{
+  uint8_t irq = (via->ifr & via->ier & 0x7F) != 0;
+
+  if(irq != via->asserted)
+  {
+    via->asserted = irq;
+    if(irq)
+    {
+      bus_irq_assert(via->bus, via->irq);
+    }
+    else
+    {
+      bus_irq_release(via->bus, via->irq);
+    }
+  }
+}
+
+/*----------------------------------------------------------------------------*/
+static void via_schedule(struct VIA *via)
+{
+  uint64_t next = SCHEDULER_NEVER;
+  uint64_t period = via_shift_period(via);
+  uint8_t wanted = via->ier & ~via->ifr;
+
+  /* Only interrupts that would change the IRQ line need an event, all
+   * other flags are caught up on the next access */
+  if((wanted & VIA_INT_T1) && ((via->acr & VIA_ACR_T1_FREE) || via->t1_armed))
+  {
+    uint64_t when = via->t1_base + via->t1_value + 1;
+
+    next = when < next ? when : next;
+  }
+  if((wanted & VIA_INT_T2) && via->t2_armed && !(via->acr & VIA_ACR_T2_PULSE))
+  {
+    uint64_t when = via->t2_base + via->t2_value + 1;
+
+    next = when < next ? when : next;
+  }
+  if((wanted & VIA_INT_SR) && via->sr_bits > 0 && period > 0 && ((via->acr >> VIA_ACR_SR_SHIFT) & 0x07) != 4)
+  {
+    uint64_t when = via->sr_base + 8 * period;
+
+    next = when < next ? when : next;
+  }
+
+  if(next == SCHEDULER_NEVER)
+  {
+    device_cancel(via->dev);
+  }
+  else
+  {
+    device_schedule(via->dev, next);
+  }
+}
@@ -5,11 +5,25 @@
  */
 
 #include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
 
 #include "util/log.h"
 #include "util/tools.h"
 
 #include "core/bus.h"
+#include "core/gdbstub.h"
+#include "core/hostcall.h"
+#include "core/machine.h"
+
+#ifdef CPU6502_AOT
+#include "core/aot.h"
+
+extern const struct AotImage aot_image;
+#endif
+
+#define OPTIONS "c:n:p:bw:t:g:H:o:S:FEP:m:"
 
 static void init(struct Bus* bus)
 {
@@ -26,28 +40,243 @@ static void init(struct Bus* bus)
   memory_dump(bus->rom, 0xFFF0, 0xFFFF);
 }
 
-int main()
+/* Save "start:end:file" after the run, Intel HEX for .hex/.ihx else raw */
+static int save(struct Bus *bus, const char *spec)
+{
+  char *next = NULL;
+  const char *file = NULL;
+  const char *ext = NULL;
+  uint32_t start = 0;
+  uint32_t end = 0;
+  uint8_t *data = NULL;
+  int ret = 0;
+
+  start = strtoul(spec, &next, 0);
+  if(*next == ':')
+  {
+    end = strtoul(next + 1, &next, 0);
+  }
+  if(*next != ':' || start >= end || end > 0x10000)
+  {
+    log_error("Invalid save range %s", spec);
+    return -1;
+  }
+  file = next + 1;
+
+  data = malloc(end - start);
+  if(data == NULL)
+  {
+    log_error("Could not allocate memory for save buffer");
+    return -1;
+  }
+  bus_peek_block(bus, start, data, end - start);
+
+  log_info("Save 0x%04x - 0x%04x to %s", start, end, file);
+  ext = strrchr(file, '.');
+  if(ext != NULL && (strcmp(ext, ".hex") == 0 || strcmp(ext, ".ihx") == 0))
+  {
+    ret = file_saveIntelHex(file, start, data, end - start);
+  }
+  else
+  {
+    ret = file_saveBinary(file, data, end - start);
+  }
+
+  free(data);
+
+  return ret;
+}
+
+static void usage(const char *name)
+{
+  fprintf(stderr, "Usage: %s [options]\n", name);
+  fprintf(stderr, "  -m file    load the machine description instead of test.bin\n");
+  fprintf(stderr, "  -c cycles  stop after the given number of cycles\n");
+  fprintf(stderr, "  -n count   stop after the given number of instructions\n");
+  fprintf(stderr, "  -p addr    stop when PC reaches addr (repeatable)\n");
+  fprintf(stderr, "  -b         stop on BRK\n");
+  fprintf(stderr, "  -w addr    stop on a write to addr\n");
+  fprintf(stderr, "  -t seconds stop after the given wall clock time\n");
+  fprintf(stderr, "  -H page    map the host call page (e.g. 0x7f)\n");
+  fprintf(stderr, "  -o s:e:file save [s, e) after the run (raw, or Intel HEX for .hex)\n");
+  fprintf(stderr, "  -S name    publish RAM and CPU state as POSIX shared memory\n");
+  fprintf(stderr, "  -F         disable instruction fusion\n");
+  fprintf(stderr, "  -E         run the cycle-exact core with every bus access\n");
+  fprintf(stderr, "  -P count   profile and report the most frequent instruction pairs\n");
+  fprintf(stderr, "  -g port    serve GDB on a loopback TCP port or Unix socket path\n");
+}
+
+int main(int argc, char *argv[])
 {
   struct Bus *bus = NULL;
+  struct GdbStub *gdb = NULL;
+  struct HostCall *hc = NULL;
+  const char *machine = NULL;
+  const char *output = NULL;
+  int pairs = 0;
+  int opt = 0;
+  int ret = 0;
 
   log_set_level(LOG_DEBUG);
 
+  /* The machine has to exist before the other options configure it */
+  opterr = 0;
+  while((opt = getopt(argc, argv, OPTIONS)) != -1)
+  {
+    if(opt == 'm')
+    {
+      machine = optarg;
+    }
+  }
+  opterr = 1;
+  optind = 1;
+
   bus = bus_create();
-  init(bus);
+  if(bus == NULL)
+  {
+    return 1;
+  }
+  if(machine == NULL)
+  {
+    init(bus);
+  }
+  else if(machine_load(bus, machine) != 0)
+  {
+    bus_destroy(&bus);
+    return 1;
+  }
   bus_reset(bus);
 
-  do
+  if(device_lookup(bus, "hostcall") != NULL)
   {
-    bus_clock(bus);
-  }while(bus_is_set_to_stop(bus) != 1);
+    hc = device_lookup(bus, "hostcall")->ctx;
+  }
 
-  log_info("RAM DUMP 0x0200 - 0x0220");
-  memory_dump(bus->ram, 0x0200, 0x0220);
+#ifdef CPU6502_AOT
+  aot_install(bus, &aot_image);
+#endif
+
+  while(ret == 0 && (opt = getopt(argc, argv, OPTIONS)) != -1)
+  {
+    switch(opt)
+    {
+      case 'c':
+        stop_at_cycle(bus->stopcond, strtoull(optarg, NULL, 0));
+        break;
+      case 'n':
+        stop_after_instructions(bus->stopcond, strtoull(optarg, NULL, 0));
+        break;
+      case 'p':
+        stop_at_pc(bus->stopcond, strtoul(optarg, NULL, 0));
+        break;
+      case 'b':
+        stop_on_brk(bus->stopcond, 1);
+        break;
+      case 'w':
+        stop_on_write(bus->stopcond, strtoul(optarg, NULL, 0));
+        break;
+      case 't':
+        stop_after_seconds(bus->stopcond, strtod(optarg, NULL));
+        break;
+      case 'H':
+        hc = hostcall_create(bus, strtoul(optarg, NULL, 0), STDOUT_FILENO);
+        if(hc == NULL)
+        {
+          ret = 1;
+        }
+        break;
+      case 'S':
+        if(shmview_create(bus, optarg) == NULL)
+        {
+          ret = 1;
+        }
+        break;
+      case 'F':
+        CPU6502_setFusion(bus->cpu, 0);
+        break;
+      case 'E':
+        CPU6502_setAccuracy(bus->cpu, CPU6502_ACCURACY_EXACT);
+        break;
+      case 'P':
+        pairs = strtol(optarg, NULL, 0);
+        if(CPU6502_profilePairs(bus->cpu, 1) != 0)
+        {
+          ret = 1;
+        }
+        break;
+      case 'o':
+        output = optarg;
+        break;
+      case 'm':
+        break;
+      case 'g':
+        gdbstub_destroy(&gdb);
+        gdb = gdbstub_create(bus, optarg);
+        if(gdb == NULL)
+        {
+          ret = 1;
+        }
+        break;
+      default:
+        usage(argv[0]);
+        ret = 1;
+        break;
+    }
+  }
+
+  /* Option errors, the stub goes before the bus it serves */
+  if(ret != 0)
+  {
+    gdbstub_destroy(&gdb);
+    bus_destroy(&bus);
+    return ret;
+  }
+
+  if(gdb != NULL)
+  {
+    gdbstub_serve(gdb);
+    gdbstub_destroy(&gdb);
+  }
+
+  bus_run(bus, BUS_RUN_FOREVER);
+  log_info("Emulator stopped: %s", bus_stop_reason_string(bus->stop));
+  CPU6502_dumpStatus(bus->cpu);
+
+  if(pairs > 0)
+  {
+    CPU6502_reportPairs(bus->cpu, pairs);
+  }
+
+  if(bus->stop == BUS_STOP_TIMEOUT)
+  {
+    ret = 2;
+  }
+  else if(bus->stop == BUS_STOP_EXIT && hc != NULL)
+  {
+    int i = 0;
+
+    for(i = 0; i < hc->result_count; i++)
+    {
+      log_info("Result %d: 0x%02x", i, hc->results[i]);
+    }
+    ret = hc->exit_status;
+  }
+
+  if(output != NULL && save(bus, output) != 0)
+  {
+    ret = 1;
+  }
+
+  if(bus->ram != NULL && bus->ram->baseaddr == 0x0000)
+  {
+    log_info("RAM DUMP 0x0200 - 0x0220");
+    memory_dump(bus->ram, 0x0200, 0x0220);
 
-  log_info("STACK DUMP 0x0100 - 0x0200");
-  memory_dump(bus->ram, 0x0100, 0x0200);
+    log_info("STACK DUMP 0x0100 - 0x0200");
+    memory_dump(bus->ram, 0x0100, 0x0200);
+  }
 
   bus_destroy(&bus);
 
-  return 0;
+  return ret;
 }
@@ -0,0 +1,218 @@
+/*
+ * Copyright (c) 2022, Bernd Bauer <bernd.bauer@gmx.at>
+ *
+ * SPDX-License-Identifier: BSD-2-Clause
+ */
+
+#include <stdio.h>
+
+#include "util/log.h"
+#include "util/unit.h"
+
+#include "core/bus.h"
+#include "core/bcd.h"
+
+/**
+ * Ripple carry adder over the lowest bits of a and b
+ */
+static uint8_t ref_ripple(uint8_t a, uint8_t b, uint8_t *carry, int bits)
+{
+  uint8_t sum = 0;
+  uint8_t c = *carry;
+  int i = 0;
+
+  for(i = 0; i < bits; i++)
+  {
+    uint8_t x = (a >> i) & 1;
+    uint8_t y = (b >> i) & 1;
+
+    sum |= (x ^ y ^ c) << i;
+    c = (x & y) | (c & (x ^ y));
+  }
+
+  *carry = c;
+  return sum;
+}
+
+/**
+ * Reference decimal ADC: nibble adders with decimal adjust after each
+ * nibble, N and V from the unadjusted high nibble, Z from the binary sum
+ */
+static uint16_t ref_adc(uint8_t a, uint8_t b, uint8_t c)
+{
+  uint8_t flags = 0;
+  uint8_t carry = c;
+  uint8_t lo = 0;
+  uint8_t hi = 0;
+
+  lo = ref_ripple(a & 0x0F, b & 0x0F, &carry, 4);
+  if(carry || lo > 9)
+  {
+    lo = (lo + 6) & 0x0F;
+    carry = 1;
+  }
+  hi = ref_ripple(a >> 4, b >> 4, &carry, 4);
+
+  if(hi & 0x08) flags |= CPU6502_FLAG_NEGATIVE;
+  if(~(a ^ b) & (a ^ (hi << 4)) & 0x80) flags |= CPU6502_FLAG_OVERFLOW;
+
+  if(carry || hi > 9)
+  {
+    hi = (hi + 6) & 0x0F;
+    carry = 1;
+  }
+  if(carry) flags |= CPU6502_FLAG_CARRY;
+
+  carry = c;
+  if(ref_ripple(a, b, &carry, 8) == 0) flags |= CPU6502_FLAG_ZERO;
+
+  return (flags << 8) | (hi << 4) | lo;
+}
+
+/**
+ * Reference decimal SBC: A + ~B + C with nibble wise correction on
+ * borrow, all flags from the binary difference
+ */
+static uint16_t ref_sbc(uint8_t a, uint8_t b, uint8_t c)
+{
+  uint8_t flags = 0;
+  uint8_t carry = c;
+  uint8_t lo = 0;
+  uint8_t hi = 0;
+  uint8_t diff = 0;
+
+  lo = ref_ripple(a & 0x0F, ~b & 0x0F, &carry, 4);
+  if(!carry)
+  {
+    lo = (lo - 6) & 0x0F;
+  }
+  hi = ref_ripple(a >> 4, (~b >> 4) & 0x0F, &carry, 4);
+  if(!carry)
+  {
+    hi = (hi - 6) & 0x0F;
+  }
+  if(carry) flags |= CPU6502_FLAG_CARRY;
+
+  carry = c;
+  diff = ref_ripple(a, ~b, &carry, 8);
+  if(diff == 0) flags |= CPU6502_FLAG_ZERO;
+  if(diff & 0x80) flags |= CPU6502_FLAG_NEGATIVE;
+  if((a ^ b) & (a ^ diff) & 0x80) flags |= CPU6502_FLAG_OVERFLOW;
+
+  return (flags << 8) | (hi << 4) | lo;
+}
+
+/**
+ * Compare every decimal ADC table entry with the reference
+ */
+int bcd_t0001()
+{
+  int a = 0;
+  int b = 0;
+  int c = 0;
+
+  bcd_init();
+
+  for(c = 0; c < 2; c++)
+  {
+    for(a = 0; a < 256; a++)
+    {
+      for(b = 0; b < 256; b++)
+      {
+        if(bcd_adc_table[c][a][b] != ref_adc(a, b, c))
+        {
+          log_error("ADC 0x%02x + 0x%02x + %d: table 0x%04x reference 0x%04x", a, b, c, bcd_adc_table[c][a][b], ref_adc(a, b, c));
+          return -1;
+        }
+      }
+    }
+  }
+
+  return 0;
+}
+
+/**
+ * Compare every decimal SBC table entry with the reference
+ */
+int bcd_t0002()
+{
+  int a = 0;
+  int b = 0;
+  int c = 0;
+
+  bcd_init();
+
+  for(c = 0; c < 2; c++)
+  {
+    for(a = 0; a < 256; a++)
+    {
+      for(b = 0; b < 256; b++)
+      {
+        if(bcd_sbc_table[c][a][b] != ref_sbc(a, b, c))
+        {
+          log_error("SBC 0x%02x - 0x%02x C %d: table 0x%04x reference 0x%04x", a, b, c, bcd_sbc_table[c][a][b], ref_sbc(a, b, c));
+          return -1;
+        }
+      }
+    }
+  }
+
+  return 0;
+}
+
+/**
+ * Run SED; CLC; LDA #$19; ADC #$28; SEC; SBC #$48; CLD on the CPU
+ */
+int bcd_t0003()
+{
+  static const uint8_t code[] = { 0xF8, 0x18, 0xA9, 0x19, 0x69, 0x28, 0x38, 0xE9, 0x48, 0xD8 };
+  struct Bus *bus = NULL;
+  int i = 0;
+
+  bus = bus_create();
+  ASSERT("Failed to create bus", bus!=NULL);
+  bus_reset(bus);
+
+  for(i = 0; i < sizeof(code); i++)
+  {
+    memory_writeByte(bus->ram, 0x0200 + i, code[i]);
+  }
+  bus->cpu->Reg.PC = 0x0200;
+  bus->cpu->cycles = 0;
+
+  for(i = 0; i < 4; i++)
+  {
+    CPU6502_step(bus->cpu);
+  }
+  ASSERT("Decimal mode not set", bus->cpu->Reg.DECIMAL==1);
+  ASSERT("Wrong decimal sum", bus->cpu->Reg.A==0x47 && bus->cpu->Reg.CARRY==0);
+
+  for(i = 0; i < 2; i++)
+  {
+    CPU6502_step(bus->cpu);
+  }
+  ASSERT("Wrong decimal difference", bus->cpu->Reg.A==0x99 && bus->cpu->Reg.CARRY==0);
+
+  CPU6502_step(bus->cpu);
+  ASSERT("Decimal mode not cleared", bus->cpu->Reg.DECIMAL==0);
+
+  bus_destroy(&bus);
+  ASSERT("Failed to destroy bus", bus==NULL);
+
+  return 0;
+}
+
+int main()
+{
+  UNIT_TEST_INIT("BCD");
+
+  log_set_level(LOG_INFO);
+
+  RUN_TEST(bcd_t0001, "Decimal ADC table against reference");
+  RUN_TEST(bcd_t0002, "Decimal SBC table against reference");
+  RUN_TEST(bcd_t0003, "Decimal arithmetic on the CPU");
+
+  UNIT_TEST_ERG();
+
+  return unit_failed == 0 ? 0 : 1;
+}
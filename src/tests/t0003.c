@@ -0,0 +1,322 @@
+/*
+ * Copyright (c) 2022, Bernd Bauer <bernd.bauer@gmx.at>
+ *
+ * SPDX-License-Identifier: BSD-2-Clause
+ */
+
+#include <stdio.h>
+
+#include "util/log.h"
+#include "util/unit.h"
+
+#include "core/bus.h"
+
+#define ZP_ADDR 0x10
+
+enum Mode
+{
+  MODE_IMM,
+  MODE_ZPG,
+  MODE_IMP
+};
+
+struct State
+{
+  uint8_t a;
+  uint8_t x;
+  uint8_t y;
+  uint8_t p;
+  uint8_t m;
+};
+
+typedef void (*ref_Fn)(struct State *s);
+
+struct Instruction
+{
+  uint8_t opcode;
+  uint8_t mode;
+  ref_Fn ref;
+};
+
+/* Straightforward reference implementations, one flag at a time */
+
+static void ref_flag(struct State *s, uint8_t flag, int set)
+{
+  if(set) s->p |= flag; else s->p &= ~flag;
+}
+
+static void ref_nz(struct State *s, uint8_t value)
+{
+  ref_flag(s, CPU6502_FLAG_ZERO, value == 0);
+  ref_flag(s, CPU6502_FLAG_NEGATIVE, value >= 0x80);
+}
+
+static void ref_adc(struct State *s)
+{
+  int c = (s->p & CPU6502_FLAG_CARRY) ? 1 : 0;
+  int sum = s->a + s->m + c;
+  int ssum = (int8_t)s->a + (int8_t)s->m + c;
+
+  ref_flag(s, CPU6502_FLAG_CARRY, sum > 255);
+  ref_flag(s, CPU6502_FLAG_OVERFLOW, ssum < -128 || ssum > 127);
+  s->a = sum;
+  ref_nz(s, s->a);
+}
+
+static void ref_sbc(struct State *s)
+{
+  int b = (s->p & CPU6502_FLAG_CARRY) ? 0 : 1;
+  int diff = s->a - s->m - b;
+  int sdiff = (int8_t)s->a - (int8_t)s->m - b;
+
+  ref_flag(s, CPU6502_FLAG_CARRY, diff >= 0);
+  ref_flag(s, CPU6502_FLAG_OVERFLOW, sdiff < -128 || sdiff > 127);
+  s->a = diff;
+  ref_nz(s, s->a);
+}
+
+static void ref_compare(struct State *s, uint8_t reg)
+{
+  ref_flag(s, CPU6502_FLAG_CARRY, reg >= s->m);
+  ref_nz(s, (uint8_t)(reg - s->m));
+}
+
+static void ref_and(struct State *s) { s->a &= s->m; ref_nz(s, s->a); }
+static void ref_ora(struct State *s) { s->a |= s->m; ref_nz(s, s->a); }
+static void ref_eor(struct State *s) { s->a ^= s->m; ref_nz(s, s->a); }
+static void ref_cmp(struct State *s) { ref_compare(s, s->a); }
+static void ref_cpx(struct State *s) { ref_compare(s, s->x); }
+static void ref_cpy(struct State *s) { ref_compare(s, s->y); }
+static void ref_lda(struct State *s) { s->a = s->m; ref_nz(s, s->a); }
+static void ref_ldx(struct State *s) { s->x = s->m; ref_nz(s, s->x); }
+static void ref_ldy(struct State *s) { s->y = s->m; ref_nz(s, s->y); }
+static void ref_inc(struct State *s) { s->m++; ref_nz(s, s->m); }
+static void ref_dec(struct State *s) { s->m--; ref_nz(s, s->m); }
+static void ref_inx(struct State *s) { s->x++; ref_nz(s, s->x); }
+static void ref_dex(struct State *s) { s->x--; ref_nz(s, s->x); }
+static void ref_iny(struct State *s) { s->y++; ref_nz(s, s->y); }
+static void ref_dey(struct State *s) { s->y--; ref_nz(s, s->y); }
+static void ref_tax(struct State *s) { s->x = s->a; ref_nz(s, s->x); }
+static void ref_txa(struct State *s) { s->a = s->x; ref_nz(s, s->a); }
+
+static void ref_bit(struct State *s)
+{
+  ref_flag(s, CPU6502_FLAG_ZERO, (s->a & s->m) == 0);
+  ref_flag(s, CPU6502_FLAG_NEGATIVE, s->m & 0x80);
+  ref_flag(s, CPU6502_FLAG_OVERFLOW, s->m & 0x40);
+}
+
+static void ref_asl(struct State *s)
+{
+  ref_flag(s, CPU6502_FLAG_CARRY, s->a & 0x80);
+  s->a <<= 1;
+  ref_nz(s, s->a);
+}
+
+static void ref_lsr(struct State *s)
+{
+  ref_flag(s, CPU6502_FLAG_CARRY, s->a & 0x01);
+  s->a >>= 1;
+  ref_nz(s, s->a);
+}
+
+static void ref_rol(struct State *s)
+{
+  uint8_t c = (s->p & CPU6502_FLAG_CARRY) ? 1 : 0;
+
+  ref_flag(s, CPU6502_FLAG_CARRY, s->m & 0x80);
+  s->m = (s->m << 1) | c;
+  ref_nz(s, s->m);
+}
+
+static void ref_ror(struct State *s)
+{
+  uint8_t c = (s->p & CPU6502_FLAG_CARRY) ? 0x80 : 0;
+
+  ref_flag(s, CPU6502_FLAG_CARRY, s->m & 0x01);
+  s->m = (s->m >> 1) | c;
+  ref_nz(s, s->m);
+}
+
+static const struct Instruction instructions[] = {
+  { 0x69, MODE_IMM, ref_adc },
+  { 0xE9, MODE_IMM, ref_sbc },
+  { 0x29, MODE_IMM, ref_and },
+  { 0x09, MODE_IMM, ref_ora },
+  { 0x49, MODE_IMM, ref_eor },
+  { 0xC9, MODE_IMM, ref_cmp },
+  { 0xE0, MODE_IMM, ref_cpx },
+  { 0xC0, MODE_IMM, ref_cpy },
+  { 0xA9, MODE_IMM, ref_lda },
+  { 0xA2, MODE_IMM, ref_ldx },
+  { 0xA0, MODE_IMM, ref_ldy },
+  { 0x24, MODE_ZPG, ref_bit },
+  { 0xE6, MODE_ZPG, ref_inc },
+  { 0xC6, MODE_ZPG, ref_dec },
+  { 0x26, MODE_ZPG, ref_rol },
+  { 0x66, MODE_ZPG, ref_ror },
+  { 0x0A, MODE_IMP, ref_asl },
+  { 0x4A, MODE_IMP, ref_lsr },
+  { 0xE8, MODE_IMP, ref_inx },
+  { 0xCA, MODE_IMP, ref_dex },
+  { 0xC8, MODE_IMP, ref_iny },
+  { 0x88, MODE_IMP, ref_dey },
+  { 0xAA, MODE_IMP, ref_tax },
+  { 0x8A, MODE_IMP, ref_txa },
+};
+
+/* Status register patterns the flags are merged into, decimal mode off */
+static const uint8_t patterns[] = { 0x24, 0xE6 };
+
+/**
+ * Run one instruction for every register, operand and flag combination and
+ * compare the result with the reference
+ */
+static int alu_check(struct Bus *bus, const struct Instruction *ins)
+{
+  struct CPU6502 *cpu = bus->cpu;
+  int p = 0;
+  int c = 0;
+  int a = 0;
+  int m = 0;
+
+  bus_poke(bus, 0x0200, ins->opcode);
+
+  for(p = 0; p < sizeof(patterns); p++)
+  {
+    for(c = 0; c < 2; c++)
+    {
+      for(a = 0; a < 256; a++)
+      {
+        for(m = 0; m < 256; m++)
+        {
+          struct State in = { a, a ^ 0x5A, a ^ 0xA5, patterns[p] | c, m };
+          struct State ref = in;
+          uint8_t mem = 0;
+
+          ins->ref(&ref);
+
+          bus_poke(bus, 0x0201, ins->mode == MODE_ZPG ? ZP_ADDR : m);
+          bus_poke(bus, ZP_ADDR, m);
+
+          cpu->Reg.A = in.a;
+          cpu->Reg.X = in.x;
+          cpu->Reg.Y = in.y;
+          cpu->Reg.PSR = in.p;
+          cpu->Reg.PC = 0x0200;
+          cpu->cycles = 0;
+          CPU6502_step(cpu);
+
+          mem = bus_peek(bus, ZP_ADDR);
+          if(ins->mode != MODE_ZPG)
+          {
+            ref.m = m;
+          }
+
+          if(cpu->Reg.A != ref.a || cpu->Reg.X != ref.x || cpu->Reg.Y != ref.y ||
+             cpu->Reg.PSR != ref.p || mem != ref.m)
+          {
+            log_error("Opcode 0x%02x A 0x%02x M 0x%02x P 0x%02x: got A 0x%02x X 0x%02x Y 0x%02x P 0x%02x M 0x%02x expected A 0x%02x X 0x%02x Y 0x%02x P 0x%02x M 0x%02x",
+                      ins->opcode, in.a, in.m, in.p,
+                      cpu->Reg.A, cpu->Reg.X, cpu->Reg.Y, cpu->Reg.PSR, mem,
+                      ref.a, ref.x, ref.y, ref.p, ref.m);
+            return -1;
+          }
+        }
+      }
+    }
+  }
+
+  return 0;
+}
+
+/**
+ * Differential test of all table driven flag updates
+ */
+int alu_t0001()
+{
+  struct Bus *bus = NULL;
+  int i = 0;
+  int ret = 0;
+
+  bus = bus_create();
+  ASSERT("Failed to create bus", bus!=NULL);
+  bus_reset(bus);
+
+  for(i = 0; i < sizeof(instructions) / sizeof(instructions[0]) && ret == 0; i++)
+  {
+    ret = alu_check(bus, &instructions[i]);
+  }
+
+  bus_destroy(&bus);
+  ASSERT("Failed to destroy bus", bus==NULL);
+
+  return ret;
+}
+
+/**
+ * Addressing modes with index registers and page crossing cycles
+ */
+int alu_t0002()
+{
+  /* LDX #$01; LDY #$02; LDA $10,X; LDA $30FF,X; LDA ($20,X); LDA ($30),Y */
+  static const uint8_t code[] = { 0xA2, 0x01, 0xA0, 0x02, 0xB5, 0x10, 0xBD, 0xFF, 0x30,
+                                  0xA1, 0x20, 0xB1, 0x30 };
+  struct Bus *bus = NULL;
+  int i = 0;
+  int cycles = 0;
+
+  bus = bus_create();
+  ASSERT("Failed to create bus", bus!=NULL);
+  bus_reset(bus);
+
+  for(i = 0; i < sizeof(code); i++)
+  {
+    bus_poke(bus, 0x0200 + i, code[i]);
+  }
+  bus_poke(bus, 0x0011, 0x11);
+  bus_poke(bus, 0x3100, 0x31);
+  bus_poke(bus, 0x0021, 0x00);
+  bus_poke(bus, 0x0022, 0x40);
+  bus_poke(bus, 0x4000, 0x40);
+  bus_poke(bus, 0x0030, 0xFF);
+  bus_poke(bus, 0x0031, 0x50);
+  bus_poke(bus, 0x5101, 0x51);
+
+  bus->cpu->Reg.PC = 0x0200;
+  bus->cpu->cycles = 0;
+
+  CPU6502_step(bus->cpu);
+  CPU6502_step(bus->cpu);
+
+  cycles = CPU6502_step(bus->cpu);
+  ASSERT("Wrong zero page X value", bus->cpu->Reg.A==0x11 && cycles==4);
+
+  cycles = CPU6502_step(bus->cpu);
+  ASSERT("Wrong absolute X value or cycles", bus->cpu->Reg.A==0x31 && cycles==5);
+
+  cycles = CPU6502_step(bus->cpu);
+  ASSERT("Wrong indirect X value", bus->cpu->Reg.A==0x40 && cycles==6);
+
+  cycles = CPU6502_step(bus->cpu);
+  ASSERT("Wrong indirect Y value or cycles", bus->cpu->Reg.A==0x51 && cycles==6);
+
+  bus_destroy(&bus);
+  ASSERT("Failed to destroy bus", bus==NULL);
+
+  return 0;
+}
+
+int main()
+{
+  UNIT_TEST_INIT("ALU");
+
+  log_set_level(LOG_INFO);
+
+  RUN_TEST(alu_t0001, "Flags of load, ALU, shift and compare instructions");
+  RUN_TEST(alu_t0002, "Indexed and indirect addressing modes");
+
+  UNIT_TEST_ERG();
+
+  return unit_failed == 0 ? 0 : 1;
+}
@@ -0,0 +1,358 @@
+/*
+ * Copyright (c) 2022, Bernd Bauer <bernd.bauer@gmx.at>
+ *
+ * SPDX-License-Identifier: BSD-2-Clause
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "util/log.h"
+#include "util/unit.h"
+
+#include "core/bus.h"
+#include "core/device.h"
+
+#define TRIALS 32
+
+/* Page that records the address of every read */
+struct Probe
+{
+  uint16_t base;
+  uint8_t mem[0x100];
+};
+
+static uint16_t probe_log[16];
+static int probe_count;
+
+static uint8_t probe_read(void *ctx, uint16_t offset)
+{
+  struct Probe *probe = ctx;
+
+  if(probe_count < 16)
+  {
+    probe_log[probe_count++] = probe->base + offset;
+  }
+
+  return probe->mem[offset];
+}
+
+static uint8_t probe_peek(void *ctx, uint16_t offset)
+{
+  struct Probe *probe = ctx;
+
+  return probe->mem[offset];
+}
+
+static void probe_write(void *ctx, uint16_t offset, uint8_t data)
+{
+  struct Probe *probe = ctx;
+
+  probe->mem[offset] = data;
+}
+
+static const struct DeviceOps probe_ops = {
+  .name = "probe",
+  .read = probe_read,
+  .write = probe_write,
+  .peek = probe_peek
+};
+
+static struct Bus* core_bus(uint8_t accuracy)
+{
+  struct Bus *bus = bus_create();
+  int i = 0;
+
+  if(bus == NULL)
+  {
+    return NULL;
+  }
+  bus_reset(bus);
+  CPU6502_setAccuracy(bus->cpu, accuracy);
+
+  /* Same random RAM for both cores, pointers stay below the ROM */
+  srand(6502);
+  for(i = 0; i < 0x8000; i++)
+  {
+    bus_poke(bus, i, i < 0x100 ? rand() & 0x7F : rand() & 0xFF);
+  }
+
+  return bus;
+}
+
+static int core_compare(struct Bus *fast, struct Bus *exact, uint8_t opcode, int c1, int c2)
+{
+  struct CPU6502 *f = fast->cpu;
+  struct CPU6502 *e = exact->cpu;
+
+  if(c1 != c2 || f->clock_count != e->clock_count ||
+     f->Reg.A != e->Reg.A || f->Reg.X != e->Reg.X || f->Reg.Y != e->Reg.Y ||
+     f->Reg.PSR != e->Reg.PSR || f->Reg.SP != e->Reg.SP || f->Reg.PC != e->Reg.PC ||
+     fast->stop != exact->stop ||
+     memcmp(fast->ram->mem, exact->ram->mem, fast->ram->size) != 0)
+  {
+    log_error("Opcode 0x%02x: fast %d cycles A 0x%02x X 0x%02x Y 0x%02x P 0x%02x SP 0x%02x PC 0x%04x, "
+              "exact %d cycles A 0x%02x X 0x%02x Y 0x%02x P 0x%02x SP 0x%02x PC 0x%04x",
+              opcode, c1, f->Reg.A, f->Reg.X, f->Reg.Y, f->Reg.PSR, f->Reg.SP, f->Reg.PC,
+              c2, e->Reg.A, e->Reg.X, e->Reg.Y, e->Reg.PSR, e->Reg.SP, e->Reg.PC);
+    return -1;
+  }
+
+  return 0;
+}
+
+/**
+ * Every opcode gives the same state and cycles in the fast and exact core
+ */
+int core_t0001()
+{
+  struct Bus *fast = NULL;
+  struct Bus *exact = NULL;
+  struct CPU6502OpInfo info;
+  int opcode = 0;
+  int trial = 0;
+  int ret = 0;
+
+  fast = core_bus(CPU6502_ACCURACY_FAST);
+  exact = core_bus(CPU6502_ACCURACY_EXACT);
+  ASSERT("Failed to create bus", fast!=NULL && exact!=NULL);
+
+  for(opcode = 0; opcode < 256 && ret == 0; opcode++)
+  {
+    CPU6502_opcodeInfo(opcode, &info);
+    if(info.mnemonic[0] == '\0')
+    {
+      continue;
+    }
+
+    for(trial = 0; trial < TRIALS && ret == 0; trial++)
+    {
+      /* Operands near page ends so indexing crosses pages */
+      uint8_t lo = (trial & 1) ? 0xF0 | (rand() & 0x0F) : rand() & 0xFF;
+      uint8_t hi = 0x10 + (rand() & 0x5F);
+      uint8_t regs[5] = { rand(), rand(), rand(), rand() & ~CPU6502_FLAG_DECIMAL, rand() };
+      struct Bus *bus[2] = { fast, exact };
+      int cycles[2] = { 0, 0 };
+      uint8_t zp[0x100];
+      int i = 0;
+
+      /* Earlier stores may have moved zero page pointers into the ROM */
+      for(i = 0; i < 0x100; i++)
+      {
+        zp[i] = rand() & 0x7F;
+      }
+
+      for(i = 0; i < 2; i++)
+      {
+        struct CPU6502 *cpu = bus[i]->cpu;
+        int j = 0;
+
+        for(j = 0; j < 0x100; j++)
+        {
+          bus_poke(bus[i], j, zp[j]);
+        }
+
+        bus_poke(bus[i], 0x0200, opcode);
+        bus_poke(bus[i], 0x0201, lo);
+        bus_poke(bus[i], 0x0202, hi);
+
+        cpu->Reg.A = regs[0];
+        cpu->Reg.X = regs[1];
+        cpu->Reg.Y = regs[2];
+        cpu->Reg.PSR = regs[3];
+        cpu->Reg.SP = regs[4];
+        cpu->Reg.PC = 0x0200;
+        cpu->cycles = 0;
+        cpu->deadline = cpu->clock_count + 100;
+        bus[i]->stop = BUS_RUNNING;
+
+        cycles[i] = CPU6502_step(cpu);
+      }
+
+      ret = core_compare(fast, exact, opcode, cycles[0], cycles[1]);
+    }
+  }
+
+  bus_destroy(&fast);
+  bus_destroy(&exact);
+
+  return ret;
+}
+
+/**
+ * Dummy reads of the exact core reach the bus, the fast core skips them
+ */
+int core_t0002()
+{
+  /* LDA $30F0,X with X = 0x20 reads $3010 before $3110,
+   * STA $3000,X with X = 0x20 reads $3020 before writing it */
+  static const uint8_t code[] = { 0xBD, 0xF0, 0x30, 0x9D, 0x00, 0x30 };
+  static const uint16_t watch[] = { 0x3010, 0x3020 };
+  struct Bus *bus = NULL;
+  int accuracy = 0;
+  int i = 0;
+
+  for(accuracy = CPU6502_ACCURACY_FAST; accuracy <= CPU6502_ACCURACY_EXACT; accuracy++)
+  {
+    bus = bus_create();
+    ASSERT("Failed to create bus", bus!=NULL);
+    bus_reset(bus);
+    CPU6502_setAccuracy(bus->cpu, accuracy);
+
+    for(i = 0; i < sizeof(code); i++)
+    {
+      bus_poke(bus, 0x0200 + i, code[i]);
+    }
+    bus->cpu->Reg.PC = 0x0200;
+    bus->cpu->Reg.X = 0x20;
+    bus->cpu->cycles = 0;
+
+    for(i = 0; i < 2; i++)
+    {
+      debug_watch_set(bus->dbg, watch[i], watch[i], DEBUG_WATCH_READ);
+      bus->stop = BUS_RUNNING;
+
+      ASSERT("Wrong cycles", CPU6502_step(bus->cpu) == 5);
+      if(accuracy == CPU6502_ACCURACY_EXACT)
+      {
+        ASSERT("Missing dummy read", bus->stop == BUS_STOP_WATCHPOINT && bus->dbg->hit_addr == watch[i]);
+      }
+      else
+      {
+        ASSERT("Unexpected dummy read", bus->stop == BUS_RUNNING);
+      }
+
+      debug_watch_clear(bus->dbg, watch[i], watch[i], DEBUG_WATCH_READ);
+    }
+
+    bus_destroy(&bus);
+    ASSERT("Failed to destroy bus", bus==NULL);
+  }
+
+  return 0;
+}
+
+/**
+ * Switching cores between instructions keeps the state and the cycle count
+ */
+int core_t0003()
+{
+  /* LDX #$00; loop: TXA; CLC; ADC $10; STA $0300,X; INX; BNE loop; JMP * */
+  static const uint8_t code[] = { 0xA2, 0x00, 0x8A, 0x18, 0x65, 0x10, 0x9D, 0x00, 0x03,
+                                  0xE8, 0xD0, 0xF6, 0x4C, 0x0C, 0x02 };
+  struct Bus *bus[2] = { NULL, NULL };
+  int i = 0;
+  int j = 0;
+
+  for(i = 0; i < 2; i++)
+  {
+    bus[i] = bus_create();
+    ASSERT("Failed to create bus", bus[i]!=NULL);
+    bus_reset(bus[i]);
+
+    for(j = 0; j < sizeof(code); j++)
+    {
+      bus_poke(bus[i], 0x0200 + j, code[j]);
+    }
+    bus_poke(bus[i], 0x0010, 0x42);
+    bus[i]->cpu->Reg.PC = 0x0200;
+    bus[i]->cpu->cycles = 0;
+  }
+
+  /* Reference in the fast core, the other one alternates every slice */
+  bus_run(bus[0], BUS_RUN_FOREVER);
+  for(j = 0; bus[1]->stop == BUS_RUNNING; j++)
+  {
+    CPU6502_setAccuracy(bus[1]->cpu, j & 1 ? CPU6502_ACCURACY_EXACT : CPU6502_ACCURACY_FAST);
+    bus_run(bus[1], 97);
+  }
+
+  ASSERT("Different stop", bus[0]->stop == BUS_STOP_IDLE && bus[1]->stop == BUS_STOP_IDLE);
+  ASSERT("Different cycles", bus[0]->cpu->clock_count == bus[1]->cpu->clock_count);
+  ASSERT("Different registers", bus[0]->cpu->Reg.A == bus[1]->cpu->Reg.A &&
+                                bus[0]->cpu->Reg.PC == bus[1]->cpu->Reg.PC &&
+                                bus[0]->cpu->Reg.PSR == bus[1]->cpu->Reg.PSR);
+  ASSERT("Different memory", memcmp(bus[0]->ram->mem, bus[1]->ram->mem, bus[0]->ram->size) == 0);
+
+  for(i = 0; i < 2; i++)
+  {
+    bus_destroy(&bus[i]);
+    ASSERT("Failed to destroy bus", bus[i]==NULL);
+  }
+
+  return 0;
+}
+
+/**
+ * The exact core reads indirect pointers low byte first
+ */
+int core_t0004()
+{
+  /* LDA ($10),Y; LDA ($20,X); JMP ($03FF) */
+  static const uint8_t code[] = { 0xB1, 0x10, 0xA1, 0x20, 0x6C, 0xFF, 0x03 };
+  static const uint16_t izy[] = { 0x0010, 0x0011, 0x0385 };
+  static const uint16_t izx[] = { 0x0020, 0x0022, 0x0023, 0x0390 };
+  static const uint16_t ind[] = { 0x03FF, 0x0300 };
+  static struct Probe zp = { .base = 0x0000 };
+  static struct Probe page = { .base = 0x0300 };
+  struct Bus *bus = NULL;
+  int i = 0;
+
+  bus = bus_create();
+  ASSERT("Failed to create bus", bus!=NULL);
+  bus_reset(bus);
+  CPU6502_setAccuracy(bus->cpu, CPU6502_ACCURACY_EXACT);
+  ASSERT("Failed to attach probe", device_attach(bus, 0x0000, 0x00FF, &probe_ops, &zp) != NULL &&
+         device_attach(bus, 0x0300, 0x03FF, &probe_ops, &page) != NULL);
+
+  for(i = 0; i < sizeof(code); i++)
+  {
+    bus_poke(bus, 0x0200 + i, code[i]);
+  }
+  zp.mem[0x10] = 0x80;
+  zp.mem[0x11] = 0x03;
+  zp.mem[0x22] = 0x90;
+  zp.mem[0x23] = 0x03;
+  page.mem[0xFF] = 0x00;
+  page.mem[0x00] = 0x04;
+  bus->cpu->Reg.PC = 0x0200;
+  bus->cpu->Reg.X = 0x02;
+  bus->cpu->Reg.Y = 0x05;
+  bus->cpu->cycles = 0;
+
+  probe_count = 0;
+  ASSERT("Wrong cycles", CPU6502_step(bus->cpu) == 5);
+  ASSERT("Wrong (zp),Y order", probe_count == 3 && memcmp(probe_log, izy, sizeof(izy)) == 0);
+
+  /* The pointer is read once unindexed before X is added */
+  probe_count = 0;
+  ASSERT("Wrong cycles", CPU6502_step(bus->cpu) == 6);
+  ASSERT("Wrong (zp,X) order", probe_count == 4 && memcmp(probe_log, izx, sizeof(izx)) == 0);
+
+  /* The high byte comes from the start of the pointer's page */
+  probe_count = 0;
+  ASSERT("Wrong cycles", CPU6502_step(bus->cpu) == 5);
+  ASSERT("Wrong JMP (ind) order", probe_count == 2 && memcmp(probe_log, ind, sizeof(ind)) == 0);
+  ASSERT("Wrong target", bus->cpu->Reg.PC == 0x0400);
+
+  bus_destroy(&bus);
+
+  return 0;
+}
+
+int main()
+{
+  UNIT_TEST_INIT("CORE");
+
+  log_set_level(LOG_INFO);
+
+  RUN_TEST(core_t0001, "Fast and exact core agree on every opcode");
+  RUN_TEST(core_t0002, "Dummy reads of indexed addressing");
+  RUN_TEST(core_t0003, "Core switch at instruction boundaries");
+  RUN_TEST(core_t0004, "Order of indirect pointer reads");
+
+  UNIT_TEST_ERG();
+
+  return unit_failed == 0 ? 0 : 1;
+}
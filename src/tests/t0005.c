@@ -0,0 +1,219 @@
+/*
+ * Copyright (c) 2022, Bernd Bauer <bernd.bauer@gmx.at>
+ *
+ * SPDX-License-Identifier: BSD-2-Clause
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "util/log.h"
+#include "util/unit.h"
+
+#include "core/bus.h"
+#include "core/device.h"
+#include "core/hostcall.h"
+
+/* Register file device recording its last access */
+struct TestDevice
+{
+  uint8_t regs[0x400];
+  uint16_t last;
+  uint64_t ticked;
+  int destroyed;
+};
+
+static uint8_t test_read(void *ctx, uint16_t offset)
+{
+  struct TestDevice *td = ctx;
+
+  td->last = offset;
+  return td->regs[offset];
+}
+
+static void test_write(void *ctx, uint16_t offset, uint8_t data)
+{
+  struct TestDevice *td = ctx;
+
+  td->last = offset;
+  td->regs[offset] = data;
+}
+
+static void test_tick(void *ctx, uint64_t now)
+{
+  struct TestDevice *td = ctx;
+
+  td->ticked = now;
+}
+
+static void test_destroy(void *ctx)
+{
+  struct TestDevice *td = ctx;
+
+  td->destroyed++;
+}
+
+static const struct DeviceOps test_ops = {
+  .name = "test",
+  .read = test_read,
+  .write = test_write,
+  .tick = test_tick,
+  .destroy = test_destroy
+};
+
+/**
+ * Register accesses reach the device, the rest of the page stays memory
+ */
+int device_t0001()
+{
+  struct Bus *bus = NULL;
+  struct Device *a = NULL;
+  struct Device *b = NULL;
+  struct TestDevice ta;
+  struct TestDevice tb;
+
+  memset(&ta, 0, sizeof(ta));
+  memset(&tb, 0, sizeof(tb));
+
+  bus = bus_create();
+  ASSERT("Failed to create bus", bus!=NULL);
+
+  /* Two devices in one page and unclaimed memory between them */
+  a = device_attach(bus, 0x6000, 0x600F, &test_ops, &ta);
+  b = device_attach(bus, 0x6020, 0x602F, &test_ops, &tb);
+  ASSERT("Failed to attach devices", a!=NULL && b!=NULL);
+  ASSERT("Overlap accepted", device_attach(bus, 0x600F, 0x6010, &test_ops, &ta) == NULL);
+  ASSERT("Overlap accepted", device_attach(bus, 0x5F00, 0x6100, &test_ops, &ta) == NULL);
+
+  ASSERT("Page not trapped", bus->rpage[0x60] == NULL && bus->wpage[0x60] == NULL);
+  ASSERT("Other page trapped", bus->rpage[0x5F] != NULL && bus->rpage[0x61] != NULL);
+
+  bus_write(bus, 0x6003, 0x42);
+  ASSERT("Write missed device", ta.regs[3] == 0x42 && ta.last == 3);
+  bus_write(bus, 0x602F, 0x17);
+  ASSERT("Write missed device", tb.regs[0x0F] == 0x17 && tb.last == 0x0F);
+  ASSERT("Read missed device", bus_read(bus, 0x6003) == 0x42);
+
+  bus_write(bus, 0x6018, 0x99);
+  ASSERT("Memory between devices", bus_read(bus, 0x6018) == 0x99 && bus->ram->mem[0x6018] == 0x99);
+  ASSERT("Device memory written", bus->ram->mem[0x6003] == 0x00);
+
+  device_detach(&a);
+  ASSERT("Failed to detach", a==NULL && bus->rpage[0x60] == NULL);
+  device_detach(&b);
+  ASSERT("Page still trapped", bus->rpage[0x60] != NULL && bus->wpage[0x60] != NULL);
+  ASSERT("Device list not empty", bus->devices == NULL && bus->dev[0x60] == NULL);
+
+  bus_destroy(&bus);
+  ASSERT("Failed to destroy bus", bus==NULL);
+  ASSERT("Detached device destroyed", ta.destroyed == 0 && tb.destroyed == 0);
+
+  return 0;
+}
+
+/**
+ * Multi page device, scheduled tick and destroy with the bus
+ */
+int device_t0002()
+{
+  /* LDA $5120; STA $5301; JMP * */
+  static const uint8_t code[] = { 0xAD, 0x20, 0x51, 0x8D, 0x01, 0x53, 0x4C, 0x06, 0x02 };
+  struct Bus *bus = NULL;
+  struct Device *dev = NULL;
+  struct TestDevice td;
+  int i = 0;
+
+  memset(&td, 0, sizeof(td));
+
+  bus = bus_create();
+  ASSERT("Failed to create bus", bus!=NULL);
+  bus_reset(bus);
+
+  dev = device_attach(bus, 0x5100, 0x53FF, &test_ops, &td);
+  ASSERT("Failed to attach device", dev!=NULL);
+  ASSERT("Pages not trapped", bus->rpage[0x51] == NULL && bus->rpage[0x52] == NULL && bus->rpage[0x53] == NULL);
+  td.regs[0x20] = 0x5A;
+
+  for(i = 0; i < sizeof(code); i++)
+  {
+    bus_poke(bus, 0x0200 + i, code[i]);
+  }
+  bus->cpu->Reg.PC = 0x0200;
+  bus->cpu->cycles = 0;
+
+  ASSERT("Failed to schedule", device_schedule(dev, 1000) == 0);
+  bus_run(bus, 500);
+  ASSERT("Tick too early", td.ticked == 0);
+  ASSERT("Register not read", bus->cpu->Reg.A == 0x5A);
+  ASSERT("Register not written", td.regs[0x201] == 0x5A);
+
+  bus_run(bus, BUS_RUN_FOREVER);
+  ASSERT("Tick missed", td.ticked == 1000);
+  ASSERT("Wrong stop", bus->stop == BUS_STOP_IDLE);
+
+  bus_destroy(&bus);
+  ASSERT("Failed to destroy bus", bus==NULL);
+  ASSERT("Device not destroyed", td.destroyed == 1);
+
+  return 0;
+}
+
+/**
+ * Host call page as a bus device
+ */
+int device_t0003()
+{
+  /* LDA #'O'; STA $7F00; LDA #'K'; STA $7F00; LDA #3; STA $7F01 */
+  static const uint8_t code[] = { 0xA9, 'O', 0x8D, 0x00, 0x7F, 0xA9, 'K', 0x8D, 0x00, 0x7F,
+                                  0xA9, 0x03, 0x8D, 0x01, 0x7F };
+  struct Bus *bus = NULL;
+  struct HostCall *hc = NULL;
+  char out[4];
+  int fd[2];
+  int i = 0;
+
+  ASSERT("Failed to create pipe", pipe(fd) == 0);
+
+  bus = bus_create();
+  ASSERT("Failed to create bus", bus!=NULL);
+  bus_reset(bus);
+
+  hc = hostcall_create(bus, HOSTCALL_DEFAULT_PAGE, fd[1]);
+  ASSERT("Failed to create host call page", hc!=NULL);
+
+  for(i = 0; i < sizeof(code); i++)
+  {
+    bus_poke(bus, 0x0200 + i, code[i]);
+  }
+  bus->cpu->Reg.PC = 0x0200;
+  bus->cpu->cycles = 0;
+
+  bus_run(bus, BUS_RUN_FOREVER);
+  ASSERT("Guest did not exit", bus->stop == BUS_STOP_EXIT && hc->exit_status == 3);
+  ASSERT("Guest output missing", read(fd[0], out, sizeof(out)) == 2 && memcmp(out, "OK", 2) == 0);
+
+  bus_destroy(&bus);
+  ASSERT("Failed to destroy bus", bus==NULL);
+
+  close(fd[0]);
+  close(fd[1]);
+
+  return 0;
+}
+
+int main()
+{
+  UNIT_TEST_INIT("DEVICE");
+
+  log_set_level(LOG_INFO);
+
+  RUN_TEST(device_t0001, "Register dispatch through the page table");
+  RUN_TEST(device_t0002, "Multi page device with scheduled tick");
+  RUN_TEST(device_t0003, "Host call page device");
+
+  UNIT_TEST_ERG();
+
+  return unit_failed == 0 ? 0 : 1;
+}
@@ -0,0 +1,185 @@
+/*
+ * Copyright (c) 2022, Bernd Bauer <bernd.bauer@gmx.at>
+ *
+ * SPDX-License-Identifier: BSD-2-Clause
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "util/log.h"
+#include "util/unit.h"
+
+#include "core/bus.h"
+#include "core/device.h"
+#include "core/framebuffer.h"
+#include "core/machine.h"
+#include "core/offload.h"
+#include "core/uart.h"
+#include "core/via.h"
+
+static char dir[] = "/tmp/t0006XXXXXX";
+static char cfg[64];
+static char img[64];
+
+static int write_file(const char *name, const void *data, size_t len)
+{
+  FILE *fp = fopen(name, "w");
+
+  if(fp == NULL)
+  {
+    return -1;
+  }
+  fwrite(data, 1, len, fp);
+  fclose(fp);
+
+  return 0;
+}
+
+/**
+ * Regions, mirrors, images and devices from a description
+ */
+int machine_t0001()
+{
+  static const char desc[] =
+    "# test board\n"
+    "ram    0x0000 0x4000          # main RAM\n"
+    "mirror 0x4000 0x0800 0x0000\n"
+    "device 0x7f00 0x0100 hostcall\n"
+    "device 0x7e00 0x10 via 2\n"
+    "device 0x6000 0x0200 framebuffer 64x64 1 /dev/null 20000 0\n"
+    "rom    0xc000 0x4000 rom.bin 0x10\n";
+  uint8_t image[0x4010];
+  struct Bus *bus = NULL;
+  int i = 0;
+
+  for(i = 0; i < sizeof(image); i++)
+  {
+    image[i] = i & 0xFF;
+  }
+  ASSERT("Failed to write files", write_file(cfg, desc, strlen(desc)) == 0 && write_file(img, image, sizeof(image)) == 0);
+
+  bus = bus_create();
+  ASSERT("Failed to create bus", bus!=NULL);
+  ASSERT("Failed to load machine", machine_load(bus, cfg) == 0);
+  ASSERT("Wrong regions", bus->regions == 3 && bus->ram != NULL && bus->rom != NULL);
+
+  bus_write(bus, 0x0123, 0x5A);
+  ASSERT("Mirror does not see RAM", bus_read(bus, 0x4123) == 0x5A);
+  bus_write(bus, 0x4456, 0xA5);
+  ASSERT("RAM does not see mirror", bus_read(bus, 0x0456) == 0xA5);
+  ASSERT("Mirror page not direct", bus->rpage[0x41] == bus->rpage[0x01]);
+
+  ASSERT("Unmapped page mapped", bus->rpage[0x50] == NULL && bus_peek(bus, 0x5000) == 0);
+  ASSERT("Image offset ignored", bus_read(bus, 0xc000) == 0x10 && bus_read(bus, 0xffff) == 0x0F);
+  bus_write(bus, 0xc000, 0x00);
+  ASSERT("ROM written", bus_read(bus, 0xc000) == 0x10);
+
+  ASSERT("Host call device missing", device_lookup(bus, "hostcall") != NULL && device_find(bus, 0x7f01) != NULL);
+  ASSERT("VIA missing", device_lookup(bus, "via") != NULL && ((struct VIA*)device_find(bus, 0x7e0f)->ctx)->irq == 2);
+  ASSERT("Framebuffer missing", device_lookup(bus, "framebuffer") != NULL && device_find(bus, 0x61ff) != NULL &&
+         device_find(bus, 0x6200) == NULL);
+  ASSERT("Max lag ignored", !((struct Framebuffer*)device_find(bus, 0x6000)->ctx)->off->threaded);
+
+  bus_destroy(&bus);
+  ASSERT("Failed to destroy bus", bus==NULL);
+
+  return 0;
+}
+
+/**
+ * Malformed descriptions are rejected
+ */
+int machine_t0002()
+{
+  static const char *bad[] = {
+    "ram 0x0000\n",
+    "ram 0x0010 0x0100\n",
+    "rom 0x8000 0x8000\n",
+    "ram 0xc000 0x8000\n",
+    "flash 0x0000 0x0100\n",
+    "mirror 0x1000 0x0100\n",
+    "ram 0x0100 0xFFFFFF00\n",
+    "mirror 0x1000 0xFFFFF000 0x0000\n",
+    "mirror 0x1000 0x1000 0xFFFFF000\n",
+    "device 0x7f00 0x0100 nothing\n",
+    "device 0x7e00 0x0100 via\n",
+    "device 0x6000 0x0100 framebuffer 64x64 1\n",
+    "device 0x6000 0x0200 framebuffer 64x64 1 /dev/null 20000 0 1\n",
+    "rom 0x8000 0x1000 missing.bin\n"
+  };
+  struct Bus *bus = NULL;
+  int i = 0;
+
+  for(i = 0; i < sizeof(bad) / sizeof(bad[0]); i++)
+  {
+    ASSERT("Failed to write file", write_file(cfg, bad[i], strlen(bad[i])) == 0);
+
+    bus = bus_create();
+    ASSERT("Failed to create bus", bus!=NULL);
+    ASSERT("Invalid description accepted", machine_load(bus, cfg) != 0);
+    bus_destroy(&bus);
+  }
+
+  return 0;
+}
+
+/**
+ * Sockets and outputs of devices are relative to the description
+ */
+int machine_t0003()
+{
+  static const char desc[] =
+    "ram    0x0000 0x4000\n"
+    "device 0x7e00 4 uart tty.sock\n"
+    "device 0x6000 0x0200 framebuffer 64x64 1 fb.raw 20000 0\n";
+  char sock[80];
+  char raw[80];
+  struct Bus *bus = NULL;
+
+  snprintf(sock, sizeof(sock), "%s/tty.sock", dir);
+  snprintf(raw, sizeof(raw), "%s/fb.raw", dir);
+  ASSERT("Failed to write file", write_file(cfg, desc, strlen(desc)) == 0);
+
+  bus = bus_create();
+  ASSERT("Failed to create bus", bus!=NULL);
+  ASSERT("Failed to load machine", machine_load(bus, cfg) == 0);
+  ASSERT("Socket not beside the description", strcmp(((struct Uart*)device_find(bus, 0x7e00)->ctx)->name, sock) == 0 &&
+         access(sock, F_OK) == 0);
+  ASSERT("Output not beside the description", strcmp(((struct Framebuffer*)device_find(bus, 0x6000)->ctx)->output, raw) == 0 &&
+         access(raw, F_OK) == 0);
+
+  bus_destroy(&bus);
+  unlink(sock);
+  unlink(raw);
+
+  return 0;
+}
+
+int main()
+{
+  UNIT_TEST_INIT("MACHINE");
+
+  log_set_level(LOG_INFO);
+
+  if(mkdtemp(dir) == NULL)
+  {
+    return 1;
+  }
+  snprintf(cfg, sizeof(cfg), "%s/board.cfg", dir);
+  snprintf(img, sizeof(img), "%s/rom.bin", dir);
+
+  RUN_TEST(machine_t0001, "Memory map from a machine description");
+  RUN_TEST(machine_t0002, "Invalid machine descriptions");
+  RUN_TEST(machine_t0003, "Device files relative to the description");
+
+  unlink(cfg);
+  unlink(img);
+  rmdir(dir);
+
+  UNIT_TEST_ERG();
+
+  return unit_failed == 0 ? 0 : 1;
+}
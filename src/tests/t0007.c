@@ -0,0 +1,138 @@
+/*
+ * Copyright (c) 2022, Bernd Bauer <bernd.bauer@gmx.at>
+ *
+ * SPDX-License-Identifier: BSD-2-Clause
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "util/log.h"
+#include "util/unit.h"
+
+#include "core/bus.h"
+#include "core/mapper.h"
+
+static void block(struct CPU6502 *cpu)
+{
+}
+
+static struct Mapper* mapper_setup(struct Bus *bus)
+{
+  static const uint16_t start[] = { 0x8000, 0xC000 };
+  static const uint32_t length[] = { 0x4000, 0x4000 };
+  struct Mapper *mapper = NULL;
+  int i = 0;
+
+  /* Four banks of 16 KB, every byte holds its bank number */
+  mapper = mapper_create(bus, 0x7E00, BUS_REGION_ROM, 0x10000, 2, start, length);
+  if(mapper != NULL)
+  {
+    for(i = 0; i < 4; i++)
+    {
+      memset(mapper->mem->mem + i * 0x4000, 0xB0 + i, 0x4000);
+    }
+  }
+
+  return mapper;
+}
+
+/**
+ * Bank registers switch the page table to other offsets of the memory
+ */
+int mapper_t0001()
+{
+  struct Bus *bus = NULL;
+  struct Mapper *mapper = NULL;
+
+  bus = bus_create();
+  ASSERT("Failed to create bus", bus!=NULL);
+  mapper = mapper_setup(bus);
+  ASSERT("Failed to create mapper", mapper!=NULL);
+
+  ASSERT("Wrong reset banks", bus_read(bus, 0x8000) == 0xB0 && bus_read(bus, 0xFFFF) == 0xB1);
+  ASSERT("Wrong registers", bus_read(bus, 0x7E00) == 0 && bus_read(bus, 0x7E01) == 1);
+
+  bus_write(bus, 0x7E00, 3);
+  ASSERT("Bank not switched", bus_read(bus, 0x8000) == 0xB3 && bus_read(bus, 0xBFFF) == 0xB3);
+  ASSERT("Other window switched", bus_read(bus, 0xC000) == 0xB1);
+  ASSERT("Page table not direct", bus->rpage[0x80] == mapper->mem->mem + 0xC000 && bus->rpage[0xBF] == mapper->mem->mem + 0xFF00);
+  ASSERT("Banked ROM writable", bus->wpage[0x80] == NULL);
+  ASSERT("Register not updated", bus_read(bus, 0x7E00) == 3);
+
+  bus_write(bus, 0x7E01, 6);
+  ASSERT("Bank does not wrap", bus_read(bus, 0xC000) == 0xB2);
+
+  /* Traps survive a switch */
+  debug_watch_set(bus->dbg, 0x8010, 0x8010, DEBUG_WATCH_READ);
+  bus_write(bus, 0x7E00, 0);
+  ASSERT("Trap lost", bus->rpage[0x80] == NULL && bus->rpage[0x81] == mapper->mem->mem + 0x0100);
+  ASSERT("Trapped page wrong", bus_peek(bus, 0x8010) == 0xB0);
+  debug_watch_clear(bus->dbg, 0x8010, 0x8010, DEBUG_WATCH_READ);
+  ASSERT("Trap not released", bus->rpage[0x80] == mapper->mem->mem);
+
+  bus_reset(bus);
+  ASSERT("Reset did not restore banks", bus_read(bus, 0x7E00) == 0 && bus_read(bus, 0x7E01) == 1);
+
+  bus_destroy(&bus);
+  ASSERT("Failed to destroy bus", bus==NULL);
+
+  return 0;
+}
+
+/**
+ * Running code sees the switch, recompiled code of switched pages is dropped
+ */
+int mapper_t0002()
+{
+  /* LDA $8000; STA $10; LDA #2; STA $7E00; LDA $8000; STA $11; JMP * */
+  static const uint8_t code[] = { 0xAD, 0x00, 0x80, 0x85, 0x10, 0xA9, 0x02, 0x8D, 0x00, 0x7E,
+                                  0xAD, 0x00, 0x80, 0x85, 0x11, 0x4C, 0x0F, 0x02 };
+  struct Bus *bus = NULL;
+  struct Mapper *mapper = NULL;
+  int i = 0;
+
+  bus = bus_create();
+  ASSERT("Failed to create bus", bus!=NULL);
+  mapper = mapper_setup(bus);
+  ASSERT("Failed to create mapper", mapper!=NULL);
+  bus_reset(bus);
+
+  bus->cpu->blocks = calloc(0x10000, sizeof(CPU6502_BlockFn));
+  ASSERT("Failed to allocate blocks", bus->cpu->blocks!=NULL);
+  bus->cpu->blocks[0x8123] = block;
+  bus->cpu->blocks[0xC123] = block;
+
+  for(i = 0; i < sizeof(code); i++)
+  {
+    bus_poke(bus, 0x0200 + i, code[i]);
+  }
+  bus->cpu->Reg.PC = 0x0200;
+  bus->cpu->cycles = 0;
+
+  bus_run(bus, BUS_RUN_FOREVER);
+  ASSERT("Wrong stop", bus->stop == BUS_STOP_IDLE);
+  ASSERT("Wrong banks read", bus_read(bus, 0x10) == 0xB0 && bus_read(bus, 0x11) == 0xB2);
+  ASSERT("Stale block kept", bus->cpu->blocks[0x8123] == NULL);
+  ASSERT("Unaffected block dropped", bus->cpu->blocks[0xC123] == block);
+
+  bus_destroy(&bus);
+  ASSERT("Failed to destroy bus", bus==NULL);
+
+  return 0;
+}
+
+int main()
+{
+  UNIT_TEST_INIT("MAPPER");
+
+  log_set_level(LOG_INFO);
+
+  RUN_TEST(mapper_t0001, "Bank switching through the page table");
+  RUN_TEST(mapper_t0002, "Bank switch from running code");
+
+  UNIT_TEST_ERG();
+
+  return unit_failed == 0 ? 0 : 1;
+}
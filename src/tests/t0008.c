@@ -0,0 +1,152 @@
+/*
+ * Copyright (c) 2022, Bernd Bauer <bernd.bauer@gmx.at>
+ *
+ * SPDX-License-Identifier: BSD-2-Clause
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "util/log.h"
+#include "util/unit.h"
+
+#include "core/bus.h"
+#include "core/device.h"
+
+#include "testbus.h"
+
+/* Counts the cycles it was caught up over */
+struct Counter
+{
+  uint64_t elapsed;
+  int syncs;
+  uint64_t tick;
+};
+
+static uint8_t counter_read(void *ctx, uint16_t offset)
+{
+  struct Counter *counter = ctx;
+
+  return counter->syncs;
+}
+
+static void counter_write(void *ctx, uint16_t offset, uint8_t data)
+{
+}
+
+static void counter_sync(void *ctx, uint64_t from, uint64_t to)
+{
+  struct Counter *counter = ctx;
+
+  counter->elapsed += to - from;
+  counter->syncs++;
+}
+
+static void counter_tick(void *ctx, uint64_t now)
+{
+  struct Counter *counter = ctx;
+
+  counter->tick = now;
+}
+
+static const struct DeviceOps counter_ops = {
+  .name = "counter",
+  .read = counter_read,
+  .write = counter_write,
+  .sync = counter_sync,
+  .tick = counter_tick
+};
+
+/**
+ * A device is caught up once when its register is read, not on every cycle
+ */
+int sync_t0001()
+{
+  /* LDX #0; DEX; BNE *-1; LDA $7000; STA $10; JMP * */
+  static const uint8_t code[] = { 0xA2, 0x00, 0xCA, 0xD0, 0xFD, 0xAD, 0x00, 0x70, 0x85, 0x10, 0x4C, 0x0A, 0x02 };
+  static const uint8_t accuracy[] = { CPU6502_ACCURACY_FAST, CPU6502_ACCURACY_EXACT };
+  struct Counter counter;
+  struct Bus *bus = NULL;
+  struct Device *dev = NULL;
+  int i = 0;
+
+  for(i = 0; i < sizeof(accuracy); i++)
+  {
+    memset(&counter, 0, sizeof(counter));
+
+    bus = testbus_create(code, sizeof(code));
+    ASSERT("Failed to create bus", bus!=NULL);
+    dev = device_attach(bus, 0x7000, 0x7000, &counter_ops, &counter);
+    ASSERT("Failed to attach device", dev!=NULL);
+    CPU6502_setAccuracy(bus->cpu, accuracy[i]);
+
+    bus_run(bus, BUS_RUN_FOREVER);
+    ASSERT("Wrong stop", bus->stop == BUS_STOP_IDLE);
+
+    /* 2 + 256 * 2 + 255 * 3 + 2 cycles of loop, LDA reads in its 4th cycle */
+    ASSERT("Device not synced before the read", counter.syncs == 1 && bus_peek(bus, 0x10) == 1);
+    ASSERT("Wrong catch up", counter.elapsed == 1285 && dev->synced == 1285);
+
+    /* Peeking has no side effects */
+    bus_peek(bus, 0x7000);
+    ASSERT("Peek synced", counter.syncs == 1);
+
+    bus_reset(bus);
+    ASSERT("Reset did not restart the device clock", dev->synced == 0);
+
+    bus_destroy(&bus);
+    ASSERT("Failed to destroy bus", bus==NULL);
+  }
+
+  return 0;
+}
+
+/**
+ * A scheduled event catches the device up to the event time before tick
+ */
+int sync_t0002()
+{
+  /* LDX #0; DEX; BNE *-1; JMP * */
+  static const uint8_t code[] = { 0xA2, 0x00, 0xCA, 0xD0, 0xFD, 0x4C, 0x05, 0x02 };
+  struct Counter counter;
+  struct Bus *bus = NULL;
+  struct Device *dev = NULL;
+
+  memset(&counter, 0, sizeof(counter));
+
+  bus = testbus_create(code, sizeof(code));
+  ASSERT("Failed to create bus", bus!=NULL);
+  dev = device_attach(bus, 0x7000, 0x7000, &counter_ops, &counter);
+  ASSERT("Failed to attach device", dev!=NULL);
+
+  ASSERT("Failed to schedule", device_schedule(dev, 1000) == 0);
+  bus_run(bus, 2000);
+
+  ASSERT("Tick missing", counter.tick == 1000);
+  ASSERT("Not synced to the event", counter.syncs == 1 && counter.elapsed == 1000 && dev->synced == 1000);
+
+  /* A later access catches up from the event */
+  bus_read(bus, 0x7000);
+  ASSERT("Not synced on access", counter.syncs == 2 && dev->synced == CPU6502_now(bus->cpu));
+  ASSERT("Wrong catch up", counter.elapsed == dev->synced);
+
+  bus_destroy(&bus);
+  ASSERT("Failed to destroy bus", bus==NULL);
+
+  return 0;
+}
+
+int main()
+{
+  UNIT_TEST_INIT("SYNC");
+
+  log_set_level(LOG_INFO);
+
+  RUN_TEST(sync_t0001, "Catch up on register access");
+  RUN_TEST(sync_t0002, "Catch up on scheduled events");
+
+  UNIT_TEST_ERG();
+
+  return unit_failed == 0 ? 0 : 1;
+}
@@ -0,0 +1,262 @@
+/*
+ * Copyright (c) 2022, Bernd Bauer <bernd.bauer@gmx.at>
+ *
+ * SPDX-License-Identifier: BSD-2-Clause
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "util/log.h"
+#include "util/unit.h"
+
+#include "core/bus.h"
+#include "core/device.h"
+#include "core/via.h"
+
+#define VIA_BASE 0x6000
+
+static uint8_t out[3];
+
+static void output(void *ctx, uint8_t port, uint8_t value)
+{
+  out[port] = value;
+}
+
+static struct VIA* via_setup(struct Bus **bus)
+{
+  *bus = bus_create();
+  if(*bus == NULL)
+  {
+    return NULL;
+  }
+  return via_create(*bus, VIA_BASE, 1);
+}
+
+/* Move the CPU clock, accesses from outside an instruction happen there */
+static void at(struct Bus *bus, uint64_t when)
+{
+  bus->cpu->clock_count = when;
+  bus->cpu->cycles = 0;
+}
+
+/**
+ * Timer 1 one shot counts down without events and flags a single underflow
+ */
+int via_t0001()
+{
+  struct Bus *bus = NULL;
+  struct VIA *via = NULL;
+
+  via = via_setup(&bus);
+  ASSERT("Failed to create VIA", via!=NULL);
+
+  at(bus, 100);
+  bus_write(bus, VIA_BASE + VIA_T1CL, 0x10);
+  bus_write(bus, VIA_BASE + VIA_T1CH, 0x00);
+  ASSERT("Event without enabled interrupt", via->dev->event == -1);
+
+  at(bus, 110);
+  ASSERT("Wrong counter", bus_read(bus, VIA_BASE + VIA_T1CL) == 6 && bus_read(bus, VIA_BASE + VIA_T1CH) == 0);
+  at(bus, 116);
+  ASSERT("Early underflow", bus_read(bus, VIA_BASE + VIA_IFR) == 0);
+  at(bus, 117);
+  ASSERT("Missing underflow", bus_read(bus, VIA_BASE + VIA_IFR) == VIA_INT_T1);
+  ASSERT("Counter does not wrap", bus_read(bus, VIA_BASE + VIA_T1CH) == 0xFF);
+  ASSERT("Latch changed", bus_read(bus, VIA_BASE + VIA_T1LL) == 0x10);
+
+  /* Reading the low counter clears the flag, a one shot fires once */
+  bus_read(bus, VIA_BASE + VIA_T1CL);
+  at(bus, 117 + 3 * 0x10000);
+  ASSERT("One shot fired again", bus_read(bus, VIA_BASE + VIA_IFR) == 0);
+  ASSERT("IRQ without enable", bus->cpu->irq_lines == 0);
+
+  bus_destroy(&bus);
+  ASSERT("Failed to destroy bus", bus==NULL);
+
+  return 0;
+}
+
+/**
+ * Firmware main loop driven by free running timer 1 interrupts
+ */
+int via_t0002()
+{
+  /* LDA #$40; STA ACR; LDA #$C0; STA IER; LDA #$E6; STA T1CL; LDA #$03;
+   * STA T1CH; CLI; JMP * */
+  static const uint8_t code[] = { 0xA9, 0x40, 0x8D, 0x0B, 0x60, 0xA9, 0xC0, 0x8D, 0x0E, 0x60,
+                                  0xA9, 0xE6, 0x8D, 0x04, 0x60, 0xA9, 0x03, 0x8D, 0x05, 0x60,
+                                  0x58, 0x4C, 0x15, 0x02 };
+  /* INC $10; LDA T1CL; RTI */
+  static const uint8_t isr[] = { 0xE6, 0x10, 0xAD, 0x04, 0x60, 0x40 };
+  struct Bus *bus = NULL;
+  struct VIA *via = NULL;
+  int i = 0;
+
+  via = via_setup(&bus);
+  ASSERT("Failed to create VIA", via!=NULL);
+
+  for(i = 0; i < sizeof(code); i++)
+  {
+    bus_poke(bus, 0x0200 + i, code[i]);
+  }
+  for(i = 0; i < sizeof(isr); i++)
+  {
+    bus_poke(bus, 0x0300 + i, isr[i]);
+  }
+  bus_poke(bus, 0xFFFE, 0x00);
+  bus_poke(bus, 0xFFFF, 0x03);
+  bus_poke(bus, 0x10, 0);
+
+  bus_reset(bus);
+  bus->cpu->Reg.PC = 0x0200;
+  bus->cpu->cycles = 0;
+
+  /* The timer starts at cycle 24 and underflows every 1000 cycles from 1023 */
+  bus_run(bus, 100500);
+  ASSERT("Wrong stop", bus->stop == BUS_RUNNING);
+  ASSERT("Wrong interrupt count", bus_peek(bus, 0x10) == 100);
+  ASSERT("Timer not rearmed", via->dev->event >= 0);
+
+  bus_destroy(&bus);
+  ASSERT("Failed to destroy bus", bus==NULL);
+
+  return 0;
+}
+
+/**
+ * Timer 2 raises the IRQ line through an event, IFR writes release it
+ */
+int via_t0003()
+{
+  struct Bus *bus = NULL;
+  struct VIA *via = NULL;
+
+  via = via_setup(&bus);
+  ASSERT("Failed to create VIA", via!=NULL);
+
+  at(bus, 1000);
+  bus_write(bus, VIA_BASE + VIA_IER, 0xA0);
+  bus_write(bus, VIA_BASE + VIA_IER, 0x00);
+  ASSERT("Wrong enable", bus_read(bus, VIA_BASE + VIA_IER) == 0xA0);
+
+  bus_write(bus, VIA_BASE + VIA_T2CL, 0x05);
+  bus_write(bus, VIA_BASE + VIA_T2CH, 0x00);
+  ASSERT("No event for enabled interrupt", via->dev->event >= 0);
+
+  scheduler_dispatch(bus->sched, 1005);
+  ASSERT("Early IRQ", bus->cpu->irq_lines == 0);
+  at(bus, 1006);
+  scheduler_dispatch(bus->sched, 1006);
+  ASSERT("Missing IRQ", bus->cpu->irq_lines == 0x02 && bus_peek(bus, VIA_BASE + VIA_IFR) == (VIA_INT_ANY | VIA_INT_T2));
+
+  bus_write(bus, VIA_BASE + VIA_IFR, VIA_INT_T2);
+  ASSERT("IRQ not released", bus->cpu->irq_lines == 0 && bus_read(bus, VIA_BASE + VIA_IFR) == 0);
+  ASSERT("Event left", via->dev->event == -1);
+
+  bus_destroy(&bus);
+  ASSERT("Failed to destroy bus", bus==NULL);
+
+  return 0;
+}
+
+/**
+ * Ports, control line edges and the shift register
+ */
+int via_t0004()
+{
+  struct Bus *bus = NULL;
+  struct VIA *via = NULL;
+
+  via = via_setup(&bus);
+  ASSERT("Failed to create VIA", via!=NULL);
+  via_connect(via, output, NULL);
+
+  at(bus, 10);
+  bus_write(bus, VIA_BASE + VIA_DDRA, 0x0F);
+  bus_write(bus, VIA_BASE + VIA_ORA, 0x55);
+  via_input(via, VIA_PORT_A, 0xA0);
+  ASSERT("Wrong port output", out[VIA_PORT_A] == 0x05 && via_output(via, VIA_PORT_A) == 0x05);
+  ASSERT("Wrong port input", bus_read(bus, VIA_BASE + VIA_ORA) == 0xA5);
+
+  /* CA1 on the falling edge by default */
+  via_control(via, VIA_CA1, 1);
+  ASSERT("Rising edge flagged", bus_read(bus, VIA_BASE + VIA_IFR) == 0);
+  via_control(via, VIA_CA1, 0);
+  ASSERT("Falling edge missing", bus_read(bus, VIA_BASE + VIA_IFR) == VIA_INT_CA1);
+  bus_read(bus, VIA_BASE + VIA_ORA);
+  ASSERT("Port read keeps CA1", bus_read(bus, VIA_BASE + VIA_IFR) == 0);
+
+  /* Shift out under phi2, eight bits of two cycles */
+  bus_write(bus, VIA_BASE + VIA_ACR, 6 << VIA_ACR_SR_SHIFT);
+  bus_write(bus, VIA_BASE + VIA_SR, 0x5A);
+  at(bus, 25);
+  ASSERT("Early shift", bus_read(bus, VIA_BASE + VIA_IFR) == 0 && out[VIA_SHIFT] == 0);
+  at(bus, 26);
+  ASSERT("Shift missing", bus_read(bus, VIA_BASE + VIA_IFR) == VIA_INT_SR && out[VIA_SHIFT] == 0x5A);
+
+  /* Reset clears the registers but not the timers */
+  bus_write(bus, VIA_BASE + VIA_IER, 0x80 | VIA_INT_SR);
+  bus_reset(bus);
+  ASSERT("IRQ survived reset", bus->cpu->irq_lines == 0);
+  ASSERT("Registers survived reset", bus_peek(bus, VIA_BASE + VIA_ACR) == 0 && bus_peek(bus, VIA_BASE + VIA_IER) == 0x80);
+
+  bus_destroy(&bus);
+  ASSERT("Failed to destroy bus", bus==NULL);
+
+  return 0;
+}
+
+/**
+ * PB7 follows free running timer 1 and reaches the output callback
+ */
+int via_t0005()
+{
+  struct Bus *bus = NULL;
+  struct VIA *via = NULL;
+
+  via = via_setup(&bus);
+  ASSERT("Failed to create VIA", via!=NULL);
+  via_connect(via, output, NULL);
+
+  at(bus, 100);
+  bus_write(bus, VIA_BASE + VIA_ACR, VIA_ACR_T1_FREE | VIA_ACR_T1_PB7);
+  bus_write(bus, VIA_BASE + VIA_T1CL, 0x10);
+  bus_write(bus, VIA_BASE + VIA_T1CH, 0x00);
+  ASSERT("PB7 not low after load", out[VIA_PORT_B] == 0x00);
+
+  /* First underflow at 117, then every 0x12 cycles */
+  at(bus, 117);
+  bus_read(bus, VIA_BASE + VIA_IFR);
+  ASSERT("PB7 toggle not notified", out[VIA_PORT_B] == 0x80);
+  at(bus, 117 + 0x12);
+  bus_read(bus, VIA_BASE + VIA_IFR);
+  ASSERT("PB7 toggle not notified", out[VIA_PORT_B] == 0x00);
+
+  /* Three periods caught up at once leave it toggled */
+  at(bus, 117 + 4 * 0x12);
+  bus_read(bus, VIA_BASE + VIA_IFR);
+  ASSERT("PB7 catch up not notified", out[VIA_PORT_B] == 0x80 && via_output(via, VIA_PORT_B) == 0x80);
+
+  bus_destroy(&bus);
+
+  return 0;
+}
+
+int main()
+{
+  UNIT_TEST_INIT("VIA");
+
+  log_set_level(LOG_INFO);
+
+  RUN_TEST(via_t0001, "Timer 1 one shot");
+  RUN_TEST(via_t0002, "Timer 1 interrupts in free running mode");
+  RUN_TEST(via_t0003, "Timer 2 interrupt line");
+  RUN_TEST(via_t0004, "Ports, control lines and shift register");
+  RUN_TEST(via_t0005, "PB7 output of timer 1");
+
+  UNIT_TEST_ERG();
+
+  return unit_failed == 0 ? 0 : 1;
+}
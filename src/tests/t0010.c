@@ -0,0 +1,205 @@
+/*
+ * Copyright (c) 2022, Bernd Bauer <bernd.bauer@gmx.at>
+ *
+ * SPDX-License-Identifier: BSD-2-Clause
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+
+#include "util/log.h"
+#include "util/unit.h"
+
+#include "core/bus.h"
+#include "core/device.h"
+#include "core/uart.h"
+
+#include "testbus.h"
+
+#define UART_BASE 0x7000
+
+/* The guest idles, without a pending event the bus stops at once */
+static void run(struct Bus *bus)
+{
+  testbus_run(bus, 2 * UART_INTERVAL);
+}
+
+/* Run until the status bits in mask equal bits or a second passes */
+static int wait_status(struct Bus *bus, uint8_t mask, uint8_t bits)
+{
+  int i = 0;
+
+  for(i = 0; i < 1000; i++)
+  {
+    run(bus);
+    if((bus_read(bus, UART_BASE + UART_STATUS) & mask) == bits)
+    {
+      return 0;
+    }
+    usleep(1000);
+  }
+
+  return -1;
+}
+
+/* Receive len bytes with a second of timeout */
+static int receive(int fd, char *buf, int len)
+{
+  struct pollfd pfd = { .fd = fd, .events = POLLIN };
+  int got = 0;
+
+  while(got < len && poll(&pfd, 1, 1000) == 1)
+  {
+    int n = read(fd, buf + got, len - got);
+
+    if(n <= 0)
+    {
+      break;
+    }
+    got += n;
+  }
+
+  return got;
+}
+
+/**
+ * Bytes over a Unix socket in both directions, receive raises the IRQ
+ */
+int uart_t0001()
+{
+  char path[64];
+  char buf[16];
+  struct sockaddr_un addr;
+  struct Bus *bus = NULL;
+  struct Uart *uart = NULL;
+  const char *msg = "ok\n";
+  int fd = -1;
+  int i = 0;
+
+  snprintf(path, sizeof(path), "/tmp/t0010-%d.sock", (int)getpid());
+
+  bus = testbus_idle();
+  ASSERT("Failed to create bus", bus!=NULL);
+  uart = uart_create(bus, UART_BASE, 3, path);
+  ASSERT("Failed to create UART", uart!=NULL);
+  ASSERT("Connected without peer", (bus_read(bus, UART_BASE + UART_STATUS) & UART_STATUS_CONNECTED) == 0);
+
+  /* Output before the peer connects is kept */
+  for(i = 0; msg[i] != '\0'; i++)
+  {
+    bus_write(bus, UART_BASE + UART_DATA, msg[i]);
+  }
+
+  memset(&addr, 0, sizeof(addr));
+  addr.sun_family = AF_UNIX;
+  strcpy(addr.sun_path, path);
+  fd = socket(AF_UNIX, SOCK_STREAM, 0);
+  ASSERT("Failed to connect", fd >= 0 && connect(fd, (struct sockaddr *)&addr, sizeof(addr)) == 0);
+  ASSERT("Peer not seen", wait_status(bus, UART_STATUS_CONNECTED, UART_STATUS_CONNECTED) == 0);
+
+  ASSERT("Output not received", receive(fd, buf, 3) == 3 && memcmp(buf, msg, 3) == 0);
+
+  bus_write(bus, UART_BASE + UART_CONTROL, UART_CONTROL_RX_IRQ);
+  ASSERT("Failed to send", write(fd, "hello", 5) == 5);
+  ASSERT("Input not received", wait_status(bus, UART_STATUS_RX_READY | UART_STATUS_IRQ, UART_STATUS_RX_READY | UART_STATUS_IRQ) == 0);
+  ASSERT("IRQ line not asserted", bus->cpu->irq_lines == (1 << 3));
+  ASSERT("Wrong count", bus_read(bus, UART_BASE + UART_RXCOUNT) == 5);
+
+  for(i = 0; i < 5; i++)
+  {
+    buf[i] = bus_read(bus, UART_BASE + UART_DATA);
+  }
+  ASSERT("Wrong input", memcmp(buf, "hello", 5) == 0);
+  ASSERT("IRQ not released", bus->cpu->irq_lines == 0 && bus_read(bus, UART_BASE + UART_STATUS) == (UART_STATUS_TX_READY | UART_STATUS_CONNECTED));
+
+  close(fd);
+  ASSERT("Disconnect not seen", wait_status(bus, UART_STATUS_CONNECTED, 0) == 0);
+
+  bus_destroy(&bus);
+  ASSERT("Failed to destroy bus", bus==NULL);
+  ASSERT("Socket left", access(path, F_OK) != 0);
+
+  return 0;
+}
+
+/**
+ * Pseudo terminal backend, more input than the ring holds is throttled
+ */
+int uart_t0002()
+{
+  static char big[UART_RING_SIZE + 1000];
+  struct Bus *bus = NULL;
+  struct Uart *uart = NULL;
+  char buf[4];
+  int fd = -1;
+  int sent = 0;
+  int i = 0;
+
+  bus = testbus_idle();
+  ASSERT("Failed to create bus", bus!=NULL);
+  uart = uart_create(bus, UART_BASE, 0, UART_PTY);
+  ASSERT("Failed to create UART", uart!=NULL);
+
+  fd = open(uart->name, O_RDWR | O_NOCTTY | O_NONBLOCK);
+  ASSERT("Failed to open pty", fd >= 0);
+
+  bus_write(bus, UART_BASE + UART_DATA, 'x');
+  run(bus);
+  ASSERT("Output not received", receive(fd, buf, 1) == 1 && buf[0] == 'x');
+
+  for(i = 0; i < sizeof(big); i++)
+  {
+    big[i] = i & 0x7F;
+  }
+  for(i = 0; i < 1000 && sent < sizeof(big); i++)
+  {
+    int n = write(fd, big + sent, sizeof(big) - sent);
+
+    sent += n > 0 ? n : 0;
+    usleep(1000);
+  }
+  ASSERT("Input not received", wait_status(bus, UART_STATUS_RX_READY, UART_STATUS_RX_READY) == 0);
+
+  /* Drain everything in order, the thread refills after the throttle */
+  for(i = 0; i < sent; i++)
+  {
+    int j = 0;
+
+    for(j = 0; j < 1000 && !(bus_read(bus, UART_BASE + UART_STATUS) & UART_STATUS_RX_READY); j++)
+    {
+      run(bus);
+      usleep(100);
+    }
+    if(bus_read(bus, UART_BASE + UART_DATA) != (i & 0x7F))
+    {
+      break;
+    }
+  }
+  ASSERT("Input lost or reordered", i == sent);
+
+  close(fd);
+  bus_destroy(&bus);
+  ASSERT("Failed to destroy bus", bus==NULL);
+
+  return 0;
+}
+
+int main()
+{
+  UNIT_TEST_INIT("UART");
+
+  log_set_level(LOG_INFO);
+
+  RUN_TEST(uart_t0001, "Unix socket backend");
+  RUN_TEST(uart_t0002, "Pseudo terminal backend");
+
+  UNIT_TEST_ERG();
+
+  return unit_failed == 0 ? 0 : 1;
+}
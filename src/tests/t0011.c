@@ -0,0 +1,187 @@
+/*
+ * Copyright (c) 2022, Bernd Bauer <bernd.bauer@gmx.at>
+ *
+ * SPDX-License-Identifier: BSD-2-Clause
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+
+#include "util/log.h"
+#include "util/unit.h"
+
+#include "core/bus.h"
+#include "core/device.h"
+#include "core/block.h"
+
+#include "testbus.h"
+
+#define BLOCK_BASE 0x7000
+#define SECTORS    8
+
+static char image[64];
+
+static void block(struct CPU6502 *cpu)
+{
+}
+
+static void command(struct Bus *bus, uint8_t cmd, uint8_t count, uint16_t addr, uint32_t lba)
+{
+  int i = 0;
+
+  bus_write(bus, BLOCK_BASE + BLOCK_COUNT, count);
+  bus_write(bus, BLOCK_BASE + BLOCK_ADDRL, addr & 0xFF);
+  bus_write(bus, BLOCK_BASE + BLOCK_ADDRH, addr >> 8);
+  for(i = 0; i < 4; i++)
+  {
+    bus_write(bus, BLOCK_BASE + BLOCK_LBA0 + i, lba >> (i * 8));
+  }
+  bus_write(bus, BLOCK_BASE + BLOCK_COMMAND, cmd);
+}
+
+/**
+ * Sectors arrive in memory at once after the latency, with an interrupt
+ */
+int block_t0001()
+{
+  uint8_t data[4 * BLOCK_SECTOR_SIZE];
+  struct Bus *bus = NULL;
+  struct Block *blk = NULL;
+  int i = 0;
+
+  bus = testbus_idle();
+  ASSERT("Failed to create bus", bus!=NULL);
+  blk = block_create(bus, BLOCK_BASE, 2, image, 500);
+  ASSERT("Failed to create block device", blk!=NULL);
+  ASSERT("Wrong size", bus_read(bus, BLOCK_BASE + BLOCK_SIZE0) == SECTORS && bus_read(bus, BLOCK_BASE + BLOCK_SIZE0 + 1) == 0);
+
+  bus->cpu->blocks = calloc(0x10000, sizeof(CPU6502_BlockFn));
+  ASSERT("Failed to allocate blocks", bus->cpu->blocks!=NULL);
+  bus->cpu->blocks[0x1234] = block;
+
+  bus_write(bus, BLOCK_BASE + BLOCK_CONTROL, BLOCK_CONTROL_IRQ);
+  command(bus, BLOCK_CMD_READ, 4, 0x1000, 2);
+  ASSERT("Not busy", bus_read(bus, BLOCK_BASE + BLOCK_STATUS) == BLOCK_STATUS_BUSY);
+
+  testbus_run(bus, 400);
+  ASSERT("Early completion", bus_read(bus, BLOCK_BASE + BLOCK_STATUS) == BLOCK_STATUS_BUSY && bus_peek(bus, 0x1000) == 0);
+
+  testbus_run(bus, 200);
+  ASSERT("No completion", bus_read(bus, BLOCK_BASE + BLOCK_STATUS) == (BLOCK_STATUS_DONE | BLOCK_STATUS_IRQ));
+  ASSERT("IRQ line not asserted", bus->cpu->irq_lines == (1 << 2));
+
+  bus_peek_block(bus, 0x1000, data, sizeof(data));
+  for(i = 0; i < sizeof(data); i++)
+  {
+    if(data[i] != ((2 + i / BLOCK_SECTOR_SIZE) ^ (i & 0xFF)))
+    {
+      break;
+    }
+  }
+  ASSERT("Wrong data", i == sizeof(data) && bus_peek(bus, 0x1800) == 0);
+  ASSERT("Recompiled code of overwritten memory kept", bus->cpu->blocks[0x1234] == NULL);
+
+  bus_write(bus, BLOCK_BASE + BLOCK_STATUS, 0);
+  ASSERT("Not acknowledged", bus_read(bus, BLOCK_BASE + BLOCK_STATUS) == 0 && bus->cpu->irq_lines == 0);
+
+  bus_destroy(&bus);
+  ASSERT("Failed to destroy bus", bus==NULL);
+
+  return 0;
+}
+
+/**
+ * Memory written to the image reaches the file, invalid commands fail
+ */
+int block_t0002()
+{
+  uint8_t data[BLOCK_SECTOR_SIZE];
+  struct Bus *bus = NULL;
+  struct Block *blk = NULL;
+  int fd = -1;
+  int i = 0;
+
+  bus = testbus_idle();
+  ASSERT("Failed to create bus", bus!=NULL);
+  blk = block_create(bus, BLOCK_BASE, 0, image, 100);
+  ASSERT("Failed to create block device", blk!=NULL);
+
+  for(i = 0; i < BLOCK_SECTOR_SIZE; i++)
+  {
+    bus_poke(bus, 0x2000 + i, 0xFF - (i & 0xFF));
+  }
+  command(bus, BLOCK_CMD_WRITE, 1, 0x2000, SECTORS - 1);
+  command(bus, BLOCK_CMD_READ, 1, 0x3000, 0);
+  ASSERT("Busy device took a command", bus_read(bus, BLOCK_BASE + BLOCK_COMMAND) == BLOCK_CMD_WRITE);
+  testbus_run(bus, 200);
+  ASSERT("Write failed", bus_read(bus, BLOCK_BASE + BLOCK_STATUS) == BLOCK_STATUS_DONE);
+
+  bus_write(bus, BLOCK_BASE + BLOCK_COMMAND, BLOCK_CMD_FLUSH);
+  testbus_run(bus, 200);
+  ASSERT("Flush failed", bus_read(bus, BLOCK_BASE + BLOCK_STATUS) == BLOCK_STATUS_DONE);
+
+  command(bus, BLOCK_CMD_READ, 2, 0x3000, SECTORS - 1);
+  testbus_run(bus, 200);
+  ASSERT("Read past the end", bus_read(bus, BLOCK_BASE + BLOCK_STATUS) == (BLOCK_STATUS_DONE | BLOCK_STATUS_ERROR));
+  command(bus, BLOCK_CMD_READ, 1, 0xFF00, 0);
+  testbus_run(bus, 200);
+  ASSERT("Read past the address space", bus_read(bus, BLOCK_BASE + BLOCK_STATUS) == (BLOCK_STATUS_DONE | BLOCK_STATUS_ERROR));
+
+  bus_destroy(&bus);
+  ASSERT("Failed to destroy bus", bus==NULL);
+
+  fd = open(image, O_RDONLY);
+  ASSERT("Failed to open image", fd >= 0);
+  ASSERT("Failed to read image", pread(fd, data, sizeof(data), (SECTORS - 1) * BLOCK_SECTOR_SIZE) == sizeof(data));
+  close(fd);
+  for(i = 0; i < BLOCK_SECTOR_SIZE; i++)
+  {
+    if(data[i] != 0xFF - (i & 0xFF))
+    {
+      break;
+    }
+  }
+  ASSERT("Sector not written", i == BLOCK_SECTOR_SIZE);
+
+  return 0;
+}
+
+int main()
+{
+  uint8_t sector[BLOCK_SECTOR_SIZE];
+  FILE *fp = NULL;
+  int i = 0;
+  int j = 0;
+
+  UNIT_TEST_INIT("BLOCK");
+
+  log_set_level(LOG_INFO);
+
+  snprintf(image, sizeof(image), "/tmp/t0011-%d.img", (int)getpid());
+  fp = fopen(image, "w");
+  if(fp == NULL)
+  {
+    return 1;
+  }
+  for(i = 0; i < SECTORS; i++)
+  {
+    for(j = 0; j < BLOCK_SECTOR_SIZE; j++)
+    {
+      sector[j] = i ^ (j & 0xFF);
+    }
+    fwrite(sector, 1, sizeof(sector), fp);
+  }
+  fclose(fp);
+
+  RUN_TEST(block_t0001, "DMA read with completion interrupt");
+  RUN_TEST(block_t0002, "DMA write and invalid commands");
+
+  unlink(image);
+
+  UNIT_TEST_ERG();
+
+  return unit_failed == 0 ? 0 : 1;
+}
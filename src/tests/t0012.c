@@ -0,0 +1,178 @@
+/*
+ * Copyright (c) 2022, Bernd Bauer <bernd.bauer@gmx.at>
+ *
+ * SPDX-License-Identifier: BSD-2-Clause
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/stat.h>
+
+#include "util/log.h"
+#include "util/unit.h"
+
+#include "core/bus.h"
+#include "core/device.h"
+#include "core/framebuffer.h"
+
+#include "testbus.h"
+
+#define FB_BASE 0x4000
+
+static const uint8_t* pixel(struct Framebuffer *fb, int x, int y)
+{
+  return fb->rgba + (y * fb->width + x) * 4;
+}
+
+/**
+ * Only scanlines written since the last render are converted
+ */
+int framebuffer_t0001()
+{
+  struct Bus *bus = NULL;
+  struct Framebuffer *fb = NULL;
+
+  bus = testbus_idle();
+  ASSERT("Failed to create bus", bus!=NULL);
+  fb = framebuffer_create(bus, FB_BASE, 32, 8, 8, NULL, FRAMEBUFFER_INTERVAL, 0);
+  ASSERT("Failed to create framebuffer", fb!=NULL);
+  ASSERT("Initial conversion missing", fb->converted == 8 && pixel(fb, 0, 0)[3] == 0xFF);
+
+  bus_write(bus, FB_BASE + 3 * 32 + 5, 0xE0);
+  ASSERT("Write not stored", bus_read(bus, FB_BASE + 3 * 32 + 5) == 0xE0);
+  ASSERT("Event without output", fb->dev->event == -1);
+  ASSERT("Wrong scanlines converted", framebuffer_render(fb) == 1 && fb->converted == 9);
+  ASSERT("Wrong colour", memcmp(pixel(fb, 5, 3), "\xFF\x00\x00\xFF", 4) == 0 && pixel(fb, 4, 3)[0] == 0);
+  ASSERT("Clean screen converted", framebuffer_render(fb) == 0);
+
+  bus_write(bus, FB_BASE + 3 * 32 + 5, 0xE0);
+  ASSERT("Unchanged pixel converted", framebuffer_render(fb) == 0);
+
+  bus_write(bus, FB_BASE + 0 * 32 + 31, 0x03);
+  bus_write(bus, FB_BASE + 7 * 32 + 0, 0x1C);
+  bus_write(bus, FB_BASE + 7 * 32 + 1, 0xFF);
+  ASSERT("Wrong scanlines converted", framebuffer_render(fb) == 2 && fb->converted == 11);
+  ASSERT("Wrong colours", memcmp(pixel(fb, 31, 0), "\x00\x00\xFF\xFF", 4) == 0 &&
+         memcmp(pixel(fb, 0, 7), "\x00\xFF\x00\xFF", 4) == 0 && memcmp(pixel(fb, 1, 7), "\xFF\xFF\xFF\xFF", 4) == 0);
+
+  bus_destroy(&bus);
+  ASSERT("Failed to destroy bus", bus==NULL);
+
+  return 0;
+}
+
+/**
+ * Changed frames are written as PPM at the next interval, a still screen
+ * posts no event
+ */
+int framebuffer_t0002()
+{
+  char pattern[64];
+  char name[64];
+  char header[16];
+  uint8_t rgb[3];
+  struct Bus *bus = NULL;
+  struct Framebuffer *fb = NULL;
+  FILE *fp = NULL;
+
+  snprintf(pattern, sizeof(pattern), "/tmp/t0012-%d-%%03d.ppm", (int)getpid());
+
+  bus = testbus_idle();
+  ASSERT("Failed to create bus", bus!=NULL);
+  ASSERT("Bad pattern accepted", framebuffer_create(bus, FB_BASE, 16, 4, 2, "/tmp/%s.ppm", 1000, 0) == NULL);
+  fb = framebuffer_create(bus, FB_BASE, 16, 4, 2, pattern, 1000, 0);
+  ASSERT("Failed to create framebuffer", fb!=NULL && fb->size == 16);
+
+  testbus_run(bus, 5000);
+  ASSERT("Frame of a still screen", fb->frames == 0 && fb->dev->event == -1);
+
+  /* Second pixel of line 2 white, both writes land in one frame */
+  bus_write(bus, FB_BASE + 2 * 4, 0x30);
+  ASSERT("No frame booked", fb->dev->event != -1);
+  testbus_run(bus, 100);
+  bus_write(bus, FB_BASE + 3 * 4, 0x01);
+  testbus_run(bus, 2000);
+  ASSERT("Wrong frames", fb->frames == 1 && fb->converted == 4 + 2 && fb->dev->event == -1);
+
+  testbus_run(bus, 5000);
+  ASSERT("Frame of a still screen", fb->frames == 1);
+
+  snprintf(name, sizeof(name), pattern, 0);
+  fp = fopen(name, "rb");
+  ASSERT("Frame missing", fp != NULL);
+  ASSERT("Wrong header", fread(header, 1, 12, fp) == 12 && memcmp(header, "P6\n16 4\n255\n", 12) == 0);
+  fseek(fp, 12 + (2 * 16 + 1) * 3, SEEK_SET);
+  ASSERT("Wrong pixel", fread(rgb, 1, 3, fp) == 3 && memcmp(rgb, "\xFF\xFF\xFF", 3) == 0);
+  fseek(fp, 12 + (3 * 16 + 3) * 3, SEEK_SET);
+  ASSERT("Wrong pixel", fread(rgb, 1, 3, fp) == 3 && memcmp(rgb, "\x55\x55\x55", 3) == 0);
+  fclose(fp);
+  unlink(name);
+
+  /* A change left at exit is still written */
+  bus_write(bus, FB_BASE, 0xC0);
+  bus_destroy(&bus);
+  ASSERT("Failed to destroy bus", bus==NULL);
+
+  snprintf(name, sizeof(name), pattern, 1);
+  ASSERT("Last frame missing", access(name, F_OK) == 0);
+  unlink(name);
+
+  return 0;
+}
+
+/**
+ * Raw RGBA stream of the changed frames
+ */
+int framebuffer_t0003()
+{
+  char name[64];
+  uint8_t frame[8 * 2 * 4];
+  struct Bus *bus = NULL;
+  struct Framebuffer *fb = NULL;
+  struct stat st;
+  FILE *fp = NULL;
+
+  snprintf(name, sizeof(name), "/tmp/t0012-%d.rgba", (int)getpid());
+
+  bus = testbus_idle();
+  ASSERT("Failed to create bus", bus!=NULL);
+  fb = framebuffer_create(bus, FB_BASE, 8, 2, 1, name, 1000, 0);
+  ASSERT("Failed to create framebuffer", fb!=NULL && fb->size == 2);
+
+  bus_write(bus, FB_BASE + 1, 0x81);
+  testbus_run(bus, 2000);
+  bus_write(bus, FB_BASE + 1, 0x00);
+  testbus_run(bus, 2000);
+  testbus_run(bus, 2000);
+  ASSERT("Wrong frames", fb->frames == 2);
+
+  bus_destroy(&bus);
+  ASSERT("Failed to destroy bus", bus==NULL);
+
+  ASSERT("Wrong stream size", stat(name, &st) == 0 && st.st_size == 2 * sizeof(frame));
+  fp = fopen(name, "rb");
+  ASSERT("Stream missing", fp != NULL && fread(frame, 1, sizeof(frame), fp) == sizeof(frame));
+  fclose(fp);
+  unlink(name);
+  ASSERT("Wrong first frame", frame[8 * 4] == 0xFF && frame[9 * 4] == 0x00 && frame[15 * 4] == 0xFF &&
+         frame[15 * 4 + 3] == 0xFF && frame[0] == 0x00);
+
+  return 0;
+}
+
+int main()
+{
+  UNIT_TEST_INIT("FRAMEBUFFER");
+
+  log_set_level(LOG_INFO);
+
+  RUN_TEST(framebuffer_t0001, "Dirty scanline conversion");
+  RUN_TEST(framebuffer_t0002, "PPM frames");
+  RUN_TEST(framebuffer_t0003, "Raw RGBA stream");
+
+  UNIT_TEST_ERG();
+
+  return unit_failed == 0 ? 0 : 1;
+}
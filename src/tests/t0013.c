@@ -0,0 +1,208 @@
+/*
+ * Copyright (c) 2022, Bernd Bauer <bernd.bauer@gmx.at>
+ *
+ * SPDX-License-Identifier: BSD-2-Clause
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "util/log.h"
+#include "util/unit.h"
+
+#include "core/bus.h"
+#include "core/system.h"
+
+#include "testbus.h"
+
+#define SHARED_BASE  0x3000
+#define MAILBOX_BASE 0x7000
+
+/**
+ * Independent CPUs run whole quanta and stay within one of each other
+ */
+int system_t0001()
+{
+  /* INC $10; JMP $0200 */
+  static const uint8_t code[] = { 0xE6, 0x10, 0x4C, 0x00, 0x02 };
+  struct System *sys = NULL;
+  struct Bus *bus[2] = { NULL, NULL };
+  int i = 0;
+
+  sys = system_create(1000);
+  ASSERT("Failed to create system", sys!=NULL);
+  for(i = 0; i < 2; i++)
+  {
+    bus[i] = system_add_cpu(sys);
+    ASSERT("Failed to add CPU", bus[i]!=NULL);
+    testbus_load(bus[i], 0x0200, code, sizeof(code));
+  }
+
+  system_run(sys, 10000);
+  ASSERT("Wrong stop", sys->stop == BUS_RUNNING && sys->stopped == -1);
+  ASSERT("Not in quanta", sys->slices == 10 && sys->contended == 0);
+  ASSERT("Not run", system_now(sys) >= 10000 && bus[0]->cpu->clock_count < 10000 + 8 && bus[1]->cpu->clock_count < 10000 + 8);
+  ASSERT("Different progress", bus_peek(bus[0], 0x10) == bus_peek(bus[1], 0x10) && bus_peek(bus[0], 0x10) != 0);
+
+  system_destroy(&sys);
+  ASSERT("Failed to destroy system", sys==NULL);
+
+  return 0;
+}
+
+/**
+ * Ping pong over shared memory tightens the quantum, private memory stays
+ * private, both sides idle at the end
+ */
+int system_t0002()
+{
+  /* LDX #0; INX; STX ping; CPX pong; BNE *-3; CPX #100; BNE *-11; JMP * */
+  static const uint8_t ping[] = { 0xA2, 0x00, 0xE8, 0x8E, 0x00, 0x30, 0xEC, 0x01, 0x30, 0xD0, 0xFB,
+                                  0xE0, 0x64, 0xD0, 0xF3, 0x4C, 0x0F, 0x02 };
+  /* LDA ping; CMP pong; BEQ *-6; STA pong; STA $10; CMP #100; BNE *-17; JMP * */
+  static const uint8_t pong[] = { 0xAD, 0x00, 0x30, 0xCD, 0x01, 0x30, 0xF0, 0xF8, 0x8D, 0x01, 0x30,
+                                  0x85, 0x10, 0xC9, 0x64, 0xD0, 0xEF, 0x4C, 0x11, 0x02 };
+  struct System *sys = NULL;
+  struct Memory *mem = NULL;
+  struct Bus *bus[2] = { NULL, NULL };
+  int i = 0;
+
+  sys = system_create(1000);
+  ASSERT("Failed to create system", sys!=NULL);
+  mem = system_add_shared(sys, 0x100);
+  ASSERT("Failed to add shared memory", mem!=NULL);
+  for(i = 0; i < 2; i++)
+  {
+    bus[i] = system_add_cpu(sys);
+    ASSERT("Failed to add CPU", bus[i]!=NULL);
+    ASSERT("Failed to share memory", system_share(sys, mem, i, SHARED_BASE) == 0);
+    ASSERT("Shared reads trapped", bus_is_plain_memory(bus[i], SHARED_BASE));
+  }
+  testbus_load(bus[0], 0x0200, ping, sizeof(ping));
+  testbus_load(bus[1], 0x0200, pong, sizeof(pong));
+
+  system_run(sys, BUS_RUN_FOREVER);
+  ASSERT("Wrong stop", sys->stop == BUS_STOP_IDLE);
+  ASSERT("Wrong shared memory", mem->mem[0] == 100 && mem->mem[1] == 100 && bus_peek(bus[0], SHARED_BASE + 1) == 100);
+  ASSERT("Private memory shared", bus_peek(bus[1], 0x10) == 100 && bus_peek(bus[0], 0x10) == 0);
+  ASSERT("Not contended", sys->contended == 200);
+
+  /* A quantum per round trip would take 100000 cycles */
+  ASSERT("Quantum not tightened", system_now(sys) < 20000);
+
+  system_destroy(&sys);
+  ASSERT("Failed to destroy system", sys==NULL);
+
+  return 0;
+}
+
+/**
+ * A mailbox byte raises the IRQ of the idle receiver, which answers
+ */
+int system_t0003()
+{
+  /* LDA #$5A; STA data; CLI; JMP * */
+  static const uint8_t sender[] = { 0xA9, 0x5A, 0x8D, 0x00, 0x70, 0x58, 0x4C, 0x06, 0x02 };
+  /* CLI; JMP * */
+  static const uint8_t receiver[] = { 0x58, 0x4C, 0x01, 0x02 };
+  /* IRQ handlers at 0x0300: LDA data; STA $10; RTI and LDA data; CLC; ADC #1; STA data; RTI */
+  static const uint8_t handler0[] = { 0xAD, 0x00, 0x70, 0x85, 0x10, 0x40 };
+  static const uint8_t handler1[] = { 0xAD, 0x00, 0x70, 0x18, 0x69, 0x01, 0x8D, 0x00, 0x70, 0x40 };
+  struct System *sys = NULL;
+  struct Bus *bus[2] = { NULL, NULL };
+  int i = 0;
+
+  sys = system_create(5000);
+  ASSERT("Failed to create system", sys!=NULL);
+  for(i = 0; i < 2; i++)
+  {
+    bus[i] = system_add_cpu(sys);
+    ASSERT("Failed to add CPU", bus[i]!=NULL);
+    bus_poke(bus[i], CPU6502_VECTOR_IRQ, 0x00);
+    bus_poke(bus[i], CPU6502_VECTOR_IRQ + 1, 0x03);
+  }
+  ASSERT("Failed to add mailbox", system_add_mailbox(sys, 0, MAILBOX_BASE, 1, 1, MAILBOX_BASE, 2) == 0);
+  ASSERT("Invalid mailbox accepted", system_add_mailbox(sys, 0, 0x7100, 1, 2, MAILBOX_BASE, 2) != 0);
+
+  /* Register semantics without running */
+  bus_write(bus[0], MAILBOX_BASE + SYSTEM_MAILBOX_DATA, 0x11);
+  ASSERT("Not sent", bus_read(bus[0], MAILBOX_BASE + SYSTEM_MAILBOX_STATUS) == SYSTEM_MAILBOX_TX_FULL &&
+         bus_read(bus[1], MAILBOX_BASE + SYSTEM_MAILBOX_STATUS) == SYSTEM_MAILBOX_RX_FULL);
+  ASSERT("IRQ not raised", bus[1]->cpu->irq_lines == (1 << 2) && bus[0]->cpu->irq_lines == 0);
+  ASSERT("Not received", bus_read(bus[1], MAILBOX_BASE + SYSTEM_MAILBOX_DATA) == 0x11);
+  ASSERT("Not acknowledged", bus[1]->cpu->irq_lines == 0 && bus_read(bus[0], MAILBOX_BASE + SYSTEM_MAILBOX_STATUS) == 0);
+
+  testbus_load(bus[0], 0x0300, handler0, sizeof(handler0));
+  testbus_load(bus[1], 0x0300, handler1, sizeof(handler1));
+  testbus_load(bus[0], 0x0200, sender, sizeof(sender));
+  testbus_load(bus[1], 0x0200, receiver, sizeof(receiver));
+
+  system_run(sys, BUS_RUN_FOREVER);
+  ASSERT("Wrong stop", sys->stop == BUS_STOP_IDLE);
+  ASSERT("No answer", bus_peek(bus[0], 0x10) == 0x5B);
+  ASSERT("IRQ left", bus[0]->cpu->irq_lines == 0 && bus[1]->cpu->irq_lines == 0);
+
+  system_destroy(&sys);
+  ASSERT("Failed to destroy system", sys==NULL);
+
+  return 0;
+}
+
+/**
+ * A CPU that went idle first in a slice still wakes for a mailbox byte
+ * sent later in the same slice
+ */
+int system_t0004()
+{
+  /* CLI; JMP * */
+  static const uint8_t receiver[] = { 0x58, 0x4C, 0x01, 0x02 };
+  /* LDA #$5A; STA data; SEI; JMP * */
+  static const uint8_t sender[] = { 0xA9, 0x5A, 0x8D, 0x00, 0x70, 0x78, 0x4C, 0x06, 0x02 };
+  /* IRQ handler at 0x0300: LDA data; STA $10; RTI */
+  static const uint8_t handler[] = { 0xAD, 0x00, 0x70, 0x85, 0x10, 0x40 };
+  struct System *sys = NULL;
+  struct Bus *bus[2] = { NULL, NULL };
+  int i = 0;
+
+  sys = system_create(5000);
+  ASSERT("Failed to create system", sys!=NULL);
+  for(i = 0; i < 2; i++)
+  {
+    bus[i] = system_add_cpu(sys);
+    ASSERT("Failed to add CPU", bus[i]!=NULL);
+  }
+  ASSERT("Failed to add mailbox", system_add_mailbox(sys, 0, MAILBOX_BASE, 1, 1, MAILBOX_BASE, 2) == 0);
+  bus_poke(bus[0], CPU6502_VECTOR_IRQ, 0x00);
+  bus_poke(bus[0], CPU6502_VECTOR_IRQ + 1, 0x03);
+  testbus_load(bus[0], 0x0300, handler, sizeof(handler));
+
+  /* The receiver idles first, the byte arrives within the tight quantum */
+  testbus_load(bus[0], 0x0200, receiver, sizeof(receiver));
+  testbus_load(bus[1], 0x0200, sender, sizeof(sender));
+
+  system_run(sys, BUS_RUN_FOREVER);
+  ASSERT("Wrong stop", sys->stop == BUS_STOP_IDLE);
+  ASSERT("Handler not run", bus_peek(bus[0], 0x10) == 0x5A);
+  ASSERT("IRQ left", bus[0]->cpu->irq_lines == 0);
+
+  system_destroy(&sys);
+
+  return 0;
+}
+
+int main()
+{
+  UNIT_TEST_INIT("SYSTEM");
+
+  log_set_level(LOG_INFO);
+
+  RUN_TEST(system_t0001, "Quantum interleaving");
+  RUN_TEST(system_t0002, "Shared memory");
+  RUN_TEST(system_t0003, "Mailbox");
+  RUN_TEST(system_t0004, "Mailbox to a CPU idle earlier in the slice");
+
+  UNIT_TEST_ERG();
+
+  return unit_failed == 0 ? 0 : 1;
+}
@@ -0,0 +1,333 @@
+/*
+ * Copyright (c) 2022, Bernd Bauer <bernd.bauer@gmx.at>
+ *
+ * SPDX-License-Identifier: BSD-2-Clause
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "util/log.h"
+#include "util/unit.h"
+#include "util/ring.h"
+
+#include "core/bus.h"
+#include "core/offload.h"
+#include "core/framebuffer.h"
+
+#include "testbus.h"
+
+#define FB_BASE 0x4000
+#define RECORDS 2000
+
+struct Counter
+{
+  uint64_t last;
+  uint32_t writes;
+  uint32_t advances;
+  uint32_t sum;
+  int ordered;
+  int slow;
+};
+
+static void counter_write(void *ctx, uint64_t when, uint16_t offset, uint8_t data)
+{
+  struct Counter *c = ctx;
+
+  if(c->slow)
+  {
+    usleep(20);
+  }
+  c->ordered = c->ordered && when >= c->last;
+  c->last = when;
+  c->writes++;
+  c->sum += data;
+}
+
+static void counter_advance(void *ctx, uint64_t when)
+{
+  struct Counter *c = ctx;
+
+  c->ordered = c->ordered && when >= c->last;
+  c->last = when;
+  c->advances++;
+}
+
+static const struct OffloadOps counter_ops = {
+  .name = "counter",
+  .write = counter_write,
+  .advance = counter_advance
+};
+
+static long load(const char *path, uint8_t **data)
+{
+  FILE *fp = fopen(path, "rb");
+  long len = 0;
+
+  if(fp == NULL)
+  {
+    return -1;
+  }
+  fseek(fp, 0, SEEK_END);
+  len = ftell(fp);
+  fseek(fp, 0, SEEK_SET);
+  *data = malloc(len + 1);
+  if(*data == NULL || fread(*data, 1, len, fp) != len)
+  {
+    len = -1;
+  }
+  fclose(fp);
+
+  return len;
+}
+
+/* Draws a moving pattern for a number of frames, leaves the frames in
+ * output and the last picture in rgba */
+static int draw(const char *output, uint64_t max_lag, uint8_t *rgba, uint32_t *frames)
+{
+  struct Bus *bus = NULL;
+  struct Framebuffer *fb = NULL;
+  int f = 0;
+  int k = 0;
+
+  bus = testbus_idle();
+  if(bus == NULL)
+  {
+    return -1;
+  }
+  fb = framebuffer_create(bus, FB_BASE, 64, 32, 8, output, 1000, max_lag);
+  if(fb == NULL)
+  {
+    bus_destroy(&bus);
+    return -1;
+  }
+
+  for(f = 0; f < 50; f++)
+  {
+    for(k = 0; k < 40; k++)
+    {
+      bus_write(bus, FB_BASE + (f * 37 + k * 53) % fb->size, f * 7 + k);
+    }
+    testbus_run(bus, 1000);
+  }
+  bus_write(bus, FB_BASE, 0xFF);
+
+  framebuffer_render(fb);
+  memcpy(rgba, fb->rgba, 64 * 32 * 4);
+  *frames = fb->frames;
+
+  bus_destroy(&bus);
+
+  return 0;
+}
+
+/**
+ * A threaded back end gets every record in order
+ */
+int offload_t0001()
+{
+  struct Counter c = { .ordered = 1 };
+  struct Offload *off = NULL;
+  uint32_t sum = 0;
+  int i = 0;
+
+  off = offload_create(&counter_ops, &c, OFFLOAD_QUEUE, OFFLOAD_MAX_LAG);
+  ASSERT("Failed to create offload", off!=NULL && off->threaded);
+  ASSERT("Invalid queue size accepted", offload_create(&counter_ops, &c, 1000, OFFLOAD_MAX_LAG) == NULL);
+
+  for(i = 0; i < RECORDS; i++)
+  {
+    offload_write(off, i, 0, i & 0xFF);
+    sum += i & 0xFF;
+    if(i % 100 == 0)
+    {
+      offload_advance(off, i);
+    }
+  }
+
+  offload_sync(off);
+  ASSERT("Not drained", ring_count(off->queue) == 0);
+  ASSERT("Records lost", c.writes == RECORDS && c.sum == sum && c.advances == RECORDS / 100);
+  ASSERT("Out of order", c.ordered && c.last == RECORDS - 1);
+
+  offload_write(off, RECORDS, 0, 1);
+  offload_destroy(&off);
+  ASSERT("Failed to destroy offload", off==NULL);
+  ASSERT("Not drained on destroy", c.writes == RECORDS + 1);
+
+  return 0;
+}
+
+/**
+ * A slow back end holds the emulation thread back to max lag cycles
+ */
+int offload_t0002()
+{
+  struct Counter c = { .ordered = 1, .slow = 1 };
+  struct Offload *off = NULL;
+  int behind = 0;
+  int i = 0;
+
+  off = offload_create(&counter_ops, &c, OFFLOAD_QUEUE, 100);
+  ASSERT("Failed to create offload", off!=NULL);
+
+  for(i = 0; i < RECORDS / 4; i++)
+  {
+    offload_write(off, i * 10, 0, 0);
+
+    /* Everything older than the lag is done */
+    if(ring_count(off->queue) > 11)
+    {
+      behind++;
+    }
+  }
+  ASSERT("Lag not bounded", behind == 0);
+  ASSERT("Never stalled", off->stalls > 0);
+
+  offload_destroy(&off);
+  ASSERT("Records lost", c.writes == RECORDS / 4 && c.ordered);
+
+  return 0;
+}
+
+/**
+ * Without a lag the back end runs inline
+ */
+int offload_t0003()
+{
+  struct Counter c = { .ordered = 1 };
+  struct Offload *off = NULL;
+
+  off = offload_create(&counter_ops, &c, OFFLOAD_QUEUE, 0);
+  ASSERT("Failed to create offload", off!=NULL && !off->threaded);
+
+  offload_write(off, 10, 0, 5);
+  ASSERT("Write not applied", c.writes == 1 && c.sum == 5 && c.last == 10);
+  offload_advance(off, 20);
+  ASSERT("Advance not applied", c.advances == 1 && c.last == 20);
+
+  offload_destroy(&off);
+  ASSERT("Failed to destroy offload", off==NULL);
+
+  return 0;
+}
+
+/**
+ * The frames are the same whether made inline or on the worker thread
+ */
+int offload_t0004()
+{
+  char inline_path[] = "/tmp/t0014_inline_XXXXXX";
+  char thread_path[] = "/tmp/t0014_thread_XXXXXX";
+  static uint8_t rgba[2][64 * 32 * 4];
+  uint8_t *a = NULL;
+  uint8_t *b = NULL;
+  uint32_t frames[2] = { 0, 0 };
+  long len[2] = { 0, 0 };
+  int fd = 0;
+
+  fd = mkstemp(inline_path);
+  ASSERT("Failed to create output", fd >= 0);
+  close(fd);
+  fd = mkstemp(thread_path);
+  ASSERT("Failed to create output", fd >= 0);
+  close(fd);
+
+  ASSERT("Failed to draw inline", draw(inline_path, 0, rgba[0], &frames[0]) == 0);
+  ASSERT("Failed to draw threaded", draw(thread_path, OFFLOAD_MAX_LAG, rgba[1], &frames[1]) == 0);
+
+  len[0] = load(inline_path, &a);
+  len[1] = load(thread_path, &b);
+  unlink(inline_path);
+  unlink(thread_path);
+
+  /* One frame per interval and the last change written on destroy */
+  ASSERT("Wrong frames", frames[0] == 50 && frames[1] == frames[0]);
+  ASSERT("Wrong stream size", len[0] == 51 * sizeof(rgba[0]) && len[1] == len[0]);
+  ASSERT("Different frames", memcmp(a, b, len[0]) == 0);
+  ASSERT("Different picture", memcmp(rgba[0], rgba[1], sizeof(rgba[0])) == 0 &&
+         memcmp(rgba[0], "\xFF\xFF\xFF\xFF", 4) == 0);
+
+  free(a);
+  free(b);
+
+  return 0;
+}
+
+/**
+ * Rendering waits for every queued write of the threaded back end
+ */
+int offload_t0005()
+{
+  struct Bus *bus = NULL;
+  struct Framebuffer *fb = NULL;
+  int y = 0;
+
+  bus = testbus_idle();
+  ASSERT("Failed to create bus", bus!=NULL);
+  fb = framebuffer_create(bus, FB_BASE, 64, 32, 8, NULL, FRAMEBUFFER_INTERVAL, OFFLOAD_MAX_LAG);
+  ASSERT("Failed to create framebuffer", fb!=NULL && fb->off->threaded);
+
+  for(y = 0; y < 32; y++)
+  {
+    bus_write(bus, FB_BASE + y * 64 + y, 0xE0);
+  }
+  ASSERT("Wrong scanlines converted", framebuffer_render(fb) == 32 && ring_count(fb->off->queue) == 0);
+  for(y = 0; y < 32; y++)
+  {
+    ASSERT("Write missing", memcmp(fb->rgba + (y * 64 + y) * 4, "\xFF\x00\x00\xFF", 4) == 0);
+  }
+
+  bus_destroy(&bus);
+
+  return 0;
+}
+
+/**
+ * Records wrap around a small queue and a full queue holds the emulation
+ * thread back
+ */
+int offload_t0006()
+{
+  struct Counter c = { .ordered = 1 };
+  struct Offload *off = NULL;
+  uint32_t sum = 0;
+  int i = 0;
+
+  off = offload_create(&counter_ops, &c, 16, OFFLOAD_MAX_LAG);
+  ASSERT("Failed to create offload", off!=NULL);
+
+  for(i = 0; i < RECORDS; i++)
+  {
+    offload_write(off, i, i, i & 0xFF);
+    sum += i & 0xFF;
+    ASSERT("Queue overrun", ring_count(off->queue) <= 16);
+  }
+
+  offload_sync(off);
+  ASSERT("Records lost", c.writes == RECORDS && c.sum == sum && c.ordered && c.last == RECORDS - 1);
+
+  offload_destroy(&off);
+
+  return 0;
+}
+
+int main()
+{
+  UNIT_TEST_INIT("OFFLOAD");
+
+  log_set_level(LOG_INFO);
+
+  RUN_TEST(offload_t0001, "Record order");
+  RUN_TEST(offload_t0002, "Lag bound");
+  RUN_TEST(offload_t0003, "Inline back end");
+  RUN_TEST(offload_t0004, "Framebuffer inline and threaded");
+  RUN_TEST(offload_t0005, "Render as sync point");
+  RUN_TEST(offload_t0006, "Small queue");
+
+  UNIT_TEST_ERG();
+
+  return unit_failed == 0 ? 0 : 1;
+}
@@ -0,0 +1,161 @@
+/*
+ * Copyright (c) 2022, Bernd Bauer <bernd.bauer@gmx.at>
+ *
+ * SPDX-License-Identifier: BSD-2-Clause
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "util/log.h"
+#include "util/unit.h"
+
+#include "core/scheduler.h"
+
+#define EVENTS 100
+
+/* Records the order events fire in */
+struct Trace
+{
+  struct Scheduler *sched;
+  uint64_t when[EVENTS * 2];
+  int count;
+};
+
+static void trace_event(void *ctx, uint64_t when)
+{
+  struct Trace *trace = ctx;
+
+  trace->when[trace->count++] = when;
+}
+
+static void trace_rearm(void *ctx, uint64_t when)
+{
+  struct Trace *trace = ctx;
+
+  trace_event(ctx, when);
+  if(trace->count < 5)
+  {
+    scheduler_add(trace->sched, when + 10, trace_rearm, ctx);
+  }
+}
+
+/**
+ * Events fire in timestamp order, whatever order they were added in
+ */
+int scheduler_t0001()
+{
+  struct Trace trace = { .count = 0 };
+  struct Scheduler *sched = NULL;
+  uint64_t deadline = SCHEDULER_NEVER;
+  int i = 0;
+
+  sched = scheduler_create(&deadline);
+  ASSERT("Failed to create scheduler", sched!=NULL);
+  ASSERT("Empty scheduler has an event", scheduler_next(sched) == SCHEDULER_NEVER);
+
+  /* More than the initial capacity, in a scrambled order */
+  for(i = 0; i < EVENTS; i++)
+  {
+    ASSERT("Failed to add event", scheduler_add(sched, 1000 + (i * 37) % EVENTS, trace_event, &trace) > 0);
+  }
+  ASSERT("Deadline not lowered", deadline == 1000);
+  ASSERT("Wrong next event", scheduler_next(sched) == 1000);
+
+  ASSERT("Future event fired", scheduler_dispatch(sched, 999) == 0);
+  ASSERT("Wrong events fired", scheduler_dispatch(sched, 1049) == 50 && scheduler_next(sched) == 1050);
+  ASSERT("Wrong events fired", scheduler_dispatch(sched, SCHEDULER_NEVER - 1) == 50);
+  ASSERT("Events left", scheduler_next(sched) == SCHEDULER_NEVER);
+
+  for(i = 0; i < EVENTS; i++)
+  {
+    ASSERT("Out of order", trace.when[i] == 1000 + i);
+  }
+
+  scheduler_destroy(&sched);
+  ASSERT("Failed to destroy scheduler", sched==NULL);
+
+  return 0;
+}
+
+/**
+ * Cancelled events do not fire, the rest keeps its order
+ */
+int scheduler_t0002()
+{
+  struct Trace trace = { .count = 0 };
+  struct Scheduler *sched = NULL;
+  int id[5];
+  int i = 0;
+
+  sched = scheduler_create(NULL);
+  ASSERT("Failed to create scheduler", sched!=NULL);
+
+  for(i = 0; i < 5; i++)
+  {
+    id[i] = scheduler_add(sched, 100 * (5 - i), trace_event, &trace);
+    ASSERT("Failed to add event", id[i] > 0);
+  }
+  ASSERT("Ids not unique", id[0] != id[1] && id[1] != id[2]);
+
+  /* The head, a middle and the last added one */
+  ASSERT("Failed to cancel", scheduler_cancel(sched, id[4]) == 0);
+  ASSERT("Failed to cancel", scheduler_cancel(sched, id[2]) == 0);
+  ASSERT("Failed to cancel", scheduler_cancel(sched, id[0]) == 0);
+  ASSERT("Cancelled twice", scheduler_cancel(sched, id[2]) == -1);
+  ASSERT("Wrong next event", scheduler_next(sched) == 200);
+
+  ASSERT("Wrong events fired", scheduler_dispatch(sched, 1000) == 2);
+  ASSERT("Wrong order", trace.count == 2 && trace.when[0] == 200 && trace.when[1] == 400);
+  ASSERT("Fired event cancelled", scheduler_cancel(sched, id[1]) == -1);
+
+  scheduler_destroy(&sched);
+
+  return 0;
+}
+
+/**
+ * An event may add the next one while it is dispatched, it fires in the
+ * same dispatch when it is already due
+ */
+int scheduler_t0003()
+{
+  struct Trace trace = { .count = 0 };
+  struct Scheduler *sched = NULL;
+  uint64_t deadline = 500;
+
+  sched = scheduler_create(&deadline);
+  ASSERT("Failed to create scheduler", sched!=NULL);
+  trace.sched = sched;
+
+  scheduler_add(sched, 600, trace_event, &trace);
+  ASSERT("Later event lowered deadline", deadline == 500);
+  scheduler_add(sched, 100, trace_rearm, &trace);
+  ASSERT("Deadline not lowered", deadline == 100);
+
+  ASSERT("Wrong events fired", scheduler_dispatch(sched, 125) == 3);
+  ASSERT("Wrong events fired", scheduler_dispatch(sched, 1000) == 3);
+  ASSERT("Wrong order", trace.count == 6 && trace.when[0] == 100 && trace.when[2] == 120 &&
+         trace.when[4] == 140 && trace.when[5] == 600);
+  ASSERT("Events left", scheduler_next(sched) == SCHEDULER_NEVER);
+
+  scheduler_destroy(&sched);
+
+  return 0;
+}
+
+int main()
+{
+  UNIT_TEST_INIT("SCHEDULER");
+
+  log_set_level(LOG_INFO);
+
+  RUN_TEST(scheduler_t0001, "Event order");
+  RUN_TEST(scheduler_t0002, "Cancel events");
+  RUN_TEST(scheduler_t0003, "Events added while dispatching");
+
+  UNIT_TEST_ERG();
+
+  return unit_failed == 0 ? 0 : 1;
+}
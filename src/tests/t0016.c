@@ -0,0 +1,180 @@
+/*
+ * Copyright (c) 2022, Bernd Bauer <bernd.bauer@gmx.at>
+ *
+ * SPDX-License-Identifier: BSD-2-Clause
+ */
+
+#include <stdio.h>
+
+#include "util/log.h"
+#include "util/unit.h"
+
+#include "core/bus.h"
+
+#include "testbus.h"
+
+#define IRQ_HANDLER 0x0300
+#define NMI_HANDLER 0x0340
+
+/* INC $20; LDA $20; STA $10; JMP * */
+static const uint8_t irq_handler[] = { 0xE6, 0x20, 0xA5, 0x20, 0x85, 0x10, 0x4C, 0x06, 0x03 };
+/* INC $20; LDA $20; STA $11; RTI */
+static const uint8_t nmi_handler[] = { 0xE6, 0x20, 0xA5, 0x20, 0x85, 0x11, 0x40 };
+
+static struct Bus* interrupt_bus(uint8_t accuracy)
+{
+  struct Bus *bus = bus_create();
+
+  if(bus != NULL)
+  {
+    bus_reset(bus);
+    CPU6502_setAccuracy(bus->cpu, accuracy);
+    testbus_load(bus, IRQ_HANDLER, irq_handler, sizeof(irq_handler));
+    testbus_load(bus, NMI_HANDLER, nmi_handler, sizeof(nmi_handler));
+    bus_poke(bus, CPU6502_VECTOR_IRQ, IRQ_HANDLER & 0xFF);
+    bus_poke(bus, CPU6502_VECTOR_IRQ + 1, IRQ_HANDLER >> 8);
+    bus_poke(bus, CPU6502_VECTOR_NMI, NMI_HANDLER & 0xFF);
+    bus_poke(bus, CPU6502_VECTOR_NMI + 1, NMI_HANDLER >> 8);
+  }
+
+  return bus;
+}
+
+/**
+ * An asserted IRQ line waits for the I flag to clear, an NMI does not
+ */
+int interrupt_t0001()
+{
+  /* SEI; NOP; NOP; NOP; CLI; JMP * */
+  static const uint8_t code[] = { 0x78, 0xEA, 0xEA, 0xEA, 0x58, 0x4C, 0x05, 0x02 };
+  struct Bus *bus = NULL;
+  struct CPU6502 *cpu = NULL;
+  int accuracy = 0;
+
+  for(accuracy = CPU6502_ACCURACY_FAST; accuracy <= CPU6502_ACCURACY_EXACT; accuracy++)
+  {
+    bus = interrupt_bus(accuracy);
+    ASSERT("Failed to create bus", bus!=NULL);
+    cpu = bus->cpu;
+    testbus_load(bus, 0x0200, code, sizeof(code));
+
+    CPU6502_step(cpu);
+    bus_irq_assert(bus, 3);
+    ASSERT("Masked IRQ pending", cpu->irq_lines == (1 << 3) && cpu->pending == 0);
+    CPU6502_step(cpu);
+    ASSERT("Masked IRQ taken", cpu->Reg.PC == 0x0202);
+
+    /* An NMI gets through, its RTI restores the mask */
+    bus_nmi_assert(bus);
+    ASSERT("NMI not taken", CPU6502_step(cpu) == 7 && cpu->Reg.PC == NMI_HANDLER && cpu->Reg.IRQB == 1);
+    ASSERT("Wrong status pushed", (bus_peek(bus, 0x0100 + cpu->Reg.SP + 1) & (CPU6502_FLAG_BRK | CPU6502_FLAG_IRQB)) ==
+           CPU6502_FLAG_IRQB);
+    while(cpu->Reg.PC != 0x0202)
+    {
+      CPU6502_step(cpu);
+    }
+    ASSERT("NMI handler not run", bus_peek(bus, 0x11) == 1 && cpu->Reg.IRQB == 1 && cpu->pending == 0);
+    bus_nmi_release(bus);
+
+    /* CLI lets the waiting IRQ in */
+    CPU6502_step(cpu);
+    CPU6502_step(cpu);
+    ASSERT("IRQ before CLI", cpu->Reg.PC == 0x0204);
+    CPU6502_step(cpu);
+    ASSERT("IRQ not taken", CPU6502_step(cpu) == 7 && cpu->Reg.PC == IRQ_HANDLER);
+    ASSERT("Wrong return address", bus_peek(bus, 0x0100 + cpu->Reg.SP + 2) == 0x05);
+
+    bus_destroy(&bus);
+  }
+
+  return 0;
+}
+
+/**
+ * NMI goes first when both arrive together, the IRQ follows its RTI
+ */
+int interrupt_t0002()
+{
+  /* JMP * */
+  static const uint8_t code[] = { 0x4C, 0x00, 0x02 };
+  struct Bus *bus = NULL;
+  struct CPU6502 *cpu = NULL;
+  int accuracy = 0;
+
+  for(accuracy = CPU6502_ACCURACY_FAST; accuracy <= CPU6502_ACCURACY_EXACT; accuracy++)
+  {
+    bus = interrupt_bus(accuracy);
+    ASSERT("Failed to create bus", bus!=NULL);
+    cpu = bus->cpu;
+    testbus_load(bus, 0x0200, code, sizeof(code));
+    cpu->Reg.IRQB = 0;
+
+    /* Both lines change at the same cycle */
+    ASSERT("Failed to schedule IRQ", bus_irq_assert_at(bus, 0, cpu->clock_count + 30) > 0);
+    ASSERT("Failed to schedule NMI", bus_nmi_at(bus, cpu->clock_count + 30) > 0);
+
+    bus_resume(bus);
+    bus_run(bus, 500);
+
+    ASSERT("Wrong order", bus_peek(bus, 0x11) == 1 && bus_peek(bus, 0x10) == 2);
+    ASSERT("IRQ left masked", cpu->Reg.PC == IRQ_HANDLER + 6 && cpu->irq_lines == 1);
+
+    bus_destroy(&bus);
+  }
+
+  return 0;
+}
+
+/**
+ * RTI and PLP take the same bits from the stack
+ */
+int interrupt_t0003()
+{
+  /* LDA #$CF; PHA; PLP; JMP * */
+  static const uint8_t plp[] = { 0xA9, 0xCF, 0x48, 0x28, 0x4C, 0x04, 0x02 };
+  /* LDA #$02; PHA; LDA #$10; PHA; LDA #$CF; PHA; RTI at 0x0200, JMP * at 0x0210 */
+  static const uint8_t rti[] = { 0xA9, 0x02, 0x48, 0xA9, 0x10, 0x48, 0xA9, 0xCF, 0x48, 0x40 };
+  static const uint8_t loop[] = { 0x4C, 0x10, 0x02 };
+  struct Bus *bus = NULL;
+  uint8_t psr = 0;
+  int i = 0;
+
+  bus = interrupt_bus(CPU6502_ACCURACY_FAST);
+  ASSERT("Failed to create bus", bus!=NULL);
+
+  testbus_load(bus, 0x0200, plp, sizeof(plp));
+  for(i = 0; i < 3; i++)
+  {
+    CPU6502_step(bus->cpu);
+  }
+  psr = bus->cpu->Reg.PSR;
+  ASSERT("U bit not set by PLP", (psr & CPU6502_FLAG_NU) != 0);
+
+  testbus_load(bus, 0x0210, loop, sizeof(loop));
+  testbus_load(bus, 0x0200, rti, sizeof(rti));
+  for(i = 0; i < 7; i++)
+  {
+    CPU6502_step(bus->cpu);
+  }
+  ASSERT("RTI did not return", bus->cpu->Reg.PC == 0x0210);
+  ASSERT("RTI and PLP differ", bus->cpu->Reg.PSR == psr);
+
+  bus_destroy(&bus);
+
+  return 0;
+}
+
+int main()
+{
+  UNIT_TEST_INIT("INTERRUPT");
+
+  log_set_level(LOG_INFO);
+
+  RUN_TEST(interrupt_t0001, "I flag masks IRQ only");
+  RUN_TEST(interrupt_t0002, "NMI before IRQ");
+  RUN_TEST(interrupt_t0003, "Status pulled by RTI and PLP");
+
+  UNIT_TEST_ERG();
+
+  return unit_failed == 0 ? 0 : 1;
+}
@@ -0,0 +1,192 @@
+/*
+ * Copyright (c) 2022, Bernd Bauer <bernd.bauer@gmx.at>
+ *
+ * SPDX-License-Identifier: BSD-2-Clause
+ */
+
+#include <stdio.h>
+
+#include "util/log.h"
+#include "util/unit.h"
+
+#include "core/bus.h"
+#include "core/stop.h"
+
+#include "testbus.h"
+
+/* INC $10; JMP $0200 */
+static const uint8_t busy[] = { 0xE6, 0x10, 0x4C, 0x00, 0x02 };
+/* JMP * */
+static const uint8_t idle[] = { 0x4C, 0x00, 0x02 };
+
+/**
+ * The cycle limit stops at the first instruction boundary past it
+ */
+int stop_t0001()
+{
+  struct Bus *bus = NULL;
+
+  bus = testbus_create(busy, sizeof(busy));
+  ASSERT("Failed to create bus", bus!=NULL);
+  ASSERT("Failed to arm", stop_at_cycle(bus->stopcond, 1000) == 0);
+  ASSERT("Cycle limit is an event", scheduler_next(bus->sched) == SCHEDULER_NEVER);
+
+  bus_run(bus, BUS_RUN_FOREVER);
+  ASSERT("Wrong stop", bus->stop == BUS_STOP_CYCLES);
+  ASSERT("Wrong cycle", bus->cpu->clock_count >= 1000 && bus->cpu->clock_count < 1005);
+
+  bus_destroy(&bus);
+
+  return 0;
+}
+
+/**
+ * The instruction limit counts whole instructions
+ */
+int stop_t0002()
+{
+  struct Bus *bus = NULL;
+
+  bus = testbus_create(busy, sizeof(busy));
+  ASSERT("Failed to create bus", bus!=NULL);
+  stop_after_instructions(bus->stopcond, 100);
+
+  bus_run(bus, BUS_RUN_FOREVER);
+  ASSERT("Wrong stop", bus->stop == BUS_STOP_INSTRUCTIONS);
+  ASSERT("Wrong instruction count", bus_peek(bus, 0x10) == 50 && bus->cpu->Reg.PC == 0x0200);
+  ASSERT("Hook left on", (bus->cpu->hooks & CPU6502_HOOK_STOP) == 0);
+
+  bus_destroy(&bus);
+
+  return 0;
+}
+
+/**
+ * A PC stop hits before the instruction runs and not again on resume
+ */
+int stop_t0003()
+{
+  struct Bus *bus = NULL;
+
+  bus = testbus_create(busy, sizeof(busy));
+  ASSERT("Failed to create bus", bus!=NULL);
+  stop_at_pc(bus->stopcond, 0x0202);
+
+  bus_run(bus, BUS_RUN_FOREVER);
+  ASSERT("Wrong stop", bus->stop == BUS_STOP_PC);
+  ASSERT("Wrong PC", bus->cpu->Reg.PC == 0x0202 && bus_peek(bus, 0x10) == 1);
+
+  bus_resume(bus);
+  bus_run(bus, BUS_RUN_FOREVER);
+  ASSERT("Not stopped again", bus->stop == BUS_STOP_PC && bus_peek(bus, 0x10) == 2);
+
+  bus_destroy(&bus);
+
+  return 0;
+}
+
+/**
+ * BRK stops only when asked to
+ */
+int stop_t0004()
+{
+  /* INC $10; BRK */
+  static const uint8_t code[] = { 0xE6, 0x10, 0x00, 0x00 };
+  struct Bus *bus = NULL;
+
+  bus = testbus_create(code, sizeof(code));
+  ASSERT("Failed to create bus", bus!=NULL);
+  stop_on_brk(bus->stopcond, 1);
+
+  bus_run(bus, BUS_RUN_FOREVER);
+  ASSERT("Wrong stop", bus->stop == BUS_STOP_BRK);
+  ASSERT("Code not run", bus_peek(bus, 0x10) == 1);
+
+  bus_destroy(&bus);
+
+  return 0;
+}
+
+/**
+ * A write to the stop address stops, it still reaches memory
+ */
+int stop_t0005()
+{
+  /* LDA #$42; STA $0301; STA $0300; JMP * */
+  static const uint8_t code[] = { 0xA9, 0x42, 0x8D, 0x01, 0x03, 0x8D, 0x00, 0x03, 0x4C, 0x08, 0x02 };
+  struct Bus *bus = NULL;
+
+  bus = testbus_create(code, sizeof(code));
+  ASSERT("Failed to create bus", bus!=NULL);
+  stop_on_write(bus->stopcond, 0x0300);
+
+  bus_run(bus, BUS_RUN_FOREVER);
+  ASSERT("Wrong stop", bus->stop == BUS_STOP_WRITE);
+  ASSERT("Write lost", bus_peek(bus, 0x0300) == 0x42 && bus_peek(bus, 0x0301) == 0x42);
+  ASSERT("Stopped late", bus->cpu->Reg.PC == 0x0208);
+
+  bus_destroy(&bus);
+
+  return 0;
+}
+
+/**
+ * The wall clock timeout stops a busy guest
+ */
+int stop_t0006()
+{
+  struct Bus *bus = NULL;
+
+  bus = testbus_create(busy, sizeof(busy));
+  ASSERT("Failed to create bus", bus!=NULL);
+  ASSERT("Failed to arm", stop_after_seconds(bus->stopcond, 0.05) == 0);
+  ASSERT("Timeout is an event", scheduler_next(bus->sched) == SCHEDULER_NEVER);
+
+  bus_run(bus, BUS_RUN_FOREVER);
+  ASSERT("Wrong stop", bus->stop == BUS_STOP_TIMEOUT);
+  ASSERT("Checked too often", bus->cpu->clock_count >= STOP_TIMEOUT_PERIOD);
+
+  bus_destroy(&bus);
+
+  return 0;
+}
+
+/**
+ * Armed limits do not keep an idle guest running
+ */
+int stop_t0007()
+{
+  struct Bus *bus = NULL;
+
+  bus = testbus_create(idle, sizeof(idle));
+  ASSERT("Failed to create bus", bus!=NULL);
+  stop_after_seconds(bus->stopcond, 3);
+  stop_at_cycle(bus->stopcond, 100000000000ULL);
+
+  bus_run(bus, BUS_RUN_FOREVER);
+  ASSERT("Wrong stop", bus->stop == BUS_STOP_IDLE);
+  ASSERT("Not stopped at once", bus->cpu->clock_count < 100);
+
+  bus_destroy(&bus);
+
+  return 0;
+}
+
+int main()
+{
+  UNIT_TEST_INIT("STOP");
+
+  log_set_level(LOG_INFO);
+
+  RUN_TEST(stop_t0001, "Cycle limit");
+  RUN_TEST(stop_t0002, "Instruction limit");
+  RUN_TEST(stop_t0003, "Stop at PC");
+  RUN_TEST(stop_t0004, "Stop on BRK");
+  RUN_TEST(stop_t0005, "Stop on write");
+  RUN_TEST(stop_t0006, "Wall clock timeout");
+  RUN_TEST(stop_t0007, "Idle guest with limits armed");
+
+  UNIT_TEST_ERG();
+
+  return unit_failed == 0 ? 0 : 1;
+}
@@ -0,0 +1,108 @@
+/*
+ * Copyright (c) 2022, Bernd Bauer <bernd.bauer@gmx.at>
+ *
+ * SPDX-License-Identifier: BSD-2-Clause
+ */
+
+#include <stdio.h>
+
+#include "util/log.h"
+#include "util/unit.h"
+
+#include "core/bus.h"
+#include "core/debug.h"
+
+#include "testbus.h"
+
+static int counter_reached(struct CPU6502 *cpu, void *ctx)
+{
+  return bus_peek(ctx, 0x10) == 3;
+}
+
+/**
+ * Watchpoints stop after the access, only on the watched addresses
+ */
+int debug_t0001()
+{
+  /* LDA $0310; LDA $0320; STA $0311; STA $0321; JMP * */
+  static const uint8_t code[] = { 0xAD, 0x10, 0x03, 0xAD, 0x20, 0x03, 0x8D, 0x11, 0x03, 0x8D, 0x21, 0x03,
+                                  0x4C, 0x0C, 0x02 };
+  struct Bus *bus = NULL;
+  struct Debugger *dbg = NULL;
+
+  bus = testbus_create(code, sizeof(code));
+  ASSERT("Failed to create bus", bus!=NULL);
+  dbg = bus->dbg;
+  bus_poke(bus, 0x0320, 0x5A);
+
+  debug_watch_set(dbg, 0x0320, 0x0320, DEBUG_WATCH_READ);
+  debug_watch_set(dbg, 0x0321, 0x0321, DEBUG_WATCH_WRITE);
+  ASSERT("Page not trapped", !bus_is_plain_memory(bus, 0x0300) && bus->wpage[0x03] == NULL);
+  ASSERT("Other page trapped", bus_is_plain_memory(bus, 0x0400));
+
+  bus_run(bus, BUS_RUN_FOREVER);
+  ASSERT("Read not caught", bus->stop == BUS_STOP_WATCHPOINT && dbg->hit == DEBUG_HIT_READ && dbg->hit_addr == 0x0320);
+  ASSERT("Read not finished", bus->cpu->Reg.PC == 0x0206 && bus->cpu->Reg.A == 0x5A);
+
+  bus_resume(bus);
+  bus_run(bus, BUS_RUN_FOREVER);
+  ASSERT("Write not caught", bus->stop == BUS_STOP_WATCHPOINT && dbg->hit == DEBUG_HIT_WRITE && dbg->hit_addr == 0x0321);
+  ASSERT("Write not finished", bus->cpu->Reg.PC == 0x020C && bus_peek(bus, 0x0321) == 0x5A &&
+         bus_peek(bus, 0x0311) == 0x5A);
+
+  bus_resume(bus);
+  bus_run(bus, BUS_RUN_FOREVER);
+  ASSERT("Wrong stop", bus->stop == BUS_STOP_IDLE);
+
+  /* The page goes back to the fast path */
+  debug_watch_clear(dbg, 0x0320, 0x0321, DEBUG_WATCH_READ | DEBUG_WATCH_WRITE);
+  ASSERT("Page still trapped", bus_is_plain_memory(bus, 0x0300) && bus->wpage[0x03] != NULL);
+
+  bus_destroy(&bus);
+
+  return 0;
+}
+
+/**
+ * Breakpoints stop before the instruction, conditional ones only when
+ * their condition holds
+ */
+int debug_t0002()
+{
+  /* INC $10; JMP $0200 */
+  static const uint8_t code[] = { 0xE6, 0x10, 0x4C, 0x00, 0x02 };
+  struct Bus *bus = NULL;
+
+  bus = testbus_create(code, sizeof(code));
+  ASSERT("Failed to create bus", bus!=NULL);
+
+  debug_break_set(bus->dbg, 0x0202);
+  bus_run(bus, BUS_RUN_FOREVER);
+  ASSERT("Breakpoint missed", bus->stop == BUS_STOP_BREAKPOINT && bus->cpu->Reg.PC == 0x0202 && bus_peek(bus, 0x10) == 1);
+
+  debug_break_clear(bus->dbg, 0x0202);
+  ASSERT("Hook left on", (bus->cpu->hooks & CPU6502_HOOK_DEBUG) == 0);
+  ASSERT("Failed to set condition", debug_break_condition(bus->dbg, 0x0200, counter_reached, bus) == 0);
+
+  bus_resume(bus);
+  bus_run(bus, BUS_RUN_FOREVER);
+  ASSERT("Condition ignored", bus->stop == BUS_STOP_BREAKPOINT && bus->cpu->Reg.PC == 0x0200 && bus_peek(bus, 0x10) == 3);
+
+  bus_destroy(&bus);
+
+  return 0;
+}
+
+int main()
+{
+  UNIT_TEST_INIT("DEBUG");
+
+  log_set_level(LOG_INFO);
+
+  RUN_TEST(debug_t0001, "Read and write watchpoints");
+  RUN_TEST(debug_t0002, "Breakpoints");
+
+  UNIT_TEST_ERG();
+
+  return unit_failed == 0 ? 0 : 1;
+}
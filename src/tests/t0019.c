@@ -0,0 +1,202 @@
+/*
+ * Copyright (c) 2022, Bernd Bauer <bernd.bauer@gmx.at>
+ *
+ * SPDX-License-Identifier: BSD-2-Clause
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+
+#include "util/log.h"
+#include "util/unit.h"
+
+#include "core/bus.h"
+#include "core/gdbstub.h"
+
+#define GDB_PATH "/tmp/t0019_gdb.sock"
+
+/* Packets sent by the client and the replies it expects, '.' matches any
+ * character */
+struct Exchange
+{
+  const char *request;
+  const char *reply;
+};
+
+static const struct Exchange session[] = {
+  { "?", "S05" },
+  { "M300,2:a55a", "OK" },
+  { "m300,2", "a55a" },
+  { "Z0,205,1", "OK" },
+  { "c", "T05swbreak:;" },
+  { "g", "a50000..fd0502" },
+  { "z0,205,1", "OK" },
+  { "G5a000000fd0302", "OK" },
+  { "s", "S05" },
+  { "c", "W00" },
+  { "vUnknown", "" }
+};
+
+struct Client
+{
+  int failed;
+  char got[64];
+  int step;
+};
+
+static int client_match(const char *got, const char *expected)
+{
+  if(strlen(got) != strlen(expected))
+  {
+    return 0;
+  }
+  while(*got != '\0' && (*expected == '.' || *got == *expected))
+  {
+    got++;
+    expected++;
+  }
+
+  return *got == '\0';
+}
+
+static int client_send(int fd, const char *data)
+{
+  char pkt[128];
+  uint8_t sum = 0;
+  size_t i = 0;
+  int n = 0;
+
+  for(i = 0; i < strlen(data); i++)
+  {
+    sum += (uint8_t)data[i];
+  }
+  n = snprintf(pkt, sizeof(pkt), "$%s#%02x", data, sum);
+
+  return send(fd, pkt, n, 0) == n ? 0 : -1;
+}
+
+static int client_recv(int fd, char *data, size_t size)
+{
+  size_t len = 0;
+  char c = 0;
+
+  /* Skip acks up to the packet start, drop the checksum */
+  do
+  {
+    if(recv(fd, &c, 1, 0) != 1)
+    {
+      return -1;
+    }
+  }while(c != '$');
+
+  while(recv(fd, &c, 1, 0) == 1 && c != '#')
+  {
+    if(len < size - 1)
+    {
+      data[len++] = c;
+    }
+  }
+  data[len] = '\0';
+
+  return recv(fd, &c, 1, 0) == 1 && recv(fd, &c, 1, 0) == 1 ? 0 : -1;
+}
+
+static void* client_thread(void *arg)
+{
+  struct Client *client = arg;
+  struct sockaddr_un addr;
+  int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+  int i = 0;
+
+  memset(&addr, 0, sizeof(addr));
+  addr.sun_family = AF_UNIX;
+  strcpy(addr.sun_path, GDB_PATH);
+
+  if(fd < 0 || connect(fd, (struct sockaddr*)&addr, sizeof(addr)) != 0)
+  {
+    client->failed = 1;
+    return NULL;
+  }
+
+  for(i = 0; i < sizeof(session) / sizeof(session[0]); i++)
+  {
+    client->step = i;
+    if(client_send(fd, session[i].request) != 0 || client_recv(fd, client->got, sizeof(client->got)) != 0 ||
+       !client_match(client->got, session[i].reply))
+    {
+      client->failed = 1;
+      break;
+    }
+  }
+
+  client_send(fd, "k");
+  close(fd);
+
+  return NULL;
+}
+
+/**
+ * A scripted session reads and writes registers and memory, stops on a
+ * breakpoint, steps and runs to the end
+ */
+int gdbstub_t0001()
+{
+  /* LDA $0300; STA $10; JMP *, the step runs the STA again with A set by G */
+  static const uint8_t code[] = { 0xAD, 0x00, 0x03, 0x85, 0x10, 0x4C, 0x05, 0x02 };
+  struct Client client = { .failed = 0 };
+  struct GdbStub *gdb = NULL;
+  struct Bus *bus = NULL;
+  pthread_t thread;
+  int i = 0;
+
+  bus = bus_create();
+  ASSERT("Failed to create bus", bus!=NULL);
+  for(i = 0; i < sizeof(code); i++)
+  {
+    bus_poke(bus, 0x0200 + i, code[i]);
+  }
+  bus->cpu->Reg.PC = 0x0200;
+  bus->cpu->Reg.X = 0x00;
+  bus->cpu->Reg.Y = 0x00;
+  bus->cpu->Reg.SP = 0xFD;
+  bus->cpu->cycles = 0;
+
+  gdb = gdbstub_create(bus, GDB_PATH);
+  ASSERT("Failed to create stub", gdb!=NULL);
+  ASSERT("Failed to start client", pthread_create(&thread, NULL, client_thread, &client) == 0);
+
+  ASSERT("Session failed", gdbstub_serve(gdb) == 0);
+  pthread_join(thread, NULL);
+  if(client.failed)
+  {
+    log_error("Exchange %d: got <%s> expected <%s>", client.step, client.got, session[client.step].reply);
+  }
+  ASSERT("Wrong reply", client.failed == 0);
+  ASSERT("Memory not written", bus_peek(bus, 0x0300) == 0xA5 && bus_peek(bus, 0x0301) == 0x5A);
+  ASSERT("Registers not written", bus->cpu->Reg.A == 0x5A && bus_peek(bus, 0x10) == 0x5A);
+  ASSERT("Still running", bus->stop != BUS_RUNNING);
+
+  gdbstub_destroy(&gdb);
+  ASSERT("Failed to destroy stub", gdb==NULL && access(GDB_PATH, F_OK) != 0);
+  bus_destroy(&bus);
+
+  return 0;
+}
+
+int main()
+{
+  UNIT_TEST_INIT("GDBSTUB");
+
+  log_set_level(LOG_INFO);
+
+  RUN_TEST(gdbstub_t0001, "Remote protocol session");
+
+  UNIT_TEST_ERG();
+
+  return unit_failed == 0 ? 0 : 1;
+}
@@ -0,0 +1,96 @@
+/*
+ * Copyright (c) 2022, Bernd Bauer <bernd.bauer@gmx.at>
+ *
+ * SPDX-License-Identifier: BSD-2-Clause
+ */
+
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "util/log.h"
+#include "util/unit.h"
+#include "util/tools.h"
+
+#define HEX_FILE "/tmp/t0020.hex"
+
+static uint8_t image[0x10000];
+static uint8_t loaded[0x10000];
+
+static int write_file(const char *text)
+{
+  FILE *fp = fopen(HEX_FILE, "w");
+
+  if(fp == NULL)
+  {
+    return -1;
+  }
+  fputs(text, fp);
+
+  return fclose(fp);
+}
+
+/**
+ * A range ending at 0xFFFF comes back unchanged, its last record is a
+ * short one
+ */
+int tools_t0001()
+{
+  uint32_t start = 0xFFE3;
+  uint32_t i = 0;
+
+  for(i = 0; i < sizeof(image); i++)
+  {
+    image[i] = i * 7 + (i >> 8);
+  }
+  memset(loaded, 0, sizeof(loaded));
+
+  ASSERT("Failed to save", file_saveIntelHex(HEX_FILE, start, image + start, 0x10000 - start) == 0);
+  ASSERT("Wrong byte count", file_loadIntelHex(HEX_FILE, loaded, sizeof(loaded)) == 0x10000 - start);
+  ASSERT("Data changed", memcmp(image + start, loaded + start, 0x10000 - start) == 0);
+  for(i = 0; i < start; i++)
+  {
+    ASSERT("Outside the range written", loaded[i] == 0);
+  }
+
+  unlink(HEX_FILE);
+
+  return 0;
+}
+
+/**
+ * Ranges and records past 0xFFFF are refused in both directions
+ */
+int tools_t0002()
+{
+  ASSERT("Saved past the end", file_saveIntelHex(HEX_FILE, 0xFFF8, image, 16) == -1);
+  ASSERT("Length wrapped", file_saveIntelHex(HEX_FILE, 0x0100, image, 0xFFFFFF00) == -1);
+
+  /* 16 bytes at 0xFFF8, the checksum is right */
+  ASSERT("Failed to write", write_file(":10FFF80000000000000000000000000000000000F9\n:00000001FF\n") == 0);
+  ASSERT("Loaded past the end", file_loadIntelHex(HEX_FILE, loaded, sizeof(loaded)) == -1);
+
+  /* 8 bytes at 0xFFF8 fit, a wrong checksum does not load */
+  ASSERT("Failed to write", write_file(":08FFF8000102030405060708DD\n:00000001FF\n") == 0);
+  ASSERT("Failed to load", file_loadIntelHex(HEX_FILE, loaded, sizeof(loaded)) == 8 && loaded[0xFFFF] == 0x08);
+  ASSERT("Failed to write", write_file(":08FFF8000102030405060708DE\n:00000001FF\n") == 0);
+  ASSERT("Bad checksum loaded", file_loadIntelHex(HEX_FILE, loaded, sizeof(loaded)) == -1);
+
+  unlink(HEX_FILE);
+
+  return 0;
+}
+
+int main()
+{
+  UNIT_TEST_INIT("TOOLS");
+
+  log_set_level(LOG_INFO);
+
+  RUN_TEST(tools_t0001, "Intel HEX round trip up to 0xFFFF");
+  RUN_TEST(tools_t0002, "Intel HEX past 0xFFFF");
+
+  UNIT_TEST_ERG();
+
+  return unit_failed == 0 ? 0 : 1;
+}
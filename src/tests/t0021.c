@@ -0,0 +1,104 @@
+/*
+ * Copyright (c) 2022, Bernd Bauer <bernd.bauer@gmx.at>
+ *
+ * SPDX-License-Identifier: BSD-2-Clause
+ */
+
+#include <stdio.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+
+#include "util/log.h"
+#include "util/unit.h"
+
+#include "core/bus.h"
+#include "core/shmview.h"
+
+#include "testbus.h"
+
+#define VIEW_NAME "/t0021"
+
+static int shm_exists(const char *name)
+{
+  int fd = shm_open(name, O_RDONLY, 0);
+
+  if(fd < 0)
+  {
+    return errno == ENOENT ? 0 : -1;
+  }
+  close(fd);
+
+  return 1;
+}
+
+/**
+ * A guest that terminates still goes idle with a view attached, the
+ * objects are gone after destroy
+ */
+int shmview_t0001()
+{
+  /* LDA #$5A; STA $10; JMP * */
+  static const uint8_t code[] = { 0xA9, 0x5A, 0x85, 0x10, 0x4C, 0x04, 0x02 };
+  struct Bus *bus = NULL;
+  struct ShmView *view = NULL;
+
+  bus = testbus_create(code, sizeof(code));
+  ASSERT("Failed to create bus", bus!=NULL);
+  view = shmview_create(bus, VIEW_NAME);
+  ASSERT("Failed to create view", view!=NULL);
+  ASSERT("Refresh is an event", scheduler_next(bus->sched) == SCHEDULER_NEVER);
+
+  bus_run(bus, BUS_RUN_FOREVER);
+  ASSERT("Wrong stop", bus->stop == BUS_STOP_IDLE);
+  ASSERT("State not published", view->state->stop == BUS_STOP_IDLE && view->state->PC == 0x0204 &&
+         view->state->A == 0x5A);
+  ASSERT("Objects missing", shm_exists(VIEW_NAME) == 1 && shm_exists(VIEW_NAME SHMVIEW_STATE_SUFFIX) == 1);
+
+  bus_destroy(&bus);
+  ASSERT("Objects left behind", shm_exists(VIEW_NAME) == 0 && shm_exists(VIEW_NAME SHMVIEW_STATE_SUFFIX) == 0);
+
+  return 0;
+}
+
+/**
+ * A busy guest refreshes the state every SHMVIEW_PERIOD cycles
+ */
+int shmview_t0002()
+{
+  /* INC $10; JMP $0200 */
+  static const uint8_t code[] = { 0xE6, 0x10, 0x4C, 0x00, 0x02 };
+  struct Bus *bus = NULL;
+  struct ShmView *view = NULL;
+  uint64_t updates = 0;
+
+  bus = testbus_create(code, sizeof(code));
+  ASSERT("Failed to create bus", bus!=NULL);
+  view = shmview_create(bus, VIEW_NAME);
+  ASSERT("Failed to create view", view!=NULL);
+  updates = view->state->updates;
+
+  bus_run(bus, 4 * SHMVIEW_PERIOD);
+  ASSERT("Wrong stop", bus->stop == BUS_RUNNING);
+  ASSERT("Not refreshed", view->state->updates >= updates + 4 && view->state->updates <= updates + 6);
+  ASSERT("Stale state", view->state->clock_count == bus->cpu->clock_count && (view->state->seq & 1) == 0);
+
+  bus_destroy(&bus);
+
+  return 0;
+}
+
+int main()
+{
+  UNIT_TEST_INIT("SHMVIEW");
+
+  log_set_level(LOG_INFO);
+
+  RUN_TEST(shmview_t0001, "Terminating guest with a view");
+  RUN_TEST(shmview_t0002, "Periodic refresh");
+
+  UNIT_TEST_ERG();
+
+  return unit_failed == 0 ? 0 : 1;
+}
@@ -0,0 +1,228 @@
+/*
+ * Copyright (c) 2022, Bernd Bauer <bernd.bauer@gmx.at>
+ *
+ * SPDX-License-Identifier: BSD-2-Clause
+ */
+
+#include <stdio.h>
+
+#include "util/log.h"
+#include "util/unit.h"
+
+#include "core/bus.h"
+
+#define MEM_END 0x0500
+
+/* A piece of a test program */
+struct Segment
+{
+  uint16_t addr;
+  uint8_t len;
+  const uint8_t *code;
+};
+
+#define SEGMENT(a, c) { a, sizeof(c), c }
+
+/* LDA #$F0; CLC; ADC #$20; STA $40; CLC; ADC $41; CLC; ADC $0342; STA $43;
+ * LDA #$7F; CLC; ADC #$01; PHP; JMP * */
+static const uint8_t adc_code[] = { 0xA9, 0xF0, 0x18, 0x69, 0x20, 0x85, 0x40, 0x18, 0x65, 0x41, 0x18, 0x6D,
+                                    0x42, 0x03, 0x85, 0x43, 0xA9, 0x7F, 0x18, 0x69, 0x01, 0x08, 0x4C, 0x16,
+                                    0x02 };
+/* LDA #$10; SEC; SBC #$20; PHP; SEC; SBC $41; PHP; SEC; SBC $0342; PHP;
+ * STA $45; JMP * */
+static const uint8_t sbc_code[] = { 0xA9, 0x10, 0x38, 0xE9, 0x20, 0x08, 0x38, 0xE5, 0x41, 0x08, 0x38, 0xED,
+                                    0x42, 0x03, 0x08, 0x85, 0x45, 0x4C, 0x11, 0x02 };
+/* LDA #$00; STA $50; PHP; LDA $41; STA $0351; LDA $0342; STA $52;
+ * LDA #$80; STA $0353; PHP; JMP * */
+static const uint8_t sta_code[] = { 0xA9, 0x00, 0x85, 0x50, 0x08, 0xA5, 0x41, 0x8D, 0x51, 0x03, 0xAD, 0x42,
+                                    0x03, 0x85, 0x52, 0xA9, 0x80, 0x8D, 0x53, 0x03, 0x08, 0x4C, 0x15, 0x02 };
+/* LDX #$40; loop: LDA $60; CLC; ADC #$07; STA $60; LDA $0361; CLC;
+ * ADC #$FF; STA $0361; DEX; BNE loop; PHP; JMP * */
+static const uint8_t counter_code[] = { 0xA2, 0x40, 0xA5, 0x60, 0x18, 0x69, 0x07, 0x85, 0x60, 0xAD, 0x61, 0x03,
+                                        0x18, 0x69, 0xFF, 0x8D, 0x61, 0x03, 0xCA, 0xD0, 0xED, 0x08, 0x4C, 0x16,
+                                        0x02 };
+/* LDY #$03; LDX #$03; JMP $02F0 */
+static const uint8_t branch_start[] = { 0xA0, 0x03, 0xA2, 0x03, 0x4C, 0xF0, 0x02 };
+/* 0x02F0: DEY; BNE $0303; JMP $03F0 */
+static const uint8_t branch_down[] = { 0x88, 0xD0, 0x10, 0x4C, 0xF0, 0x03 };
+/* 0x0303: JMP $02F0 */
+static const uint8_t branch_back[] = { 0x4C, 0xF0, 0x02 };
+/* 0x03F0: INC $70; JMP $0400 */
+static const uint8_t branch_count[] = { 0xE6, 0x70, 0x4C, 0x00, 0x04 };
+/* 0x0400: DEX; BNE $03F0; PHP; JMP * */
+static const uint8_t branch_up[] = { 0xCA, 0xD0, 0xED, 0x08, 0x4C, 0x04, 0x04 };
+
+static const struct Segment adc_prog[] = { SEGMENT(0x0200, adc_code) };
+static const struct Segment sbc_prog[] = { SEGMENT(0x0200, sbc_code) };
+static const struct Segment sta_prog[] = { SEGMENT(0x0200, sta_code) };
+static const struct Segment counter_prog[] = { SEGMENT(0x0200, counter_code) };
+static const struct Segment branch_prog[] = { SEGMENT(0x0200, branch_start), SEGMENT(0x02F0, branch_down),
+                                              SEGMENT(0x0303, branch_back), SEGMENT(0x03F0, branch_count),
+                                              SEGMENT(0x0400, branch_up) };
+
+static struct Bus* fusion_run(const struct Segment *prog, int segments, uint8_t psr, int fuse)
+{
+  struct Bus *bus = bus_create();
+  struct CPU6502 *cpu = NULL;
+  int i = 0;
+  int j = 0;
+
+  if(bus == NULL)
+  {
+    return NULL;
+  }
+  cpu = bus->cpu;
+
+  for(i = 0; i < MEM_END; i++)
+  {
+    bus_poke(bus, i, 0x00);
+  }
+  bus_poke(bus, 0x41, 0x85);
+  bus_poke(bus, 0x0342, 0x33);
+  bus_poke(bus, 0x60, 0xF9);
+  bus_poke(bus, 0x0361, 0x02);
+  for(i = 0; i < segments; i++)
+  {
+    for(j = 0; j < prog[i].len; j++)
+    {
+      bus_poke(bus, prog[i].addr + j, prog[i].code[j]);
+    }
+  }
+
+  cpu->Reg.A = 0x00;
+  cpu->Reg.X = 0x00;
+  cpu->Reg.Y = 0x00;
+  cpu->Reg.SP = 0xFF;
+  cpu->Reg.PSR = psr;
+  cpu->Reg.PC = 0x0200;
+  cpu->cycles = 0;
+
+  /* The reference run counts the pairs, which also keeps fusion off */
+  if(fuse)
+  {
+    CPU6502_setFusion(cpu, 1);
+  }
+  else if(CPU6502_setFusion(cpu, 0) != 0 || CPU6502_profilePairs(cpu, 1) != 0)
+  {
+    bus_destroy(&bus);
+    return NULL;
+  }
+
+  bus_run(bus, BUS_RUN_FOREVER);
+
+  return bus;
+}
+
+/* Registers, flags, memory, stack and cycles have to match */
+static int fusion_same(struct Bus *a, struct Bus *b)
+{
+  int i = 0;
+
+  if(a->stop != BUS_STOP_IDLE || b->stop != BUS_STOP_IDLE ||
+     a->cpu->Reg.A != b->cpu->Reg.A || a->cpu->Reg.X != b->cpu->Reg.X || a->cpu->Reg.Y != b->cpu->Reg.Y ||
+     a->cpu->Reg.PSR != b->cpu->Reg.PSR || a->cpu->Reg.SP != b->cpu->Reg.SP || a->cpu->Reg.PC != b->cpu->Reg.PC ||
+     a->cpu->clock_count != b->cpu->clock_count)
+  {
+    return 0;
+  }
+  for(i = 0; i < MEM_END; i++)
+  {
+    if(bus_peek(a, i) != bus_peek(b, i))
+    {
+      log_error("Memory differs at 0x%04x: 0x%02x 0x%02x", i, bus_peek(a, i), bus_peek(b, i));
+      return 0;
+    }
+  }
+
+  return 1;
+}
+
+static uint64_t pair(struct Bus *bus, uint8_t first, uint8_t second)
+{
+  return bus->cpu->pairs[(first << 8) | second];
+}
+
+/**
+ * Every fused sequence leaves the same machine state as the single
+ * instructions, with all flags in and out
+ */
+int fusion_t0001()
+{
+  static const struct
+  {
+    const char *name;
+    const struct Segment *prog;
+    int segments;
+  } progs[] = {
+    { "CLC; ADC", adc_prog, 1 },
+    { "SEC; SBC", sbc_prog, 1 },
+    { "LDA; STA", sta_prog, 1 },
+    { "LDA; CLC; ADC; STA", counter_prog, 1 },
+    { "DEX/DEY; BNE", branch_prog, sizeof(branch_prog) / sizeof(branch_prog[0]) }
+  };
+  static const uint8_t psrs[] = { 0x20, 0xE3 };
+  struct Bus *fused = NULL;
+  struct Bus *plain = NULL;
+  int i = 0;
+  int j = 0;
+
+  for(i = 0; i < sizeof(progs) / sizeof(progs[0]); i++)
+  {
+    for(j = 0; j < sizeof(psrs); j++)
+    {
+      fused = fusion_run(progs[i].prog, progs[i].segments, psrs[j], 1);
+      plain = fusion_run(progs[i].prog, progs[i].segments, psrs[j], 0);
+      ASSERT("Failed to run", fused!=NULL && plain!=NULL);
+
+      if(!fusion_same(fused, plain))
+      {
+        log_error("%s differs with P=0x%02x", progs[i].name, psrs[j]);
+      }
+      ASSERT("Fused run differs", fusion_same(fused, plain));
+
+      bus_destroy(&fused);
+      bus_destroy(&plain);
+    }
+  }
+
+  return 0;
+}
+
+/**
+ * The pair profile counts the sequences the fused run replaces
+ */
+int fusion_t0002()
+{
+  struct Bus *bus = NULL;
+
+  bus = fusion_run(counter_prog, 1, 0x20, 0);
+  ASSERT("Failed to run", bus!=NULL);
+  ASSERT("Fusion left on", bus->cpu->fusion == 0);
+  ASSERT("Wrong LDA CLC count", pair(bus, 0xA5, 0x18) == 0x40 && pair(bus, 0xAD, 0x18) == 0x40);
+  ASSERT("Wrong CLC ADC count", pair(bus, 0x18, 0x69) == 0x80);
+  ASSERT("Wrong DEX BNE count", pair(bus, 0xCA, 0xD0) == 0x40 && pair(bus, 0xD0, 0xA5) == 0x3F);
+  ASSERT("Failed to report", CPU6502_reportPairs(bus->cpu, 5) == 0);
+  bus_destroy(&bus);
+
+  bus = fusion_run(branch_prog, sizeof(branch_prog) / sizeof(branch_prog[0]), 0x20, 0);
+  ASSERT("Failed to run", bus!=NULL);
+  ASSERT("Wrong DEY BNE count", pair(bus, 0x88, 0xD0) == 3 && pair(bus, 0xCA, 0xD0) == 3);
+  ASSERT("Wrong loop counter", bus_peek(bus, 0x70) == 3);
+  bus_destroy(&bus);
+
+  return 0;
+}
+
+int main()
+{
+  UNIT_TEST_INIT("FUSION");
+
+  log_set_level(LOG_INFO);
+
+  RUN_TEST(fusion_t0001, "Fused and single instructions agree");
+  RUN_TEST(fusion_t0002, "Pair profile counts");
+
+  UNIT_TEST_ERG();
+
+  return unit_failed == 0 ? 0 : 1;
+}
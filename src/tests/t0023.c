@@ -0,0 +1,247 @@
+/*
+ * Copyright (c) 2022, Bernd Bauer <bernd.bauer@gmx.at>
+ *
+ * SPDX-License-Identifier: BSD-2-Clause
+ */
+
+#include <stdio.h>
+
+#include "util/log.h"
+#include "util/unit.h"
+
+#include "core/bus.h"
+#include "core/aot.h"
+#include "core/mapper.h"
+
+#include "t0023_rom.h"
+
+/* Generated by 6502-recomp from the ROM of t0023_rom.h at build time */
+extern const struct AotImage aot_image;
+
+static struct Bus* rom_bus(void)
+{
+  struct Bus *bus = bus_create();
+  uint8_t rom[ROM_SIZE];
+  int i = 0;
+
+  if(bus != NULL)
+  {
+    rom_build(rom);
+    for(i = 0; i < ROM_SIZE; i++)
+    {
+      bus_poke(bus, ROM_BASE + i, rom[i]);
+    }
+    bus_reset(bus);
+    bus->cpu->cycles = 0;
+  }
+
+  return bus;
+}
+
+/* Run to the idle loop in slices of the given length */
+static void rom_run(struct Bus *bus, uint64_t slice)
+{
+  while(bus->stop == BUS_RUNNING)
+  {
+    bus_run(bus, slice);
+  }
+}
+
+static int rom_same(struct Bus *a, struct Bus *b)
+{
+  int i = 0;
+
+  if(a->stop != BUS_STOP_IDLE || b->stop != BUS_STOP_IDLE ||
+     a->cpu->Reg.A != b->cpu->Reg.A || a->cpu->Reg.X != b->cpu->Reg.X || a->cpu->Reg.Y != b->cpu->Reg.Y ||
+     a->cpu->Reg.PSR != b->cpu->Reg.PSR || a->cpu->Reg.SP != b->cpu->Reg.SP || a->cpu->Reg.PC != b->cpu->Reg.PC ||
+     a->cpu->clock_count != b->cpu->clock_count)
+  {
+    return 0;
+  }
+  for(i = 0; i < 0x0300; i++)
+  {
+    if(bus_peek(a, i) != bus_peek(b, i))
+    {
+      return 0;
+    }
+  }
+
+  return 1;
+}
+
+/**
+ * The recompiled ROM gives the interpreter's result, instructions that
+ * change the interrupt state or jump indirectly are left to it
+ */
+int recomp_t0001()
+{
+  static const uint64_t slices[] = { BUS_RUN_FOREVER, 50, 7 };
+  struct Bus *plain = NULL;
+  struct Bus *aot = NULL;
+  int i = 0;
+
+  plain = rom_bus();
+  ASSERT("Failed to create bus", plain!=NULL);
+  rom_run(plain, BUS_RUN_FOREVER);
+  ASSERT("Wrong result", bus_peek(plain, 0x0200) == 0xE0 && bus_peek(plain, 0x11) == 0x07 &&
+         bus_peek(plain, 0x12) == 0x11);
+  ASSERT("Interrupts masked", plain->cpu->Reg.IRQB == 0 && plain->cpu->Reg.PC == 0xC036);
+
+  for(i = 0; i < sizeof(slices) / sizeof(slices[0]); i++)
+  {
+    aot = rom_bus();
+    ASSERT("Failed to create bus", aot!=NULL);
+    ASSERT("Failed to install", aot_install(aot, &aot_image) == 0);
+
+    ASSERT("Code not recompiled", aot->cpu->blocks[0xC000] != NULL && aot->cpu->blocks[0xC00B] != NULL &&
+           aot->cpu->blocks[0xC040] != NULL && aot->cpu->blocks[0xC04C] != NULL);
+    ASSERT("Fallback recompiled", aot->cpu->blocks[0xC013] == NULL && aot->cpu->blocks[0xC014] == NULL &&
+           aot->cpu->blocks[0xC030] == NULL && aot->cpu->blocks[0xC036] == NULL &&
+           aot->cpu->blocks[0xC100] == NULL);
+
+    rom_run(aot, slices[i]);
+    if(!rom_same(plain, aot))
+    {
+      log_error("Differs in slices of %d cycles", (int)slices[i]);
+    }
+    ASSERT("Recompiled run differs", rom_same(plain, aot));
+
+    bus_destroy(&aot);
+  }
+
+  bus_destroy(&plain);
+
+  return 0;
+}
+
+/**
+ * Code generated for a different ROM is refused, the interpreter runs
+ */
+int recomp_t0002()
+{
+  struct Bus *bus = NULL;
+
+  bus = rom_bus();
+  ASSERT("Failed to create bus", bus!=NULL);
+  bus_poke(bus, ROM_BASE + 0x0080, 0xEA);
+
+  ASSERT("Stale image installed", aot_install(bus, &aot_image) == -1);
+  ASSERT("Blocks registered", bus->cpu->blocks == NULL);
+
+  rom_run(bus, BUS_RUN_FOREVER);
+  ASSERT("Wrong result", bus->stop == BUS_STOP_IDLE && bus_peek(bus, 0x0200) == 0xE0);
+
+  bus_destroy(&bus);
+
+  return 0;
+}
+
+/**
+ * A bank switch from recompiled code continues with the new bank
+ */
+int recomp_t0003()
+{
+  static const uint16_t start[] = { 0xC000 };
+  static const uint32_t length[] = { 0x1000 };
+  struct Bus *bus = NULL;
+  struct Mapper *mapper = NULL;
+  uint8_t rom[ROM_SIZE];
+
+  bus = rom_bus();
+  ASSERT("Failed to create bus", bus!=NULL);
+  mapper = mapper_create(bus, 0x7F00, BUS_REGION_ROM, 0x2000, 1, start, length);
+  ASSERT("Failed to create mapper", mapper!=NULL);
+  rom_build(rom);
+  bank_build(mapper->mem->mem, rom);
+
+  ASSERT("Failed to install", aot_install(bus, &aot_image) == 0);
+  ASSERT("Switch not recompiled", bus->cpu->blocks[0xC050] != NULL && bus->cpu->blocks[0xC055] != NULL);
+
+  bus_run(bus, 100000);
+  ASSERT("Old bank ran on", bus->stop == BUS_STOP_IDLE && bus_peek(bus, 0x12) == 0x22 && bus->cpu->Reg.PC == 0xD000);
+  ASSERT("Blocks of the old bank left", bus->cpu->blocks[0xC055] == NULL && bus->cpu->blocks[0xC000] == NULL);
+
+  mapper_destroy(&mapper);
+  bus_destroy(&bus);
+
+  return 0;
+}
+
+/**
+ * The same code in RAM stays with the interpreter, a patch by the guest
+ * takes effect
+ */
+int recomp_t0004()
+{
+  /* LDA #$33; STA $C056; JMP $C000, the bank routine then stores $33 */
+  static const uint8_t patch[] = { 0xA9, 0x33, 0x8D, 0x56, 0xC0, 0x4C, 0x00, 0xC0 };
+  struct Bus *bus = NULL;
+  uint8_t rom[ROM_SIZE];
+  int i = 0;
+
+  bus = rom_bus();
+  ASSERT("Failed to create bus", bus!=NULL);
+  ASSERT("Failed to add RAM", bus_add_memory(bus, BUS_REGION_RAM, ROM_BASE, ROM_SIZE) != NULL);
+  rom_build(rom);
+  for(i = 0; i < ROM_SIZE; i++)
+  {
+    bus_poke(bus, ROM_BASE + i, rom[i]);
+  }
+  for(i = 0; i < sizeof(patch); i++)
+  {
+    bus_poke(bus, 0x0300 + i, patch[i]);
+  }
+  bus->cpu->Reg.PC = 0x0300;
+
+  ASSERT("Failed to install", aot_install(bus, &aot_image) == 0);
+  ASSERT("Writable code recompiled", bus->cpu->blocks[0xC000] == NULL && bus->cpu->blocks[0xC055] == NULL);
+
+  rom_run(bus, BUS_RUN_FOREVER);
+  ASSERT("Patch lost", bus->stop == BUS_STOP_IDLE && bus_peek(bus, 0x12) == 0x33 && bus_peek(bus, 0x0200) == 0xE0);
+
+  bus_destroy(&bus);
+
+  return 0;
+}
+
+/**
+ * A debugger patch of recompiled code drops its block
+ */
+int recomp_t0005()
+{
+  struct Bus *bus = NULL;
+
+  bus = rom_bus();
+  ASSERT("Failed to create bus", bus!=NULL);
+  ASSERT("Failed to install", aot_install(bus, &aot_image) == 0 && bus->cpu->blocks[0xC055] != NULL);
+
+  /* LDA #$44 in the bank routine, its function is entered at 0xC050 */
+  bus_poke(bus, 0xC056, 0x44);
+  ASSERT("Block left", bus->cpu->blocks[0xC050] == NULL && bus->cpu->blocks[0xC055] == NULL &&
+         bus->cpu->blocks[0xC059] == NULL);
+  ASSERT("Other blocks dropped", bus->cpu->blocks[0xC04C] != NULL && bus->cpu->blocks[0xC000] != NULL);
+
+  rom_run(bus, BUS_RUN_FOREVER);
+  ASSERT("Patch lost", bus->stop == BUS_STOP_IDLE && bus_peek(bus, 0x12) == 0x44 && bus_peek(bus, 0x0200) == 0xE0);
+
+  bus_destroy(&bus);
+
+  return 0;
+}
+
+int main()
+{
+  UNIT_TEST_INIT("RECOMP");
+
+  log_set_level(LOG_INFO);
+
+  RUN_TEST(recomp_t0001, "Recompiled ROM against the interpreter");
+  RUN_TEST(recomp_t0002, "Image hash mismatch");
+  RUN_TEST(recomp_t0003, "Bank switch from recompiled code");
+  RUN_TEST(recomp_t0004, "Self-modifying code in RAM");
+  RUN_TEST(recomp_t0005, "Debugger patch of recompiled code");
+
+  UNIT_TEST_ERG();
+
+  return unit_failed == 0 ? 0 : 1;
+}
@@ -0,0 +1,29 @@
+/*
+ * Copyright (c) 2022, Bernd Bauer <bernd.bauer@gmx.at>
+ *
+ * SPDX-License-Identifier: BSD-2-Clause
+ */
+
+/* Writes the ROM of t0023 for 6502-recomp */
+
+#include <stdio.h>
+
+#include "util/log.h"
+#include "util/tools.h"
+
+#include "t0023_rom.h"
+
+int main(int argc, char *argv[])
+{
+  uint8_t rom[ROM_SIZE];
+
+  if(argc != 2)
+  {
+    fprintf(stderr, "Usage: %s rom.bin\n", argv[0]);
+    return 1;
+  }
+
+  rom_build(rom);
+
+  return file_saveBinary(argv[1], rom, sizeof(rom)) == 0 ? 0 : 1;
+}
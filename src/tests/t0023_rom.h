@@ -0,0 +1,65 @@
+/*
+ * Copyright (c) 2022, Bernd Bauer <bernd.bauer@gmx.at>
+ *
+ * SPDX-License-Identifier: BSD-2-Clause
+ */
+
+#ifndef T0023_ROM_H
+#define T0023_ROM_H
+
+#include <stdint.h>
+#include <string.h>
+
+/* ROM for the recompiler test, 0xC000 - 0xFFFF. It selects bank 1 of a
+ * mapper at 0x7F00 and stores $11 to $12, sums 0..63 through a subroutine
+ * into $10/$11, passes SEI, JMP (ind) and CLI which stay with the
+ * interpreter and stores the low byte to $0200 before it idles. Without a
+ * mapper 0x7F00 is RAM. */
+#define ROM_BASE 0xC000
+#define ROM_SIZE 0x4000
+
+/* JSR $C050; LDX #$00; LDA #$00; STA $10; STA $11;
+ * loop: JSR $C040; INX; CPX #$40; BNE loop; SEI; JMP ($C020) */
+static const uint8_t rom_main[] = { 0x20, 0x50, 0xC0, 0xA2, 0x00, 0xA9, 0x00, 0x85, 0x10, 0x85, 0x11, 0x20, 0x40, 0xC0, 0xE8,
+                                    0xE0, 0x40, 0xD0, 0xF8, 0x78, 0x6C, 0x20, 0xC0 };
+/* .word $C030 */
+static const uint8_t rom_vector[] = { 0x30, 0xC0 };
+/* CLI; LDA $10; STA $0200; JMP * */
+static const uint8_t rom_end[] = { 0x58, 0xA5, 0x10, 0x8D, 0x00, 0x02, 0x4C, 0x36, 0xC0 };
+/* TXA; CLC; ADC $10; STA $10; LDA $11; ADC #$00; STA $11; RTS */
+static const uint8_t rom_add[] = { 0x8A, 0x18, 0x65, 0x10, 0x85, 0x10, 0xA5, 0x11, 0x69, 0x00, 0x85, 0x11,
+                                   0x60 };
+/* LDA #$01; STA $7F00; LDA #$11; STA $12; RTS */
+static const uint8_t rom_bank[] = { 0xA9, 0x01, 0x8D, 0x00, 0x7F, 0xA9, 0x11, 0x85, 0x12, 0x60 };
+/* 0xD000: JMP * */
+static const uint8_t rom_fixed[] = { 0x4C, 0x00, 0xD0 };
+/* RTI */
+static const uint8_t rom_irq[] = { 0x40 };
+/* Bank 1 of the mapper window 0xC000 - 0xCFFF at 0xC055:
+ * LDA #$22; STA $12; JMP $D000 */
+static const uint8_t bank_code[] = { 0xA9, 0x22, 0x85, 0x12, 0x4C, 0x00, 0xD0 };
+/* NMI, reset and IRQ vectors */
+static const uint8_t rom_vectors[] = { 0x00, 0xC1, 0x00, 0xC0, 0x00, 0xC1 };
+
+static inline void rom_build(uint8_t *rom)
+{
+  memset(rom, 0, ROM_SIZE);
+  memcpy(rom + 0x0000, rom_main, sizeof(rom_main));
+  memcpy(rom + 0x0020, rom_vector, sizeof(rom_vector));
+  memcpy(rom + 0x0030, rom_end, sizeof(rom_end));
+  memcpy(rom + 0x0040, rom_add, sizeof(rom_add));
+  memcpy(rom + 0x0050, rom_bank, sizeof(rom_bank));
+  memcpy(rom + 0x1000, rom_fixed, sizeof(rom_fixed));
+  memcpy(rom + 0x0100, rom_irq, sizeof(rom_irq));
+  memcpy(rom + 0x3FFA, rom_vectors, sizeof(rom_vectors));
+}
+
+/* Bank 0 holds the ROM content of the window, bank 1 the code above */
+static inline void bank_build(uint8_t *banks, const uint8_t *rom)
+{
+  memcpy(banks, rom, 0x1000);
+  memset(banks + 0x1000, 0, 0x1000);
+  memcpy(banks + 0x1055, bank_code, sizeof(bank_code));
+}
+
+#endif /* T0023_ROM_H */
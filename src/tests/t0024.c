@@ -0,0 +1,287 @@
+/*
+ * Copyright (c) 2022, Bernd Bauer <bernd.bauer@gmx.at>
+ *
+ * SPDX-License-Identifier: BSD-2-Clause
+ */
+
+#include <stdio.h>
+
+#include "util/log.h"
+#include "util/unit.h"
+
+#include "core/bus.h"
+#include "core/device.h"
+#include "core/stop.h"
+
+#include "testbus.h"
+
+/* LDA $10; BEQ $0200; INC $11; JMP * */
+static const uint8_t poll_zp[] = { 0xA5, 0x10, 0xF0, 0xFC, 0xE6, 0x11, 0x4C, 0x06, 0x02 };
+/* LDA $0300; AND #$01; BNE $0200; INC $11; JMP * */
+static const uint8_t poll_abs[] = { 0xAD, 0x00, 0x03, 0x29, 0x01, 0xD0, 0xF9, 0xE6, 0x11, 0x4C, 0x09, 0x02 };
+/* LDA $D000; BEQ $0200; INC $11; JMP * */
+static const uint8_t poll_dev[] = { 0xAD, 0x00, 0xD0, 0xF0, 0xFB, 0xE6, 0x11, 0x4C, 0x07, 0x02 };
+
+struct Wake
+{
+  struct Bus *bus;
+  uint16_t addr;
+  uint8_t data;
+};
+
+struct Flag
+{
+  struct Bus *bus;
+  int reads;
+  uint64_t ready;
+};
+
+static void wake_event(void *ctx, uint64_t when);
+static void noop_event(void *ctx, uint64_t when);
+static uint8_t flag_read(void *ctx, uint16_t addr);
+static uint8_t flag_peek(void *ctx, uint16_t addr);
+static void flag_write(void *ctx, uint16_t addr, uint8_t data);
+
+static const struct DeviceOps flag_ops =
+{
+  .name = "flag",
+  .read = flag_read,
+  .write = flag_write,
+  .peek = flag_peek,
+};
+
+/* Runs a poll loop on addr woken by a write of data at cycle 1000, a hooked
+ * run keeps the CPU from fast forwarding */
+static int run_woken(const uint8_t *code, int len, uint16_t addr, uint8_t init, uint8_t data,
+                     int hooked, uint64_t *clock)
+{
+  struct Bus *bus = NULL;
+  struct Wake wake;
+
+  bus = testbus_create(code, len);
+  if(bus == NULL)
+  {
+    return -1;
+  }
+
+  bus_poke(bus, addr, init);
+  wake.bus = bus;
+  wake.addr = addr;
+  wake.data = data;
+  scheduler_add(bus->sched, 1000, wake_event, &wake);
+  if(hooked)
+  {
+    /* Never reached, it only makes the CPU look at every instruction */
+    stop_at_pc(bus->stopcond, 0xFFF0);
+  }
+
+  bus_run(bus, BUS_RUN_FOREVER);
+  *clock = bus->cpu->clock_count;
+  if(bus->stop != BUS_STOP_IDLE || bus_peek(bus, 0x11) != 0x01)
+  {
+    bus_destroy(&bus);
+    return -1;
+  }
+
+  bus_destroy(&bus);
+
+  return 0;
+}
+
+/**
+ * A zero page poll loop wakes on the same cycle as with every iteration run
+ */
+int idle_t0001()
+{
+  uint64_t fast = 0;
+  uint64_t slow = 0;
+
+  ASSERT("Loop not left", run_woken(poll_zp, sizeof(poll_zp), 0x10, 0x00, 0x01, 0, &fast) == 0);
+  ASSERT("Loop not left without fast forward", run_woken(poll_zp, sizeof(poll_zp), 0x10, 0x00, 0x01, 1, &slow) == 0);
+  /* 167 iterations of 6 cycles, LDA, BEQ not taken, INC and JMP * */
+  ASSERT("Wrong clock", fast == 1015);
+  ASSERT("Clock differs from the plain run", fast == slow);
+
+  return 0;
+}
+
+/**
+ * An absolute poll loop with a mask wakes on the same cycle as with every
+ * iteration run
+ */
+int idle_t0002()
+{
+  uint64_t fast = 0;
+  uint64_t slow = 0;
+
+  ASSERT("Loop not left", run_woken(poll_abs, sizeof(poll_abs), 0x0300, 0x01, 0xFE, 0, &fast) == 0);
+  ASSERT("Loop not left without fast forward", run_woken(poll_abs, sizeof(poll_abs), 0x0300, 0x01, 0xFE, 1, &slow) == 0);
+  /* 112 iterations of 9 cycles, LDA, AND, BNE not taken, INC and JMP * */
+  ASSERT("Wrong clock", fast == 1024);
+  ASSERT("Clock differs from the plain run", fast == slow);
+
+  return 0;
+}
+
+/**
+ * A loop polling a device runs every iteration
+ */
+int idle_t0003()
+{
+  struct Bus *bus = NULL;
+  struct Flag flag = { 0 };
+
+  bus = testbus_create(poll_dev, sizeof(poll_dev));
+  ASSERT("Failed to create bus", bus!=NULL);
+  flag.bus = bus;
+  ASSERT("Failed to attach", device_attach(bus, 0xD000, 0xD0FF, &flag_ops, &flag) != NULL);
+  scheduler_add(bus->sched, 1000000, noop_event, NULL);
+
+  bus_run(bus, BUS_RUN_FOREVER);
+  ASSERT("Wrong stop", bus->stop == BUS_STOP_IDLE);
+  ASSERT("Loop not left", bus_peek(bus, 0x11) == 0x01);
+  ASSERT("Wrong read count", flag.reads == 100);
+  ASSERT("Device loop fast forwarded", flag.ready < 1000);
+
+  bus_destroy(&bus);
+
+  return 0;
+}
+
+/**
+ * A branch to itself without a pending event stops at once
+ */
+int idle_t0004()
+{
+  /* LDA #$01; BNE * */
+  static const uint8_t code[] = { 0xA9, 0x01, 0xD0, 0xFE };
+  struct Bus *bus = NULL;
+
+  bus = testbus_create(code, sizeof(code));
+  ASSERT("Failed to create bus", bus!=NULL);
+
+  bus_run(bus, BUS_RUN_FOREVER);
+  ASSERT("Wrong stop", bus->stop == BUS_STOP_IDLE);
+  ASSERT("Wrong PC", bus->cpu->Reg.PC == 0x0202);
+  ASSERT("Not stopped at once", bus->cpu->clock_count < 100);
+
+  bus_destroy(&bus);
+
+  return 0;
+}
+
+/**
+ * An instruction limit is not overrun by a fast forwarded poll loop
+ */
+int idle_t0005()
+{
+  struct Bus *bus = NULL;
+
+  bus = testbus_create(poll_zp, sizeof(poll_zp));
+  ASSERT("Failed to create bus", bus!=NULL);
+  scheduler_add(bus->sched, 1000000, noop_event, NULL);
+  stop_after_instructions(bus->stopcond, 101);
+
+  bus_run(bus, BUS_RUN_FOREVER);
+  ASSERT("Wrong stop", bus->stop == BUS_STOP_INSTRUCTIONS);
+  ASSERT("Wrong PC", bus->cpu->Reg.PC == 0x0202);
+  ASSERT("Wrong clock", bus->cpu->clock_count == 50 * 6 + 3);
+
+  bus_destroy(&bus);
+
+  return 0;
+}
+
+/**
+ * A write between the load and the branch is seen by the next iteration
+ */
+int idle_t0006()
+{
+  struct Bus *bus = NULL;
+  struct Wake wake;
+
+  bus = testbus_create(poll_zp, sizeof(poll_zp));
+  ASSERT("Failed to create bus", bus!=NULL);
+  wake.bus = bus;
+  wake.addr = 0x10;
+  wake.data = 0x01;
+  /* Right after the first LDA */
+  scheduler_add(bus->sched, 3, wake_event, &wake);
+
+  bus_run(bus, BUS_RUN_FOREVER);
+  ASSERT("Wrong stop", bus->stop == BUS_STOP_IDLE);
+  ASSERT("Loop not left", bus_peek(bus, 0x11) == 0x01);
+  /* LDA, BEQ taken, LDA, BEQ not taken, INC and JMP * */
+  ASSERT("Wrong clock", bus->cpu->clock_count == 19);
+
+  bus_destroy(&bus);
+
+  return 0;
+}
+
+/*----------------------------------------------------------------------------*/
+void wake_event(void *ctx, uint64_t when)
+{
+  struct Wake *wake = ctx;
+
+  (void)when;
+  bus_write(wake->bus, wake->addr, wake->data);
+}
+
+/*----------------------------------------------------------------------------*/
+void noop_event(void *ctx, uint64_t when)
+{
+  (void)ctx;
+  (void)when;
+}
+
+/*----------------------------------------------------------------------------*/
+uint8_t flag_read(void *ctx, uint16_t addr)
+{
+  struct Flag *flag = ctx;
+
+  (void)addr;
+  flag->reads++;
+  if(flag->reads < 100)
+  {
+    return 0x00;
+  }
+
+  flag->ready = flag->bus->cpu->clock_count;
+  return 0x01;
+}
+
+/*----------------------------------------------------------------------------*/
+uint8_t flag_peek(void *ctx, uint16_t addr)
+{
+  struct Flag *flag = ctx;
+
+  (void)addr;
+  return flag->reads < 100 ? 0x00 : 0x01;
+}
+
+/*----------------------------------------------------------------------------*/
+void flag_write(void *ctx, uint16_t addr, uint8_t data)
+{
+  (void)ctx;
+  (void)addr;
+  (void)data;
+}
+
+int main()
+{
+  UNIT_TEST_INIT("IDLE");
+
+  log_set_level(LOG_INFO);
+
+  RUN_TEST(idle_t0001, "Zero page poll loop woken by a write");
+  RUN_TEST(idle_t0002, "Masked absolute poll loop woken by a write");
+  RUN_TEST(idle_t0003, "Device poll loop");
+  RUN_TEST(idle_t0004, "Branch to itself");
+  RUN_TEST(idle_t0005, "Instruction limit in a poll loop");
+  RUN_TEST(idle_t0006, "Write between load and branch");
+
+  UNIT_TEST_ERG();
+
+  return unit_failed == 0 ? 0 : 1;
+}
@@ -0,0 +1,56 @@
+/*
+ * Copyright (c) 2022, Bernd Bauer <bernd.bauer@gmx.at>
+ *
+ * SPDX-License-Identifier: BSD-2-Clause
+ */
+
+#ifndef TESTBUS_H
+#define TESTBUS_H
+
+#include <stdint.h>
+
+#include "core/bus.h"
+
+/* Code at addr and the CPU ready to run it, load handlers before the program */
+static inline void testbus_load(struct Bus *bus, uint16_t addr, const uint8_t *code, int len)
+{
+  int i = 0;
+
+  for(i = 0; i < len; i++)
+  {
+    bus_poke(bus, addr + i, code[i]);
+  }
+  bus->cpu->Reg.PC = addr;
+  bus->cpu->cycles = 0;
+}
+
+/* Default bus with code at 0x0200 and the CPU ready to run it */
+static inline struct Bus* testbus_create(const uint8_t *code, int len)
+{
+  struct Bus *bus = bus_create();
+
+  if(bus != NULL)
+  {
+    testbus_load(bus, 0x0200, code, len);
+  }
+
+  return bus;
+}
+
+/* Guest that masks interrupts and idles, devices are driven by the test */
+static inline struct Bus* testbus_idle(void)
+{
+  /* SEI; JMP * */
+  static const uint8_t code[] = { 0x78, 0x4C, 0x01, 0x02 };
+
+  return testbus_create(code, sizeof(code));
+}
+
+/* Run on after an idle stop */
+static inline void testbus_run(struct Bus *bus, uint64_t cycles)
+{
+  bus_resume(bus);
+  bus_run(bus, cycles);
+}
+
+#endif /* TESTBUS_H */
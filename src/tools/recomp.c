@@ -0,0 +1,649 @@
+/*
+ * Copyright (c) 2022, Bernd Bauer <bernd.bauer@gmx.at>
+ *
+ * SPDX-License-Identifier: BSD-2-Clause
+ */
+
+/* Ahead-of-time recompiler: translates the code reachable from the
+ * vectors of a ROM image into C functions for core/aot.h. Instructions
+ * with effects on the interrupt state (BRK, RTI, CLI, SEI, PLP), indirect
+ * jumps, illegal opcodes and idle or poll loops stay with the interpreter. */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "util/log.h"
+
+#include "core/aot.h"
+#include "core/cpu6502.h"
+
+#define RECOMP_START    0x01 /* an instruction is decoded at this address */
+#define RECOMP_COMPILED 0x02 /* the instruction is translated to C */
+
+struct Recomp
+{
+  uint8_t mem[0x10000];
+  uint32_t base;
+
+  uint8_t flags[0x10000];
+  uint16_t func[0x10000];   /* entry of the function an instruction is in */
+  uint16_t last[0x10000];   /* last instruction of the function at entry */
+
+  uint16_t *work;
+  int work_count;
+};
+
+static const char *modeFormat[] = {
+  [CPU6502_MODE_IMP] = "",
+  [CPU6502_MODE_IMM] = " #$%02X",
+  [CPU6502_MODE_ZPG] = " $%02X",
+  [CPU6502_MODE_ZPX] = " $%02X,X",
+  [CPU6502_MODE_ZPY] = " $%02X,Y",
+  [CPU6502_MODE_REL] = " $%04X",
+  [CPU6502_MODE_ABS] = " $%04X",
+  [CPU6502_MODE_ABX] = " $%04X,X",
+  [CPU6502_MODE_ABY] = " $%04X,Y",
+  [CPU6502_MODE_IND] = " ($%04X)",
+  [CPU6502_MODE_IZX] = " ($%02X,X)",
+  [CPU6502_MODE_IZY] = " ($%02X),Y",
+};
+
+/*----------------------------------------------------------------------------*/
+static uint16_t operand(struct Recomp *rc, uint16_t pc, const struct CPU6502OpInfo *info)
+{
+  if(info->mode == CPU6502_MODE_REL)
+  {
+    return pc + 2 + (int8_t)rc->mem[pc + 1];
+  }
+  if(info->length == 3)
+  {
+    return rc->mem[pc + 1] | (rc->mem[(uint16_t)(pc + 2)] << 8);
+  }
+  return rc->mem[pc + 1];
+}
+
+/*----------------------------------------------------------------------------*/
+static int decode(struct Recomp *rc, uint16_t pc, struct CPU6502OpInfo *info)
+{
+  if(CPU6502_opcodeInfo(rc->mem[pc], info) != 0 || info->mnemonic[0] == '\0')
+  {
+    return -1;
+  }
+  if(pc < rc->base || pc + info->length > 0x10000)
+  {
+    return -1;
+  }
+  return 0;
+}
+
+/*----------------------------------------------------------------------------*/
+static int isBranch(const struct CPU6502OpInfo *info)
+{
+  return info->mode == CPU6502_MODE_REL;
+}
+
+/* Left to the interpreter because they change the interrupt state, need
+ * the idle loop detection or have a target that is only known at run time */
+static int isFallback(struct Recomp *rc, uint16_t pc, const struct CPU6502OpInfo *info)
+{
+  static const char *names[] = { "BRK", "RTI", "CLI", "SEI", "PLP" };
+  uint16_t target = operand(rc, pc, info);
+  int i = 0;
+
+  for(i = 0; i < sizeof(names) / sizeof(names[0]); i++)
+  {
+    if(strcmp(info->mnemonic, names[i]) == 0)
+    {
+      return 1;
+    }
+  }
+
+  if(strcmp(info->mnemonic, "JMP") == 0)
+  {
+    return info->mode == CPU6502_MODE_IND || target == pc;
+  }
+
+  /* Branch to itself or back over a poll of at most 5 bytes */
+  if(isBranch(info) && target <= pc && pc - target <= 5)
+  {
+    return 1;
+  }
+
+  return 0;
+}
+
+/* No fall through into the next instruction */
+static int isTerminal(const struct CPU6502OpInfo *info)
+{
+  return strcmp(info->mnemonic, "JMP") == 0 ||
+         strcmp(info->mnemonic, "RTS") == 0 ||
+         strcmp(info->mnemonic, "RTI") == 0;
+}
+
+/*----------------------------------------------------------------------------*/
+static void push(struct Recomp *rc, uint32_t pc)
+{
+  if(pc >= rc->base && pc < 0x10000 && (rc->flags[pc] & RECOMP_START) == 0)
+  {
+    rc->work[rc->work_count++] = pc;
+  }
+}
+
+/*----------------------------------------------------------------------------*/
+static void discover(struct Recomp *rc)
+{
+  struct CPU6502OpInfo info;
+  uint32_t vector = 0;
+
+  for(vector = 0xFFFA; vector < 0x10000; vector += 2)
+  {
+    if(vector >= rc->base)
+    {
+      push(rc, rc->mem[vector] | (rc->mem[vector + 1] << 8));
+    }
+  }
+
+  while(rc->work_count > 0)
+  {
+    uint16_t pc = rc->work[--rc->work_count];
+
+    if((rc->flags[pc] & RECOMP_START) || decode(rc, pc, &info) != 0)
+    {
+      continue;
+    }
+
+    rc->flags[pc] |= RECOMP_START;
+    if(!isFallback(rc, pc, &info))
+    {
+      rc->flags[pc] |= RECOMP_COMPILED;
+    }
+
+    if(strcmp(info.mnemonic, "JMP") == 0)
+    {
+      if(info.mode == CPU6502_MODE_ABS)
+      {
+        push(rc, operand(rc, pc, &info));
+      }
+    }
+    else if(strcmp(info.mnemonic, "BRK") == 0)
+    {
+      /* RTI returns behind the padding byte */
+      push(rc, pc + 2);
+    }
+    else if(!isTerminal(&info))
+    {
+      if(isBranch(&info) || strcmp(info.mnemonic, "JSR") == 0)
+      {
+        push(rc, operand(rc, pc, &info));
+      }
+      push(rc, pc + info.length);
+    }
+  }
+}
+
+/*----------------------------------------------------------------------------*/
+static const char* branchCondition(const char *mnemonic)
+{
+  static const char *conditions[][2] = {
+    { "BCC", "!cpu->Reg.CARRY" },
+    { "BCS", "cpu->Reg.CARRY" },
+    { "BEQ", "cpu->Reg.ZERO" },
+    { "BNE", "!cpu->Reg.ZERO" },
+    { "BMI", "cpu->Reg.NEGATIVE" },
+    { "BPL", "!cpu->Reg.NEGATIVE" },
+    { "BVC", "!cpu->Reg.OVERFLOW" },
+    { "BVS", "cpu->Reg.OVERFLOW" },
+  };
+  int i = 0;
+
+  for(i = 0; i < sizeof(conditions) / sizeof(conditions[0]); i++)
+  {
+    if(strcmp(mnemonic, conditions[i][0]) == 0)
+    {
+      return conditions[i][1];
+    }
+  }
+  return "0";
+}
+
+/* Continue at target: inside the function unless a stop is due */
+static void emitJump(struct Recomp *rc, FILE *out, uint16_t entry, uint16_t target, const char *indent)
+{
+  fprintf(out, "%scpu->Reg.PC = 0x%04X;\n", indent, target);
+  if((rc->flags[target] & RECOMP_COMPILED) && rc->func[target] == entry)
+  {
+    fprintf(out, "%sif(AOT_STOP(cpu)) return;\n", indent);
+    fprintf(out, "%sgoto L_%04X;\n", indent, target);
+  }
+  else
+  {
+    fprintf(out, "%sreturn;\n", indent);
+  }
+}
+
+/* Effective address into addr, base holds the unindexed address of the
+ * modes with a page crossing penalty */
+static void emitAddress(FILE *out, uint8_t mode, uint16_t arg)
+{
+  switch(mode)
+  {
+    case CPU6502_MODE_ZPG:
+    case CPU6502_MODE_ABS:
+      fprintf(out, "  addr = 0x%04X;\n", arg);
+      break;
+    case CPU6502_MODE_ZPX:
+      fprintf(out, "  addr = (uint8_t)(0x%02X + cpu->Reg.X);\n", arg);
+      break;
+    case CPU6502_MODE_ZPY:
+      fprintf(out, "  addr = (uint8_t)(0x%02X + cpu->Reg.Y);\n", arg);
+      break;
+    case CPU6502_MODE_ABX:
+      fprintf(out, "  base = 0x%04X;\n", arg);
+      fprintf(out, "  addr = base + cpu->Reg.X;\n");
+      break;
+    case CPU6502_MODE_ABY:
+      fprintf(out, "  base = 0x%04X;\n", arg);
+      fprintf(out, "  addr = base + cpu->Reg.Y;\n");
+      break;
+    case CPU6502_MODE_IZX:
+      fprintf(out, "  addr = aot_zpWord(bus, 0x%02X + cpu->Reg.X);\n", arg);
+      break;
+    case CPU6502_MODE_IZY:
+      fprintf(out, "  base = aot_zpWord(bus, 0x%02X);\n", arg);
+      fprintf(out, "  addr = base + cpu->Reg.Y;\n");
+      break;
+  }
+}
+
+/*----------------------------------------------------------------------------*/
+static void emitInstruction(struct Recomp *rc, FILE *out, uint16_t entry, uint16_t pc, const struct CPU6502OpInfo *info)
+{
+  static const char *reads[] = { "ADC", "AND", "BIT", "CMP", "CPX", "CPY", "EOR", "LDA", "LDX", "LDY", "ORA", "SBC" };
+  static const char *penalty[] = { "ADC", "AND", "CMP", "EOR", "LDA", "LDX", "LDY", "ORA", "SBC" };
+  const char *m = info->mnemonic;
+  uint16_t arg = operand(rc, pc, info);
+  uint16_t next = pc + info->length;
+  int cross = 0;
+  int i = 0;
+
+  fprintf(out, "L_%04X: /* %s", pc, m);
+  fprintf(out, modeFormat[info->mode], arg);
+  fprintf(out, " */\n");
+
+  if(isBranch(info))
+  {
+    fprintf(out, "  cpu->clock_count += %d;\n", info->cycles);
+    fprintf(out, "  if(%s)\n  {\n", branchCondition(m));
+    fprintf(out, "    cpu->clock_count += %d;\n", ((arg ^ next) & 0xFF00) ? 2 : 1);
+    emitJump(rc, out, entry, arg, "    ");
+    fprintf(out, "  }\n");
+  }
+  else if(strcmp(m, "JMP") == 0)
+  {
+    fprintf(out, "  cpu->clock_count += %d;\n", info->cycles);
+    emitJump(rc, out, entry, arg, "  ");
+    return;
+  }
+  else if(strcmp(m, "JSR") == 0)
+  {
+    fprintf(out, "  bus_write_fast(bus, 0x0100 + cpu->Reg.SP--, 0x%02X);\n", (uint16_t)(next - 1) >> 8);
+    fprintf(out, "  bus_write_fast(bus, 0x0100 + cpu->Reg.SP--, 0x%02X);\n", (uint16_t)(next - 1) & 0xFF);
+    fprintf(out, "  cpu->clock_count += %d;\n", info->cycles);
+    emitJump(rc, out, entry, arg, "  ");
+    return;
+  }
+  else if(strcmp(m, "RTS") == 0)
+  {
+    fprintf(out, "  addr = bus_read_fast(bus, 0x0100 + ++cpu->Reg.SP);\n");
+    fprintf(out, "  addr |= bus_read_fast(bus, 0x0100 + ++cpu->Reg.SP) << 8;\n");
+    fprintf(out, "  cpu->Reg.PC = addr + 1;\n");
+    fprintf(out, "  cpu->clock_count += %d;\n", info->cycles);
+    fprintf(out, "  return;\n");
+    return;
+  }
+  else
+  {
+    emitAddress(out, info->mode, arg);
+
+    for(i = 0; i < sizeof(reads) / sizeof(reads[0]); i++)
+    {
+      if(strcmp(m, reads[i]) == 0)
+      {
+        if(info->mode == CPU6502_MODE_IMM)
+        {
+          fprintf(out, "  value = 0x%02X;\n", arg);
+        }
+        else
+        {
+          fprintf(out, "  value = bus_read_fast(bus, addr);\n");
+        }
+      }
+    }
+    for(i = 0; i < sizeof(penalty) / sizeof(penalty[0]); i++)
+    {
+      if(strcmp(m, penalty[i]) == 0)
+      {
+        cross = info->mode == CPU6502_MODE_ABX || info->mode == CPU6502_MODE_ABY ||
+                info->mode == CPU6502_MODE_IZY;
+      }
+    }
+
+    if(strcmp(m, "ADC") == 0) fprintf(out, "  CPU6502_aluAdc(cpu, value);\n");
+    else if(strcmp(m, "SBC") == 0) fprintf(out, "  CPU6502_aluSbc(cpu, value);\n");
+    else if(strcmp(m, "BIT") == 0) fprintf(out, "  CPU6502_aluBit(cpu, value);\n");
+    else if(strcmp(m, "AND") == 0) fprintf(out, "  cpu->Reg.A &= value;\n  CPU6502_setNZ(cpu, cpu->Reg.A);\n");
+    else if(strcmp(m, "ORA") == 0) fprintf(out, "  cpu->Reg.A |= value;\n  CPU6502_setNZ(cpu, cpu->Reg.A);\n");
+    else if(strcmp(m, "EOR") == 0) fprintf(out, "  cpu->Reg.A ^= value;\n  CPU6502_setNZ(cpu, cpu->Reg.A);\n");
+    else if(strcmp(m, "CMP") == 0) fprintf(out, "  CPU6502_setCompareFlags(cpu, cpu->Reg.A, value);\n");
+    else if(strcmp(m, "CPX") == 0) fprintf(out, "  CPU6502_setCompareFlags(cpu, cpu->Reg.X, value);\n");
+    else if(strcmp(m, "CPY") == 0) fprintf(out, "  CPU6502_setCompareFlags(cpu, cpu->Reg.Y, value);\n");
+    else if(strcmp(m, "LDA") == 0) fprintf(out, "  cpu->Reg.A = value;\n  CPU6502_setNZ(cpu, value);\n");
+    else if(strcmp(m, "LDX") == 0) fprintf(out, "  cpu->Reg.X = value;\n  CPU6502_setNZ(cpu, value);\n");
+    else if(strcmp(m, "LDY") == 0) fprintf(out, "  cpu->Reg.Y = value;\n  CPU6502_setNZ(cpu, value);\n");
+    else if(strcmp(m, "STA") == 0) fprintf(out, "  bus_write_fast(bus, addr, cpu->Reg.A);\n");
+    else if(strcmp(m, "STX") == 0) fprintf(out, "  bus_write_fast(bus, addr, cpu->Reg.X);\n");
+    else if(strcmp(m, "STY") == 0) fprintf(out, "  bus_write_fast(bus, addr, cpu->Reg.Y);\n");
+    else if(strcmp(m, "INC") == 0 || strcmp(m, "DEC") == 0)
+    {
+      fprintf(out, "  value = bus_read_fast(bus, addr) %s 1;\n", m[0] == 'I' ? "+" : "-");
+      fprintf(out, "  bus_write_fast(bus, addr, value);\n");
+      fprintf(out, "  CPU6502_setNZ(cpu, value);\n");
+    }
+    else if(strcmp(m, "ASL") == 0 || strcmp(m, "LSR") == 0 || strcmp(m, "ROL") == 0 || strcmp(m, "ROR") == 0)
+    {
+      static const char *shifts[][2] = {
+        { "value << 1", "value >> 7" },
+        { "value >> 1", "value & 0x01" },
+        { "(value << 1) | cpu->Reg.CARRY", "value >> 7" },
+        { "(value >> 1) | (cpu->Reg.CARRY << 7)", "value & 0x01" },
+      };
+      int s = m[0] == 'A' ? 0 : m[0] == 'L' ? 1 : m[2] == 'L' ? 2 : 3;
+      int acc = info->mode == CPU6502_MODE_IMP;
+
+      fprintf(out, "  value = %s;\n", acc ? "cpu->Reg.A" : "bus_read_fast(bus, addr)");
+      fprintf(out, "  result = %s;\n", shifts[s][0]);
+      fprintf(out, "  CPU6502_setShiftFlags(cpu, result, %s);\n", shifts[s][1]);
+      if(acc)
+      {
+        fprintf(out, "  cpu->Reg.A = result;\n");
+      }
+      else
+      {
+        fprintf(out, "  bus_write_fast(bus, addr, result);\n");
+      }
+    }
+    else if(strcmp(m, "INX") == 0) fprintf(out, "  CPU6502_setNZ(cpu, ++cpu->Reg.X);\n");
+    else if(strcmp(m, "INY") == 0) fprintf(out, "  CPU6502_setNZ(cpu, ++cpu->Reg.Y);\n");
+    else if(strcmp(m, "DEX") == 0) fprintf(out, "  CPU6502_setNZ(cpu, --cpu->Reg.X);\n");
+    else if(strcmp(m, "DEY") == 0) fprintf(out, "  CPU6502_setNZ(cpu, --cpu->Reg.Y);\n");
+    else if(strcmp(m, "TAX") == 0) fprintf(out, "  cpu->Reg.X = cpu->Reg.A;\n  CPU6502_setNZ(cpu, cpu->Reg.X);\n");
+    else if(strcmp(m, "TAY") == 0) fprintf(out, "  cpu->Reg.Y = cpu->Reg.A;\n  CPU6502_setNZ(cpu, cpu->Reg.Y);\n");
+    else if(strcmp(m, "TXA") == 0) fprintf(out, "  cpu->Reg.A = cpu->Reg.X;\n  CPU6502_setNZ(cpu, cpu->Reg.A);\n");
+    else if(strcmp(m, "TYA") == 0) fprintf(out, "  cpu->Reg.A = cpu->Reg.Y;\n  CPU6502_setNZ(cpu, cpu->Reg.A);\n");
+    else if(strcmp(m, "TSX") == 0) fprintf(out, "  cpu->Reg.X = cpu->Reg.SP;\n  CPU6502_setNZ(cpu, cpu->Reg.X);\n");
+    else if(strcmp(m, "TXS") == 0) fprintf(out, "  cpu->Reg.SP = cpu->Reg.X;\n");
+    else if(strcmp(m, "PHA") == 0) fprintf(out, "  bus_write_fast(bus, 0x0100 + cpu->Reg.SP--, cpu->Reg.A);\n");
+    else if(strcmp(m, "PLA") == 0) fprintf(out, "  cpu->Reg.A = bus_read_fast(bus, 0x0100 + ++cpu->Reg.SP);\n  CPU6502_setNZ(cpu, cpu->Reg.A);\n");
+    else if(strcmp(m, "PHP") == 0)
+    {
+      /* Same as the interpreter: B and bit 5 are pushed set and cleared */
+      fprintf(out, "  bus_write_fast(bus, 0x0100 + cpu->Reg.SP--, cpu->Reg.PSR | 0x30);\n");
+      fprintf(out, "  cpu->Reg.PSR &= ~0x30;\n");
+    }
+    else if(strcmp(m, "CLC") == 0) fprintf(out, "  cpu->Reg.CARRY = 0;\n");
+    else if(strcmp(m, "SEC") == 0) fprintf(out, "  cpu->Reg.CARRY = 1;\n");
+    else if(strcmp(m, "CLD") == 0) fprintf(out, "  cpu->Reg.DECIMAL = 0;\n");
+    else if(strcmp(m, "SED") == 0) fprintf(out, "  cpu->Reg.DECIMAL = 1;\n");
+    else if(strcmp(m, "CLV") == 0) fprintf(out, "  cpu->Reg.OVERFLOW = 0;\n");
+
+    if(cross)
+    {
+      fprintf(out, "  cpu->clock_count += %d + (((addr ^ base) & 0xFF00) != 0);\n", info->cycles);
+    }
+    else
+    {
+      fprintf(out, "  cpu->clock_count += %d;\n", info->cycles);
+    }
+  }
+
+  if(rc->func[next] == entry && (rc->flags[next] & RECOMP_COMPILED))
+  {
+    fprintf(out, "  if(AOT_STOP(cpu))\n  {\n    cpu->Reg.PC = 0x%04X;\n    return;\n  }\n", next);
+  }
+  else
+  {
+    fprintf(out, "  cpu->Reg.PC = 0x%04X;\n  return;\n", next);
+  }
+}
+
+/*----------------------------------------------------------------------------*/
+static int emitFunction(struct Recomp *rc, FILE *out, uint16_t entry, uint16_t last)
+{
+  struct CPU6502OpInfo info;
+  char *body = NULL;
+  size_t size = 0;
+  FILE *buf = NULL;
+  uint32_t pc = 0;
+
+  buf = open_memstream(&body, &size);
+  if(buf == NULL)
+  {
+    log_error("Could not allocate memory for function body");
+    return -1;
+  }
+
+  for(pc = entry; pc <= last; pc += info.length)
+  {
+    decode(rc, pc, &info);
+    emitInstruction(rc, buf, entry, pc, &info);
+  }
+  fclose(buf);
+
+  fprintf(out, "/*----------------------------------------------------------------------------*/\n");
+  fprintf(out, "static void aot_%04X(struct CPU6502 *cpu)\n{\n", entry);
+  if(strstr(body, "bus,"))
+  {
+    fprintf(out, "  struct Bus *bus = cpu->bus;\n");
+  }
+  if(strstr(body, "addr"))
+  {
+    fprintf(out, "  uint16_t addr;\n");
+  }
+  if(strstr(body, "base"))
+  {
+    fprintf(out, "  uint16_t base;\n");
+  }
+  if(strstr(body, "value"))
+  {
+    fprintf(out, "  uint8_t value;\n");
+  }
+  if(strstr(body, "result"))
+  {
+    fprintf(out, "  uint8_t result;\n");
+  }
+  fprintf(out, "\n  switch(cpu->Reg.PC)\n  {\n");
+  for(pc = entry; pc <= last; pc += info.length)
+  {
+    decode(rc, pc, &info);
+    fprintf(out, "    case 0x%04X: goto L_%04X;\n", pc, pc);
+  }
+  fprintf(out, "    default: return;\n  }\n\n%s}\n\n", body);
+
+  free(body);
+
+  return 0;
+}
+
+/*----------------------------------------------------------------------------*/
+static int emit(struct Recomp *rc, FILE *out, const char *source)
+{
+  struct CPU6502OpInfo info;
+  uint32_t pc = 0;
+  int functions = 0;
+  int entries = 0;
+
+  /* Maximal fall through runs of compiled instructions, one per function */
+  for(pc = rc->base; pc < 0x10000; pc++)
+  {
+    uint32_t cur = pc;
+
+    if((rc->flags[pc] & RECOMP_COMPILED) == 0 || rc->func[pc] != 0)
+    {
+      continue;
+    }
+
+    while(1)
+    {
+      rc->func[cur] = pc;
+      rc->last[pc] = cur;
+      decode(rc, cur, &info);
+      cur += info.length;
+      if(isTerminal(&info) || cur >= 0x10000 ||
+         (rc->flags[cur] & RECOMP_COMPILED) == 0 || rc->func[cur] != 0)
+      {
+        break;
+      }
+    }
+  }
+
+  fprintf(out, "/* Generated by 6502-recomp from %s, do not edit */\n\n", source);
+  fprintf(out, "#include \"core/aot.h\"\n\n");
+
+  for(pc = rc->base; pc < 0x10000; pc++)
+  {
+    if((rc->flags[pc] & RECOMP_COMPILED) && rc->func[pc] == pc)
+    {
+      if(emitFunction(rc, out, pc, rc->last[pc]) != 0)
+      {
+        return -1;
+      }
+      functions++;
+    }
+  }
+
+  fprintf(out, "static const struct AotEntry aot_entries[] = {\n");
+  for(pc = rc->base; pc < 0x10000; pc++)
+  {
+    if((rc->flags[pc] & RECOMP_COMPILED) && rc->func[pc] != 0)
+    {
+      fprintf(out, "  { 0x%04X, aot_%04X },\n", pc, rc->func[pc]);
+      entries++;
+    }
+  }
+  fprintf(out, "};\n\n");
+
+  fprintf(out, "const struct AotImage aot_image = {\n");
+  fprintf(out, "  .base = 0x%04X,\n", rc->base);
+  fprintf(out, "  .size = 0x%X,\n", 0x10000 - rc->base);
+  fprintf(out, "  .hash = 0x%08X,\n", aot_hash(rc->mem + rc->base, 0x10000 - rc->base));
+  fprintf(out, "  .entries = aot_entries,\n");
+  fprintf(out, "  .count = %d,\n", entries);
+  fprintf(out, "};\n");
+
+  log_info("Recompiled %d instructions in %d functions", entries, functions);
+
+  return 0;
+}
+
+/*----------------------------------------------------------------------------*/
+static int load(struct Recomp *rc, const char *filename)
+{
+  FILE *in = NULL;
+  long size = 0;
+
+  in = fopen(filename, "rb");
+  if(in == NULL)
+  {
+    log_error("Could not open %s", filename);
+    return -1;
+  }
+  fseek(in, 0, SEEK_END);
+  size = ftell(in);
+  fseek(in, 0, SEEK_SET);
+
+  /* Either a full 64K image or the ROM part only */
+  if(size == 0x10000)
+  {
+    size = fread(rc->mem, 1, 0x10000, in) == 0x10000 ? 0 : -1;
+  }
+  else if(size == 0x10000 - rc->base)
+  {
+    size = fread(rc->mem + rc->base, 1, size, in) == size ? 0 : -1;
+  }
+  else
+  {
+    log_error("%s is neither a 64K image nor a 0x%X byte ROM", filename, 0x10000 - rc->base);
+    size = -1;
+  }
+  fclose(in);
+
+  return size;
+}
+
+/*----------------------------------------------------------------------------*/
+int main(int argc, char *argv[])
+{
+  struct Recomp *rc = NULL;
+  FILE *out = NULL;
+  int opt = 0;
+  int ret = 1;
+
+  rc = calloc(1, sizeof(struct Recomp));
+  if(rc == NULL)
+  {
+    log_error("Could not allocate memory for struct Recomp");
+    return 1;
+  }
+  rc->base = 0x8000;
+
+  while((opt = getopt(argc, argv, "b:")) != -1)
+  {
+    switch(opt)
+    {
+      case 'b':
+        rc->base = strtoul(optarg, NULL, 0) & 0xFF00;
+        break;
+      default:
+        optind = argc;
+        break;
+    }
+  }
+
+  if(argc - optind != 2 || rc->base == 0)
+  {
+    fprintf(stderr, "Usage: %s [-b base] image.bin output.c\n", argv[0]);
+    free(rc);
+    return 1;
+  }
+
+  rc->work = malloc((0x10000 * 2 + 4) * sizeof(uint16_t));
+  if(rc->work == NULL)
+  {
+    log_error("Could not allocate memory for work list");
+    free(rc);
+    return 1;
+  }
+
+  if(load(rc, argv[optind]) == 0)
+  {
+    discover(rc);
+
+    out = fopen(argv[optind + 1], "w");
+    if(out == NULL)
+    {
+      log_error("Could not create %s", argv[optind + 1]);
+    }
+    else
+    {
+      ret = emit(rc, out, argv[optind]) == 0 ? 0 : 1;
+      fclose(out);
+    }
+  }
+
+  free(rc->work);
+  free(rc);
+
+  return ret;
+}
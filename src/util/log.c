@@ -188,10 +188,13 @@ int log_add_fp(FILE *fp, int level)
 /*----------------------------------------------------------------------------*/
 static void init_event(log_Event *ev, void *udata)
 {
+  /* Device threads log too */
+  static __thread struct tm tm;
+
   if(!ev->time)
   {
     time_t t = time(NULL);
-    ev->time = localtime(&t);
+    ev->time = localtime_r(&t, &tm);
   }
   ev->udata = udata;
 }
@@ -0,0 +1,129 @@
+/*
+ * Copyright (c) 2022, Bernd Bauer <bernd.bauer@gmx.at>
+ *
+ * SPDX-License-Identifier: BSD-2-Clause
+ */
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "util/log.h"
+#include "util/ring.h"
+
+/*----------------------------------------------------------------------------*/
+struct Ring* ring_create(uint32_t size, uint32_t elem)
+{
+  struct Ring *ring = NULL;
+
+  if(size == 0 || (size & (size - 1)) != 0)
+  {
+    log_error("Ring size %u is no power of two", size);
+    return NULL;
+  }
+  if(elem == 0)
+  {
+    log_error("Ring elements of no size");
+    return NULL;
+  }
+
+  ring = malloc(sizeof(struct Ring));
+  if(ring == NULL)
+  {
+    log_error("Could not allocate memory for struct Ring");
+    return NULL;
+  }
+
+  ring->buf = malloc((size_t)size * elem);
+  if(ring->buf == NULL)
+  {
+    log_error("Could not allocate memory for ring buffer");
+    free(ring);
+    return NULL;
+  }
+
+  ring->size = size;
+  ring->elem = elem;
+  ring->head = 0;
+  ring->tail = 0;
+
+  return ring;
+}
+
+/*----------------------------------------------------------------------------*/
+void ring_destroy(struct Ring **ring)
+{
+  if(*ring)
+  {
+    free((*ring)->buf);
+    free(*ring);
+    *ring = NULL;
+  }
+}
+
+/*----------------------------------------------------------------------------*/
+uint32_t ring_push(struct Ring *ring, const void *data, uint32_t count)
+{
+  uint32_t head = ring->head;
+  uint32_t tail = __atomic_load_n(&ring->tail, __ATOMIC_ACQUIRE);
+  uint32_t space = ring->size - (head - tail);
+  uint32_t pos = head & (ring->size - 1);
+  uint32_t first = 0;
+
+  count = count < space ? count : space;
+  first = ring->size - pos < count ? ring->size - pos : count;
+
+  memcpy(ring->buf + (size_t)pos * ring->elem, data, (size_t)first * ring->elem);
+  memcpy(ring->buf, (const uint8_t*)data + (size_t)first * ring->elem, (size_t)(count - first) * ring->elem);
+
+  /* Publish the elements before the new head */
+  __atomic_store_n(&ring->head, head + count, __ATOMIC_RELEASE);
+
+  return count;
+}
+
+/*----------------------------------------------------------------------------*/
+uint32_t ring_pop(struct Ring *ring, void *data, uint32_t count)
+{
+  count = ring_peek(ring, data, count);
+
+  /* Hand the space back only after the elements were copied out */
+  ring_drop(ring, count);
+
+  return count;
+}
+
+/*----------------------------------------------------------------------------*/
+uint32_t ring_peek(struct Ring *ring, void *data, uint32_t count)
+{
+  uint32_t tail = __atomic_load_n(&ring->tail, __ATOMIC_ACQUIRE);
+  uint32_t head = __atomic_load_n(&ring->head, __ATOMIC_ACQUIRE);
+  uint32_t avail = head - tail;
+  uint32_t pos = tail & (ring->size - 1);
+  uint32_t first = 0;
+
+  count = count < avail ? count : avail;
+  first = ring->size - pos < count ? ring->size - pos : count;
+
+  memcpy(data, ring->buf + (size_t)pos * ring->elem, (size_t)first * ring->elem);
+  memcpy((uint8_t*)data + (size_t)first * ring->elem, ring->buf, (size_t)(count - first) * ring->elem);
+
+  return count;
+}
+
+/*----------------------------------------------------------------------------*/
+void ring_drop(struct Ring *ring, uint32_t count)
+{
+  __atomic_store_n(&ring->tail, ring->tail + count, __ATOMIC_RELEASE);
+}
+
+/*----------------------------------------------------------------------------*/
+uint32_t ring_count(struct Ring *ring)
+{
+  return __atomic_load_n(&ring->head, __ATOMIC_ACQUIRE) - __atomic_load_n(&ring->tail, __ATOMIC_ACQUIRE);
+}
+
+/*----------------------------------------------------------------------------*/
+uint32_t ring_free(struct Ring *ring)
+{
+  return ring->size - ring_count(ring);
+}
@@ -13,14 +13,16 @@
 #include "util/tools.h"
 #include "core/memory.h"
 
+#define IHEX_RECORD_SIZE 16
+
 static int file_exists(const char *filename);
+static int file_hexByte(const char *p);
 
 
 /*----------------------------------------------------------------------------*/
 int memory_loadFromFile(struct Memory* mem, uint32_t pos, char* filename, uint32_t off, uint32_t count)
 {
   uint32_t size = 0;
-  int i = 0;
   FILE *fp = NULL;
 
   if(mem==NULL)
@@ -28,9 +30,10 @@ int memory_loadFromFile(struct Memory* mem, uint32_t pos, char* filename, uint32
     log_error("Pointer to struct memory is NULL");
     return -1;
   }
-  if(pos + count - mem->baseaddr > mem->size)
+  if(pos < mem->baseaddr || pos + count - mem->baseaddr > mem->size)
   {
     log_error("An attempt is made to write beyond the memory end.");
+    return -1;
   }
 
   if((size = file_exists(filename)) == 0)
@@ -51,25 +54,186 @@ int memory_loadFromFile(struct Memory* mem, uint32_t pos, char* filename, uint32
     return -1;
   }
 
-  fseek(fp, off, SEEK_SET);
+  /* Straight into the backing store, images are loaded at every start */
+  if(fseek(fp, off, SEEK_SET) != 0 ||
+     fread(mem->mem + (pos - mem->baseaddr), sizeof(uint8_t), count, fp) != count)
+  {
+    log_error("Error reading file");
+    fclose(fp);
+    return -1;
+  }
+
+  fclose(fp);
+
+  return 0;
+}
+
+/*----------------------------------------------------------------------------*/
+int file_saveBinary(const char *filename, const uint8_t *data, uint32_t len)
+{
+  FILE *fp = NULL;
+
+  fp = fopen(filename, "wb");
+  if(fp == NULL)
+  {
+    log_error("Could not open file %s", filename);
+    return -1;
+  }
+
+  if(fwrite(data, sizeof(uint8_t), len, fp) != len)
+  {
+    log_error("Error writing file %s", filename);
+    fclose(fp);
+    return -1;
+  }
+
+  if(fclose(fp) != 0)
+  {
+    log_error("Error writing file %s", filename);
+    return -1;
+  }
+
+  return 0;
+}
+
+/*----------------------------------------------------------------------------*/
+int file_saveIntelHex(const char *filename, uint16_t addr, const uint8_t *data, uint32_t len)
+{
+  FILE *fp = NULL;
+  uint32_t pos = 0;
+
+  if(len > 0x10000 - addr)
+  {
+    log_error("Intel HEX range 0x%04x + 0x%04x exceeds the address space", addr, len);
+    return -1;
+  }
+
+  fp = fopen(filename, "w");
+  if(fp == NULL)
+  {
+    log_error("Could not open file %s", filename);
+    return -1;
+  }
 
-  for(i=0; i < count; i++)
+  /* Data records with up to 16 bytes each */
+  for(pos = 0; pos < len; pos += IHEX_RECORD_SIZE)
   {
-    uint8_t data = 0;
-    if(fread(&data, sizeof(uint8_t), 1, fp) != 1)
+    uint32_t count = len - pos < IHEX_RECORD_SIZE ? len - pos : IHEX_RECORD_SIZE;
+    uint16_t rec = addr + pos;
+    uint8_t sum = count + (rec >> 8) + (rec & 0xff);
+    uint32_t i = 0;
+
+    fprintf(fp, ":%02X%04X00", count, rec);
+    for(i = 0; i < count; i++)
     {
-      log_error("Error reading file");
+      fprintf(fp, "%02X", data[pos + i]);
+      sum += data[pos + i];
+    }
+    fprintf(fp, "%02X\n", (uint8_t)-sum);
+  }
+
+  /* End of file record */
+  fprintf(fp, ":00000001FF\n");
+
+  if(fclose(fp) != 0)
+  {
+    log_error("Error writing file %s", filename);
+    return -1;
+  }
+
+  return 0;
+}
+
+/*----------------------------------------------------------------------------*/
+int file_loadIntelHex(const char *filename, uint8_t *data, uint32_t size)
+{
+  FILE *fp = NULL;
+  char line[600];
+  int loaded = 0;
+  int line_no = 0;
+
+  fp = fopen(filename, "r");
+  if(fp == NULL)
+  {
+    log_error("Could not open file %s", filename);
+    return -1;
+  }
+
+  while(fgets(line, sizeof(line), fp) != NULL)
+  {
+    int count = 0;
+    int type = 0;
+    uint32_t rec = 0;
+    uint8_t sum = 0;
+    int i = 0;
+
+    line_no++;
+    if(line[0] != ':')
+    {
+      continue;
+    }
+
+    /* Byte count, address, type, data and checksum all sum up to zero */
+    count = file_hexByte(line + 1);
+    for(i = 0; count >= 0 && i < count + 5; i++)
+    {
+      int byte = file_hexByte(line + 1 + 2 * i);
+      if(byte < 0)
+      {
+        count = -1;
+        break;
+      }
+      sum += byte;
+    }
+    if(count < 0 || sum != 0)
+    {
+      log_error("%s:%d: Invalid Intel HEX record", filename, line_no);
+      fclose(fp);
+      return -1;
+    }
+
+    rec = (file_hexByte(line + 3) << 8) | file_hexByte(line + 5);
+    type = file_hexByte(line + 7);
+    if(type == 0x01)
+    {
+      break;
+    }
+    if(type != 0x00)
+    {
+      log_warn("%s:%d: Ignoring Intel HEX record type %02x", filename, line_no, type);
+      continue;
+    }
+
+    /* Records do not wrap around the end of the address space */
+    if(rec >= size || count > size - rec)
+    {
+      log_error("%s:%d: Intel HEX record 0x%04x + 0x%02x exceeds the address space", filename, line_no, rec, count);
       fclose(fp);
       return -1;
     }
-    log_set_quiet(true);
-    memory_writeByte(mem, pos + i, data);
-    log_set_quiet(false);
+
+    for(i = 0; i < count; i++)
+    {
+      data[rec + i] = file_hexByte(line + 9 + 2 * i);
+    }
+    loaded += count;
   }
 
   fclose(fp);
 
-  return 0;
+  return loaded;
+}
+
+/*----------------------------------------------------------------------------*/
+static int file_hexByte(const char *p)
+{
+  if(!isxdigit((unsigned char)p[0]) || !isxdigit((unsigned char)p[1]))
+  {
+    return -1;
+  }
+
+  return (isdigit((unsigned char)p[0]) ? p[0] - '0' : (toupper((unsigned char)p[0]) - 'A' + 10)) << 4 |
+         (isdigit((unsigned char)p[1]) ? p[1] - '0' : (toupper((unsigned char)p[1]) - 'A' + 10));
 }
 
 /*----------------------------------------------------------------------------*/